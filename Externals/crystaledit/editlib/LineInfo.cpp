@@ -6,6 +6,7 @@
 
 #include "stdafx.h"
 #include "LineInfo.h"
+#include "TextArena.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -19,6 +20,7 @@ LineInfo::LineInfo()
 , m_nLength(0)
 , m_nMax(0)
 , m_nEolChars(0)
+, m_bInArena(false)
 , m_dwFlags(0)
 , m_dwRevisionNumber(0)
 {
@@ -32,10 +34,8 @@ void LineInfo::Clear()
 {
   if (m_pcLine != nullptr)
     {
-      delete[] m_pcLine;
-      m_pcLine = nullptr;
+      ReplaceBuffer(nullptr, 0);
       m_nLength = 0;
-      m_nMax = 0;
       m_nEolChars = 0;
       m_dwFlags = 0;
       m_dwRevisionNumber = 0;
@@ -50,10 +50,8 @@ void LineInfo::FreeBuffer()
 {
   if (m_pcLine != nullptr)
     {
-      delete[] m_pcLine;
-      m_pcLine = nullptr;
+      ReplaceBuffer(nullptr, 0);
       m_nLength = 0;
-      m_nMax = 0;
       m_nEolChars = 0;
     }
 }
@@ -73,17 +71,46 @@ void LineInfo::Create(LPCTSTR pszLine, size_t nLength)
 
   ASSERT (nLength <= INT_MAX);		// assert "positive int"
   m_nLength = nLength;
-  m_nMax = ALIGN_BUF_SIZE (m_nLength + 1);
-  ASSERT (m_nMax < INT_MAX);
-  ASSERT (m_nMax >= m_nLength + 1);
-  if (m_pcLine != nullptr)
-    delete[] m_pcLine;
-  m_pcLine = new TCHAR[m_nMax];
+  size_t nMax = ALIGN_BUF_SIZE (m_nLength + 1);
+  ASSERT (nMax < INT_MAX);
+  ASSERT (nMax >= m_nLength + 1);
+  ReplaceBuffer(new TCHAR[nMax], nMax);
   ZeroMemory(m_pcLine, m_nMax * sizeof(TCHAR));
   const size_t dwLen = sizeof (TCHAR) * m_nLength;
   CopyMemory (m_pcLine, pszLine, dwLen);
   m_pcLine[m_nLength] = '\0';
+  DetectEol();
+}
+
+/**
+ * @brief Create a line stored in a text arena.
+ * Loading a file this way does not allocate memory for each line. If the
+ * line grows later, it is copied to memory allocated for the line.
+ * @param [in] pszLine Line data.
+ * @param [in] nLength Line length.
+ * @param [in] arena Arena storing the line, must live longer than the line.
+ */
+void LineInfo::Create(LPCTSTR pszLine, size_t nLength, TextArena & arena)
+{
+  if (nLength == 0)
+    {
+      CreateEmpty();
+      return;
+    }
 
+  ASSERT (nLength <= INT_MAX);		// assert "positive int"
+  m_nLength = nLength;
+  ReplaceBuffer(arena.Append(pszLine, nLength), nLength + 1, true);
+  DetectEol();
+}
+
+/**
+ * @brief Split the EOL bytes at the end of the line from the line length.
+ */
+void LineInfo::DetectEol()
+{
+  const size_t nLength = m_nLength;
+  LPCTSTR pszLine = m_pcLine;
   int nEols = 0;
   if (nLength > 1 && IsDosEol(&pszLine[nLength - 2]))
     nEols = 2;
@@ -101,9 +128,8 @@ void LineInfo::CreateEmpty()
 {
   m_nLength = 0;
   m_nEolChars = 0;
-  m_nMax = ALIGN_BUF_SIZE (m_nLength + 1);
-  delete [] m_pcLine;
-  m_pcLine = new TCHAR[m_nMax];
+  size_t nMax = ALIGN_BUF_SIZE (m_nLength + 1);
+  ReplaceBuffer(new TCHAR[nMax], nMax);
   ZeroMemory(m_pcLine, m_nMax * sizeof(TCHAR));
 }
 
@@ -118,14 +144,13 @@ void LineInfo::Append(LPCTSTR pszChars, size_t nLength, bool bDetectEol)
   size_t nBufNeeded = m_nLength + m_nEolChars + nLength + 1;
   if (nBufNeeded > m_nMax)
     {
-      m_nMax = ALIGN_BUF_SIZE (nBufNeeded);
-      ASSERT (m_nMax < INT_MAX);
-      ASSERT (m_nMax >= m_nLength + nLength);
-      TCHAR *pcNewBuf = new TCHAR[m_nMax];
+      size_t nMax = ALIGN_BUF_SIZE (nBufNeeded);
+      ASSERT (nMax < INT_MAX);
+      ASSERT (nMax >= m_nLength + nLength);
+      TCHAR *pcNewBuf = new TCHAR[nMax];
       if (FullLength() > 0)
         memcpy (pcNewBuf, m_pcLine, sizeof (TCHAR) * (FullLength() + 1));
-      delete[] m_pcLine;
-      m_pcLine = pcNewBuf;
+      ReplaceBuffer(pcNewBuf, nMax);
     }
 
   memcpy (m_pcLine + m_nLength + m_nEolChars, pszChars, sizeof (TCHAR) * nLength);
@@ -191,13 +216,12 @@ bool LineInfo::ChangeEol(LPCTSTR lpEOL)
   ASSERT (nBufNeeded < INT_MAX);
   if (nBufNeeded > m_nMax)
     {
-      m_nMax = ALIGN_BUF_SIZE (nBufNeeded);
-      ASSERT (m_nMax >= nBufNeeded);
-      TCHAR *pcNewBuf = new TCHAR[m_nMax];
+      size_t nMax = ALIGN_BUF_SIZE (nBufNeeded);
+      ASSERT (nMax >= nBufNeeded);
+      TCHAR *pcNewBuf = new TCHAR[nMax];
       if (FullLength() > 0)
         memcpy (pcNewBuf, m_pcLine, sizeof (TCHAR) * (FullLength() + 1));
-      delete[] m_pcLine;
-      m_pcLine = pcNewBuf;
+      ReplaceBuffer(pcNewBuf, nMax);
     }
   
   // copy also the 0 to zero-terminate the line
@@ -216,7 +240,7 @@ void LineInfo::Delete(size_t nStartChar, size_t nEndChar)
   if (nEndChar < Length() || m_nEolChars)
     {
       // preserve characters after deleted range by shifting up
-      memcpy (m_pcLine + nStartChar, m_pcLine + nEndChar,
+      memmove (m_pcLine + nStartChar, m_pcLine + nEndChar,
               sizeof (TCHAR) * (FullLength() - nEndChar));
     }
   size_t nDelete = (nEndChar - nStartChar);
@@ -255,9 +279,9 @@ void LineInfo::DeleteEnd(size_t nStartChar)
  */
 void LineInfo::CopyFrom(const LineInfo &li)
 {
-  delete [] m_pcLine;
-  m_pcLine = new TCHAR[li.m_nMax];
-  memcpy(m_pcLine, li.m_pcLine, li.m_nMax * sizeof(TCHAR));
+  TCHAR *pcNewBuf = new TCHAR[li.m_nMax];
+  memcpy(pcNewBuf, li.m_pcLine, li.m_nMax * sizeof(TCHAR));
+  ReplaceBuffer(pcNewBuf, li.m_nMax);
 }
 
 /**
@@ -281,3 +305,19 @@ LPCTSTR LineInfo::GetLine(size_t index) const
 {
   return &m_pcLine[index];
 }
+
+/**
+ * @brief Replace line data buffer, freeing the old one if it was allocated
+ * for the line.
+ * @param [in] pcNewBuf New buffer.
+ * @param [in] nMax Size of the new buffer.
+ * @param [in] bInArena Is the new buffer stored in a TextArena?
+ */
+void LineInfo::ReplaceBuffer(TCHAR *pcNewBuf, size_t nMax, bool bInArena)
+{
+  if (!m_bInArena)
+    delete[] m_pcLine;
+  m_pcLine = pcNewBuf;
+  m_nMax = nMax;
+  m_bInArena = bInArena;
+}
@@ -7,6 +7,8 @@
 
 #pragma once
 
+class TextArena;
+
 //  Line allocation granularity
 #define     CHAR_ALIGN                  16
 #define     ALIGN_BUF_SIZE(size)        ((size) / CHAR_ALIGN) * CHAR_ALIGN + CHAR_ALIGN;
@@ -25,6 +27,7 @@ public:
     void Clear();
     void FreeBuffer();
     void Create(LPCTSTR pszLine, size_t nLength);
+    void Create(LPCTSTR pszLine, size_t nLength, TextArena & arena);
     void CreateEmpty();
     void Append(LPCTSTR pszChars, size_t nLength, bool bDetectEol = true);
     void Delete(size_t nStartChar, size_t nEndChar);
@@ -58,4 +61,8 @@ private:
     size_t m_nMax; /**< Allocated space for line data. */
     size_t m_nLength; /**< Line length (without EOL bytes). */
     int m_nEolChars; /**< # of EOL bytes. */
+    bool m_bInArena; /**< Line data is stored in a TextArena, not allocated for the line. */
+
+    void ReplaceBuffer(TCHAR *pcNewBuf, size_t nMax, bool bInArena = false);
+    void DetectEol();
   };
@@ -0,0 +1,122 @@
+/** 
+ * @file  TextArena.cpp
+ *
+ * @brief Implementation of TextArena class.
+ */
+
+#include <windows.h>
+#include <tchar.h>
+#include <algorithm>
+#include <cstring>
+#include "TextArena.h"
+
+/** @brief Size of text chunks, in characters. Longer texts get chunks of their own. */
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+/**
+ * @brief Store a text after the texts stored before.
+ * @return Stored text, terminated with a zero.
+ */
+LPTSTR TextArena::
+Append (LPCTSTR pszText, size_t cchText)
+{
+  if (m_chunks.empty () || m_chunks.back ().nUsed + cchText + 1 > m_chunks.back ().nCapacity)
+    {
+      Chunk chunk;
+      chunk.nCapacity = (std::max) (CHUNK_SIZE, cchText + 1);
+      chunk.data.reset (new TCHAR[chunk.nCapacity]);
+      chunk.nUsed = 0;
+      m_nMemorySize += chunk.nCapacity * sizeof (TCHAR);
+      m_chunks.push_back (std::move (chunk));
+    }
+  Chunk & chunk = m_chunks.back ();
+  TCHAR *pszStored = chunk.data.get () + chunk.nUsed;
+  memcpy (pszStored, pszText, cchText * sizeof (TCHAR));
+  pszStored[cchText] = _T('\0');
+  chunk.nUsed += cchText + 1;
+  m_nUsed += cchText + 1;
+  return pszStored;
+}
+
+/**
+ * @brief Append a text to the last stored text, if it fits in its chunk.
+ * @param [in] pszLast Last stored text.
+ * @param [in] cchLast Length of the last stored text.
+ * @return false if the text was not appended.
+ */
+bool TextArena::
+Extend (LPCTSTR pszLast, size_t cchLast, LPCTSTR pszText, size_t cchText)
+{
+  if (m_chunks.empty () || pszLast == nullptr)
+    return false;
+  Chunk & chunk = m_chunks.back ();
+  TCHAR *pszEnd = chunk.data.get () + chunk.nUsed;
+  if (pszLast + cchLast + 1 != pszEnd || chunk.nUsed + cchText > chunk.nCapacity)
+    return false;
+  TCHAR *pszAppend = pszEnd - 1;
+  memcpy (pszAppend, pszText, cchText * sizeof (TCHAR));
+  pszAppend[cchText] = _T('\0');
+  chunk.nUsed += cchText;
+  m_nUsed += cchText;
+  return true;
+}
+
+/**
+ * @brief Release the texts stored after a text.
+ * @param [in] pszEnd End of the last text to keep, after its terminating zero.
+ */
+void TextArena::
+Truncate (LPCTSTR pszEnd)
+{
+  while (!m_chunks.empty ())
+    {
+      Chunk & chunk = m_chunks.back ();
+      if (pszEnd > chunk.data.get () && pszEnd <= chunk.data.get () + chunk.nUsed)
+        {
+          const size_t nUsed = pszEnd - chunk.data.get ();
+          m_nUsed -= chunk.nUsed - nUsed;
+          chunk.nUsed = nUsed;
+          if (m_chunks.size () == 1)
+            m_nReleased = (std::min) (m_nReleased, nUsed);
+          return;
+        }
+      m_nMemorySize -= chunk.nCapacity * sizeof (TCHAR);
+      m_nUsed -= chunk.nUsed;
+      m_chunks.pop_back ();
+    }
+  m_nReleased = 0;
+}
+
+/**
+ * @brief Release the texts stored before a text.
+ * Chunks holding only released texts are freed. Released texts in the
+ * chunk of the given text are not counted by GetUsedSize() any more.
+ */
+void TextArena::
+ReleaseBefore (LPCTSTR pszText)
+{
+  while (!m_chunks.empty ())
+    {
+      Chunk & chunk = m_chunks.front ();
+      if (pszText >= chunk.data.get () && pszText < chunk.data.get () + chunk.nUsed)
+        {
+          m_nReleased = (std::max) (m_nReleased, static_cast<size_t> (pszText - chunk.data.get ()));
+          return;
+        }
+      if (m_chunks.size () == 1)
+        return;
+      m_nMemorySize -= chunk.nCapacity * sizeof (TCHAR);
+      m_nUsed -= chunk.nUsed;
+      m_nReleased = 0;
+      m_chunks.pop_front ();
+    }
+}
+
+void TextArena::
+Clear ()
+{
+  m_chunks.clear ();
+  m_nMemorySize = 0;
+  m_nUsed = 0;
+  m_nReleased = 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file TextArena.h
+ *
+ * @brief Declaration for TextArena class.
+ *
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+
+/**
+ * @brief Append-only storage for texts.
+ *
+ * Texts are stored one after another in large chunks, so storing a text
+ * does not allocate memory for it, and the owner of a text only keeps a
+ * pointer to it. Chunks never move, so a text stays where it is until it
+ * is released by Truncate(), ReleaseBefore() or Clear().
+ * Text buffers keep the texts of undo records and of loaded lines here.
+ */
+class TextArena
+{
+public:
+  TextArena () : m_nMemorySize(0), m_nUsed(0), m_nReleased(0) {}
+
+  LPTSTR Append (LPCTSTR pszText, size_t cchText);
+  bool Extend (LPCTSTR pszLast, size_t cchLast, LPCTSTR pszText, size_t cchText);
+  void Truncate (LPCTSTR pszEnd);
+  void ReleaseBefore (LPCTSTR pszText);
+  void Clear ();
+
+  /** @brief Get memory allocated for texts, in bytes. */
+  size_t GetMemorySize () const { return m_nMemorySize; }
+  /** @brief Get memory used by texts not released yet, in bytes. */
+  size_t GetUsedSize () const { return (m_nUsed - m_nReleased) * sizeof (TCHAR); }
+
+private:
+  struct Chunk
+  {
+    std::unique_ptr<TCHAR[]> data;
+    size_t nUsed;
+    size_t nCapacity;
+  };
+
+  std::deque<Chunk> m_chunks;
+  size_t m_nMemorySize;
+  size_t m_nUsed;       /**< Characters used in all chunks */
+  size_t m_nReleased;   /**< Characters released at the start of the first chunk */
+};
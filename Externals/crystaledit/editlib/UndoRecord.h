@@ -1,91 +1,106 @@
-/**
- * @file UndoRecord.h
- *
- * @brief Declaration for UndoRecord structure.
- *
- */
-
-#pragma once
-
-class UndoRecord
-{
-public:
-  DWORD m_dwFlags;
-  CPoint m_ptStartPos, m_ptEndPos;  //  Block of text participating
-  int m_nAction;            //  For information only: action type
-  CDWordArray *m_paSavedRevisionNumbers;
-
-private:
-  //  TCHAR   *m_pcText;
-  //  Since in most cases we have 1 character here,
-  //  we should invent a better way. Note: 2 * sizeof(WORD) <= sizeof(TCHAR*)
-  //
-  //  Here we will use the following trick: on Win32 platforms high-order word
-  //  of any pointer will be != 0. So we can store 1 character strings without
-  //  allocating memory.
-  //
-  struct TextBuffer
-  {
-    size_t size;
-    TCHAR data[1];
-  };
-
-  union
-  {
-    TextBuffer *m_pszText;     //  For cases when we have > 1 character strings
-    TCHAR m_szText[2];    //  For single-character strings
-  };
-
-  public:
-  UndoRecord () // default constructor
-    : m_dwFlags(0)
-    , m_nAction(0)
-    , m_paSavedRevisionNumbers(nullptr)
-    , m_pszText(nullptr)
-  {
-  }
-
-  UndoRecord (const UndoRecord & src) // copy constructor
-    : m_dwFlags(0)
-    , m_nAction(0)
-    , m_paSavedRevisionNumbers(nullptr)
-    , m_pszText(nullptr)
-  {
-    UndoRecord::Clone(src);
-  }
-
-  virtual void Clone(const UndoRecord &src);
-
-  virtual UndoRecord & operator=(const UndoRecord & src) // copy assignment
-  {
-    Clone(src);
-    return *this;
-  }
-
-  virtual ~UndoRecord () // destructor
-  {
-    FreeText();
-    delete m_paSavedRevisionNumbers;
-  }
-
-  void SetText (LPCTSTR pszText, size_t cchText);
-  void FreeText ();
-
-  LPCTSTR GetText () const
-  {
-    // See the m_szText/m_pszText definition
-    // Check if m_pszText is a pointer by removing bits having
-    // possible char value
-    if (((INT_PTR)m_pszText >> 16) != 0)
-      return m_pszText->data;
-    return m_szText;
-  }
-
-  size_t GetTextLength () const
-  {
-    if (((INT_PTR)m_pszText >> 16) != 0)
-      return m_pszText->size;
-    return 1;
-  }
-};
-
+/**
+ * @file UndoRecord.h
+ *
+ * @brief Declaration for UndoRecord structure.
+ *
+ */
+
+#pragma once
+
+#include "TextArena.h"
+
+class UndoRecord
+{
+public:
+  DWORD m_dwFlags;
+  CPoint m_ptStartPos, m_ptEndPos;  //  Block of text participating
+  int m_nAction;            //  For information only: action type
+  CDWordArray *m_paSavedRevisionNumbers;
+
+private:
+  //  The text is owned by a TextArena of the text buffer, so copies
+  //  of a record share it.
+  LPCTSTR m_pszText;
+  size_t m_nTextLength;
+
+  public:
+  UndoRecord () // default constructor
+    : m_dwFlags(0)
+    , m_nAction(0)
+    , m_paSavedRevisionNumbers(nullptr)
+    , m_pszText(nullptr)
+    , m_nTextLength(0)
+  {
+  }
+
+  UndoRecord (const UndoRecord & src) // copy constructor
+    : m_dwFlags(0)
+    , m_nAction(0)
+    , m_paSavedRevisionNumbers(nullptr)
+    , m_pszText(nullptr)
+    , m_nTextLength(0)
+  {
+    UndoRecord::Clone(src);
+  }
+
+  UndoRecord (UndoRecord && src) noexcept // move constructor
+    : m_dwFlags(src.m_dwFlags)
+    , m_ptStartPos(src.m_ptStartPos)
+    , m_ptEndPos(src.m_ptEndPos)
+    , m_nAction(src.m_nAction)
+    , m_paSavedRevisionNumbers(src.m_paSavedRevisionNumbers)
+    , m_pszText(src.m_pszText)
+    , m_nTextLength(src.m_nTextLength)
+  {
+    src.m_paSavedRevisionNumbers = nullptr;
+  }
+
+  virtual void Clone(const UndoRecord &src);
+
+  virtual UndoRecord & operator=(const UndoRecord & src) // copy assignment
+  {
+    Clone(src);
+    return *this;
+  }
+
+  UndoRecord & operator=(UndoRecord && src) noexcept // move assignment
+  {
+    m_dwFlags = src.m_dwFlags;
+    m_ptStartPos = src.m_ptStartPos;
+    m_ptEndPos = src.m_ptEndPos;
+    m_nAction = src.m_nAction;
+    std::swap(m_paSavedRevisionNumbers, src.m_paSavedRevisionNumbers);
+    m_pszText = src.m_pszText;
+    m_nTextLength = src.m_nTextLength;
+    return *this;
+  }
+
+  virtual ~UndoRecord () // destructor
+  {
+    delete m_paSavedRevisionNumbers;
+  }
+
+  /** @brief Set text of the record, stored in a TextArena. */
+  void SetText (LPCTSTR pszText, size_t cchText)
+  {
+    m_pszText = pszText;
+    m_nTextLength = cchText;
+  }
+
+  LPCTSTR GetText () const
+  {
+    return m_pszText != nullptr ? m_pszText : _T("");
+  }
+
+  size_t GetTextLength () const
+  {
+    return m_nTextLength;
+  }
+
+  /** @brief Get memory used by the record itself and its saved revision numbers, in bytes. */
+  size_t GetMemorySize () const
+  {
+    return sizeof (UndoRecord) + sizeof (CDWordArray) +
+      (m_paSavedRevisionNumbers != nullptr ? m_paSavedRevisionNumbers->GetSize () * sizeof (DWORD) : 0);
+  }
+};
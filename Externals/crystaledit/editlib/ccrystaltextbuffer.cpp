@@ -157,6 +157,9 @@ CCrystalTextBuffer::CCrystalTextBuffer ()
   m_dwCurrentRevisionNumber = 0;
   m_dwRevisionNumberOnSave = 0;
   m_bUndoGroup = m_bUndoBeginGroup = false;
+  m_nLastUndoTextLength = 0;
+  m_nUndoMemoryLimit = 0;
+  m_nUndoRecordsSize = 0;
 
   // Table Editing
   m_bAllowNewlinesInQuotes = true;
@@ -220,6 +223,18 @@ void CCrystalTextBuffer::InsertLine (LPCTSTR pszLine, size_t nLength,
 #endif
 }
 
+/**
+ * @brief Add a line read from a file at the end of array.
+ * The line is stored in the line text arena, so loading a file does not
+ * allocate memory for each line.
+ */
+void CCrystalTextBuffer::
+InsertLoadedLine (LPCTSTR pszLine, size_t nLength)
+{
+  m_aLines.emplace_back ();
+  m_aLines.back ().Create (pszLine, nLength, m_lineTextArena);
+}
+
 // Add characters to end of specified line
 // Specified line must not have any EOL characters
 void CCrystalTextBuffer::
@@ -296,6 +311,7 @@ FreeAll ()
       ++iter;
     }
   m_aLines.clear();
+  m_lineTextArena.Clear();
 
   // Undo buffer will be cleared by its destructor
 
@@ -466,12 +482,12 @@ LoadFromFile (LPCTSTR pszFileName, CRLFSTYLE nCrlfStyle /*= CRLFSTYLE::AUTOMATIC
               int len = MultiByteToWideChar(CP_UTF8, 0, pcLineBuf, nCurrentLength, buf, nCurrentLength);
               if (m_nSourceEncoding >= 0)
                 iconvert(buf, m_nSourceEncoding, 1, m_nSourceEncoding == 15);
-              InsertLine(buf, len);
+              InsertLoadedLine(buf, len);
               delete[] buf;
 #else
               if (m_nSourceEncoding >= 0)
                 iconvert (pcLineBuf, m_nSourceEncoding, 1, m_nSourceEncoding == 15);
-              InsertLine (pcLineBuf, nCurrentLength);
+              InsertLoadedLine (pcLineBuf, nCurrentLength);
 #endif
               nCurrentLength = 0;
             }
@@ -481,10 +497,10 @@ LoadFromFile (LPCTSTR pszFileName, CRLFSTYLE nCrlfStyle /*= CRLFSTYLE::AUTOMATIC
 #ifdef _UNICODE
       wchar_t *buf = new wchar_t[nCurrentLength];
       int len = MultiByteToWideChar(CP_UTF8, 0, pcLineBuf, nCurrentLength, buf, nCurrentLength);
-      InsertLine(buf, len);
+      InsertLoadedLine(buf, len);
       delete[] buf;
 #else
-      InsertLine (&pcLineBuf[0], nCurrentLength);
+      InsertLoadedLine (&pcLineBuf[0], nCurrentLength);
 #endif
 
       ASSERT (m_aLines.size() > 0);   //  At least one empty line must present
@@ -1502,8 +1518,7 @@ Undo (CCrystalTextView * pSource, CPoint & ptCursorPos)
       // If the Undo failed, clear the entire Undo/Redo stack
       // Not only can we not Redo the failed Undo, but the Undo
       // may have partially completed (if in a group)
-      m_nUndoPosition = 0;
-      m_aUndoBuf.clear ();
+      ClearUndoHistory ();
     }
   else
     {
@@ -1598,7 +1613,24 @@ AddUndoRecord (bool bInsert, const CPoint & ptStartPos,
   int nBufSize = (int) m_aUndoBuf.size ();
   if (m_nUndoPosition < nBufSize)
     {
+      for (int i = m_nUndoPosition; i < nBufSize; ++i)
+        m_nUndoRecordsSize -= m_aUndoBuf[i].GetMemorySize ();
       m_aUndoBuf.resize (m_nUndoPosition);
+      if (m_aUndoBuf.empty ())
+        m_undoTextArena.Clear ();
+      else
+        {
+          const UndoRecord & last = m_aUndoBuf.back ();
+          m_undoTextArena.Truncate (last.GetText () + last.GetTextLength () + 1);
+        }
+    }
+
+  m_nLastUndoTextLength = cchText;
+  if (!m_bUndoBeginGroup && MergeUndoRecord (bInsert, ptStartPos, ptEndPos, pszText, cchText, nActionType))
+    {
+      //  The previous record saved the older revision numbers already
+      delete paSavedRevisionNumbers;
+      return;
     }
 
   //  Add new record
@@ -1609,24 +1641,127 @@ AddUndoRecord (bool bInsert, const CPoint & ptStartPos,
     {
       ur.m_dwFlags |= UNDO_BEGINGROUP;
       m_bUndoBeginGroup = false;
+      //  Only whole groups can be discarded, and never the one just started
+      LimitUndoMemory ();
     }
   ur.m_ptStartPos = ptStartPos;
   ur.m_ptEndPos = ptEndPos;
-  ur.SetText (pszText, cchText);
+  ur.SetText (m_undoTextArena.Append (pszText, cchText), cchText);
   ur.m_paSavedRevisionNumbers = paSavedRevisionNumbers;
 
   // Optimize memory allocation
   if (m_aUndoBuf.capacity() == m_aUndoBuf.size())
+    m_aUndoBuf.reserve((std::max) (m_aUndoBuf.size() * 2, static_cast<size_t>(16)));
+  m_nUndoRecordsSize += ur.GetMemorySize ();
+  m_aUndoBuf.push_back (std::move (ur));
+  m_nUndoPosition = (int) m_aUndoBuf.size ();
+}
+
+/**
+ * @brief Merge an edit into the last undo record of the same group.
+ * Typing characters one by one, or deleting them with the Delete key,
+ * extends the last record instead of adding a record per character.
+ * Edits containing EOLs are never merged, so undo restores the same
+ * lines and revision numbers as without merging.
+ * @return true if the edit was merged.
+ */
+bool CCrystalTextBuffer::
+MergeUndoRecord (bool bInsert, const CPoint & ptStartPos, const CPoint & ptEndPos,
+                 LPCTSTR pszText, size_t cchText, int nActionType)
+{
+  //  Undoing must stop at the saved state
+  if (m_aUndoBuf.empty () || m_nSyncPosition == m_nUndoPosition)
+    return false;
+  UndoRecord & prev = m_aUndoBuf.back ();
+  if (((prev.m_dwFlags & UNDO_INSERT) != 0) != bInsert || prev.m_nAction != nActionType)
+    return false;
+  if (ptStartPos.y != ptEndPos.y || prev.m_ptStartPos.y != ptStartPos.y || prev.m_ptEndPos.y != ptStartPos.y)
+    return false;
+  if (bInsert ? prev.m_ptEndPos.x != ptStartPos.x : prev.m_ptStartPos.x != ptStartPos.x)
+    return false;
+  for (size_t i = 0; i < cchText; ++i)
     {
-      if (m_aUndoBuf.size() == 0)
-        m_aUndoBuf.reserve(16);
-      else if (m_aUndoBuf.size() < 1025)
-        m_aUndoBuf.reserve(m_aUndoBuf.size() * 2);
-      else
-        m_aUndoBuf.reserve(m_aUndoBuf.size() + 1024);
+      if (pszText[i] == '\r' || pszText[i] == '\n')
+        return false;
     }
-  m_aUndoBuf.push_back (ur);
-  m_nUndoPosition = (int) m_aUndoBuf.size ();
+  if (!m_undoTextArena.Extend (prev.GetText (), prev.GetTextLength (), pszText, cchText))
+    return false;
+  prev.SetText (prev.GetText (), prev.GetTextLength () + cchText);
+  prev.m_ptEndPos.x += ptEndPos.x - ptStartPos.x;
+  return true;
+}
+
+/**
+ * @brief Discard the oldest undo groups while the undo history uses more
+ * memory than allowed.
+ * Discards down to 3/4 of the limit, so that this is not repeated for
+ * every new group.
+ */
+void CCrystalTextBuffer::
+LimitUndoMemory ()
+{
+  if (m_nUndoMemoryLimit == 0 || GetUndoMemorySize () <= m_nUndoMemoryLimit)
+    return;
+  const size_t nTarget = m_nUndoMemoryLimit / 4 * 3;
+  size_t nMemorySize = GetUndoMemorySize ();
+  const int nRecords = m_nUndoPosition;
+  int nDiscard = 0;
+  int nGroups = 0;
+  for (int i = 0; i < nRecords && nMemorySize > nTarget; )
+    {
+      int j = i + 1;
+      size_t nGroupSize = m_aUndoBuf[i].GetMemorySize () + (m_aUndoBuf[i].GetTextLength () + 1) * sizeof (TCHAR);
+      while (j < nRecords && (m_aUndoBuf[j].m_dwFlags & UNDO_BEGINGROUP) == 0)
+        {
+          nGroupSize += m_aUndoBuf[j].GetMemorySize () + (m_aUndoBuf[j].GetTextLength () + 1) * sizeof (TCHAR);
+          ++j;
+        }
+      nMemorySize -= (std::min) (nGroupSize, nMemorySize);
+      nDiscard = j;
+      ++nGroups;
+      i = j;
+    }
+  if (nDiscard == 0)
+    return;
+  if (nDiscard < static_cast<int> (m_aUndoBuf.size ()))
+    m_undoTextArena.ReleaseBefore (m_aUndoBuf[nDiscard].GetText ());
+  else
+    m_undoTextArena.Clear ();
+  for (int i = 0; i < nDiscard; ++i)
+    m_nUndoRecordsSize -= m_aUndoBuf[i].GetMemorySize ();
+  m_aUndoBuf.erase (m_aUndoBuf.begin (), m_aUndoBuf.begin () + nDiscard);
+  //  Records are movable, so giving back unused capacity is cheap
+  if (m_aUndoBuf.capacity () > m_aUndoBuf.size () * 2)
+    m_aUndoBuf.shrink_to_fit ();
+  m_nUndoPosition -= nDiscard;
+  //  The saved state can not be reached by undo any more
+  m_nSyncPosition = m_nSyncPosition >= nDiscard ? m_nSyncPosition - nDiscard : -1;
+  OnDiscardUndoGroups (nGroups);
+}
+
+/**
+ * @brief Get memory used by undo history, in bytes.
+ * Counts the records, their saved revision numbers and their texts not
+ * discarded yet, so that the size goes down as soon as old undo groups are
+ * discarded.
+ */
+size_t CCrystalTextBuffer::
+GetUndoMemorySize () const
+{
+  return m_undoTextArena.GetUsedSize () + m_nUndoRecordsSize;
+}
+
+/**
+ * @brief Discard all undo and redo records.
+ */
+void CCrystalTextBuffer::
+ClearUndoHistory ()
+{
+  m_aUndoBuf.clear ();
+  m_nUndoRecordsSize = 0;
+  m_undoTextArena.Clear ();
+  m_nUndoPosition = 0;
+  m_nLastUndoTextLength = 0;
 }
 
 /**
@@ -1931,7 +2066,10 @@ FlushUndoGroup (CCrystalTextView * pSource)
       ASSERT (static_cast<size_t>(m_nUndoPosition) <= m_aUndoBuf.size());
       if (m_nUndoPosition > 0)
         {
-          pSource->OnEditOperation (m_aUndoBuf[m_nUndoPosition - 1].m_nAction, m_aUndoBuf[m_nUndoPosition - 1].GetText (), m_aUndoBuf[m_nUndoPosition - 1].GetTextLength ());
+          //  The last record may hold several merged edits, report only the last one
+          const UndoRecord & ur = m_aUndoBuf[m_nUndoPosition - 1];
+          const size_t cchText = (std::min) (m_nLastUndoTextLength, ur.GetTextLength ());
+          pSource->OnEditOperation (ur.m_nAction, ur.GetText () + ur.GetTextLength () - cchText, cchText);
         }
     }
   m_bUndoGroup = false;
@@ -2124,8 +2262,7 @@ void CCrystalTextBuffer::JoinLinesForTableEditingMode ()
       j = 0;
       bInQuote = false;
     }
-  m_aUndoBuf.clear();
-  m_nUndoPosition = 0;
+  ClearUndoHistory ();
   m_bModified = false;
 }
 
@@ -2153,8 +2290,7 @@ void CCrystalTextBuffer::SplitLinesForTableEditingMode ()
             }
         }
     }
-  m_aUndoBuf.clear ();
-  m_nUndoPosition = 0;
+  ClearUndoHistory ();
   m_bModified = false;
 }
 
@@ -33,6 +33,7 @@
 
 #include <vector>
 #include "LineInfo.h"
+#include "TextArena.h"
 #include "UndoRecord.h"
 #include "ccrystaltextview.h"
 
@@ -148,12 +149,17 @@ public :
 
     //  Lines of text
     std::vector<LineInfo> m_aLines; /**< Text lines. */
+    TextArena m_lineTextArena; /**< Texts of lines loaded from files. */
 
     //  Undo
     std::vector<UndoRecord> m_aUndoBuf; /**< Undo records. */
+    TextArena m_undoTextArena; /**< Texts of undo records. */
     int m_nUndoPosition;
     int m_nSyncPosition;
     bool m_bUndoGroup, m_bUndoBeginGroup;
+    size_t m_nLastUndoTextLength; /**< Length of the text of the last edit. */
+    size_t m_nUndoMemoryLimit; /**< Memory limit for undo history, 0 if no limit. */
+    size_t m_nUndoRecordsSize; /**< Memory used by undo records, without their texts. */
 
     //BEGIN SW
     /** Position where the last change was made. */
@@ -177,6 +183,7 @@ public :
 
     //  Helper methods
     void InsertLine (LPCTSTR pszLine, size_t nLength, int nPosition = -1, int nCount = 1);
+    void InsertLoadedLine (LPCTSTR pszLine, size_t nLength);
     void AppendLine (int nLineIndex, LPCTSTR pszChars, size_t nLength, bool bDetectEol = true);
     void MoveLine(int line1, int line2, int newline1);
     void SetEmptyLine(int nPosition, int nCount = 1);
@@ -190,6 +197,11 @@ public :
     virtual void AddUndoRecord (bool bInsert, const CPoint & ptStartPos, const CPoint & ptEndPos,
                                 LPCTSTR pszText, size_t cchText, int nActionType = CE_ACTION_UNKNOWN, CDWordArray *paSavedRevisionNumbers = nullptr);
     virtual UndoRecord GetUndoRecord (int nUndoPos) const { return m_aUndoBuf[nUndoPos]; }
+    bool MergeUndoRecord (bool bInsert, const CPoint & ptStartPos, const CPoint & ptEndPos,
+                          LPCTSTR pszText, size_t cchText, int nActionType);
+    void LimitUndoMemory ();
+    //  Overridable: called after the oldest undo groups were discarded
+    virtual void OnDiscardUndoGroups (int nGroups) {}
 
     virtual CDWordArray *CopyRevisionNumbers(int nStartLine, int nEndLine) const;
     virtual void RestoreRevisionNumbers(int nStartLine, CDWordArray *psaSavedRevisionNumbers);
@@ -273,6 +285,10 @@ public :
     //  Undo grouping
     virtual void BeginUndoGroup (bool bMergeWithPrevious = false);
     virtual void FlushUndoGroup (CCrystalTextView * pSource);
+    void ClearUndoHistory ();
+    size_t GetUndoMemorySize () const;
+    size_t GetUndoMemoryLimit () const { return m_nUndoMemoryLimit; }
+    void SetUndoMemoryLimit (size_t nLimit) { m_nUndoMemoryLimit = nLimit; }
 
     //BEGIN SW
     /**
@@ -27,6 +27,25 @@ bool CCrystalTextMarkers::SetMarker(const TCHAR *pKey, const CString& sFindWhat,
 	return true;
 }
 
+/**
+ * @brief Get the regular expression of a marker, compiled once.
+ * The expression is compiled again only when sFindWhat or dwFlags have
+ * changed since it was compiled.
+ * @return Compiled expression, nullptr if the marker is not a valid
+ * regular expression.
+ */
+RxNode *CCrystalTextMarkers::Marker::GetRegExp() const
+{
+	const DWORD dwRxFlags = FIND_REGEXP | (dwFlags & FIND_MATCH_CASE);
+	if (sRegExpFindWhat != sFindWhat || dwRegExpFlags != dwRxFlags)
+	{
+		pRegExp.reset(RxCompile(sFindWhat, (dwFlags & FIND_MATCH_CASE) != 0 ? RX_CASE : 0), RxFree);
+		sRegExpFindWhat = sFindWhat;
+		dwRegExpFlags = dwRxFlags;
+	}
+	return pRegExp.get();
+}
+
 void CCrystalTextMarkers::DeleteMarker(const TCHAR *pKey)
 {
 	m_markers.erase(pKey);
@@ -7,7 +7,9 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include "SyntaxColors.h"
+#include "utils/cregexp.h"
 
 class CCrystalTextView;
 
@@ -21,6 +23,13 @@ public:
 		enum COLORINDEX nBgColorIndex;
 		bool bUserDefined;
 		bool bVisible;
+
+		RxNode *GetRegExp() const;
+
+		/** Regular expression compiled by GetRegExp() from these sFindWhat and dwFlags */
+		mutable std::shared_ptr<RxNode> pRegExp;
+		mutable CString sRegExpFindWhat;
+		mutable DWORD dwRegExpFlags = 0;
 	};
 
 	CCrystalTextMarkers();
@@ -156,6 +156,19 @@ const COLORREF SAVED_REVMARK_CLR = RGB(0x00, 0xFF, 0x00);
 
 #define ICON_INDEX_WRAPLINE         15
 
+/** @brief Interval of background parsing, in milliseconds. */
+const UINT PARSECOOKIES_INTERVAL = 50;
+/** @brief Time parsed in the background at a time, in milliseconds. */
+const DWORD PARSECOOKIES_TIME_SLICE = 20;
+/** @brief Lines parsed in the background between checking the time. */
+const int PARSECOOKIES_CHUNK_LINES = 1000;
+/** @brief Drawing parses at most this many lines to get a parse cookie. */
+const int PARSECOOKIES_SYNC_LINES = 10000;
+/** @brief Lines parsed to guess a parse cookie when drawing does not wait. */
+const int PARSECOOKIES_GUESS_LINES = 100;
+/** @brief Lines parsed again after an edit until parse cookies converge. */
+const int PARSECOOKIES_CONVERGE_LINES = 1000;
+
 ////////////////////////////////////////////////////////////////////////////
 // CCrystalTextView
 
@@ -167,6 +180,7 @@ HINSTANCE CCrystalTextView::s_hResourceInst = nullptr;
 CCrystalTextView::RENDERING_MODE CCrystalTextView::s_nRenderingModeDefault = RENDERING_MODE::GDI;
 
 static ptrdiff_t FindStringHelper(LPCTSTR pszLineBegin, size_t nLineLength, LPCTSTR pszFindWhere, LPCTSTR pszFindWhat, DWORD dwFlags, int &nLen, RxNode *&rxnode, RxMatchRes *rxmatch);
+static ptrdiff_t FindRegExpHelper(LPCTSTR pszLineBegin, size_t nLineLength, LPCTSTR pszFindWhere, LPCTSTR pszFindWhat, RxNode *rxnode, int &nLen, RxMatchRes *rxmatch);
 
 BEGIN_MESSAGE_MAP (CCrystalTextView, CView)
 //{{AFX_MSG_MAP(CCrystalTextView)
@@ -474,6 +488,11 @@ CCrystalTextView::CCrystalTextView ()
 , m_pstrIncrementalSearchString(new CString)
 , m_pstrIncrementalSearchStringOld(new CString)
 , m_ParseCookies(new vector<DWORD>)
+, m_nParseCookiesTimer(0)
+, m_nParsedLines(0)
+, m_nGuessedCookieLine(-1)
+, m_dwGuessedCookie(0)
+, m_nFirstGuessedLine(INT_MAX)
 , m_pnActualLineLength(new vector<int>)
 , m_nIdealCharPos(0)
 , m_bFocused(false)
@@ -1507,13 +1526,15 @@ GetLineColors (int nLineIndex, COLORREF & crBkgnd,
 }
 
 DWORD CCrystalTextView::
-GetParseCookie (int nLineIndex)
+GetParseCookie (int nLineIndex, bool bDrawing /*= false*/)
 {
   const int nLineCount = GetLineCount ();
   if (m_ParseCookies->size() == 0)
     {
       // must be initialized to invalid value (DWORD) -1
       m_ParseCookies->assign(nLineCount, static_cast<DWORD>(-1));
+      m_nParsedLines = 0;
+      StartParseCookiesTimer ();
     }
 
   if (nLineIndex < 0)
@@ -1527,6 +1548,23 @@ GetParseCookie (int nLineIndex)
   L++;
 
   int nBlocks = 0;
+  if (bDrawing && nLineIndex - L >= PARSECOOKIES_SYNC_LINES)
+    {
+      //  Too many lines to parse before drawing: guess the cookie from a few
+      //  lines above, and redraw when the background parsing gets here
+      if (m_nGuessedCookieLine != nLineIndex)
+        {
+          unsigned dwCookie = 0;
+          for (int i = nLineIndex - PARSECOOKIES_GUESS_LINES + 1; i <= nLineIndex; ++i)
+            dwCookie = ParseLine (dwCookie, GetLineChars(i), GetLineLength(i), nullptr, nBlocks);
+          m_nGuessedCookieLine = nLineIndex;
+          m_dwGuessedCookie = dwCookie;
+        }
+      m_nFirstGuessedLine = (std::min) (m_nFirstGuessedLine, nLineIndex + 1);
+      StartParseCookiesTimer ();
+      return m_dwGuessedCookie;
+    }
+
   while (L <= nLineIndex)
     {
       unsigned dwCookie = 0;
@@ -1541,6 +1579,95 @@ GetParseCookie (int nLineIndex)
   return (*m_ParseCookies)[nLineIndex];
 }
 
+/**
+ * @brief Parse a line again after it has been edited.
+ * Lines below are parsed again only until their parse cookies are the same
+ * as before the edit. If they do not converge soon, the rest of the parse
+ * cookies are invalidated and parsed in the background.
+ * @param [in] nLineIndex Edited line.
+ */
+void CCrystalTextView::
+ReparseLine (int nLineIndex)
+{
+  std::vector<DWORD> & cookies = *m_ParseCookies;
+  const int nLineCount = static_cast<int>(cookies.size ());
+  m_nGuessedCookieLine = -1;
+  if (nLineIndex > 0 && cookies[nLineIndex - 1] == - 1)
+    return;                     //  Already invalid from here
+
+  const int nLimit = (std::min) (nLineCount, nLineIndex + PARSECOOKIES_CONVERGE_LINES);
+  unsigned dwCookie = nLineIndex > 0 ? cookies[nLineIndex - 1] : 0;
+  int nBlocks = 0;
+  for (int L = nLineIndex; L < nLimit; ++L)
+    {
+      const DWORD dwOldCookie = cookies[L];
+      if (dwOldCookie == - 1)
+        return;
+      dwCookie = ParseLine (dwCookie, GetLineChars(L), GetLineLength(L), nullptr, nBlocks);
+      cookies[L] = dwCookie;
+      if (dwCookie == dwOldCookie)
+        return;                 //  Lines below parse the same as before
+    }
+
+  for (int L = nLimit; L < nLineCount; ++L)
+    cookies[L] = static_cast<DWORD>(-1);
+  StartParseCookiesTimer ();
+}
+
+void CCrystalTextView::
+StartParseCookiesTimer ()
+{
+  if (m_nParseCookiesTimer == 0 && ::IsWindow (m_hWnd))
+    m_nParseCookiesTimer = SetTimer (CRYSTAL_TIMER_PARSECOOKIES, PARSECOOKIES_INTERVAL, nullptr);
+}
+
+/**
+ * @brief Compute parse cookies of lines not parsed yet, a time slice at a time.
+ * Called from the background parsing timer. Lines drawn with guessed
+ * parse cookies are redrawn when their parse cookies are known.
+ */
+void CCrystalTextView::
+ParseCookiesInBackground ()
+{
+  std::vector<DWORD> & cookies = *m_ParseCookies;
+  int nLineCount = static_cast<int>(cookies.size ());
+  if (m_pTextBuffer == nullptr || nLineCount != GetLineCount ())
+    nLineCount = 0;             //  Parsed again when the view is updated
+
+  //  Find the first line without a parse cookie
+  int L = (std::min) (m_nParsedLines, nLineCount);
+  while (L > 0 && cookies[L - 1] == - 1)
+    L--;
+  while (L < nLineCount && cookies[L] != - 1)
+    L++;
+
+  const DWORD dwStart = GetTickCount ();
+  int nBlocks = 0;
+  while (L < nLineCount && GetTickCount () - dwStart < PARSECOOKIES_TIME_SLICE)
+    {
+      const int nEnd = (std::min) (nLineCount, L + PARSECOOKIES_CHUNK_LINES);
+      unsigned dwCookie = L > 0 ? cookies[L - 1] : 0;
+      for (; L < nEnd; ++L)
+        {
+          dwCookie = ParseLine (dwCookie, GetLineChars(L), GetLineLength(L), nullptr, nBlocks);
+          cookies[L] = dwCookie;
+        }
+    }
+  m_nParsedLines = L;
+
+  if (L >= m_nFirstGuessedLine)
+    {
+      m_nFirstGuessedLine = INT_MAX;
+      m_nGuessedCookieLine = -1;
+      Invalidate (false);
+    }
+  if (L >= nLineCount)
+    {
+      KillTimer (m_nParseCookiesTimer);
+      m_nParseCookiesTimer = 0;
+    }
+}
+
 std::vector<TEXTBLOCK> CCrystalTextView::
 GetAdditionalTextBlocks (int nLineIndex)
 {
@@ -1969,12 +2096,17 @@ CCrystalTextView::GetMarkerTextBlocks(int nLineIndex) const
       int nLineLength = GetLineLength(nLineIndex);
       if (pszChars != nullptr)
         {
+          //  Regular expressions are compiled once, not for every line
+          const bool bRegExp = (marker.second.dwFlags & FIND_REGEXP) != 0;
+          RxNode *rxnode = bRegExp ? marker.second.GetRegExp() : nullptr;
           RxNode *node = nullptr;
           for (const TCHAR *p = pszChars; p < pszChars + nLineLength; )
             {
               RxMatchRes matches;
               int nMatchLen = 0;
-              size_t nPos = ::FindStringHelper(pszChars, nLineLength, p, marker.second.sFindWhat, marker.second.dwFlags | FIND_NO_WRAP, nMatchLen, node, &matches);
+              size_t nPos = bRegExp ?
+                ::FindRegExpHelper(pszChars, nLineLength, p, marker.second.sFindWhat, rxnode, nMatchLen, &matches) :
+                ::FindStringHelper(pszChars, nLineLength, p, marker.second.sFindWhat, marker.second.dwFlags | FIND_NO_WRAP, nMatchLen, node, &matches);
               if (nPos == -1)
                 break;
               if (nLineLength < static_cast<int>((p - pszChars) + nPos) + nMatchLen)
@@ -2001,12 +2133,12 @@ CCrystalTextView::GetMarkerTextBlocks(int nLineIndex) const
 }
 
 std::vector<TEXTBLOCK>
-CCrystalTextView::GetTextBlocks(int nLineIndex)
+CCrystalTextView::GetTextBlocks(int nLineIndex, bool bDrawing /*= false*/)
 {
   int nLength = GetViewableLineLength (nLineIndex);
 
   //  Parse the line
-  unsigned dwCookie = GetParseCookie(nLineIndex - 1);
+  unsigned dwCookie = GetParseCookie(nLineIndex - 1, bDrawing);
   std::vector<TEXTBLOCK> blocks((nLength + 1) * 3); // be aware of nLength == 0
   int nBlocks = 0;
   // insert at least one textblock of normal color at the beginning
@@ -2014,8 +2146,16 @@ CCrystalTextView::GetTextBlocks(int nLineIndex)
   blocks[0].m_nColorIndex = COLORINDEX_NORMALTEXT;
   blocks[0].m_nBgColorIndex = COLORINDEX_BKGND;
   nBlocks++;
-  (*m_ParseCookies)[nLineIndex] = ParseLine(dwCookie, GetLineChars(nLineIndex), GetLineLength(nLineIndex), blocks.data(), nBlocks);
-  ASSERT((*m_ParseCookies)[nLineIndex] != -1);
+  dwCookie = ParseLine(dwCookie, GetLineChars(nLineIndex), GetLineLength(nLineIndex), blocks.data(), nBlocks);
+  ASSERT(dwCookie != -1);
+  if (nLineIndex == 0 || (*m_ParseCookies)[nLineIndex - 1] != -1)
+    (*m_ParseCookies)[nLineIndex] = dwCookie;
+  else
+    {
+      //  The cookie was guessed, keep it for drawing the next line
+      m_nGuessedCookieLine = nLineIndex;
+      m_dwGuessedCookie = dwCookie;
+    }
   blocks.resize(nBlocks);
 
   std::vector<TEXTBLOCK> additionalBlocks = GetAdditionalTextBlocks(nLineIndex);
@@ -2050,7 +2190,7 @@ DrawSingleLine (const CRect & rc, int nLineIndex)
 
   int nLength = GetViewableLineLength (nLineIndex);
 
-  std::vector<TEXTBLOCK> blocks = GetTextBlocks(nLineIndex);
+  std::vector<TEXTBLOCK> blocks = GetTextBlocks(nLineIndex, true);
 
   int nActualItem = 0;
   int nActualOffset = 0;
@@ -2802,6 +2942,9 @@ ResetView ()
   m_ptAnchor.y = 0;
   InvalidateLineCache( 0, -1 );
   m_ParseCookies->clear();
+  m_nParsedLines = 0;
+  m_nGuessedCookieLine = -1;
+  m_nFirstGuessedLine = INT_MAX;
   m_pnActualLineLength->clear();
   m_ptCursorPos.x = 0;
   m_ptCursorPos.y = 0;
@@ -3938,6 +4081,11 @@ OnDestroy ()
 {
   DetachFromBuffer ();
   m_hAccel = nullptr;
+  if (m_nParseCookiesTimer != 0)
+    {
+      KillTimer (m_nParseCookiesTimer);
+      m_nParseCookiesTimer = 0;
+    }
 
   CView::OnDestroy ();
 
@@ -5034,14 +5182,12 @@ UpdateView (CCrystalTextView * pSource, CUpdateContext * pContext,
   if ((dwFlags & UPDATE_SINGLELINE) != 0)
     {
       ASSERT (nLineIndex != -1);
-      //  All text below this line should be reparsed
+      //  Text below this line should be reparsed until it parses the same
       const int cookiesSize = (int) m_ParseCookies->size();
       if (cookiesSize > 0)
         {
           ASSERT (cookiesSize == nLineCount);
-          // must be reinitialized to invalid value (DWORD) - 1
-          for (int i = nLineIndex; i < cookiesSize; ++i)
-            (*m_ParseCookies)[i] = static_cast<DWORD>(-1);
+          ReparseLine (nLineIndex);
         }
       //  This line'th actual length must be recalculated
       if (m_pnActualLineLength->size())
@@ -5080,6 +5226,8 @@ UpdateView (CCrystalTextView * pSource, CUpdateContext * pContext,
             }
           for (size_t i = nLineIndex; i < arrSize; ++i)
             (*m_ParseCookies)[i] = static_cast<DWORD>(-1);
+          m_nGuessedCookieLine = -1;
+          StartParseCookiesTimer ();
         }
 
       //  Recalculate actual length for all lines below this
@@ -5475,13 +5623,12 @@ PrepareDragData ()
 static const TCHAR *memstr(const TCHAR *str1, size_t str1len, const TCHAR *str2, size_t str2len)
 {
   ASSERT(str1 && str2 && str2len > 0);
-  for (const TCHAR *p = str1; p < str1 + str1len; ++p)
+  const TCHAR *end = str1 + str1len;
+  //  Skip to candidates with the vectorized wmemchr()/memchr() of the CRT
+  for (const TCHAR *p = str1; (p = std::char_traits<TCHAR>::find(p, end - p, *str2)) != nullptr; ++p)
     {
-      if (*p == *str2)
-        {
-          if (memcmp(p, str2, str2len * sizeof(TCHAR)) == 0)
-            return p;
-        }
+      if (memcmp(p, str2, str2len * sizeof(TCHAR)) == 0)
+        return p;
     }
   return nullptr;
 }
@@ -5489,43 +5636,63 @@ static const TCHAR *memstr(const TCHAR *str1, size_t str1len, const TCHAR *str2,
 static const TCHAR *memistr(const TCHAR *str1, size_t str1len, const TCHAR *str2, size_t str2len)
 {
   ASSERT(str1 && str2 && str2len > 0);
-  for (const TCHAR *p = str1; p < str1 + str1len; ++p)
+  const TCHAR *end = str1 + str1len;
+  const TCHAR chUpper = static_cast<TCHAR>(toupper(*str2));
+  const TCHAR chLower = static_cast<TCHAR>(tolower(*str2));
+  for (const TCHAR *p = str1; p < end; ++p)
     {
-      if (toupper(*p) == toupper(*str2))
+      //  Skip to candidates without converting every character
+      if (chUpper == chLower)
         {
-          size_t i;
-          for (i = 0; i < str2len; ++i)
-            {
-              if (toupper(p[i]) != toupper(str2[i]))
-                break;
-            }
-          if (i == str2len)
-            return p;
+          p = std::char_traits<TCHAR>::find(p, end - p, chUpper);
+          if (p == nullptr)
+            break;
         }
+      else if (*p != chUpper && *p != chLower)
+        continue;
+      size_t i;
+      for (i = 1; i < str2len; ++i)
+        {
+          if (toupper(p[i]) != toupper(str2[i]))
+            break;
+        }
+      if (i == str2len)
+        return p;
     }
   return nullptr;
 }
 
+/**
+ * @brief Find a compiled regular expression in a line.
+ * @param [in] rxnode Compiled pszFindWhat, nullptr if it is not valid.
+ */
+static ptrdiff_t
+FindRegExpHelper (LPCTSTR pszLineBegin, size_t nLineLength, LPCTSTR pszFindWhere, LPCTSTR pszFindWhat, RxNode *rxnode, int &nLen, RxMatchRes *rxmatch)
+{
+  ptrdiff_t pos = -1;
+  if (pszFindWhat[0] == '^' && pszLineBegin != pszFindWhere)
+    return pos;
+  if (rxnode && RxExec (rxnode, pszFindWhere, nLineLength - (pszFindWhere - pszLineBegin), pszFindWhere, rxmatch))
+    {
+      pos = rxmatch->Open[0];
+      ASSERT((rxmatch->Close[0] - rxmatch->Open[0]) < INT_MAX);
+      nLen = static_cast<int>(rxmatch->Close[0] - rxmatch->Open[0]);
+    }
+  return pos;
+}
+
 static ptrdiff_t
 FindStringHelper (LPCTSTR pszLineBegin, size_t nLineLength, LPCTSTR pszFindWhere, LPCTSTR pszFindWhat, DWORD dwFlags, int &nLen, RxNode *&rxnode, RxMatchRes *rxmatch)
 {
   if (dwFlags & FIND_REGEXP)
     {
-      ptrdiff_t pos = -1;
-
       if (rxnode)
         RxFree (rxnode);
       rxnode = nullptr;
       if (pszFindWhat[0] == '^' && pszLineBegin != pszFindWhere)
-        return pos;
+        return -1;
       rxnode = RxCompile (pszFindWhat, (dwFlags & FIND_MATCH_CASE) != 0 ? RX_CASE : 0);
-      if (rxnode && RxExec (rxnode, pszFindWhere, nLineLength - (pszFindWhere - pszLineBegin), pszFindWhere, rxmatch))
-        {
-          pos = rxmatch->Open[0];
-          ASSERT((rxmatch->Close[0] - rxmatch->Open[0]) < INT_MAX);
-          nLen = static_cast<int>(rxmatch->Close[0] - rxmatch->Open[0]);
-        }
-      return pos;
+      return FindRegExpHelper (pszLineBegin, nLineLength, pszFindWhere, pszFindWhat, rxnode, nLen, rxmatch);
     }
   else
     {
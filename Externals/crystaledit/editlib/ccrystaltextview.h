@@ -76,6 +76,15 @@ enum : unsigned
   UPDATE_RESET = 0x1000U       //  document was reloaded, update all!
 };
 
+//  CCrystalTextView timer IDs, must be unique
+enum : unsigned
+{
+  CRYSTAL_TIMER_DRAGSEL = 1001,       //  scroll while dragging a selection
+  CRYSTAL_RECALC_VSCROLLBAR = 1002,   //  update vert scrollbar
+  CRYSTAL_RECALC_HSCROLLBAR = 1003,   //  update horz scrollbar
+  CRYSTAL_TIMER_PARSECOOKIES = 1004   //  parse lines in the background
+};
+
 /**
  * @brief Class for text view.
  * This class implements class for text viewing. Class implements all
@@ -158,11 +167,24 @@ private:
     stores it in m_ParseCookies, and returns the new valid value.
     When we edit the text, the parse cookies value may change for the modified line
     and all the lines below (As m_ParseCookies[line i] depends on m_ParseCookies[line (i-1)])
-    It would be a loss of time to recompute all these values after each action.
-    So we just set all these values to invalid code (DWORD) - 1.
+    After editing a single line, the lines below are parsed again only until
+    their values are the same as before the edit. Otherwise we set all these
+    values to invalid code (DWORD) - 1.
+    Invalid values are computed in the background by a timer, a time slice at a
+    time, so drawing a line far below the last valid value does not wait for
+    all the lines above to be parsed; it guesses the value and the line is
+    redrawn when the background parsing reaches it.
     */
     std::vector<DWORD> *m_ParseCookies;
-    DWORD GetParseCookie (int nLineIndex);
+    UINT_PTR m_nParseCookiesTimer;
+    int m_nParsedLines;         /**< Lines above this are likely parsed, hint for background parsing */
+    int m_nGuessedCookieLine;   /**< Line of m_dwGuessedCookie, -1 if none */
+    DWORD m_dwGuessedCookie;    /**< Guessed parse cookie of a line not parsed yet */
+    int m_nFirstGuessedLine;    /**< First line drawn with a guessed parse cookie */
+    DWORD GetParseCookie (int nLineIndex, bool bDrawing = false);
+    void ReparseLine (int nLineIndex);
+    void StartParseCookiesTimer ();
+    void ParseCookiesInBackground ();
 
     /**
     Pre-calculated line lengths (in characters)
@@ -632,7 +654,7 @@ protected:
 public:
     virtual CString GetHTMLLine (int nLineIndex, LPCTSTR pszTag);
     virtual CString GetHTMLStyles ();
-    std::vector<CrystalLineParser::TEXTBLOCK> GetTextBlocks(int nLineIndex);
+    std::vector<CrystalLineParser::TEXTBLOCK> GetTextBlocks(int nLineIndex, bool bDrawing = false);
 protected:
     virtual CString GetHTMLAttribute (int nColorIndex, int nBgColorIndex, COLORREF crText, COLORREF crBkgnd);
 
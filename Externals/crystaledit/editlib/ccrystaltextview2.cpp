@@ -61,10 +61,6 @@
 #define new DEBUG_NEW
 #endif
 
-static const UINT_PTR CRYSTAL_TIMER_DRAGSEL = 1001;
-static const UINT_PTR CRYSTAL_RECALC_VSCROLLBAR = 1002;
-static const UINT_PTR CRYSTAL_RECALC_HSCROLLBAR = 1003;
-
 static LPTSTR NTAPI EnsureCharNext(LPCTSTR current)
 {
   LPTSTR next = ::CharNext(current);
@@ -888,6 +884,12 @@ OnTimer (UINT_PTR nIDEvent)
 {
   CView::OnTimer (nIDEvent);
 
+  if (m_nParseCookiesTimer != 0 && nIDEvent == m_nParseCookiesTimer)
+    {
+      ParseCookiesInBackground ();
+      return;
+    }
+
   if (nIDEvent == CRYSTAL_TIMER_DRAGSEL)
     {
       ASSERT (m_bDragSelection);
@@ -10,8 +10,8 @@
 #include "PathContext.h"
 #include "TFile.h"
 #include "IAbortable.h"
-#include <io.h>
-#include <fcntl.h>
+#include "MemCompare.h"
+#include <Windows.h>
 
 namespace CompareEngines
 {
@@ -31,54 +31,201 @@ void BinaryCompare::SetAbortable(const IAbortable * piAbortable)
 	m_piAbortable = const_cast<IAbortable*>(piAbortable);
 }
 
-static int compare_files(const String& file1, const String& file2, IAbortable *piAbortable)
+namespace
 {
-	const size_t bufsize = 1024 * 256;
-	int code;
-	int fd1 = -1, fd2 = -1;
-	
-	_tsopen_s(&fd1, TFile(file1).wpath().c_str(), O_BINARY | O_RDONLY, _SH_DENYNO, _S_IREAD);
-	_tsopen_s(&fd2, TFile(file2).wpath().c_str(), O_BINARY | O_RDONLY, _SH_DENYNO, _S_IREAD);
-	if (fd1 != -1 && fd2 != -1)
+
+/** @brief Size of one mapped view; a multiple of the allocation granularity. */
+const int64_t MapViewSize = 64 * 1024 * 1024;
+/** @brief Bytes compared between two abort checks. */
+const size_t CompareSliceSize = 4 * 1024 * 1024;
+/** @brief Buffer size used when the files cannot be mapped. */
+const DWORD ReadBufferSize = 1024 * 1024;
+
+/**
+ * @brief Read-only file opened for comparing, either mapped or read sequentially.
+ */
+class CompareFile
+{
+public:
+	explicit CompareFile(const String& path)
+		: m_hFile(CreateFileW(TFile(path).wpath().c_str(), GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr))
+		, m_hMapping(nullptr)
+		, m_pView(nullptr)
+		, m_size(-1)
+	{
+		LARGE_INTEGER size;
+		if (m_hFile != INVALID_HANDLE_VALUE && GetFileSizeEx(m_hFile, &size))
+			m_size = size.QuadPart;
+	}
+
+	~CompareFile()
+	{
+		if (m_pView != nullptr)
+			UnmapViewOfFile(m_pView);
+		if (m_hMapping != nullptr)
+			CloseHandle(m_hMapping);
+		if (m_hFile != INVALID_HANDLE_VALUE)
+			CloseHandle(m_hFile);
+	}
+
+	bool IsOpen() const { return m_size >= 0; }
+	int64_t GetSize() const { return m_size; }
+
+	bool CreateMapping()
+	{
+		m_hMapping = CreateFileMapping(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		return m_hMapping != nullptr;
+	}
+
+	/**
+	 * @brief Map a view of the file, releasing the previous one.
+	 * @param [in] offset Start of the view, multiple of the allocation granularity.
+	 */
+	const unsigned char *MapView(int64_t offset, size_t len)
+	{
+		if (m_pView != nullptr)
+			UnmapViewOfFile(m_pView);
+		m_pView = MapViewOfFile(m_hMapping, FILE_MAP_READ,
+			static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset & 0xFFFFFFFF), len);
+		return static_cast<const unsigned char *>(m_pView);
+	}
+
+	bool Read(void *buf, DWORD len)
+	{
+		DWORD nRead = 0;
+		return ReadFile(m_hFile, buf, len, &nRead, nullptr) && nRead == len;
+	}
+
+private:
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+	void *m_pView;
+	int64_t m_size;
+};
+
+struct AlignedFree
+{
+	void operator()(void *p) const { _aligned_free(p); }
+};
+
+}
+
+/**
+ * @brief Compare two mapped buffers, trapping I/O errors raised by the pager.
+ * @param [out] pos Offset of the first difference, or @p len if equal.
+ * @return false if reading the mapped memory failed.
+ */
+static bool find_first_difference_mapped(const void *p1, const void *p2, size_t len, size_t& pos)
+{
+	__try
+	{
+		pos = FindFirstDifference(p1, p2, len);
+		return true;
+	}
+	__except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ?
+		EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+	{
+		return false;
+	}
+}
+
+static int compare_mapped(CompareFile& f1, CompareFile& f2, int64_t size, IAbortable *piAbortable, int64_t& pos)
+{
+	for (int64_t offset = 0; offset < size; offset += MapViewSize)
 	{
-		for (;;)
+		const size_t viewLen = static_cast<size_t>((std::min)(MapViewSize, size - offset));
+		const unsigned char *view1 = f1.MapView(offset, viewLen);
+		const unsigned char *view2 = f2.MapView(offset, viewLen);
+		if (view1 == nullptr || view2 == nullptr)
+			return DIFFCODE::CMPERR;
+		for (size_t i = 0; i < viewLen; i += CompareSliceSize)
 		{
 			if (piAbortable && piAbortable->ShouldAbort())
+				return DIFFCODE::CMPABORT;
+			const size_t len = (std::min)(CompareSliceSize, viewLen - i);
+			size_t diff;
+			if (!find_first_difference_mapped(view1 + i, view2 + i, len, diff))
+				return DIFFCODE::CMPERR;
+			if (diff < len)
 			{
-				code = DIFFCODE::CMPABORT;
-				break;
-			}
-			char buf1[bufsize];
-			char buf2[bufsize];
-			int size1 = _read(fd1, buf1, sizeof(buf1));
-			int size2 = _read(fd2, buf2, sizeof(buf2));
-			if (size1 <= 0 || size2 <= 0)
-			{
-				if (size1 < 0 || size2 < 0)
-					code = DIFFCODE::CMPERR;
-				else
-					code = DIFFCODE::SAME;
-				break;
-			}
-			if (size1 != size2 || memcmp(buf1, buf2, size1) != 0)
-			{
-				code = DIFFCODE::DIFF;
-				break;
+				pos = offset + i + diff;
+				return DIFFCODE::DIFF;
 			}
 		}
 	}
-	else
+	return DIFFCODE::SAME;
+}
+
+static int compare_read(CompareFile& f1, CompareFile& f2, int64_t size, IAbortable *piAbortable, int64_t& pos)
+{
+	std::unique_ptr<unsigned char, AlignedFree> buf1(static_cast<unsigned char *>(_aligned_malloc(ReadBufferSize, 4096)));
+	std::unique_ptr<unsigned char, AlignedFree> buf2(static_cast<unsigned char *>(_aligned_malloc(ReadBufferSize, 4096)));
+	if (!buf1 || !buf2)
+		return DIFFCODE::CMPERR;
+	for (int64_t offset = 0; offset < size; offset += ReadBufferSize)
 	{
-		code = DIFFCODE::CMPERR;
+		if (piAbortable && piAbortable->ShouldAbort())
+			return DIFFCODE::CMPABORT;
+		const DWORD len = static_cast<DWORD>((std::min)(static_cast<int64_t>(ReadBufferSize), size - offset));
+		if (!f1.Read(buf1.get(), len) || !f2.Read(buf2.get(), len))
+			return DIFFCODE::CMPERR;
+		const size_t diff = FindFirstDifference(buf1.get(), buf2.get(), len);
+		if (diff < len)
+		{
+			pos = offset + diff;
+			return DIFFCODE::DIFF;
+		}
 	}
-	if (fd1 != -1)
-		_close(fd1);
-	if (fd2 != -1)
-		_close(fd2);
+	return DIFFCODE::SAME;
+}
+
+/**
+ * @brief Compare two files by content.
+ * Files are memory-mapped in large views and compared with the vectorised
+ * kernel; if mapping fails they are read in large aligned chunks instead.
+ * @param [out] pFirstDiff Receives the offset of the first differing byte
+ *  when the result is DIFF. Can be nullptr.
+ */
+static int compare_files(const String& file1, const String& file2, IAbortable *piAbortable, int64_t *pFirstDiff)
+{
+	CompareFile f1(file1);
+	CompareFile f2(file2);
+	if (!f1.IsOpen() || !f2.IsOpen())
+		return DIFFCODE::CMPERR;
 
+	const int64_t size = (std::min)(f1.GetSize(), f2.GetSize());
+	int64_t pos = size;
+	int code;
+	if (size == 0)
+		code = DIFFCODE::SAME;
+	else if (f1.CreateMapping() && f2.CreateMapping())
+		code = compare_mapped(f1, f2, size, piAbortable, pos);
+	else
+		code = compare_read(f1, f2, size, piAbortable, pos);
+
+	// Common part is equal, so the shorter file ends at the first difference
+	if (code == DIFFCODE::SAME && f1.GetSize() != f2.GetSize())
+		code = DIFFCODE::DIFF;
+	if (code == DIFFCODE::DIFF && pFirstDiff != nullptr)
+		*pFirstDiff = pos;
 	return code;
 }
 
+/**
+ * @brief Compare two files byte-by-byte.
+ * @param [in] file1 First file to compare.
+ * @param [in] file2 Second file to compare.
+ * @param [out] pFirstDiff Receives the offset of the first differing byte
+ *  when files differ. Can be nullptr.
+ * @return DIFFCODE::SAME, DIFFCODE::DIFF, DIFFCODE::CMPERR or DIFFCODE::CMPABORT.
+ */
+int BinaryCompare::CompareFiles(const String& file1, const String& file2, int64_t *pFirstDiff) const
+{
+	return compare_files(file1, file2, m_piAbortable, pFirstDiff);
+}
+
 /**
  * @brief Compare two specified files, byte-by-byte
  * @param [in] di Diffitem info.
@@ -90,12 +237,12 @@ int BinaryCompare::CompareFiles(const PathContext& files, const DIFFITEM &di) co
 	{
 	case 2:
 		return di.diffFileInfo[0].size != di.diffFileInfo[1].size ? 
-			DIFFCODE::DIFF : compare_files(files[0], files[1], m_piAbortable);
+			DIFFCODE::DIFF : compare_files(files[0], files[1], m_piAbortable, nullptr);
 	case 3:
 		unsigned code10 = (di.diffFileInfo[1].size != di.diffFileInfo[0].size) ?
-			DIFFCODE::DIFF : compare_files(files[1], files[0], m_piAbortable);
+			DIFFCODE::DIFF : compare_files(files[1], files[0], m_piAbortable, nullptr);
 		unsigned code12 = (di.diffFileInfo[1].size != di.diffFileInfo[2].size) ?
-			DIFFCODE::DIFF : compare_files(files[1], files[2], m_piAbortable);
+			DIFFCODE::DIFF : compare_files(files[1], files[2], m_piAbortable, nullptr);
 		unsigned code02 = DIFFCODE::SAME;
 		if (code10 == DIFFCODE::SAME && code12 == DIFFCODE::SAME)
 			return DIFFCODE::SAME;
@@ -106,7 +253,7 @@ int BinaryCompare::CompareFiles(const PathContext& files, const DIFFITEM &di) co
 		else if (code10 == DIFFCODE::DIFF && code12 == DIFFCODE::DIFF)
 		{
 			code02 = di.diffFileInfo[0].size != di.diffFileInfo[2].size ?
-				DIFFCODE::DIFF : compare_files(files[0], files[2], m_piAbortable);
+				DIFFCODE::DIFF : compare_files(files[0], files[2], m_piAbortable, nullptr);
 			if (code02 == DIFFCODE::SAME)
 				return DIFFCODE::DIFF | DIFFCODE::DIFF2NDONLY;
 		}
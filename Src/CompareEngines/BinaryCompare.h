@@ -5,6 +5,9 @@
  */
 #pragma once
 
+#include <cstdint>
+#include "UnicodeString.h"
+
 class DIFFITEM;
 class PathContext;
 class IAbortable;
@@ -23,6 +26,7 @@ public:
 	~BinaryCompare();
 	void SetAbortable(const IAbortable * piAbortable);
 	int CompareFiles(const PathContext& files, const DIFFITEM &di) const;
+	int CompareFiles(const String& file1, const String& file2, int64_t *pFirstDiff = nullptr) const;
 private:
 	IAbortable * m_piAbortable;
 };
@@ -7,6 +7,7 @@
 #include "pch.h"
 #include "ByteComparator.h"
 #include <cassert>
+#include <algorithm>
 #include "UnicodeString.h"
 #include "FileTextStats.h"
 #include "CompareOptions.h"
@@ -59,43 +60,19 @@ static void TextScan(FileTextStats & stats, const char *ptr, const char *end, bo
 			++stats.ncrs;
 		}
 	}
-	for (; ptr < end; ++ptr)
-	{
-		char ch = *ptr;
-		if (ch == 0)
-		{
-			++stats.nzeros;
-		}
-		else if (ch == '\r')
-		{
-			if (ptr + 1 < end)
-			{
-				if (ptr[1] == '\n')
-				{
-					++stats.ncrlfs;
-					++ptr;
-				}
-				else
-				{
-					++stats.ncrs;
-				}
-			}
-			else if (eof)
-			{
-				++stats.ncrs;
-			}
-			else
-			{
-				// else last byte of buffer
-				// leave alone, the CompareBuffers loop will set the appropriate m_cr flag
-				// and we'll handle it next time we're called
-			}
-		}
-		else if (ch == '\n')
-		{
-			++stats.nlfs;
-		}
-	}
+	if (ptr >= end)
+		return;
+	size_t len = end - ptr;
+	// If last byte of buffer is CR, leave it alone, the CompareBuffers loop
+	// will set the appropriate m_cr flag and we'll handle it next time we're called
+	if (!eof && end[-1] == '\r')
+		--len;
+	CompareEngines::EolByteCounts counts;
+	CompareEngines::CountEolBytes(ptr, len, counts);
+	stats.nzeros += static_cast<int>(counts.nzeros);
+	stats.ncrs += static_cast<int>(counts.ncrs);
+	stats.nlfs += static_cast<int>(counts.nlfs);
+	stats.ncrlfs += static_cast<int>(counts.ncrlfs);
 }
 
 namespace CompareEngines
@@ -129,6 +106,20 @@ ByteComparator::ByteComparator(const QuickCompareOptions * options)
 		m_ignore_all_space = true;
 	else
 		m_ignore_all_space = false;
+
+	// Identical bytes other than these compare the same way with any options,
+	// so runs of them are skipped without the per-byte state machine
+	m_nstops = 0;
+	if (m_ignore_space_change || m_ignore_all_space)
+	{
+		m_stops[m_nstops++] = ' ';
+		m_stops[m_nstops++] = '\t';
+	}
+	if (m_ignore_eol_diff || m_ignore_blank_lines)
+	{
+		m_stops[m_nstops++] = '\r';
+		m_stops[m_nstops++] = '\n';
+	}
 }
 
 /**
@@ -169,6 +160,22 @@ ByteComparator::COMP_RESULT ByteComparator::CompareBuffers(
 	// cycle through buffer data performing actual comparison
 	while (true)
 	{
+		// Skip identical bytes up to the next difference or byte needing
+		// special handling. A pending whitespace run or split CR/LF pair
+		// must be finished by the state machine first.
+		if (!m_wsflag && !(m_ignore_eol_diff && !m_ignore_blank_lines && (m_cr0 || m_cr1)))
+		{
+			const size_t avail = (std::min)(end0 - ptr0, end1 - ptr1);
+			const size_t same = FindFirstDifferenceOrStop(ptr0, ptr1, avail, m_stops, m_nstops);
+			if (same > 0)
+			{
+				ptr0 += same;
+				ptr1 += same;
+				m_bol0 = m_bol1 = iseolch(ptr0[-1]);
+				if (m_ignore_eol_diff)
+					m_eol0 = m_eol1 = false;
+			}
+		}
 		if (m_ignore_all_space)
 		{
 			// Skip over any whitespace on either side
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <cstdint>
+#include "MemCompare.h"
 
 class QuickCompareOptions;
 struct FileTextStats;
@@ -54,6 +55,8 @@ private:
 	bool m_ignore_all_space; /**< Ignore all whitespace changes */
 	bool m_ignore_eol_diff; /**< Ignore differences in EOL bytes */
 	bool m_ignore_blank_lines; /**< Ignore blank lines */
+	char m_stops[MaxStopBytes]; /**< Bytes needing the per-byte compare with current options */
+	size_t m_nstops; /**< Number of bytes in m_stops */
 	// state
 	bool m_wsflag; /**< ignore_space_change & in a whitespace area */
 	bool m_eol0; /**< 0-side has an eol */
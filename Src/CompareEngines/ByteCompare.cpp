@@ -7,6 +7,7 @@
 #include "pch.h"
 #include "ByteCompare.h"
 #include <cassert>
+#include <algorithm>
 #include <io.h>
 #include "FileLocation.h"
 #include "UnicodeString.h"
@@ -84,6 +85,25 @@ void ByteCompare::SetFileData(int items, file_data *data)
 }
 
 
+/**
+ * @brief Read next chunk of a file, from memory if the caller preloaded it.
+ * @param [in] inf File to read.
+ * @param [in,out] pos Read offset in a preloaded file.
+ * @param [out] buf Buffer to read to.
+ * @param [in] count Max number of bytes to read.
+ * @return Number of bytes read, or -1 on error.
+ */
+static int ReadChunk(const file_data& inf, int64_t& pos, char *buf, unsigned count)
+{
+	if (!inf.preloaded)
+		return _read(inf.desc, buf, count);
+	const int64_t avail = static_cast<int64_t>(inf.buffered_chars) - pos;
+	const unsigned len = static_cast<unsigned>((std::min)(avail, static_cast<int64_t>(count)));
+	memcpy(buf, inf.buffer + pos, len);
+	pos += len;
+	return static_cast<int>(len);
+}
+
 /**
  * @brief Compare two specified files, byte-by-byte
  * @param [in] bStopAfterFirstDiff Stop compare after we find first difference?
@@ -106,6 +126,7 @@ int ByteCompare::CompareFiles(FileLocation *location)
 	// buff[0] has bytes to process from buff[0][bfstart[0]] to buff[0][bfend[0]-1]
 
 	bool eof[2]; // if we've finished file
+	int64_t readpos[2] = { 0, 0 }; // read offset in preloaded files
 
 	// initialize our buffer pointers and end of file flags
 	for (i = 0; i < 2; ++i)
@@ -137,7 +158,7 @@ int ByteCompare::CompareFiles(FileLocation *location)
 			{
 				// Assume our blocks are in range of int
 				int space = sizeof(buff[i])/sizeof(buff[i][0]) - (int) bfend[i];
-				int rtn = _read(m_inf[i].desc, &buff[i][bfend[i]], (unsigned)space);
+				int rtn = ReadChunk(m_inf[i], readpos[i], &buff[i][bfend[i]], (unsigned)space);
 				if (rtn == -1)
 					return DIFFCODE::CMPERR;
 				if (rtn < space)
@@ -0,0 +1,390 @@
+/**
+ * @file  MemCompare.cpp
+ *
+ * @brief Implementation file for vectorised memory compare helpers.
+ */
+
+#include "pch.h"
+#include "MemCompare.h"
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace CompareEngines
+{
+
+size_t FindFirstDifferenceScalar(const void *p1, const void *p2, size_t len)
+{
+	const unsigned char *b1 = static_cast<const unsigned char *>(p1);
+	const unsigned char *b2 = static_cast<const unsigned char *>(p2);
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+	{
+		uint64_t w1, w2;
+		memcpy(&w1, b1 + i, sizeof(w1));
+		memcpy(&w2, b2 + i, sizeof(w2));
+		if (w1 != w2)
+			break;
+	}
+	for (; i < len; ++i)
+	{
+		if (b1[i] != b2[i])
+			return i;
+	}
+	return len;
+}
+
+
+size_t FindFirstDifferenceOrStopScalar(const void *p1, const void *p2, size_t len, const char *stops, size_t nstops)
+{
+	const char *b1 = static_cast<const char *>(p1);
+	const char *b2 = static_cast<const char *>(p2);
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (b1[i] != b2[i])
+			return i;
+		for (size_t j = 0; j < nstops; ++j)
+		{
+			if (b1[i] == stops[j])
+				return i;
+		}
+	}
+	return len;
+}
+
+void CountEolBytesScalar(const void *p, size_t len, EolByteCounts& counts)
+{
+	const char *b = static_cast<const char *>(p);
+	counts = {};
+	for (size_t i = 0; i < len; ++i)
+	{
+		const char ch = b[i];
+		if (ch == 0)
+			++counts.nzeros;
+		else if (ch == '\r')
+		{
+			if (i + 1 < len && b[i + 1] == '\n')
+			{
+				++counts.ncrlfs;
+				++i;
+			}
+			else
+				++counts.ncrs;
+		}
+		else if (ch == '\n')
+			++counts.nlfs;
+	}
+}
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+static inline size_t LowestSetBit(unsigned mask)
+{
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return idx;
+}
+
+static size_t FindFirstDifferenceSSE2(const void *p1, const void *p2, size_t len)
+{
+	const unsigned char *b1 = static_cast<const unsigned char *>(p1);
+	const unsigned char *b2 = static_cast<const unsigned char *>(p2);
+	size_t i = 0;
+	// Check 64 bytes per iteration and only locate the byte on a mismatch
+	for (; i + 64 <= len; i += 64)
+	{
+		__m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b1 + i)),
+		                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(b2 + i)));
+		__m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b1 + i + 16)),
+		                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(b2 + i + 16)));
+		__m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b1 + i + 32)),
+		                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(b2 + i + 32)));
+		__m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b1 + i + 48)),
+		                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(b2 + i + 48)));
+		__m128i all = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+		if (_mm_movemask_epi8(all) != 0xFFFF)
+			break;
+	}
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b1 + i)),
+		                            _mm_loadu_si128(reinterpret_cast<const __m128i *>(b2 + i)));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(eq)) ^ 0xFFFFu;
+		if (mask != 0)
+			return i + LowestSetBit(mask);
+	}
+	return i + FindFirstDifferenceScalar(b1 + i, b2 + i, len - i);
+}
+
+static size_t FindFirstDifferenceAVX2(const void *p1, const void *p2, size_t len)
+{
+	const unsigned char *b1 = static_cast<const unsigned char *>(p1);
+	const unsigned char *b2 = static_cast<const unsigned char *>(p2);
+	size_t i = 0;
+	for (; i + 128 <= len; i += 128)
+	{
+		__m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b1 + i)),
+		                               _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b2 + i)));
+		__m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b1 + i + 32)),
+		                               _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b2 + i + 32)));
+		__m256i e2 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b1 + i + 64)),
+		                               _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b2 + i + 64)));
+		__m256i e3 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b1 + i + 96)),
+		                               _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b2 + i + 96)));
+		__m256i all = _mm256_and_si256(_mm256_and_si256(e0, e1), _mm256_and_si256(e2, e3));
+		if (static_cast<unsigned>(_mm256_movemask_epi8(all)) != 0xFFFFFFFFu)
+			break;
+	}
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b1 + i)),
+		                               _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b2 + i)));
+		unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(eq));
+		if (mask != 0)
+		{
+			_mm256_zeroupper();
+			return i + LowestSetBit(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return i + FindFirstDifferenceSSE2(b1 + i, b2 + i, len - i);
+}
+
+/**
+ * @brief Count bytes of @p b not handled by the vector loop: byte 0 and
+ * bytes from @p i to @p len. LF bytes preceded by CR are counted in @p ncrlfs
+ * too, like the vector loops do.
+ */
+static inline void CountTail(const unsigned char *b, size_t i, size_t len,
+	size_t& nzeros, size_t& ncrs, size_t& nlfs, size_t& ncrlfs)
+{
+	if (len == 0)
+		return;
+	if (i > len)
+		i = len;
+	auto count = [&](size_t k)
+	{
+		const unsigned char ch = b[k];
+		if (ch == 0)
+			++nzeros;
+		else if (ch == '\r')
+			++ncrs;
+		else if (ch == '\n')
+		{
+			++nlfs;
+			if (k > 0 && b[k - 1] == '\r')
+				++ncrlfs;
+		}
+	};
+	count(0);
+	for (size_t k = (i > 1 ? i : 1); k < len; ++k)
+		count(k);
+}
+
+/**
+ * @brief Return mask of bytes in @p v equal to any of the stop bytes.
+ * Unused entries of @p stops repeat the first stop byte.
+ */
+static inline __m128i MatchStops(__m128i v, const __m128i stops[MaxStopBytes])
+{
+	return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, stops[0]), _mm_cmpeq_epi8(v, stops[1])),
+	                    _mm_or_si128(_mm_cmpeq_epi8(v, stops[2]), _mm_cmpeq_epi8(v, stops[3])));
+}
+
+static inline __m256i MatchStops(__m256i v, const __m256i stops[MaxStopBytes])
+{
+	return _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, stops[0]), _mm256_cmpeq_epi8(v, stops[1])),
+	                       _mm256_or_si256(_mm256_cmpeq_epi8(v, stops[2]), _mm256_cmpeq_epi8(v, stops[3])));
+}
+
+static size_t FindFirstDifferenceOrStopSSE2(const void *p1, const void *p2, size_t len, const char *stops, size_t nstops)
+{
+	const unsigned char *b1 = static_cast<const unsigned char *>(p1);
+	const unsigned char *b2 = static_cast<const unsigned char *>(p2);
+	__m128i vstops[MaxStopBytes];
+	for (size_t j = 0; j < MaxStopBytes; ++j)
+		vstops[j] = _mm_set1_epi8(stops[j < nstops ? j : 0]);
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b1 + i));
+		__m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b2 + i));
+		// bytes that are equal and not stop bytes
+		__m128i plain = _mm_andnot_si128(MatchStops(v1, vstops), _mm_cmpeq_epi8(v1, v2));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(plain)) ^ 0xFFFFu;
+		if (mask != 0)
+			return i + LowestSetBit(mask);
+	}
+	return i + FindFirstDifferenceOrStopScalar(b1 + i, b2 + i, len - i, stops, nstops);
+}
+
+static size_t FindFirstDifferenceOrStopAVX2(const void *p1, const void *p2, size_t len, const char *stops, size_t nstops)
+{
+	const unsigned char *b1 = static_cast<const unsigned char *>(p1);
+	const unsigned char *b2 = static_cast<const unsigned char *>(p2);
+	__m256i vstops[MaxStopBytes];
+	for (size_t j = 0; j < MaxStopBytes; ++j)
+		vstops[j] = _mm256_set1_epi8(stops[j < nstops ? j : 0]);
+	size_t i = 0;
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b1 + i));
+		__m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b2 + i));
+		__m256i plain = _mm256_andnot_si256(MatchStops(v1, vstops), _mm256_cmpeq_epi8(v1, v2));
+		unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(plain));
+		if (mask != 0)
+		{
+			_mm256_zeroupper();
+			return i + LowestSetBit(mask);
+		}
+	}
+	_mm256_zeroupper();
+	return i + FindFirstDifferenceOrStopSSE2(b1 + i, b2 + i, len - i, stops, nstops);
+}
+
+/**
+ * @brief Sum the byte counters in @p acc.
+ */
+static inline size_t SumBytes(__m128i acc)
+{
+	__m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+	return static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+}
+
+static inline size_t SumBytes(__m256i acc)
+{
+	return SumBytes(_mm256_castsi256_si128(acc)) + SumBytes(_mm256_extracti128_si256(acc, 1));
+}
+
+/**
+ * @brief Count zero, CR and LF bytes and LF bytes preceded by CR.
+ * CR/LF pairs are counted at the LF, comparing each block with the same block
+ * loaded one byte earlier, so pairs spanning two blocks need no carry.
+ */
+static void CountEolBytesSSE2(const void *p, size_t len, EolByteCounts& counts)
+{
+	const unsigned char *b = static_cast<const unsigned char *>(p);
+	size_t nzeros = 0, ncrs = 0, nlfs = 0, ncrlfs = 0;
+	const __m128i zero = _mm_setzero_si128(), cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+	// Byte 0 has no previous byte; it is counted with the scalar tail below
+	size_t i = 1;
+	while (i + 16 <= len)
+	{
+		// Byte counters overflow after 255 blocks
+		__m128i accZero = zero, accCr = zero, accLf = zero, accCrLf = zero;
+		for (int n = 0; n < 255 && i + 16 <= len; ++n, i += 16)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+			__m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i - 1));
+			__m128i isLf = _mm_cmpeq_epi8(v, lf);
+			// comparison results are 0 or -1, so subtracting them counts
+			accZero = _mm_sub_epi8(accZero, _mm_cmpeq_epi8(v, zero));
+			accCr = _mm_sub_epi8(accCr, _mm_cmpeq_epi8(v, cr));
+			accLf = _mm_sub_epi8(accLf, isLf);
+			accCrLf = _mm_sub_epi8(accCrLf, _mm_and_si128(isLf, _mm_cmpeq_epi8(prev, cr)));
+		}
+		nzeros += SumBytes(accZero);
+		ncrs += SumBytes(accCr);
+		nlfs += SumBytes(accLf);
+		ncrlfs += SumBytes(accCrLf);
+	}
+	CountTail(b, i, len, nzeros, ncrs, nlfs, ncrlfs);
+	counts.nzeros = nzeros;
+	counts.ncrs = ncrs - ncrlfs;
+	counts.nlfs = nlfs - ncrlfs;
+	counts.ncrlfs = ncrlfs;
+}
+
+static void CountEolBytesAVX2(const void *p, size_t len, EolByteCounts& counts)
+{
+	const unsigned char *b = static_cast<const unsigned char *>(p);
+	size_t nzeros = 0, ncrs = 0, nlfs = 0, ncrlfs = 0;
+	const __m256i zero = _mm256_setzero_si256(), cr = _mm256_set1_epi8('\r'), lf = _mm256_set1_epi8('\n');
+	size_t i = 1;
+	while (i + 32 <= len)
+	{
+		__m256i accZero = zero, accCr = zero, accLf = zero, accCrLf = zero;
+		for (int n = 0; n < 255 && i + 32 <= len; ++n, i += 32)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+			__m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i - 1));
+			__m256i isLf = _mm256_cmpeq_epi8(v, lf);
+			accZero = _mm256_sub_epi8(accZero, _mm256_cmpeq_epi8(v, zero));
+			accCr = _mm256_sub_epi8(accCr, _mm256_cmpeq_epi8(v, cr));
+			accLf = _mm256_sub_epi8(accLf, isLf);
+			accCrLf = _mm256_sub_epi8(accCrLf, _mm256_and_si256(isLf, _mm256_cmpeq_epi8(prev, cr)));
+		}
+		nzeros += SumBytes(accZero);
+		ncrs += SumBytes(accCr);
+		nlfs += SumBytes(accLf);
+		ncrlfs += SumBytes(accCrLf);
+	}
+	_mm256_zeroupper();
+	CountTail(b, i, len, nzeros, ncrs, nlfs, ncrlfs);
+	counts.nzeros = nzeros;
+	counts.ncrs = ncrs - ncrlfs;
+	counts.nlfs = nlfs - ncrlfs;
+	counts.ncrlfs = ncrlfs;
+}
+
+/**
+ * @brief Check that both the CPU and the OS support AVX2.
+ */
+static bool IsAVX2Supported()
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	const bool bAVX = (info[2] & (1 << 28)) != 0;
+	if (!bOSXSave || !bAVX)
+		return false;
+	// XMM and YMM state must be enabled by the OS
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+#endif
+
+size_t FindFirstDifference(const void *p1, const void *p2, size_t len)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	static const auto pfnFind = IsAVX2Supported() ? FindFirstDifferenceAVX2 : FindFirstDifferenceSSE2;
+	return pfnFind(p1, p2, len);
+#else
+	return FindFirstDifferenceScalar(p1, p2, len);
+#endif
+}
+
+size_t FindFirstDifferenceOrStop(const void *p1, const void *p2, size_t len, const char *stops, size_t nstops)
+{
+	assert(nstops <= MaxStopBytes);
+	if (nstops == 0)
+		return FindFirstDifference(p1, p2, len);
+#if defined(_M_IX86) || defined(_M_X64)
+	static const auto pfnFind = IsAVX2Supported() ? FindFirstDifferenceOrStopAVX2 : FindFirstDifferenceOrStopSSE2;
+	return pfnFind(p1, p2, len, stops, nstops);
+#else
+	return FindFirstDifferenceOrStopScalar(p1, p2, len, stops, nstops);
+#endif
+}
+
+void CountEolBytes(const void *p, size_t len, EolByteCounts& counts)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	static const auto pfnCount = IsAVX2Supported() ? CountEolBytesAVX2 : CountEolBytesSSE2;
+	pfnCount(p, len, counts);
+#else
+	CountEolBytesScalar(p, len, counts);
+#endif
+}
+
+} // namespace CompareEngines
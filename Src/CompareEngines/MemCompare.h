@@ -0,0 +1,69 @@
+/**
+ * @file  MemCompare.h
+ *
+ * @brief Declaration file for vectorised memory compare helpers.
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace CompareEngines
+{
+
+/**
+ * @brief Find the offset of the first byte that differs in two buffers.
+ * Uses AVX2 or SSE2 when the CPU supports them, scalar code otherwise.
+ * @param [in] p1 First buffer.
+ * @param [in] p2 Second buffer.
+ * @param [in] len Number of bytes to compare.
+ * @return Offset of the first differing byte, or @p len if buffers are equal.
+ */
+size_t FindFirstDifference(const void *p1, const void *p2, size_t len);
+
+/**
+ * @brief Scalar reference implementation of FindFirstDifference().
+ * Exposed so that tests and benchmarks can compare against it.
+ */
+size_t FindFirstDifferenceScalar(const void *p1, const void *p2, size_t len);
+
+/**
+ * @brief Find the first byte that differs in two buffers or is one of given bytes.
+ * Used to skip runs of identical bytes none of which needs special handling.
+ * @param [in] p1 First buffer.
+ * @param [in] p2 Second buffer.
+ * @param [in] len Number of bytes to compare.
+ * @param [in] stops Bytes to stop at (checked in the first buffer).
+ * @param [in] nstops Number of bytes in @p stops, at most MaxStopBytes.
+ * @return Offset of the first differing or stop byte, or @p len if none found.
+ */
+size_t FindFirstDifferenceOrStop(const void *p1, const void *p2, size_t len, const char *stops, size_t nstops);
+
+/** @brief Max number of stop bytes FindFirstDifferenceOrStop() accepts. */
+const size_t MaxStopBytes = 4;
+
+/** @brief Counts of zero and EOL bytes in a buffer. */
+struct EolByteCounts
+{
+	size_t nzeros; /**< Zero bytes */
+	size_t ncrs; /**< CR bytes not followed by LF */
+	size_t nlfs; /**< LF bytes not preceded by CR */
+	size_t ncrlfs; /**< CR/LF pairs */
+};
+
+/**
+ * @brief Count zero bytes and EOLs in a buffer.
+ * A CR at the end of the buffer is counted as a CR.
+ * @param [in] p Buffer.
+ * @param [in] len Number of bytes in the buffer.
+ * @param [out] counts Counts of the buffer.
+ */
+void CountEolBytes(const void *p, size_t len, EolByteCounts& counts);
+
+/**
+ * @brief Scalar reference implementations.
+ * Exposed so that tests can compare against them.
+ */
+size_t FindFirstDifferenceOrStopScalar(const void *p1, const void *p2, size_t len, const char *stops, size_t nstops);
+void CountEolBytesScalar(const void *p, size_t len, EolByteCounts& counts);
+
+} // namespace CompareEngines
@@ -281,7 +281,7 @@ bool DiffUtils::RegExpFilter(int StartPos, int EndPos, const file_data *pinf) co
 		size_t len = pinf->linbuf[line + 1] - pinf->linbuf[line];
 		const char *string = pinf->linbuf[line];
 		size_t stringlen = linelen(string, len);
-		if (!m_pFilterList->Match(std::string(string, stringlen), m_codepage))
+		if (!m_pFilterList->Match(string, stringlen, m_codepage))
 		{
 			linesMatch = false;
 		}
@@ -0,0 +1,268 @@
+/**
+ *  @file CompareResultCache.cpp
+ *
+ *  @brief Implementation of CompareResultCache class.
+ */
+
+#include "pch.h"
+#include "CompareResultCache.h"
+#include <fstream>
+#include <algorithm>
+#include "DiffItem.h"
+#include "TFile.h"
+#include "paths.h"
+#include "DebugNew.h"
+
+using Poco::FastMutex;
+
+namespace
+{
+
+const uint32_t CacheFileSignature = 0x43525757; /**< "WWRC" */
+/** @brief Entries not used in this many sessions are dropped on save. */
+const uint32_t MaxIdleSessions = 16;
+/** @brief Maximum number of entries written to the cache file. */
+const size_t MaxEntries = 4 * 1024 * 1024;
+
+#pragma pack(push, 4)
+struct FileHeader
+{
+	uint32_t signature;
+	uint32_t version;
+	uint32_t session;
+	uint32_t count;
+};
+
+struct FileRecord
+{
+	uint64_t hash[2];
+	uint32_t code;
+	int32_t nsdiffs;
+	int32_t nidiffs;
+	int32_t textStats[3][4];
+	int32_t codepage[3];
+	int32_t unicoding[3];
+	int32_t bom[3];
+	uint32_t lastUsed;
+};
+#pragma pack(pop)
+
+}
+
+/**
+ * @brief Constructor.
+ * @param [in] filename Path of the file the cache is loaded from and saved to.
+ */
+CompareResultCache::CompareResultCache(const String& filename)
+: m_filename(filename)
+, m_nSession(1)
+, m_bModified(false)
+{
+}
+
+CompareResultCache::~CompareResultCache() = default;
+
+/**
+ * @brief Load cached results from the cache file.
+ * A missing or damaged cache file leaves the cache empty.
+ * @return true if the cache file was read.
+ */
+bool CompareResultCache::Load()
+{
+	FastMutex::ScopedLock lock(m_mutex);
+	m_entries.clear();
+	m_bModified = false;
+
+	std::ifstream istr(TFile(m_filename).wpath(), std::ios::in | std::ios::binary);
+	if (!istr)
+		return false;
+	FileHeader header;
+	if (!istr.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+		header.signature != CacheFileSignature || header.version != CacheFileVersion)
+		return false;
+
+	// Don't trust the count of a damaged file
+	const std::streamoff pos = istr.tellg();
+	istr.seekg(0, std::ios::end);
+	const std::streamoff nRecords = (istr.tellg() - pos) / static_cast<std::streamoff>(sizeof(FileRecord));
+	istr.seekg(pos);
+	if (!istr || nRecords < static_cast<std::streamoff>(header.count))
+		return false;
+
+	m_nSession = header.session + 1;
+	m_entries.reserve(header.count);
+	for (uint32_t i = 0; i < header.count; ++i)
+	{
+		FileRecord rec;
+		if (!istr.read(reinterpret_cast<char *>(&rec), sizeof(rec)))
+		{
+			m_entries.clear();
+			return false;
+		}
+		Key key = { { rec.hash[0], rec.hash[1] } };
+		Entry& entry = m_entries[key];
+		entry.code = rec.code;
+		entry.nsdiffs = rec.nsdiffs;
+		entry.nidiffs = rec.nidiffs;
+		for (int j = 0; j < 3; ++j)
+		{
+			entry.textStats[j].ncrs = rec.textStats[j][0];
+			entry.textStats[j].nlfs = rec.textStats[j][1];
+			entry.textStats[j].ncrlfs = rec.textStats[j][2];
+			entry.textStats[j].nzeros = rec.textStats[j][3];
+			entry.encoding[j].m_codepage = rec.codepage[j];
+			entry.encoding[j].m_unicoding = static_cast<ucr::UNICODESET>(rec.unicoding[j]);
+			entry.encoding[j].m_bom = rec.bom[j] != 0;
+		}
+		entry.nLastUsed = rec.lastUsed;
+	}
+	return true;
+}
+
+/**
+ * @brief Write cached results to the cache file.
+ * Entries that have not been used recently are dropped. The file is written
+ * to a temporary file first so that an interrupted save does not damage it.
+ * @return true if the cache was saved or there was nothing to save.
+ */
+bool CompareResultCache::Save()
+{
+	FastMutex::ScopedLock lock(m_mutex);
+	if (!m_bModified)
+		return true;
+
+	std::vector<std::pair<const Key *, const Entry *>> entries;
+	entries.reserve(m_entries.size());
+	for (const auto& it : m_entries)
+	{
+		if (it.second.nLastUsed + MaxIdleSessions >= m_nSession)
+			entries.emplace_back(&it.first, &it.second);
+	}
+	if (entries.size() > MaxEntries)
+	{
+		std::nth_element(entries.begin(), entries.begin() + MaxEntries, entries.end(),
+			[](const std::pair<const Key *, const Entry *>& a, const std::pair<const Key *, const Entry *>& b)
+				{ return a.second->nLastUsed > b.second->nLastUsed; });
+		entries.resize(MaxEntries);
+	}
+
+	paths::CreateIfNeeded(paths::GetPathOnly(m_filename));
+	const String tmpFilename = m_filename + _T(".tmp");
+	{
+		std::ofstream ostr(TFile(tmpFilename).wpath(), std::ios::out | std::ios::binary | std::ios::trunc);
+		FileHeader header = { CacheFileSignature, CacheFileVersion, m_nSession, static_cast<uint32_t>(entries.size()) };
+		ostr.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		for (const auto& it : entries)
+		{
+			const Entry& entry = *it.second;
+			FileRecord rec;
+			rec.hash[0] = it.first->hash[0];
+			rec.hash[1] = it.first->hash[1];
+			rec.code = entry.code;
+			rec.nsdiffs = entry.nsdiffs;
+			rec.nidiffs = entry.nidiffs;
+			for (int j = 0; j < 3; ++j)
+			{
+				rec.textStats[j][0] = entry.textStats[j].ncrs;
+				rec.textStats[j][1] = entry.textStats[j].nlfs;
+				rec.textStats[j][2] = entry.textStats[j].ncrlfs;
+				rec.textStats[j][3] = entry.textStats[j].nzeros;
+				rec.codepage[j] = entry.encoding[j].m_codepage;
+				rec.unicoding[j] = entry.encoding[j].m_unicoding;
+				rec.bom[j] = entry.encoding[j].m_bom;
+			}
+			rec.lastUsed = entry.nLastUsed;
+			ostr.write(reinterpret_cast<const char *>(&rec), sizeof(rec));
+		}
+		if (!ostr.flush())
+			return false;
+	}
+	try
+	{
+		TFile(tmpFilename).renameTo(m_filename);
+	}
+	catch (...)
+	{
+		return false;
+	}
+	m_bModified = false;
+	return true;
+}
+
+/**
+ * @brief Remove all cached results.
+ */
+void CompareResultCache::Clear()
+{
+	FastMutex::ScopedLock lock(m_mutex);
+	m_entries.clear();
+	m_bModified = true;
+}
+
+/**
+ * @brief Return the number of cached results.
+ */
+size_t CompareResultCache::GetCount() const
+{
+	FastMutex::ScopedLock lock(m_mutex);
+	return m_entries.size();
+}
+
+/**
+ * @brief Look up a cached result and apply it to the item.
+ * @param [in] key Key from MakeKey().
+ * @param [out] code Cached compare result code.
+ * @param [in, out] di Item receiving diff counts, text stats and encodings.
+ * @return true if a result was found.
+ */
+bool CompareResultCache::Lookup(const Key& key, unsigned& code, DIFFITEM& di)
+{
+	FastMutex::ScopedLock lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end())
+		return false;
+	Entry& entry = it->second;
+	if (entry.nLastUsed != m_nSession)
+	{
+		entry.nLastUsed = m_nSession;
+		m_bModified = true;
+	}
+	code = entry.code;
+	di.nsdiffs = entry.nsdiffs;
+	di.nidiffs = entry.nidiffs;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (di.diffcode.exists(i))
+		{
+			di.diffFileInfo[i].m_textStats = entry.textStats[i];
+			di.diffFileInfo[i].encoding = entry.encoding[i];
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Store the compare result of an item.
+ * Failed and aborted compares are not stored.
+ * @param [in] key Key from MakeKey().
+ * @param [in] code Compare result code.
+ * @param [in] di Compared item with diff counts, text stats and encodings.
+ */
+void CompareResultCache::Store(const Key& key, unsigned code, const DIFFITEM& di)
+{
+	if (DIFFCODE::isResultError(code) || DIFFCODE::isResultAbort(code))
+		return;
+	Entry entry;
+	entry.code = code;
+	entry.nsdiffs = di.nsdiffs;
+	entry.nidiffs = di.nidiffs;
+	for (int i = 0; i < 3; ++i)
+	{
+		entry.textStats[i] = di.diffFileInfo[i].m_textStats;
+		entry.encoding[i] = di.diffFileInfo[i].encoding;
+	}
+	FastMutex::ScopedLock lock(m_mutex);
+	entry.nLastUsed = m_nSession;
+	m_entries[key] = entry;
+	m_bModified = true;
+}
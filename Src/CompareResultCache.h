@@ -0,0 +1,79 @@
+/**
+ *  @file CompareResultCache.h
+ *
+ *  @brief Declaration of class CompareResultCache
+ */
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#define POCO_NO_UNWINDOWS 1
+#include <Poco/Mutex.h>
+#include "UnicodeString.h"
+#include "FileTextStats.h"
+#include "FileTextEncoding.h"
+
+class CDiffContext;
+class DIFFITEM;
+
+/**
+ * @brief Persistent cache of folder compare results.
+ *
+ * Results of comparing files are stored under a key built from the compared
+ * paths, their sizes and modification times, and a fingerprint of the compare
+ * options. When a later compare sees the same files with unchanged stats and
+ * the same options, the stored result is used and the files are not read.
+ * Changing any compare option changes the fingerprint, so older results are
+ * never returned; they age out of the cache file after some sessions.
+ *
+ * Lookup() and Store() may be called from several compare threads.
+ */
+class CompareResultCache
+{
+public:
+	/** @brief 128-bit hash identifying the compared files and options. */
+	struct Key
+	{
+		uint64_t hash[2];
+		bool operator==(const Key& other) const { return hash[0] == other.hash[0] && hash[1] == other.hash[1]; }
+	};
+
+	explicit CompareResultCache(const String& filename);
+	~CompareResultCache();
+
+	bool Load();
+	bool Save();
+	void Clear();
+	size_t GetCount() const;
+
+	static uint64_t MakeOptionsFingerprint(const CDiffContext& ctxt);
+	static bool MakeKey(CDiffContext& ctxt, const DIFFITEM& di, uint64_t fingerprint, Key& key);
+
+	bool Lookup(const Key& key, unsigned& code, DIFFITEM& di);
+	void Store(const Key& key, unsigned code, const DIFFITEM& di);
+
+private:
+	static const uint32_t CacheFileVersion = 1;
+
+	/** @brief Cached compare result of one item. */
+	struct Entry
+	{
+		unsigned code; /**< Result returned by FolderCmp::prepAndCompareFiles() */
+		int nsdiffs;
+		int nidiffs;
+		FileTextStats textStats[3];
+		FileTextEncoding encoding[3];
+		uint32_t nLastUsed; /**< Session in which entry was last used */
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash[0]); }
+	};
+
+	String m_filename; /**< Cache file */
+	std::unordered_map<Key, Entry, KeyHash> m_entries;
+	uint32_t m_nSession; /**< Incremented every time the cache is loaded */
+	bool m_bModified;
+	mutable Poco::FastMutex m_mutex;
+};
@@ -0,0 +1,121 @@
+/**
+ *  @file CompareResultCacheKey.cpp
+ *
+ *  @brief Implementation of the key functions of CompareResultCache class.
+ */
+
+#include "pch.h"
+#include "CompareResultCache.h"
+#include "DiffContext.h"
+#include "DiffItem.h"
+#include "DiffWrapper.h"
+#include "CompareOptions.h"
+#include "FileFilterHelper.h"
+#include "FileTransform.h"
+#include "FilterList.h"
+#include "KeyHasher.h"
+#include "SubstitutionList.h"
+#include "DebugNew.h"
+
+/**
+ * @brief Compute a fingerprint of all options affecting compare results.
+ * The fingerprint is part of every key, so results computed with other
+ * options are never returned.
+ * @param [in] ctxt Compare context with options set.
+ * @return Options fingerprint.
+ */
+uint64_t CompareResultCache::MakeOptionsFingerprint(const CDiffContext& ctxt)
+{
+	KeyHasher hasher;
+	hasher.Add(CacheFileVersion);
+	hasher.Add(ctxt.GetCompareMethod());
+	if (const DIFFOPTIONS *pOptions = ctxt.GetOptions())
+	{
+		hasher.Add(pOptions->nIgnoreWhitespace);
+		hasher.Add(pOptions->bIgnoreCase);
+		hasher.Add(pOptions->bIgnoreNumbers);
+		hasher.Add(pOptions->bIgnoreBlankLines);
+		hasher.Add(pOptions->bIgnoreEol);
+		hasher.Add(pOptions->bFilterCommentsLines);
+		hasher.Add(pOptions->nDiffAlgorithm);
+		hasher.Add(pOptions->bIndentHeuristic);
+		hasher.Add(pOptions->bCompletelyBlankOutIgnoredChanges);
+	}
+	hasher.Add(ctxt.m_iGuessEncodingType);
+	hasher.Add(ctxt.m_bStopAfterFirstDiff);
+	hasher.Add(ctxt.m_nQuickCompareLimit);
+	hasher.Add(ctxt.m_nBinaryCompareLimit);
+	hasher.Add(ctxt.m_bIgnoreCodepage);
+	hasher.Add(ctxt.m_bEnableImageCompare);
+	hasher.Add(ctxt.m_dColorDistanceThreshold);
+	if (ctxt.m_pFilterList != nullptr)
+	{
+		for (const auto& regexp : ctxt.m_pFilterList->GetRegExps())
+			hasher.Add(regexp);
+		for (const auto& regexp : ctxt.m_pFilterList->GetRegExps(true))
+			hasher.Add(regexp);
+	}
+	hasher.Add(static_cast<size_t>(-1));
+	if (ctxt.m_pSubstitutionList != nullptr)
+	{
+		const SubstitutionList& list = *ctxt.m_pSubstitutionList;
+		for (int i = 0; i < static_cast<int>(list.GetCount()); ++i)
+		{
+			hasher.Add(list[i].pattern);
+			hasher.Add(list[i].replacement);
+			hasher.Add(list[i].regexpCompileOptions);
+		}
+	}
+	return hasher.GetHash1() ^ hasher.GetHash2();
+}
+
+/**
+ * @brief Build the cache key of an item.
+ * Items compared by date or size, and items handled by plugins, are not
+ * cached.
+ * @param [in] ctxt Compare context.
+ * @param [in] di Item to compare.
+ * @param [in] fingerprint Fingerprint from MakeOptionsFingerprint().
+ * @param [out] key Key of the item.
+ * @return true if the item's result can be cached.
+ */
+bool CompareResultCache::MakeKey(CDiffContext& ctxt, const DIFFITEM& di, uint64_t fingerprint, Key& key)
+{
+	const int nCompMethod = ctxt.GetCompareMethod();
+	if (nCompMethod == CMP_DATE || nCompMethod == CMP_DATE_SIZE || nCompMethod == CMP_SIZE)
+		return false;
+
+	PathContext tFiles;
+	ctxt.GetComparePaths(di, tFiles);
+
+	if (ctxt.m_piPluginInfos != nullptr)
+	{
+		PackingInfo *infoUnpacker = nullptr;
+		PrediffingInfo *infoPrediffer = nullptr;
+		ctxt.FetchPluginInfos(CDiffContext::GetFilteredFilenames(tFiles), &infoUnpacker, &infoPrediffer);
+		if ((infoUnpacker != nullptr && !infoUnpacker->GetPluginPipeline().empty()) ||
+			(infoPrediffer != nullptr && !infoPrediffer->GetPluginPipeline().empty()))
+			return false;
+	}
+
+	KeyHasher hasher;
+	hasher.Add(fingerprint);
+	const int nDirs = ctxt.GetCompareDirs();
+	hasher.Add(nDirs);
+	for (int i = 0; i < nDirs; ++i)
+	{
+		const bool bExists = di.diffcode.exists(i);
+		hasher.Add(bExists);
+		if (!bExists)
+			continue;
+		const DiffFileInfo& dfi = di.diffFileInfo[i];
+		hasher.Add(tFiles[i]);
+		hasher.Add(dfi.size);
+		hasher.Add(dfi.mtime.epochMicroseconds());
+		if (ctxt.m_bEnableImageCompare && ctxt.m_pImgfileFilter != nullptr)
+			hasher.Add(ctxt.m_pImgfileFilter->includeFile(dfi.filename));
+	}
+	key.hash[0] = hasher.GetHash1();
+	key.hash[1] = hasher.GetHash2();
+	return true;
+}
@@ -9,6 +9,7 @@
 #include <cassert>
 #include <cstring>
 #include <atomic>
+#include <algorithm>
 #include "DiffItem.h"
 
 /** 
@@ -70,6 +71,40 @@ const DIFFITEM *CompareStats::GetCurDiffItem()
 	return cdi;
 }
 
+/**
+ * @brief Mark the item a compare thread started with BeginCompare() compared.
+ * @param [in] iCompareThread Index of compare thread.
+ */
+void CompareStats::EndCompare(int iCompareThread)
+{
+	ThreadState &rThreadState = m_rgThreadState[iCompareThread];
+	const int64_t nBeginTime = rThreadState.m_nBeginTime.exchange(-1);
+	if (nBeginTime >= 0)
+		rThreadState.m_nBusyTime += m_tCompareStart.elapsed() - nBeginTime;
+	++rThreadState.m_nItemCount;
+}
+
+/**
+ * @brief Return share of time a compare thread has spent comparing items.
+ * The item in compare counts from the time it was started, so a thread
+ * comparing a big file shows as busy before the file is done.
+ * @param [in] iCompareThread Index of compare thread.
+ * @return Utilization between 0.0 (idle) and 1.0 (busy all the time) since
+ * the compare threads were started.
+ */
+double CompareStats::GetThreadUtilization(int iCompareThread) const
+{
+	const ThreadState &rThreadState = m_rgThreadState[iCompareThread];
+	const int64_t elapsed = m_tCompareStart.elapsed();
+	if (elapsed <= 0)
+		return 0.0;
+	int64_t nBusyTime = rThreadState.m_nBusyTime;
+	const int64_t nBeginTime = rThreadState.m_nBeginTime;
+	if (nBeginTime >= 0)
+		nBusyTime += elapsed - nBeginTime;
+	return std::clamp(static_cast<double>(nBusyTime) / elapsed, 0.0, 1.0);
+}
+
 /** 
  * @brief Reset comparestats.
  * Use this function to reset stats before new compare.
@@ -8,6 +8,9 @@
 #include <atomic>
 #include <vector>
 #include <array>
+#include <cstdint>
+#define POCO_NO_UNWINDOWS 1
+#include <Poco/Timestamp.h>
 
 class DIFFITEM;
 
@@ -73,13 +76,19 @@ public:
 	{
 		m_rgThreadState.clear();
 		m_rgThreadState.resize(nCompareThreads);
+		m_tCompareStart.update();
 	}
 	void BeginCompare(const DIFFITEM *di, int iCompareThread)
 	{
 		ThreadState &rThreadState = m_rgThreadState[iCompareThread];
 		rThreadState.m_nHitCount = 0;
 		rThreadState.m_pDiffItem = di;
+		rThreadState.m_nBeginTime = m_tCompareStart.elapsed();
 	}
+	void EndCompare(int iCompareThread);
+	int GetCompareThreadCount() const { return static_cast<int>(m_rgThreadState.size()); }
+	int GetThreadItemCount(int iCompareThread) const { return m_rgThreadState[iCompareThread].m_nItemCount; }
+	double GetThreadUtilization(int iCompareThread) const;
 	void AddItem(int code);
 	void IncreaseTotalItems(int count = 1);
 	int GetCount(CompareStats::RESULT result) const;
@@ -103,12 +112,18 @@ private:
 	int m_nDirs; /**< number of directories to compare */
 	struct ThreadState
 	{
-		ThreadState() : m_nHitCount(0), m_pDiffItem(nullptr) {}
-		ThreadState(const ThreadState& other) : m_nHitCount(other.m_nHitCount.load()), m_pDiffItem(other.m_pDiffItem) {}
+		ThreadState() : m_nHitCount(0), m_pDiffItem(nullptr), m_nBeginTime(-1), m_nBusyTime(0), m_nItemCount(0) {}
+		ThreadState(const ThreadState& other)
+			: m_nHitCount(other.m_nHitCount.load()), m_pDiffItem(other.m_pDiffItem), m_nBeginTime(other.m_nBeginTime.load())
+			, m_nBusyTime(other.m_nBusyTime.load()), m_nItemCount(other.m_nItemCount.load()) {}
 		std::atomic_int m_nHitCount;
 		const DIFFITEM *m_pDiffItem;
+		std::atomic<int64_t> m_nBeginTime; /**< Start of current item after m_tCompareStart in microseconds, -1 if none */
+		std::atomic<int64_t> m_nBusyTime; /**< Time spent comparing finished items, in microseconds */
+		std::atomic_int m_nItemCount; /**< Items compared by the thread */
 	};
 	std::vector<ThreadState> m_rgThreadState;
+	Poco::Timestamp m_tCompareStart; /**< Time when compare threads were started */
 
 };
 
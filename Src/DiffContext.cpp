@@ -41,6 +41,7 @@ CDiffContext::CDiffContext(const PathContext & paths, int compareMethod)
 , m_nCompMethod(compareMethod)
 , m_bIgnoreSmallTimeDiff(false)
 , m_pCompareStats(nullptr)
+, m_pCompareResultCache(nullptr)
 , m_piAbortable(nullptr)
 , m_bStopAfterFirstDiff(false)
 , m_pFilterList(nullptr)
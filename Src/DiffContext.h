@@ -18,6 +18,7 @@ class PackingInfo;
 class PrediffingInfo;
 class IDiffFilter;
 class CompareStats;
+class CompareResultCache;
 class IAbortable;
 class CDiffWrapper;
 class CompareOptions;
@@ -172,6 +173,7 @@ public:
 
 	bool m_bIgnoreSmallTimeDiff; /**< Ignore small timedifferences when comparing by date */
 	CompareStats *m_pCompareStats; /**< Pointer to compare statistics */
+	CompareResultCache *m_pCompareResultCache; /**< Persistent compare results, nullptr if disabled */
 
 	/**
 	 * Optimize compare by stopping after first difference.
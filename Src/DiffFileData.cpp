@@ -15,6 +15,7 @@
 #include "diff.h"
 #include "TFile.h"
 #include "FileTransform.h"
+#include "FileContents.h"
 #include "unicoder.h"
 #include "DebugNew.h"
 
@@ -36,17 +37,52 @@ DiffFileData::~DiffFileData()
 	delete [] m_inf;
 }
 
-/** @brief Open file descriptors in the inf structure (return false if failure) */
-bool DiffFileData::OpenFiles(const String& szFilepath1, const String& szFilepath2)
+/**
+ * @brief Open file descriptors in the inf structure (return false if failure)
+ * @param [in] pContents1 Contents of first file already read by the caller, or nullptr.
+ * @param [in] pContents2 Contents of second file already read by the caller, or nullptr.
+ */
+bool DiffFileData::OpenFiles(const String& szFilepath1, const String& szFilepath2,
+	FileContents* pContents1, FileContents* pContents2)
 {
 	m_FileLocation[0].setPath(szFilepath1);
 	m_FileLocation[1].setPath(szFilepath2);
 	bool b = DoOpenFiles();
 	if (!b)
 		Reset();
+	else
+		Preload(pContents1, pContents2);
 	return b;
 }
 
+/**
+ * @brief Set up the inf structure to compare contents already in memory.
+ * No file is opened. Both sides get distinct negative descriptors, because
+ * diffutils treats equal descriptors as the same file.
+ * @param [in] contents1 Contents of first side.
+ * @param [in] contents2 Contents of second side.
+ */
+bool DiffFileData::OpenContents(const FileContents& contents1, const FileContents& contents2)
+{
+	Reset();
+
+	const FileContents* contents[2] = { &contents1, &contents2 };
+	m_used = true;
+	for (int i = 0; i < 2; ++i)
+	{
+		m_inf[i].name = _strdup(ucr::toSystemCP(m_sDisplayFilepath[i]).c_str());
+		if (m_inf[i].name == nullptr || !CopyContents(i, *contents[i]))
+		{
+			Reset();
+			return false;
+		}
+		m_inf[i].desc = -1 - i;
+		m_inf[i].stat.st_mode = _S_IFREG;
+		m_inf[i].stat.st_size = static_cast<int64_t>(contents[i]->GetSize());
+	}
+	return true;
+}
+
 /** @brief stash away true names for display, before opening files */
 void DiffFileData::SetDisplayFilepaths(const String& szTrueFilepath1, const String& szTrueFilepath2)
 {
@@ -98,6 +134,71 @@ bool DiffFileData::DoOpenFiles()
 	return true;
 }
 
+/**
+ * @brief Hand contents the caller already read to diffutils.
+ * Both files are preloaded or neither, because the compare code either reads
+ * both files from their descriptors or uses both buffers. Contents are only
+ * used if they belong to the opened file and its size has not changed since.
+ * diffutils modifies and frees the buffers, so they are detached from the
+ * contents, which only copy them for compares set to use them later again.
+ */
+void DiffFileData::Preload(FileContents* pContents1, FileContents* pContents2)
+{
+	FileContents* contents[2] = { pContents1, pContents2 };
+	for (int i = 0; i < 2; ++i)
+	{
+		if (contents[i] == nullptr || !contents[i]->IsLoaded() ||
+			contents[i]->GetPath() != m_FileLocation[i].filepath ||
+			m_inf[i].desc <= 0 || !S_ISREG(m_inf[i].stat.st_mode) ||
+			static_cast<int64_t>(contents[i]->GetSize()) != m_inf[i].stat.st_size)
+			return;
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		// The second file shares the buffer of the first one when it is the same file
+		if (i == 1 && m_inf[1].desc == m_inf[0].desc)
+			break;
+		const size_t size = contents[i]->GetSize();
+		size_t bufsize = 0;
+		char *buffer = contents[i]->Detach(bufsize);
+		if (buffer == nullptr)
+		{
+			for (int j = 0; j < i; ++j)
+			{
+				free(m_inf[j].buffer);
+				m_inf[j].buffer = nullptr;
+				m_inf[j].bufsize = m_inf[j].buffered_chars = 0;
+				m_inf[j].preloaded = 0;
+			}
+			return;
+		}
+		m_inf[i].buffer = buffer;
+		m_inf[i].bufsize = bufsize;
+		m_inf[i].buffered_chars = size;
+		m_inf[i].preloaded = 1;
+	}
+}
+
+/**
+ * @brief Copy contents into the buffer of one side and mark it preloaded.
+ * @return false if the buffer could not be allocated.
+ */
+bool DiffFileData::CopyContents(int i, const FileContents& contents)
+{
+	const size_t size = contents.GetSize();
+	// Leave room for an appended newline and sentinel word, as slurp() does
+	const size_t bufsize = size + FileContents::Slack;
+	m_inf[i].buffer = static_cast<char *>(malloc(bufsize));
+	if (m_inf[i].buffer == nullptr)
+		return false;
+	memcpy(m_inf[i].buffer, contents.GetData(), size);
+	m_inf[i].bufsize = bufsize;
+	m_inf[i].buffered_chars = size;
+	m_inf[i].preloaded = 1;
+	return true;
+}
+
 /** @brief Clear inf structure to pristine */
 void DiffFileData::Reset()
 {
@@ -14,6 +14,7 @@
 struct file_data;
 class PrediffingInfo;
 class CDiffContext;
+class FileContents;
 
 /**
  * @brief C++ container for the structure (file_data) used by diffutils' diff_2_files(...)
@@ -28,7 +29,9 @@ struct DiffFileData
 	DiffFileData(const DiffFileData& other) = delete;
 	~DiffFileData();
 
-	bool OpenFiles(const String& szFilepath1, const String& szFilepath2);
+	bool OpenFiles(const String& szFilepath1, const String& szFilepath2,
+		FileContents* pContents1 = nullptr, FileContents* pContents2 = nullptr);
+	bool OpenContents(const FileContents& contents1, const FileContents& contents2);
 	void Reset();
 	void Close() { Reset(); }
 	void SetDisplayFilepaths(const String& szTrueFilepath1, const String& szTrueFilepath2);
@@ -46,4 +49,6 @@ struct DiffFileData
 
 private:
 	bool DoOpenFiles();
+	void Preload(FileContents* pContents1, FileContents* pContents2);
+	bool CopyContents(int i, const FileContents& contents);
 };
@@ -6,11 +6,143 @@
 
 #include "pch.h"
 #include "DiffItem.h"
+#include <malloc.h>
+#include <cstdint>
+#include <new>
 #include "paths.h"
-#include "DebugNew.h"
+
+/**
+ * @brief Header of a block, followed by its items.
+ * Freed items are handed out first, then items after the used part.
+ */
+struct DiffItemPool::Block
+{
+	DiffItemPool *pPool; /**< Pool the block belongs to */
+	Block *pPrev; /**< Previous block in the list of blocks with free items */
+	Block *pNext; /**< Next block in the list of blocks with free items */
+	void *pFree; /**< Freed items, linked through their first bytes */
+	size_t nUsed; /**< Items handed out from the end of the used part */
+	size_t nLive; /**< Items allocated and not yet freed */
+};
+
+namespace
+{
+
+struct alignas(DIFFITEM) Node
+{
+	unsigned char data[sizeof(DIFFITEM)];
+};
+static_assert(sizeof(Node) >= sizeof(void *), "free list link must fit in a node");
+
+/** @brief Size and alignment of a block */
+constexpr size_t BlockSize = 256 * 1024;
+/** @brief Offset of the first item in a block */
+constexpr size_t NodesOffset = (sizeof(DiffItemPool::Block) + alignof(Node) - 1) / alignof(Node) * alignof(Node);
+constexpr size_t NodesPerBlock = (BlockSize - NodesOffset) / sizeof(Node);
+static_assert(NodesPerBlock > 0, "a block must hold at least one item");
+
+Node *GetNodes(DiffItemPool::Block *pBlock)
+{
+	return reinterpret_cast<Node *>(reinterpret_cast<unsigned char *>(pBlock) + NodesOffset);
+}
+
+}
+
+DiffItemPool::~DiffItemPool()
+{
+	// The list frees its items before the pool, and the last item frees its block
+	assert(m_pAvail == nullptr);
+}
+
+/** @brief Allocate memory of one item */
+void *DiffItemPool::Allocate()
+{
+	Block *pBlock = m_pAvail;
+	if (pBlock == nullptr)
+	{
+		pBlock = static_cast<Block *>(_aligned_malloc(BlockSize, BlockSize));
+		if (pBlock == nullptr)
+			throw std::bad_alloc();
+		*pBlock = { this, nullptr, nullptr, nullptr, 0, 0 };
+		LinkAvail(pBlock);
+	}
+	void *p;
+	if (pBlock->pFree != nullptr)
+	{
+		p = pBlock->pFree;
+		pBlock->pFree = *static_cast<void **>(p);
+	}
+	else
+		p = &GetNodes(pBlock)[pBlock->nUsed++];
+	++pBlock->nLive;
+	if (pBlock->pFree == nullptr && pBlock->nUsed == NodesPerBlock)
+		UnlinkAvail(pBlock);
+	return p;
+}
+
+/** @brief Return memory of an item to the block it was allocated from */
+void DiffItemPool::Free(void *p)
+{
+	Block *pBlock = reinterpret_cast<Block *>(reinterpret_cast<uintptr_t>(p) & ~(BlockSize - 1));
+	const bool bWasFull = (pBlock->pFree == nullptr && pBlock->nUsed == NodesPerBlock);
+	if (--pBlock->nLive == 0)
+	{
+		if (!bWasFull)
+			UnlinkAvail(pBlock);
+		_aligned_free(pBlock);
+		return;
+	}
+	*static_cast<void **>(p) = pBlock->pFree;
+	pBlock->pFree = p;
+	if (bWasFull)
+		LinkAvail(pBlock);
+}
+
+/** @brief Put a block at the head of the list of blocks with free items */
+void DiffItemPool::LinkAvail(Block *pBlock)
+{
+	DiffItemPool *pPool = pBlock->pPool;
+	pBlock->pPrev = nullptr;
+	pBlock->pNext = pPool->m_pAvail;
+	if (pPool->m_pAvail != nullptr)
+		pPool->m_pAvail->pPrev = pBlock;
+	pPool->m_pAvail = pBlock;
+}
+
+/** @brief Remove a block from the list of blocks with free items */
+void DiffItemPool::UnlinkAvail(Block *pBlock)
+{
+	if (pBlock->pPrev != nullptr)
+		pBlock->pPrev->pNext = pBlock->pNext;
+	else
+		pBlock->pPool->m_pAvail = pBlock->pNext;
+	if (pBlock->pNext != nullptr)
+		pBlock->pNext->pPrev = pBlock->pPrev;
+	pBlock->pPrev = pBlock->pNext = nullptr;
+}
 
 DIFFITEM DIFFITEM::emptyitem;
 
+/** @brief Allocate memory of an item from the pool of its list */
+void *DIFFITEM::operator new(size_t size, DiffItemPool& pool)
+{
+	assert(size == sizeof(DIFFITEM));
+	return pool.Allocate();
+}
+
+/** @brief Return memory of an item when its constructor throws */
+void DIFFITEM::operator delete(void *p, DiffItemPool& pool)
+{
+	DiffItemPool::Free(p);
+}
+
+/** @brief Return memory of an item to the pool it was allocated from */
+void DIFFITEM::operator delete(void *p)
+{
+	if (p != nullptr)
+		DiffItemPool::Free(p);
+}
+
 /** @brief DIFFITEM's destructor */
 DIFFITEM::~DIFFITEM()
 {
@@ -7,6 +7,8 @@
 
 #include "DiffFileInfo.h"
 
+class DiffItemPool;
+
 /**
  * @brief Bitfield values for binary file sides.
  * These values are used as bitfield values when determining which file(s)
@@ -283,6 +285,12 @@ public:
 	static DIFFITEM *GetEmptyItem();
 	inline bool isEmpty() const { return this == GetEmptyItem(); /* to invoke "emptiness" checking */ }
 
+//**** Allocation of items from the pool of their DiffItemList
+public:
+	static void *operator new(size_t size, DiffItemPool& pool);
+	static void operator delete(void *p, DiffItemPool& pool);
+	static void operator delete(void *p);
+
 //**** CTOR, DTOR
 public:
 	DIFFITEM() : parent(nullptr), children(nullptr), Flink(nullptr), Blink(nullptr), 
@@ -292,3 +300,33 @@ public:
 	~DIFFITEM();
 
 };
+
+/**
+ * @brief Slab allocator for the DIFFITEMs of one DiffItemList.
+ * Items are carved out of large blocks, so a folder compare of millions of
+ * items does not make millions of heap allocations, and items added one
+ * after another (as the folder scan does) lie next to each other in memory.
+ * Blocks are aligned to their size, so an item finds its block from its
+ * address. A block is released as soon as its last item is freed.
+ * The pool has no lock of its own: DiffItemList allocates and frees items
+ * with its mutex held.
+ */
+class DiffItemPool
+{
+public:
+	DiffItemPool() : m_pAvail(nullptr) {}
+	DiffItemPool(const DiffItemPool&) = delete;
+	DiffItemPool& operator=(const DiffItemPool&) = delete;
+	~DiffItemPool();
+
+	void *Allocate();
+	static void Free(void *p);
+
+	struct Block; /**< Header at the start of each block, before its items */
+
+private:
+	static void LinkAvail(Block *pBlock);
+	static void UnlinkAvail(Block *pBlock);
+
+	Block *m_pAvail; /**< Blocks with free items */
+};
@@ -11,7 +11,7 @@
 /**
  * @brief Constructor
  */
-DiffItemList::DiffItemList() : m_pRoot(nullptr)
+DiffItemList::DiffItemList() : m_pRoot(nullptr), m_nPathIndexDirs(0), m_bPathIndexValid(false)
 {
 }
 
@@ -27,10 +27,14 @@ DiffItemList::~DiffItemList()
  * @brief Add new diffitem to structured DIFFITEM tree.
  * @param [in] par Parent item, or `nullptr` if no parent.
  * @return Pointer to the added item.
+ * @note The caller must call InvalidatePathIndex() after setting paths and
+ * filenames of the item, so that lookups do not index it before that.
  */
 DIFFITEM *DiffItemList::AddNewDiff(DIFFITEM *par)
 {
-	DIFFITEM *p = new DIFFITEM;
+	// Path index may be built by another thread
+	std::lock_guard<std::mutex> lock(m_pathIndexMutex);
+	DIFFITEM *p = new (m_itemPool) DIFFITEM;
 	if (par == nullptr)
 	{
 		// if there is no `parent`, this item becomes a child of `m_pRoot`
@@ -43,11 +47,43 @@ DIFFITEM *DiffItemList::AddNewDiff(DIFFITEM *par)
 	return p;
 }
 
+/**
+ * @brief Remove diffitem and its children from structured DIFFITEM tree.
+ * The path index is invalidated before the items are freed, and lookups
+ * wait until they are unlinked.
+ * @param [in] diffpos Item to remove, deleted by this function.
+ */
+void DiffItemList::RemoveDiff(DIFFITEM *diffpos)
+{
+	assert(diffpos != nullptr);
+	std::lock_guard<std::mutex> lock(m_pathIndexMutex);
+	m_bPathIndexValid = false;
+	if (diffpos->HasChildren())
+		diffpos->RemoveChildren();
+	diffpos->DelinkFromSiblings();
+	delete diffpos;
+}
+
+/**
+ * @brief Remove the children of a diffitem from structured DIFFITEM tree.
+ * @param [in] par Item whose children are deleted.
+ */
+void DiffItemList::RemoveChildren(DIFFITEM *par)
+{
+	assert(par != nullptr);
+	std::lock_guard<std::mutex> lock(m_pathIndexMutex);
+	m_bPathIndexValid = false;
+	par->RemoveChildren();
+}
+
 /**
  * @brief Empty structured DIFFITEM tree
  */
 void DiffItemList::RemoveAll()
 {
+	std::lock_guard<std::mutex> lock(m_pathIndexMutex);
+	m_bPathIndexValid = false;
+	m_pathIndex.clear();
 	delete m_pRoot;
 	m_pRoot = nullptr;
 }
@@ -55,7 +91,9 @@ void DiffItemList::RemoveAll()
 void DiffItemList::InitDiffItemList()
 {
 	assert(m_pRoot == nullptr);
-	m_pRoot = new DIFFITEM;
+	InvalidatePathIndex();
+	std::lock_guard<std::mutex> lock(m_pathIndexMutex);
+	m_pRoot = new (m_itemPool) DIFFITEM;
 }
 
 void DiffItemList::ClearAllAdditionalProperties()
@@ -208,6 +246,84 @@ void DiffItemList::SetCustomFlags1(DIFFITEM *diffpos, unsigned flag)
 void DiffItemList::Swap(int idx1, int idx2)
 {
 	assert(m_pRoot != nullptr);
+	InvalidatePathIndex();
 	for (DIFFITEM *p = GetFirstDiffPosition(); p != nullptr; p = p->GetFwdSiblingLink())
 		p->Swap(idx1, idx2);
 }
+
+/**
+ * @brief Combine hash of relative path and filename of one side to hash.
+ */
+static size_t HashPath(size_t hash, const String& path, const String& file)
+{
+	std::hash<String> hasher;
+	hash = hash * 31 + hasher(path);
+	return hash * 31 + hasher(file);
+}
+
+/**
+ * @brief Mark the path index out of date.
+ * Called when items are added, removed or renamed.
+ */
+void DiffItemList::InvalidatePathIndex() const
+{
+	std::lock_guard<std::mutex> lock(m_pathIndexMutex);
+	m_bPathIndexValid = false;
+}
+
+/**
+ * @brief Build index of all items by their relative paths and filenames.
+ * Called with m_pathIndexMutex locked.
+ */
+void DiffItemList::BuildPathIndex(int nDirs) const
+{
+	m_bPathIndexValid = true;
+	m_nPathIndexDirs = nDirs;
+	m_pathIndex.clear();
+	if (m_pRoot == nullptr)
+		return;
+	for (DIFFITEM *pos = GetFirstDiffPosition(); pos != nullptr; )
+	{
+		DIFFITEM *currentPos = pos;
+		const DIFFITEM &di = GetNextDiffPosition(pos);
+		size_t hash = 0;
+		for (int i = 0; i < nDirs; ++i)
+			hash = HashPath(hash, di.diffFileInfo[i].path.get(), di.diffFileInfo[i].filename.get());
+		m_pathIndex.emplace(hash, currentPos);
+	}
+}
+
+/**
+ * @brief Find item having given relative paths and filenames.
+ * The first lookup after items were added, removed or renamed indexes all
+ * items, later lookups take constant time.
+ * @param [in] nDirs Number of compared folders.
+ * @param [in] path Relative paths of the item, without trailing backslash.
+ * @param [in] file Filenames of the item.
+ * @return Found item, or `nullptr` if not found. Items are unlinked and
+ * freed with m_pathIndexMutex locked, so the lookup never walks a freed item,
+ * but the returned item is valid only until it or its parent is removed.
+ */
+DIFFITEM *DiffItemList::FindItemFromRelativePaths(int nDirs, const String path[], const String file[]) const
+{
+	std::lock_guard<std::mutex> lock(m_pathIndexMutex);
+	if (!m_bPathIndexValid || m_nPathIndexDirs != nDirs)
+		BuildPathIndex(nDirs);
+	size_t hash = 0;
+	for (int i = 0; i < nDirs; ++i)
+		hash = HashPath(hash, path[i], file[i]);
+	auto range = m_pathIndex.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const DIFFITEM &di = *it->second;
+		bool bMatch = true;
+		for (int i = 0; i < nDirs && bMatch; ++i)
+		{
+			bMatch = di.diffFileInfo[i].path == path[i] &&
+				di.diffFileInfo[i].filename == file[i];
+		}
+		if (bMatch)
+			return it->second;
+	}
+	return nullptr;
+}
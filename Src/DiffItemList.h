@@ -6,6 +6,9 @@
 #pragma once
 
 #include "DiffItem.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 
 /**
  * @brief List of DIFFITEMs in folder compare.
@@ -21,6 +24,8 @@ public:
 	~DiffItemList();
 	// add & remove differences
 	DIFFITEM *AddNewDiff(DIFFITEM *parent);
+	void RemoveDiff(DIFFITEM *diffpos);
+	void RemoveChildren(DIFFITEM *par);
 	void RemoveAll();
 	void InitDiffItemList();
 	void ClearAllAdditionalProperties();
@@ -42,8 +47,22 @@ public:
 
 	void Swap(int idx1, int idx2);
 
+	// find items by paths
+	DIFFITEM *FindItemFromRelativePaths(int nDirs, const String path[], const String file[]) const;
+	void InvalidatePathIndex() const;
+
 protected:
 	DIFFITEM* m_pRoot; /**< Root of list of diffitems; initially `nullptr`. */
+
+private:
+	void BuildPathIndex(int nDirs) const;
+
+	/** Items by hash of their relative paths and filenames, built on first lookup */
+	mutable std::unordered_multimap<size_t, DIFFITEM *> m_pathIndex;
+	mutable int m_nPathIndexDirs; /**< Number of sides hashed in m_pathIndex */
+	mutable std::atomic<bool> m_bPathIndexValid; /**< Cleared when items are added, removed or renamed */
+	mutable std::mutex m_pathIndexMutex; /**< Also guards m_itemPool */
+	DiffItemPool m_itemPool; /**< Memory of the items in the list */
 };
 
 /**
@@ -21,6 +21,7 @@
 #include "FileTextEncoding.h"
 #include "codepage_detect.h"
 #include "TFile.h"
+#include "FileContents.h"
 
 using Poco::Exception;
 
@@ -83,6 +84,8 @@ CDiffTextBuffer::CDiffTextBuffer(CMergeDoc * pDoc, int pane)
 : m_pOwnerDoc(pDoc)
 , m_nThisPane(pane)
 , m_bMixedEOL(false)
+, m_dwRevisionNumberOnRescan(0)
+, m_bEditsTracked(false)
 {
 }
 
@@ -146,9 +149,11 @@ AddUndoRecord(bool bInsert, const CPoint & ptStartPos,
 		int nActionType /*= CE_ACTION_UNKNOWN*/,
 		CDWordArray *paSavedRevisionNumbers /*= nullptr*/)
 {
+	// The record may be merged into the last one, so check for a new group first
+	const bool bBeginGroup = m_bUndoBeginGroup;
 	CGhostTextBuffer::AddUndoRecord(bInsert, ptStartPos, ptEndPos, pszText,
 		cchText, nActionType, paSavedRevisionNumbers);
-	if (m_aUndoBuf[m_nUndoPosition - 1].m_dwFlags & UNDO_BEGINGROUP)
+	if (bBeginGroup)
 	{
 		m_pOwnerDoc->undoTgt.erase(m_pOwnerDoc->curUndo, m_pOwnerDoc->undoTgt.end());
 		m_pOwnerDoc->undoTgt.push_back(m_nThisPane);
@@ -156,6 +161,45 @@ AddUndoRecord(bool bInsert, const CPoint & ptStartPos,
 	}
 }
 
+/**
+ * @brief Forget the oldest undo groups of this pane in the document.
+ * Called when the undo history got too large and its oldest groups were
+ * discarded.
+ */
+void CDiffTextBuffer::			/* virtual override */
+OnDiscardUndoGroups(int nGroups)
+{
+	std::vector<int>& undoTgt = m_pOwnerDoc->undoTgt;
+	const size_t nCurUndo = m_pOwnerDoc->curUndo - undoTgt.begin();
+	size_t nRemovedBeforeCur = 0;
+	auto it = undoTgt.begin();
+	while (nGroups > 0 && it != undoTgt.end())
+	{
+		if (*it == m_nThisPane)
+		{
+			if (static_cast<size_t>(it - undoTgt.begin()) < nCurUndo)
+				++nRemovedBeforeCur;
+			it = undoTgt.erase(it);
+			--nGroups;
+		}
+		else
+			++it;
+	}
+	m_pOwnerDoc->curUndo = undoTgt.begin() + (nCurUndo - nRemovedBeforeCur);
+}
+
+/**
+ * @brief Restore line revision numbers when an edit is undone.
+ * Undone lines get their old revision numbers back, so revision numbers
+ * no longer tell which lines changed since the last compare.
+ */
+void CDiffTextBuffer::			/* virtual override */
+RestoreRevisionNumbers(int nStartLine, CDWordArray *paSavedRevisionNumbers)
+{
+	CGhostTextBuffer::RestoreRevisionNumbers(nStartLine, paSavedRevisionNumbers);
+	m_bEditsTracked = false;
+}
+
 /**
  * @brief Checks if a flag is set for line.
  * @param [in] line Index (0-based) for line.
@@ -185,6 +229,43 @@ void CDiffTextBuffer::prepareForRescan()
 	}
 }
 
+/**
+ * @brief Remember the current revision as the compared state of the buffer.
+ * Lines edited after this get newer revision numbers.
+ * @sa GetEditedLines()
+ */
+void CDiffTextBuffer::SetRescanned()
+{
+	m_dwRevisionNumberOnRescan = m_dwCurrentRevisionNumber;
+	m_bEditsTracked = true;
+}
+
+/**
+ * @brief Get the range of lines edited since the buffer was last compared.
+ * @param [out] nFirstLine First edited (apparent) line, -1 if none.
+ * @param [out] nLastLine Last edited (apparent) line, -1 if none.
+ * @return false if the edits are not known, e.g. an edit was undone.
+ */
+bool CDiffTextBuffer::GetEditedLines(int & nFirstLine, int & nLastLine) const
+{
+	nFirstLine = nLastLine = -1;
+	if (!m_bEditsTracked || m_dwCurrentRevisionNumber < m_dwRevisionNumberOnRescan)
+		return false;
+	if (m_dwCurrentRevisionNumber == m_dwRevisionNumberOnRescan)
+		return true;
+	const int nLineCount = GetLineCount();
+	for (int nLine = 0; nLine < nLineCount; ++nLine)
+	{
+		if (m_aLines[nLine].m_dwRevisionNumber > m_dwRevisionNumberOnRescan)
+		{
+			if (nFirstLine < 0)
+				nFirstLine = nLine;
+			nLastLine = nLine;
+		}
+	}
+	return true;
+}
+
 /** 
  * @brief Called when line has been edited.
  * After editing a line, we don't know if there is a diff or not.
@@ -226,6 +307,7 @@ int CDiffTextBuffer::LoadFromFile(LPCTSTR pszFileNameInit,
 {
 	ASSERT(!m_bInit);
 	ASSERT(m_aLines.size() == 0);
+	m_bEditsTracked = false;
 
 	// Unpacking the file here, save the result in a temporary file
 	m_strTempFileName = pszFileNameInit;
@@ -284,16 +366,11 @@ int CDiffTextBuffer::LoadFromFile(LPCTSTR pszFileNameInit,
 			if (encoding.m_unicoding == ucr::NONE  || !pufile->IsUnicode())
 				pufile->SetCodepage(encoding.m_codepage);
 		}
-		UINT lineno = 0;
 		String eol, preveol;
 		String sline;
 		bool done = false;
 		COleDateTime start = COleDateTime::GetCurrentTime(); // for trace messages
 
-		// Manually grow line array exponentially
-		UINT arraysize = 500;
-		m_aLines.resize(arraysize);
-		
 		// preveol must be initialized for empty files
 		preveol = _T("\n");
 		
@@ -306,32 +383,15 @@ int CDiffTextBuffer::LoadFromFile(LPCTSTR pszFileNameInit,
 				break;
 			// but if last line had eol, we add an extra (empty) line to buffer
 
-			// Grow line array
-			if (lineno == arraysize)
-			{
-				// For smaller sizes use exponential growth, but for larger
-				// sizes grow by constant ratio. Unlimited exponential growth
-				// easily runs out of memory.
-				if (arraysize < 100 * 1024)
-					arraysize *= 2;
-				else
-					arraysize += 100 * 1024;
-				m_aLines.resize(arraysize);
-			}
-
 			sline += eol; // TODO: opportunity for optimization, as CString append is terrible
 			if (lossy)
 			{
 				// TODO: Should record lossy status of line
 			}
-			AppendLine(lineno, sline.c_str(), static_cast<int>(sline.length()));
-			++lineno;
+			InsertLoadedLine(sline.c_str(), sline.length());
 			preveol = eol;
 
 		} while (!done);
-
-		// fix array size (due to our manual exponential growth
-		m_aLines.resize(lineno);
 	
 		
 		//Try to determine current CRLF mode (most frequent)
@@ -421,13 +481,7 @@ int CDiffTextBuffer::SaveToFile (const String& pszFileName,
 	if (pszFileName.empty())
 		return SAVE_FAILED;	// No filename, cannot save...
 
-	if (nCrlfStyle == CRLFSTYLE::AUTOMATIC &&
-		!GetOptionsMgr()->GetBool(OPT_ALLOW_MIXED_EOL))
-	{
-			// get the default nCrlfStyle of the CDiffTextBuffer
-		nCrlfStyle = GetCRLFMode();
-		ASSERT(nCrlfStyle != CRLFSTYLE::AUTOMATIC);
-	}
+	nCrlfStyle = GetSaveCrlfStyle(nCrlfStyle);
 
 	bool bOpenSuccess = true;
 	bool bSaveSuccess = false;
@@ -472,6 +526,86 @@ int CDiffTextBuffer::SaveToFile (const String& pszFileName,
 
 	file.WriteBom();
 
+	WriteLines(file, bTempFile, nCrlfStyle, nStartLine, nLines);
+	file.Close();
+
+	if (!bTempFile)
+	{
+		// If we are saving user files
+		// we need an unpacker/packer, at least a "do nothing" one
+		// repack the file here, overwrite the temporary file we did save in
+		bSaveSuccess = infoUnpacker.Packing(sIntermediateFilename, pszFileName, m_unpackerSubcodes, { pszFileName });
+		if (!bSaveSuccess)
+			sError = GetSysError();
+		try
+		{
+			TFile(sIntermediateFilename).remove();
+		}
+		catch (Exception& e)
+		{
+			LogErrorStringUTF8(e.displayText());
+		}
+		if (!bSaveSuccess)
+		{
+			// returns now, don't overwrite the original file
+			return m_unpackerSubcodes.empty() ? SAVE_FAILED : SAVE_PACK_FAILED;
+		}
+
+		if (bClearModifiedFlag)
+		{
+			SetModified(false);
+			m_nSyncPosition = m_nUndoPosition;
+		}
+
+		// remember revision number on save
+		m_dwRevisionNumberOnSave = m_dwCurrentRevisionNumber;
+
+		// redraw line revision marks
+		UpdateViews (nullptr, nullptr, UPDATE_FLAGSONLY);	
+	}
+	else
+	{
+		if (bClearModifiedFlag)
+		{
+			SetModified(false);
+			m_nSyncPosition = m_nUndoPosition;
+		}
+		bSaveSuccess = true;
+	}
+
+	if (bSaveSuccess)
+		return SAVE_DONE;
+	else
+		return SAVE_FAILED;
+}
+
+/**
+ * @brief Resolve the EOL style used when saving the buffer.
+ * Automatic style means the default style of the buffer unless mixed EOLs
+ * are allowed, in which case each line keeps its own EOL.
+ */
+CRLFSTYLE CDiffTextBuffer::GetSaveCrlfStyle(CRLFSTYLE nCrlfStyle) const
+{
+	if (nCrlfStyle == CRLFSTYLE::AUTOMATIC &&
+		!GetOptionsMgr()->GetBool(OPT_ALLOW_MIXED_EOL))
+	{
+			// get the default nCrlfStyle of the CDiffTextBuffer
+		nCrlfStyle = GetCRLFMode();
+		ASSERT(nCrlfStyle != CRLFSTYLE::AUTOMATIC);
+	}
+	return nCrlfStyle;
+}
+
+/**
+ * @brief Write real lines of the buffer with their EOLs.
+ * @param [in] writer Object with a WriteString(const String&) member.
+ * @param [in] bTempFile true when writing the input of the diff-engine.
+ * @param [in] nCrlfStyle Resolved EOL style, see GetSaveCrlfStyle().
+ */
+template<class Writer>
+void CDiffTextBuffer::WriteLines(Writer& writer, bool bTempFile, CRLFSTYLE nCrlfStyle,
+		int nStartLine, int nLines)
+{
 	// line loop : get each real line and write it in the file
 	String sLine;
 	String sEol = GetStringEol(nCrlfStyle);
@@ -505,7 +639,7 @@ int CDiffTextBuffer::SaveToFile (const String& pszFileName,
 			// If original last line had no EOL, then we are done
 			if( !m_aLines[line].HasEol() )
 			{
-				file.WriteString(sLine);
+				writer.WriteString(sLine);
 				break;
 			}
 			// Otherwise, add the appropriate EOL to the last line ...
@@ -524,7 +658,7 @@ int CDiffTextBuffer::SaveToFile (const String& pszFileName,
 		}
 
 		// write this line to the file (codeset or unicode conversions are done there
-		file.WriteString(sLine);
+		writer.WriteString(sLine);
 
 		if (line == lastRealLine || lastRealLine == -1)
 		{
@@ -532,56 +666,51 @@ int CDiffTextBuffer::SaveToFile (const String& pszFileName,
 			break;
 		}
 	}
-	file.Close();
+}
 
-	if (!bTempFile)
+/**
+ * @brief Serialize the buffer as SaveToFile() writes a temp file for the diff-engine.
+ * The diff-engine can then compare the text without a round trip through
+ * the disk.
+ * @param [out] contents UTF-8 text, with a BOM when the default diff algorithm is used.
+ * @param [in] nStartLine First line to write.
+ * @param [in] nLines Number of lines to write, -1 for all lines from nStartLine.
+ */
+void CDiffTextBuffer::SaveToMemory(FileContents& contents, int nStartLine /*= 0*/, int nLines /*= -1*/)
+{
+	ASSERT (m_bInit);
+
+	/** @brief Converts lines to UTF-8 the way UniStdioFile::WriteString() does. */
+	struct MemoryWriter
 	{
-		// If we are saving user files
-		// we need an unpacker/packer, at least a "do nothing" one
-		// repack the file here, overwrite the temporary file we did save in
-		bSaveSuccess = infoUnpacker.Packing(sIntermediateFilename, pszFileName, m_unpackerSubcodes, { pszFileName });
-		if (!bSaveSuccess)
-			sError = GetSysError();
-		try
-		{
-			TFile(sIntermediateFilename).remove();
-		}
-		catch (Exception& e)
-		{
-			LogErrorStringUTF8(e.displayText());
-		}
-		if (!bSaveSuccess)
+		FileContents& contents;
+		ucr::UNICODESET unicoding = ucr::NONE;
+		int codepage = 0;
+		ucr::buffer buf{ 256 };
+
+		explicit MemoryWriter(FileContents& contents) : contents(contents)
 		{
-			// returns now, don't overwrite the original file
-			return m_unpackerSubcodes.empty() ? SAVE_FAILED : SAVE_PACK_FAILED;
+			ucr::getInternalEncoding(&unicoding, &codepage);
 		}
-
-		if (bClearModifiedFlag)
+		void WriteString(const String& line)
 		{
-			SetModified(false);
-			m_nSyncPosition = m_nUndoPosition;
+			ucr::convert(unicoding, codepage, reinterpret_cast<const unsigned char *>(line.c_str()),
+				line.length() * sizeof(TCHAR), ucr::UTF8, ucr::CP_UTF_8, &buf);
+			contents.Append(reinterpret_cast<const char *>(buf.ptr), buf.size);
 		}
+	};
 
-		// remember revision number on save
-		m_dwRevisionNumberOnSave = m_dwCurrentRevisionNumber;
+	if (nLines == -1)
+		nLines = static_cast<int>(m_aLines.size() - nStartLine);
 
-		// redraw line revision marks
-		UpdateViews (nullptr, nullptr, UPDATE_FLAGSONLY);	
-	}
-	else
-	{
-		if (bClearModifiedFlag)
-		{
-			SetModified(false);
-			m_nSyncPosition = m_nUndoPosition;
-		}
-		bSaveSuccess = true;
-	}
+	// Empty text is still loaded contents, not a missing file
+	contents.Clear();
+	contents.Append(nullptr, 0);
+	if (GetOptionsMgr()->GetInt(OPT_CMP_DIFF_ALGORITHM) == 0)
+		contents.Append("\xEF\xBB\xBF", 3);
 
-	if (bSaveSuccess)
-		return SAVE_DONE;
-	else
-		return SAVE_FAILED;
+	MemoryWriter writer(contents);
+	WriteLines(writer, true, GetSaveCrlfStyle(CRLFSTYLE::AUTOMATIC), nStartLine, nLines);
 }
 
 /// Replace line (removing any eol, and only including one if in strText)
@@ -10,6 +10,7 @@
 
 class CMergeDoc;
 class PackingInfo;
+class FileContents;
 
 /**
  * @brief Specialized buffer to save file data
@@ -25,6 +26,8 @@ private :
 	String m_strTempFileName; /**< Temporary file name. */
 	std::vector<int> m_unpackerSubcodes; /**< Plugin information. */
 	bool m_bMixedEOL; /**< EOL style of this buffer is mixed? */
+	DWORD m_dwRevisionNumberOnRescan; /**< Revision number when the buffer was last compared */
+	bool m_bEditsTracked; /**< Do line revision numbers show all edits since the last compare? */
 
 	/** 
 	 * @brief Unicode encoding from ucr::UNICODESET.
@@ -38,6 +41,9 @@ private :
 	FileTextEncoding m_encoding;
 
 	bool FlagIsSet(UINT line, DWORD flag) const;
+	CRLFSTYLE GetSaveCrlfStyle(CRLFSTYLE nCrlfStyle) const;
+	template<class Writer>
+	void WriteLines(Writer& writer, bool bTempFile, CRLFSTYLE nCrlfStyle, int nStartLine, int nLines);
 
 public :
 	CDiffTextBuffer(CMergeDoc * pDoc, int pane);
@@ -57,6 +63,7 @@ public :
 	int SaveToFile (const String& pszFileName, bool bTempFile, String & sError,
 		PackingInfo& infoUnpacker, CRLFSTYLE nCrlfStyle = CRLFSTYLE::AUTOMATIC,
 		bool bClearModifiedFlag = true, int nStartLine = 0, int nLines = -1);
+	void SaveToMemory(FileContents& contents, int nStartLine = 0, int nLines = -1);
 	ucr::UNICODESET getUnicoding() const { return m_encoding.m_unicoding; }
 	void setUnicoding(ucr::UNICODESET value) { m_encoding.m_unicoding = value; }
 	int getCodepage() const { return m_encoding.m_codepage; }
@@ -75,7 +82,11 @@ public :
 	bool GetFullLine(int nLineIndex, CString &strLine) const;
 
 	virtual void SetModified (bool bModified = true) override;
+	virtual void RestoreRevisionNumbers(int nStartLine, CDWordArray *paSavedRevisionNumbers) override;
+	virtual void OnDiscardUndoGroups(int nGroups) override;
 	void prepareForRescan();
+	void SetRescanned();
+	bool GetEditedLines(int & nFirstLine, int & nLastLine) const;
 	virtual void OnNotifyLineHasBeenEdited(int nLine) override;
 	bool IsInitialized() const;
 	virtual bool DeleteText2 (CCrystalTextView * pSource, int nStartLine,
@@ -15,6 +15,7 @@
 #include "CompareStats.h"
 #include "IAbortable.h"
 #include "Plugins.h"
+#include "DirScanPipeline.h"
 #include "DebugNew.h"
 
 using Poco::Thread;
@@ -55,6 +56,7 @@ CDiffThread::CDiffThread()
 CDiffThread::~CDiffThread()
 {
 	delete m_pDiffParm->pSemaphore;
+	delete m_pDiffParm->pPipeline;
 }
 
 /**
@@ -85,6 +87,8 @@ unsigned CDiffThread::CompareDirectories()
 
 	delete m_pDiffParm->pSemaphore;
 	m_pDiffParm->pSemaphore = new Semaphore(0, LONG_MAX);
+	delete m_pDiffParm->pPipeline;
+	m_pDiffParm->pPipeline = new DirScanPipeline(m_pDiffContext);
 
 	m_pDiffParm->context->m_pCompareStats->SetCompareState(CompareStats::STATE_START);
 
@@ -112,6 +116,9 @@ static void DiffThreadCollect(void *pParam)
 	if (myStruct->m_fncCollect)
 		myStruct->m_fncCollect(myStruct);
 
+	// Stop collect workers started by DirScan_GetItems()
+	myStruct->pCollector.reset();
+
 	// Release Semaphore() once again to signal that collect phase is ready
 	myStruct->pSemaphore->set();
 
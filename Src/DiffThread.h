@@ -19,6 +19,8 @@ namespace Poco
 class Semaphore;
 }
 class DiffThreadAbortable;
+class DirScanPipeline;
+class DirScanCollector;
 
 /**
  * @brief Structure used in sending data to the threads.
@@ -33,6 +35,8 @@ struct DiffFuncStruct
 	int nCollectThreadState; /**< Collect thread state. */
 	DiffThreadAbortable * m_pAbortgate; /**< Interface for aborting compare. */
 	Poco::Semaphore *pSemaphore; /**< Semaphore for synchronizing threads. */
+	DirScanPipeline *pPipeline; /**< Items handed from collect to compare thread. */
+	std::shared_ptr<DirScanCollector> pCollector; /**< Collect workers, kept during collect phase. */
 	std::function<void (DiffFuncStruct*)> m_fncCollect;
 	std::function<void (DiffFuncStruct*)> m_fncCompare;
 	bool bMarkedRescan;	/**< Is the rescan due to "Refresh Selected"? */
@@ -43,6 +47,7 @@ struct DiffFuncStruct
 		, nCollectThreadState(0/*CDiffThread::THREAD_NOTSTARTED*/)
 		, m_pAbortgate(nullptr)
 		, pSemaphore(nullptr)
+		, pPipeline(nullptr)
 		, bMarkedRescan(false)
 		{}
 };
@@ -51,8 +56,8 @@ struct DiffFuncStruct
  * @brief Class for threaded folder compare.
  * This class implements folder compare in two phases and in two threads:
  * - first thread collects items to compare to compare-time list
- *   (m_diffList).
- * - second threads compares items in the list.
+ *   (m_diffList), and pushes them to the compare pipeline.
+ * - second threads compares items from the pipeline.
  */
 class CDiffThread
 {
@@ -19,6 +19,7 @@
 #include <map>
 #include <cassert>
 #include <exception>
+#include <execution>
 #include <vector>
 #include <list>
 #include <Poco/Format.h>
@@ -48,6 +49,7 @@
 #include "SyntaxColors.h"
 #include "MergeApp.h"
 #include "SubstitutionList.h"
+#include "FileContents.h"
 
 using Poco::Debugger;
 using Poco::format;
@@ -60,6 +62,7 @@ extern "C" int is_blank_line(char const* pch, char const* limit);
 
 static void CopyTextStats(const file_data * inf, FileTextStats * myTextStats);
 static void CopyDiffutilTextStats(file_data *inf, DiffFileData * diffData);
+static bool WriteContentsToFile(const String& path, const FileContents& contents);
 
 /**
  * @brief Default constructor.
@@ -75,6 +78,7 @@ CDiffWrapper::CDiffWrapper()
 , m_infoPrediffer(nullptr)
 , m_pDiffList(nullptr)
 , m_bPathsAreTemp(false)
+, m_pContents(nullptr)
 , m_pFilterList(nullptr)
 , m_pSubstitutionList{nullptr}
 , m_bPluginsEnabled(false)
@@ -480,9 +484,23 @@ bool CDiffWrapper::RunFileDiff()
 	if (m_bUseDiffList)
 		m_nDiffs = m_pDiffList->GetSize();
 
+	// Prediffer plugins work on files, so give them the contents as temp files
+	const FileContents *pContents = m_pContents;
+	if (pContents != nullptr && m_bPluginsEnabled && m_infoPrediffer &&
+		!m_infoPrediffer->GetPluginPipeline().empty())
+	{
+		assert(m_bPathsAreTemp);
+		for (file = 0; file < aFiles.GetSize(); file++)
+		{
+			if (!WriteContentsToFile(strFileTemp[file], pContents[file]))
+				return false;
+		}
+		pContents = nullptr;
+	}
+
 	for (file = 0; file < aFiles.GetSize(); file++)
 	{
-		if (m_bPluginsEnabled)
+		if (m_bPluginsEnabled && pContents == nullptr)
 		{
 			// Do the preprocessing now, overwrite the temp files
 			// NOTE: FileTransform_UCS2ToUTF8() may create new temp
@@ -515,7 +533,8 @@ bool CDiffWrapper::RunFileDiff()
 	{
 		diffdata.SetDisplayFilepaths(aFiles[0], aFiles[1]); // store true names for diff utils patch file
 		// This opens & fstats both files (if it succeeds)
-		if (!diffdata.OpenFiles(strFileTemp[0], strFileTemp[1]))
+		if (pContents != nullptr ? !diffdata.OpenContents(pContents[0], pContents[1]) :
+			!diffdata.OpenFiles(strFileTemp[0], strFileTemp[1]))
 		{
 			return false;
 		}
@@ -548,14 +567,16 @@ bool CDiffWrapper::RunFileDiff()
 		diffdata10.SetDisplayFilepaths(aFiles[1], aFiles[0]); // store true names for diff utils patch file
 		diffdata12.SetDisplayFilepaths(aFiles[1], aFiles[2]); // store true names for diff utils patch file
 
-		if (!diffdata10.OpenFiles(strFileTemp[1], strFileTemp[0]))
+		if (pContents != nullptr ? !diffdata10.OpenContents(pContents[1], pContents[0]) :
+			!diffdata10.OpenFiles(strFileTemp[1], strFileTemp[0]))
 		{
 			return false;
 		}
 
 		bRet = Diff2Files(&script10, &diffdata10, &bin_flag10, nullptr);
 
-		if (!diffdata12.OpenFiles(strFileTemp[1], strFileTemp[2]))
+		if (pContents != nullptr ? !diffdata12.OpenContents(pContents[1], pContents[2]) :
+			!diffdata12.OpenFiles(strFileTemp[1], strFileTemp[2]))
 		{
 			return false;
 		}
@@ -933,8 +954,7 @@ bool CDiffWrapper::RegExpFilter(int StartPos, int EndPos, const file_data *pinf)
 		size_t len = pinf->linbuf[line + 1] - pinf->linbuf[line];
 		const char *string = pinf->linbuf[line];
 		size_t stringlen = linelen(string, len);
-		if (!m_pFilterList->Match(std::string(string, stringlen)))
-
+		if (!m_pFilterList->Match(string, stringlen))
 		{
 			linesMatch = false;
 		}
@@ -944,14 +964,14 @@ bool CDiffWrapper::RegExpFilter(int StartPos, int EndPos, const file_data *pinf)
 }
 
 /**
- * @brief Walk the diff utils change script, building the WinMerge list of diff blocks
+ * @brief Split the diff utils change script into hunks.
+ * @param [in] script Change script.
+ * @param [in] inf Files compared.
+ * @return Hunks of the script that change lines or were marked trivial.
  */
-void
-CDiffWrapper::LoadWinMergeDiffsFromDiffUtilsScript(struct change * script, const file_data * file_data_ary)
+std::vector<DiffHunk> CDiffWrapper::GetHunks(struct change * script, const file_data * inf)
 {
-	//Logic needed for Ignore comment option
-	PostFilterContext ctxt;
-
+	std::vector<DiffHunk> hunks;
 	struct change *next = script;
 	
 	while (next != nullptr)
@@ -968,95 +988,143 @@ CDiffWrapper::LoadWinMergeDiffsFromDiffUtilsScript(struct change * script, const
 		debug_script(thisob);
 #endif
 
-		/* Print thisob hunk.  */
-		//(*printfun) (thisob);
-		{					
-			/* Determine range of line numbers involved in each file.  */
-			int first0=0, last0=0, first1=0, last1=0, deletes=0, inserts=0;
-			analyze_hunk (thisob, &first0, &last0, &first1, &last1, &deletes, &inserts, file_data_ary);
-			if (deletes || inserts || thisob->trivial)
-			{
-				OP_TYPE op = OP_NONE;
-				if (deletes && inserts)
-					op = OP_DIFF;
-				else if (deletes || inserts)
-					op = OP_DIFF;
-				else
-					op = OP_TRIVIAL;
-				
-				/* Print the lines that the first file has.  */
-				int trans_a0=0, trans_b0=0, trans_a1=0, trans_b1=0;
-				translate_range(&file_data_ary[0], first0, last0, &trans_a0, &trans_b0);
-				translate_range(&file_data_ary[1], first1, last1, &trans_a1, &trans_b1);
-
-				// Store information about these blocks in moved line info
-				if (GetDetectMovedBlocks())
-				{
-					if (thisob->match0>=0)
-					{
-						assert(thisob->inserted > 0);
-						for (int i=0; i<thisob->inserted; ++i)
-						{
-							int line0 = i+thisob->match0 + (trans_a0-first0-1);
-							int line1 = i+thisob->line1 + (trans_a1-first1-1);
-							GetMovedLines(1)->Add(MovedLines::SIDE::LEFT, line1, line0);
-						}
-					}
-					if (thisob->match1>=0)
-					{
-						assert(thisob->deleted > 0);
-						for (int i=0; i<thisob->deleted; ++i)
-						{
-							int line0 = i+thisob->line0 + (trans_a0-first0-1);
-							int line1 = i+thisob->match1 + (trans_a1-first1-1);
-							GetMovedLines(0)->Add(MovedLines::SIDE::RIGHT, line0, line1);
-						}
-					}
-				}
-				int QtyLinesLeft = (trans_b0 - trans_a0) + 1; //Determine quantity of lines in this block for left side
-				int QtyLinesRight = (trans_b1 - trans_a1) + 1;//Determine quantity of lines in this block for right side
+		/* Determine range of line numbers involved in each file.  */
+		DiffHunk hunk{ thisob };
+		int deletes = 0, inserts = 0;
+		analyze_hunk (thisob, &hunk.first0, &hunk.last0, &hunk.first1, &hunk.last1, &deletes, &inserts, inf);
+		if (deletes || inserts || thisob->trivial)
+		{
+			hunk.op = (deletes || inserts) ? OP_DIFF : OP_TRIVIAL;
+			translate_range(&inf[0], hunk.first0, hunk.last0, &hunk.trans_a0, &hunk.trans_b0);
+			translate_range(&inf[1], hunk.first1, hunk.last1, &hunk.trans_a1, &hunk.trans_b1);
+			hunks.push_back(hunk);
+		}
+		
+		/* Reconnect the script so it will all be freed properly.  */
+		end->link = next;
+	}
+	return hunks;
+}
 
-				if (m_options.m_filterCommentsLines ||
-					(m_pSubstitutionList && m_pSubstitutionList->HasRegExps()))
-					PostFilter(ctxt, trans_a0 - 1, QtyLinesLeft, trans_a1 - 1, QtyLinesRight, op, file_data_ary);
+/**
+ * @brief Set hunks differing only in filtered text to trivial.
+ * Comment filtering carries the parser state from hunk to hunk, so it is
+ * done in order. Substitution and line filters handle each hunk on its own,
+ * so many hunks are filtered in parallel.
+ * @param [in,out] hunks Hunks to filter.
+ * @param [in] inf Files compared.
+ */
+void CDiffWrapper::FilterHunks(std::vector<DiffHunk>& hunks, const file_data * inf) const
+{
+	const size_t ParallelFilterHunks = 64;
+	const bool bSubstitute = m_pSubstitutionList && m_pSubstitutionList->HasRegExps();
+	const bool bLineFilter = m_pFilterList != nullptr && m_pFilterList->HasRegExps();
 
-				if (m_pFilterList != nullptr && m_pFilterList->HasRegExps())
+	if (m_options.m_filterCommentsLines)
+	{
+		//Logic needed for Ignore comment option
+		PostFilterContext ctxt;
+		for (DiffHunk& hunk : hunks)
+		{
+			PostFilter(ctxt, hunk.trans_a0 - 1, (hunk.trans_b0 - hunk.trans_a0) + 1,
+				hunk.trans_a1 - 1, (hunk.trans_b1 - hunk.trans_a1) + 1, hunk.op, inf);
+		}
+	}
+	if (!bLineFilter && (!bSubstitute || m_options.m_filterCommentsLines))
+		return;
+
+	auto filter = [&](DiffHunk& hunk)
+	{
+		int QtyLinesLeft = (hunk.trans_b0 - hunk.trans_a0) + 1; //Determine quantity of lines in this block for left side
+		int QtyLinesRight = (hunk.trans_b1 - hunk.trans_a1) + 1;//Determine quantity of lines in this block for right side
+
+		if (bSubstitute && !m_options.m_filterCommentsLines)
+		{
+			PostFilterContext ctxt;
+			PostFilter(ctxt, hunk.trans_a0 - 1, QtyLinesLeft, hunk.trans_a1 - 1, QtyLinesRight, hunk.op, inf);
+		}
+
+		if (bLineFilter && hunk.op != OP_TRIVIAL)
+		{
+			// Match lines against regular expression filters
+			// Our strategy is that every line in both sides must
+			// match regexp before we mark difference as ignored.
+			bool match2 = false;
+			bool match1 = RegExpFilter(hunk.thisob->line0, hunk.thisob->line0 + QtyLinesLeft - 1, &inf[0]);
+			if (match1)
+				match2 = RegExpFilter(hunk.thisob->line1, hunk.thisob->line1 + QtyLinesRight - 1, &inf[1]);
+			if (match1 && match2)
+				hunk.op = OP_TRIVIAL;
+		}
+	};
+	if (hunks.size() >= ParallelFilterHunks)
+		std::for_each(std::execution::par, hunks.begin(), hunks.end(), filter);
+	else
+		std::for_each(hunks.begin(), hunks.end(), filter);
+}
+
+/**
+ * @brief Walk the diff utils change script, building the WinMerge list of diff blocks
+ */
+void
+CDiffWrapper::LoadWinMergeDiffsFromDiffUtilsScript(struct change * script, const file_data * file_data_ary)
+{
+	std::vector<DiffHunk> hunks = GetHunks(script, file_data_ary);
+	FilterHunks(hunks, file_data_ary);
+
+	for (const DiffHunk& hunk : hunks)
+	{
+		const struct change *thisob = hunk.thisob;
+		const int first0 = hunk.first0, first1 = hunk.first1;
+		int trans_a0 = hunk.trans_a0, trans_b0 = hunk.trans_b0, trans_a1 = hunk.trans_a1, trans_b1 = hunk.trans_b1;
+		OP_TYPE op = hunk.op;
+
+		// Store information about these blocks in moved line info
+		if (GetDetectMovedBlocks())
+		{
+			if (thisob->match0>=0)
+			{
+				assert(thisob->inserted > 0);
+				for (int i=0; i<thisob->inserted; ++i)
 				{
-					// Match lines against regular expression filters
-					// Our strategy is that every line in both sides must
-					// match regexp before we mark difference as ignored.
-					bool match2 = false;
-					bool match1 = RegExpFilter(thisob->line0, thisob->line0 + QtyLinesLeft - 1, &file_data_ary[0]);
-					if (match1)
-						match2 = RegExpFilter(thisob->line1, thisob->line1 + QtyLinesRight - 1, &file_data_ary[1]);
-					if (match1 && match2)
-						op = OP_TRIVIAL;
+					int line0 = i+thisob->match0 + (trans_a0-first0-1);
+					int line1 = i+thisob->line1 + (trans_a1-first1-1);
+					GetMovedLines(1)->Add(MovedLines::SIDE::LEFT, line1, line0);
 				}
-
-				if (op == OP_TRIVIAL && m_options.m_bCompletelyBlankOutIgnoredDiffereneces)
+			}
+			if (thisob->match1>=0)
+			{
+				assert(thisob->deleted > 0);
+				for (int i=0; i<thisob->deleted; ++i)
 				{
-					if (QtyLinesLeft == QtyLinesRight)
-					{
-						op = OP_NONE;
-					}
-					else if (QtyLinesLeft < QtyLinesRight)
-					{
-						trans_a0 += QtyLinesLeft;
-						trans_a1 += QtyLinesLeft;
-					}
-					else
-					{
-						trans_a0 += QtyLinesRight;
-						trans_a1 += QtyLinesRight;
-					}
+					int line0 = i+thisob->line0 + (trans_a0-first0-1);
+					int line1 = i+thisob->match1 + (trans_a1-first1-1);
+					GetMovedLines(0)->Add(MovedLines::SIDE::RIGHT, line0, line1);
 				}
-				if (op != OP_NONE)
-					AddDiffRange(m_pDiffList, trans_a0-1, trans_b0-1, trans_a1-1, trans_b1-1, op);
 			}
 		}
-		
-		/* Reconnect the script so it will all be freed properly.  */
-		end->link = next;
+		int QtyLinesLeft = (trans_b0 - trans_a0) + 1; //Determine quantity of lines in this block for left side
+		int QtyLinesRight = (trans_b1 - trans_a1) + 1;//Determine quantity of lines in this block for right side
+
+		if (op == OP_TRIVIAL && m_options.m_bCompletelyBlankOutIgnoredDiffereneces)
+		{
+			if (QtyLinesLeft == QtyLinesRight)
+			{
+				op = OP_NONE;
+			}
+			else if (QtyLinesLeft < QtyLinesRight)
+			{
+				trans_a0 += QtyLinesLeft;
+				trans_a1 += QtyLinesLeft;
+			}
+			else
+			{
+				trans_a0 += QtyLinesRight;
+				trans_a1 += QtyLinesRight;
+			}
+		}
+		if (op != OP_NONE)
+			AddDiffRange(m_pDiffList, trans_a0-1, trans_b0-1, trans_a1-1, trans_b1-1, op);
 	}
 }
 
@@ -1105,117 +1173,65 @@ CDiffWrapper::LoadWinMergeDiffsFromDiffUtilsScript3(
 
 	for (int file = 0; file < 2; file++)
 	{
-		struct change *next = nullptr;
-		int trans_a0, trans_b0, trans_a1, trans_b1;
-		int first0, last0, first1, last1, deletes, inserts;
-		OP_TYPE op;
+		struct change *script = nullptr;
 		const file_data *pinf = nullptr;
 		DiffList *pdiff = nullptr;
-		PostFilterContext ctxt;
 
 		switch (file)
 		{
-		case 0: next = script10; pdiff = &diff10; pinf = inf10; break;
-		case 1: next = script12; pdiff = &diff12; pinf = inf12; break;
+		case 0: script = script10; pdiff = &diff10; pinf = inf10; break;
+		case 1: script = script12; pdiff = &diff12; pinf = inf12; break;
 		}
 
-		while (next != nullptr)
+		std::vector<DiffHunk> hunks = GetHunks(script, pinf);
+		FilterHunks(hunks, pinf);
+
+		for (const DiffHunk& hunk : hunks)
 		{
-			/* Find a set of changes that belong together.  */
-			struct change *thisob = next;
-			struct change *end = find_change(next);
-			
-			/* Disconnect them from the rest of the changes,
-			making them a hunk, and remember the rest for next iteration.  */
-			next = end->link;
-			end->link = nullptr;
-#ifdef DEBUG
-			debug_script(thisob);
-#endif
+			const struct change *thisob = hunk.thisob;
+			const int first0 = hunk.first0, first1 = hunk.first1;
+			const int trans_a0 = hunk.trans_a0, trans_b0 = hunk.trans_b0, trans_a1 = hunk.trans_a1, trans_b1 = hunk.trans_b1;
 
-			/* Print thisob hunk.  */
-			//(*printfun) (thisob);
-			{					
-				/* Determine range of line numbers involved in each file.  */
-				analyze_hunk (thisob, &first0, &last0, &first1, &last1, &deletes, &inserts, pinf);
-				if (deletes || inserts || thisob->trivial)
+			// Store information about these blocks in moved line info
+			if (GetDetectMovedBlocks())
+			{
+				int index1 = 0;  // defaults for (file == 0 /* diff10 */)
+				int index2 = 1;
+				MovedLines::SIDE side1 = MovedLines::SIDE::RIGHT;
+				MovedLines::SIDE side2 = MovedLines::SIDE::LEFT;
+				if (file == 1 /* diff12 */)
+				{
+					index1 = 2;
+					index2 = 1;
+					side1 = MovedLines::SIDE::LEFT;
+					side2 = MovedLines::SIDE::RIGHT;
+				}
+				if (index1 != -1 && index2 != -1)
 				{
-					if (deletes && inserts)
-						op = OP_DIFF;
-					else if (deletes || inserts)
-						op = OP_DIFF;
-					else
-						op = OP_TRIVIAL;
-					
-					/* Print the lines that the first file has.  */
-					translate_range (&pinf[0], first0, last0, &trans_a0, &trans_b0);
-					translate_range (&pinf[1], first1, last1, &trans_a1, &trans_b1);
-
-					// Store information about these blocks in moved line info
-					if (GetDetectMovedBlocks())
+					if (thisob->match0>=0)
 					{
-						int index1 = 0;  // defaults for (file == 0 /* diff10 */)
-						int index2 = 1;
-						MovedLines::SIDE side1 = MovedLines::SIDE::RIGHT;
-						MovedLines::SIDE side2 = MovedLines::SIDE::LEFT;
-						if (file == 1 /* diff12 */)
-						{
-							index1 = 2;
-							index2 = 1;
-							side1 = MovedLines::SIDE::LEFT;
-							side2 = MovedLines::SIDE::RIGHT;
-						}
-						if (index1 != -1 && index2 != -1)
+						assert(thisob->inserted > 0);
+						for (int i=0; i<thisob->inserted; ++i)
 						{
-							if (thisob->match0>=0)
-							{
-								assert(thisob->inserted > 0);
-								for (int i=0; i<thisob->inserted; ++i)
-								{
-									int line0 = i+thisob->match0 + (trans_a0-first0-1);
-									int line1 = i+thisob->line1 + (trans_a1-first1-1);
-									GetMovedLines(index1)->Add(side1, line1, line0);
-								}
-							}
-							if (thisob->match1>=0)
-							{
-								assert(thisob->deleted > 0);
-								for (int i=0; i<thisob->deleted; ++i)
-								{
-									int line0 = i+thisob->line0 + (trans_a0-first0-1);
-									int line1 = i+thisob->match1 + (trans_a1-first1-1);
-									GetMovedLines(index2)->Add(side2, line0, line1);
-								}
-							}
+							int line0 = i+thisob->match0 + (trans_a0-first0-1);
+							int line1 = i+thisob->line1 + (trans_a1-first1-1);
+							GetMovedLines(index1)->Add(side1, line1, line0);
 						}
 					}
-
-					int QtyLinesLeft = (trans_b0 - trans_a0) + 1; //Determine quantity of lines in this block for left side
-					int QtyLinesRight = (trans_b1 - trans_a1) + 1;//Determine quantity of lines in this block for right side
-
-					if (m_options.m_filterCommentsLines ||
-						(m_pSubstitutionList && m_pSubstitutionList->HasRegExps()))
-						PostFilter(ctxt, trans_a0 - 1, QtyLinesLeft, trans_a1 - 1, QtyLinesRight, op, pinf);
-
-					if (m_pFilterList != nullptr && m_pFilterList->HasRegExps())
+					if (thisob->match1>=0)
 					{
-						// Match lines against regular expression filters
-						// Our strategy is that every line in both sides must
-						// match regexp before we mark difference as ignored.
-						bool match2 = false;
-						bool match1 = RegExpFilter(thisob->line0, thisob->line0 + QtyLinesLeft - 1, &pinf[0]);
-						if (match1)
-							match2 = RegExpFilter(thisob->line1, thisob->line1 + QtyLinesRight - 1, &pinf[1]);
-						if (match1 && match2)
-							op = OP_TRIVIAL;
+						assert(thisob->deleted > 0);
+						for (int i=0; i<thisob->deleted; ++i)
+						{
+							int line0 = i+thisob->line0 + (trans_a0-first0-1);
+							int line1 = i+thisob->match1 + (trans_a1-first1-1);
+							GetMovedLines(index2)->Add(side2, line0, line1);
+						}
 					}
-
-					AddDiffRange(pdiff, trans_a0-1, trans_b0-1, trans_a1-1, trans_b1-1, op);
 				}
 			}
-			
-			/* Reconnect the script so it will all be freed properly.  */
-			end->link = next;
+
+			AddDiffRange(pdiff, trans_a0-1, trans_b0-1, trans_a1-1, trans_b1-1, hunk.op);
 		}
 	}
 
@@ -1501,3 +1517,15 @@ void CopyDiffutilTextStats(file_data *inf, DiffFileData * diffData)
 	CopyTextStats(&inf[0], &diffData->m_textStats[0]);
 	CopyTextStats(&inf[1], &diffData->m_textStats[1]);
 }
+
+/**
+ * @brief Write contents compared in memory to a file for prediffer plugins.
+ */
+bool WriteContentsToFile(const String& path, const FileContents& contents)
+{
+	FILE *fp = nullptr;
+	if (_tfopen_s(&fp, path.c_str(), _T("wb")) != 0 || fp == nullptr)
+		return false;
+	const size_t written = fwrite(contents.GetData(), 1, contents.GetSize(), fp);
+	return fclose(fp) == 0 && written == contents.GetSize();
+}
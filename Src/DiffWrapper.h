@@ -9,6 +9,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "diff.h"
 #include "FileLocation.h"
 #include "PathContext.h"
@@ -25,6 +26,7 @@ struct file_data;
 class MovedLines;
 class FilterList;
 class SubstitutionList;
+class FileContents;
 namespace CrystalLineParser { struct TextDefinition; };
 
 /** @enum COMPARE_TYPE
@@ -147,6 +149,17 @@ struct PostFilterContext
 	unsigned dwCookieRight = 0;
 };
 
+/**
+ * @brief Line ranges of one hunk of a diffutils change script.
+ */
+struct DiffHunk
+{
+	struct change *thisob; /**< First change of the hunk */
+	int first0, last0, first1, last1; /**< Lines involved, in diffutils numbering */
+	int trans_a0, trans_b0, trans_a1, trans_b1; /**< Lines involved, in file numbering */
+	OP_TYPE op; /**< Type of the hunk, OP_TRIVIAL if filtered */
+};
+
 /**
  * @brief Wrapper class for diffengine (diffutils and ByteComparator).
  * Diffwappre class is used to run selected diffengine. For folder compare
@@ -173,6 +186,7 @@ public:
 	void SetAppendFiles(bool bAppendFiles);
 	void SetPaths(const PathContext &files, bool tempPaths);
 	void SetAlternativePaths(const PathContext &altPaths);
+	void SetContents(const FileContents *pContents);
 	bool RunFileDiff();
 	void GetDiffStatus(DIFFSTATUS *status) const;
 	void AddDiffRange(DiffList *pDiffList, unsigned begin0, unsigned end0, unsigned begin1, unsigned end1, OP_TYPE op);
@@ -197,6 +211,8 @@ protected:
 	bool Diff2Files(struct change ** diffs, DiffFileData *diffData,
 		int * bin_status, int * bin_file) const;
 	void LoadWinMergeDiffsFromDiffUtilsScript(struct change * script, const file_data * inf);
+	static std::vector<DiffHunk> GetHunks(struct change * script, const file_data * inf);
+	void FilterHunks(std::vector<DiffHunk>& hunks, const file_data * inf) const;
 	void WritePatchFile(struct change * script, file_data * inf);
 public:
 	void LoadWinMergeDiffsFromDiffUtilsScript3(
@@ -217,6 +233,7 @@ private:
 
 	String m_sPatchFile; /**< Full path to created patch file. */
 	bool m_bPathsAreTemp; /**< Are compared paths temporary? */
+	const FileContents *m_pContents; /**< Contents compared instead of reading the paths, or nullptr */
 	/// prediffer info are stored only for MergeDoc
 	std::unique_ptr<PrediffingInfo> m_infoPrediffer;
 	/// prediffer info are stored only for MergeDoc
@@ -266,6 +283,19 @@ inline void CDiffWrapper::SetCompareFiles(const PathContext &originalFile)
 	m_originalFile = originalFile;
 }
 
+/**
+ * @brief Set contents to compare instead of reading the compared files.
+ * The contents must stay valid until RunFileDiff() returns. If prediffer
+ * plugins need to run, the contents are written to the (temporary) paths
+ * set with SetPaths() first.
+ * @param [in] pContents One FileContents per compared file, or nullptr to
+ * read the files.
+ */
+inline void CDiffWrapper::SetContents(const FileContents *pContents)
+{
+	m_pContents = pContents;
+}
+
 /**
  * @brief Set alternative paths for compared files.
  * Sets alternative paths for diff'ed files. These alternative paths might not
@@ -312,38 +312,7 @@ DIFFITEM *FindItemFromPaths(const CDiffContext& ctxt, const PathContext& paths)
 	if (std::any_of(file, file + paths.GetSize(), [&](auto& it) { return strutils::compare_nocase(it, file[0]) != 0; }))
 		return 0;
 
-	DIFFITEM *pos = ctxt.GetFirstDiffPosition();
-	if (paths.GetSize() == 2)
-	{
-		while (DIFFITEM *currentPos = pos) // Save our current pos before getting next
-		{
-			const DIFFITEM &di = ctxt.GetNextDiffPosition(pos);
-			if (di.diffFileInfo[0].path == path[0] &&
-				di.diffFileInfo[1].path == path[1] &&
-				di.diffFileInfo[0].filename == file[0] &&
-				di.diffFileInfo[1].filename == file[1])
-			{
-				return currentPos;
-			}
-		}
-	}
-	else
-	{
-		while (DIFFITEM *currentPos = pos) // Save our current pos before getting next
-		{
-			const DIFFITEM &di = ctxt.GetNextDiffPosition(pos);
-			if (di.diffFileInfo[0].path == path[0] &&
-				di.diffFileInfo[1].path == path[1] &&
-				di.diffFileInfo[2].path == path[2] &&
-				di.diffFileInfo[0].filename == file[0] &&
-				di.diffFileInfo[1].filename == file[1] &&
-				di.diffFileInfo[2].filename == file[2])
-			{
-				return currentPos;
-			}
-		}
-	}
-	return 0;
+	return ctxt.FindItemFromRelativePaths(paths.GetSize(), path, file);
 }
 
 /// is it possible to copy item to left ?
@@ -555,6 +555,7 @@ bool DoItemRename(InputIterator& it, const CDiffContext& ctxt, const String& szN
 	if (std::count(bRename, bRename + nDirs, true) == 0)
 		return false;
 	
+	ctxt.InvalidatePathIndex();
 	di.diffcode.setSideNone();
 	for (int index = 0; index < nDirs; index++)
 	{
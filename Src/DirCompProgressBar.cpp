@@ -9,6 +9,8 @@
 #include "CompareStats.h"
 #include "DiffContext.h"
 #include "paths.h"
+#include <algorithm>
+#include <climits>
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -28,6 +30,7 @@ void DirCompProgressBar::ClearStat()
 
 	SetDlgItemInt(IDC_ITEMSCOMPARED, 0);
 	SetDlgItemInt(IDC_ITEMSTOTAL, 0);
+	SetDlgItemText(IDC_COMPARE_THREADS, _T(""));
 
 	m_prevState = CompareStats::STATE_IDLE;
 }
@@ -101,6 +104,32 @@ void DirCompProgressBar::SetProgressState(int comparedItems, int totalItems)
 #endif
 }
 
+/**
+ * @brief Show count of compare threads, their average utilization and
+ * range of items compared per thread.
+ */
+void DirCompProgressBar::ShowThreadUtilization()
+{
+	const int nThreads = m_pCompareStats->GetCompareThreadCount();
+	if (nThreads <= 0)
+		return;
+	double utilization = 0.0;
+	int minItems = INT_MAX, maxItems = 0;
+	for (int i = 0; i < nThreads; ++i)
+	{
+		utilization += m_pCompareStats->GetThreadUtilization(i);
+		const int nItems = m_pCompareStats->GetThreadItemCount(i);
+		minItems = (std::min)(minItems, nItems);
+		maxItems = (std::max)(maxItems, nItems);
+	}
+	const int percent = static_cast<int>(utilization * 100.0 / nThreads + 0.5);
+	String items = strutils::to_str(minItems);
+	if (minItems != maxItems)
+		items += _T("-") + strutils::to_str(maxItems);
+	SetDlgItemText(IDC_COMPARE_THREADS, strutils::format_string3(_("%1, %2%% busy, %3 items each"),
+		strutils::to_str(nThreads), strutils::to_str(percent), items).c_str());
+}
+
 /**
  * @brief Timer message received.
  * Handle timer messages. When timer fires, update the dialog.
@@ -141,6 +170,7 @@ void DirCompProgressBar::OnTimer(UINT_PTR nIDEvent)
 			const DIFFITEM *pdi = m_pCompareStats->GetCurDiffItem();
 			if (pdi != nullptr)
 				SetDlgItemText(IDC_PATH_COMPARING, pdi->diffFileInfo[0].GetFile());
+			ShowThreadUtilization();
 		}
 		// Compare is ready
 		// Update total items too since we might get only this one state
@@ -149,6 +179,7 @@ void DirCompProgressBar::OnTimer(UINT_PTR nIDEvent)
 			!m_bCompareReady && m_pCompareStats->IsCompareDone() )
 		{
 			SetProgressState(m_pCompareStats->GetComparedItems(), m_pCompareStats->GetTotalItems());
+			ShowThreadUtilization();
 			EndUpdating();
 			m_prevState = CompareStats::STATE_COMPARE;
 			m_bCompareReady = true;
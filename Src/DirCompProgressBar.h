@@ -52,6 +52,7 @@ public:
 protected:
 	void ClearStat();
 	void SetProgressState(int comparedItems, int totalItems);
+	void ShowThreadUtilization();
 
 	// Generated message map functions
 	//{{AFX_MSG(DirCompProgressBar)
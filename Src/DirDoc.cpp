@@ -20,6 +20,8 @@
 #include "CompareOptions.h"
 #include "UnicodeString.h"
 #include "CompareStats.h"
+#include "CompareResultCache.h"
+#include "PluginOutputCache.h"
 #include "FilterList.h"
 #include "SubstitutionList.h"
 #include "DirView.h"
@@ -255,6 +257,8 @@ void CDirDoc::InitDiffContext(CDiffContext *pCtxt)
 	pCtxt->m_pImgfileFilter = &m_imgfileFilter;
 
 	pCtxt->m_pCompareStats = m_pCompareStats.get();
+	pCtxt->m_pCompareResultCache = GetOptionsMgr()->GetBool(OPT_CMP_RESULT_CACHE) ?
+		theApp.GetCompareResultCache() : nullptr;
 
 	// Make sure filters are up-to-date
 	auto* pGlobalFileFilter = theApp.GetGlobalFileFilter();
@@ -586,6 +590,12 @@ void CDirDoc::CompareReady()
 	if (m_pCmpProgressBar != nullptr)
 		m_pDirView->GetParentFrame()->ShowControlBar(m_pCmpProgressBar.get(), FALSE, FALSE);
 	m_pCmpProgressBar.reset();
+
+	// Keep results of this compare for the next one
+	if (m_pCtxt != nullptr && m_pCtxt->m_pCompareResultCache != nullptr)
+		m_pCtxt->m_pCompareResultCache->Save();
+	if (FileTransform::OutputCache != nullptr)
+		FileTransform::OutputCache->Save();
 }
 
 /**
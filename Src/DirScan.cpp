@@ -7,24 +7,28 @@
 #include "pch.h"
 #include "DirScan.h"
 #include <cassert>
+#include <climits>
 #include <memory>
+#include <atomic>
+#include <deque>
+#include <vector>
 #define POCO_NO_UNWINDOWS 1
 #include <Poco/Semaphore.h>
-#include <Poco/Notification.h>
-#include <Poco/NotificationQueue.h>
+#include <Poco/Event.h>
 #include <Poco/Environment.h>
 #include <Poco/ThreadPool.h>
 #include <Poco/Thread.h>
 #include <Poco/Runnable.h>
 #include <Poco/Mutex.h>
-#include <Poco/AutoPtr.h>
-#include <Poco/Stopwatch.h>
+#include <Poco/Condition.h>
 #include <Poco/Format.h>
 #include "DiffThread.h"
+#include "DirScanPipeline.h"
 #include "UnicodeString.h"
 #include "DiffWrapper.h"
 #include "CompareStats.h"
 #include "FolderCmp.h"
+#include "CompareResultCache.h"
 #include "FileFilterHelper.h"
 #include "IAbortable.h"
 #include "DirItem.h"
@@ -37,14 +41,10 @@
 #include "PathContext.h"
 #include "DebugNew.h"
 
-using Poco::NotificationQueue;
-using Poco::Notification;
-using Poco::AutoPtr;
 using Poco::Thread;
 using Poco::ThreadPool;
 using Poco::Runnable;
 using Poco::Environment;
-using Poco::Stopwatch;
 
 // Static functions (ie, functions only used locally)
 static void CompareDiffItem(FolderCmp &fc, DIFFITEM &di);
@@ -53,33 +53,12 @@ static DIFFITEM *AddToList(const String &sLeftDir, const String &sRightDir, cons
 static DIFFITEM *AddToList(const String &sDir1, const String &sDir2, const String &sDir3, const DirItem *ent1, const DirItem *ent2, const DirItem *ent3,
 	unsigned code, DiffFuncStruct *myStruct, DIFFITEM *parent, int nItems = 3);
 static void UpdateDiffItem(DIFFITEM &di, bool &bExists, CDiffContext *pCtxt);
-static int CompareItems(NotificationQueue &queue, DiffFuncStruct *myStruct, DIFFITEM *parentdiffpos);
-
-class WorkNotification: public Poco::Notification
-{
-public:
-	WorkNotification(DIFFITEM& di, NotificationQueue& queueResult): m_di(di), m_queueResult(queueResult) {}
-	DIFFITEM& data() const { return m_di; }
-	NotificationQueue& queueResult() const { return m_queueResult; }
-private:
-	DIFFITEM& m_di;
-	NotificationQueue& m_queueResult;
-};
-
-class WorkCompletedNotification: public Poco::Notification
-{
-public:
-	explicit WorkCompletedNotification(DIFFITEM& di): m_di(di) {}
-	DIFFITEM& data() const { return m_di; }
-private:
-	DIFFITEM& m_di;
-};
 
 class DiffWorker: public Runnable
 {
 public:
-	DiffWorker(NotificationQueue& queue, CDiffContext *pCtxt, int id):
-	  m_queue(queue), m_pCtxt(pCtxt), m_id(id) {}
+	DiffWorker(DirScanPipeline& pipeline, CDiffContext *pCtxt, int id):
+	  m_pipeline(pipeline), m_pCtxt(pCtxt), m_id(id) {}
 
 	void run()
 	{
@@ -88,22 +67,20 @@ public:
 		// when we exit the thread, we delete this and release the scripts
 		CAssureScriptsForThread scriptsForRescan;
 
-		AutoPtr<Notification> pNf(m_queue.waitDequeueNotification());
-		while (pNf.get() != nullptr)
+		DIFFITEM *di = m_pipeline.Pop();
+		while (di != nullptr)
 		{
-			WorkNotification* pWorkNf = dynamic_cast<WorkNotification*>(pNf.get());
-			if (pWorkNf != nullptr) {
-				m_pCtxt->m_pCompareStats->BeginCompare(&pWorkNf->data(), m_id);
-				if (!m_pCtxt->ShouldAbort())
-					CompareDiffItem(fc, pWorkNf->data());
-				pWorkNf->queueResult().enqueueNotification(new WorkCompletedNotification(pWorkNf->data()));
-			}
-			pNf = m_queue.waitDequeueNotification();
+			m_pCtxt->m_pCompareStats->BeginCompare(di, m_id);
+			if (!m_pCtxt->ShouldAbort())
+				CompareDiffItem(fc, *di);
+			m_pCtxt->m_pCompareStats->EndCompare(m_id);
+			m_pipeline.Done(*di);
+			di = m_pipeline.Pop();
 		}
 	}
 
 private:
-	NotificationQueue& m_queue;
+	DirScanPipeline& m_pipeline;
 	CDiffContext *m_pCtxt;
 	int m_id;
 };
@@ -111,75 +88,321 @@ private:
 typedef std::shared_ptr<DiffWorker> DiffWorkerPtr;
 
 /**
- * @brief Collect file- and folder-names to list.
- * This function walks given folders and adds found subfolders and files into
- * lists. There are two modes, determined by the @p depth:
- * - in non-recursive mode we walk only given folders, and add files
- *   contained. Subfolders are added as folder items, not walked into.
- * - in recursive mode we walk all subfolders and add the files they
- *   contain into list.
+ * @brief One folder level of the collect phase.
  *
- * Items are tested against file filters in this function.
- * 
- * @param [in] paths Root paths of compare
- * @param [in] leftsubdir Left side subdirectory under root path
- * @param [in] bLeftUniq Is left-side folder unique folder?
- * @param [in] rightsubdir Right side subdirectory under root path
- * @param [in] bRightUniq Is right-side folder unique folder?
- * @param [in] myStruct Compare-related data, like context etc.
- * @param [in] casesensitive Is filename compare case sensitive?
- * @param [in] depth Levels of subdirectories to scan, -1 scans all
- * @param [in] parent Folder diff item to be scanned
- * @param [in] bUniques If true, walk into unique folders.
- * @return 1 normally, -1 if compare was aborted
+ * A node is listed and merged by whichever thread gets to it first (a collect
+ * worker or the collect thread itself), but the resulting entries are only
+ * added to the DIFFITEM tree by the collect thread, in depth-first order.
+ * So the tree order, and the order in which items are pushed to the compare
+ * pipeline, are the same as with a serial scan.
  */
-int DirScan_GetItems(const PathContext &paths, const String subdir[],
-		DiffFuncStruct *myStruct,
-		bool casesensitive, int depth, DIFFITEM *parent,
-		bool bUniques)
+struct DirScanNode
+{
+	enum State { PENDING, RUNNING, DONE };
+
+	/** @brief Folder or file found on one or more sides. */
+	struct Entry
+	{
+		unsigned code; /**< DIFFCODE for the item */
+		const DirItem *ent[3]; /**< Item data per side, nullptr if missing */
+		std::shared_ptr<DirScanNode> subnode; /**< Folder level to walk into, or nullptr */
+	};
+
+	DirScanNode(const String subdir_[], int depth_)
+		: depth(depth_), bEmpty(false), state(PENDING), evDone(Poco::Event::EVENT_MANUALRESET)
+	{
+		std::copy(subdir_, subdir_ + 3, subdir);
+	}
+
+	String subdir[3]; /**< Subdirectories under root paths */
+	int depth; /**< Levels of subdirectories to scan, -1 scans all */
+	DirItemArray dirs[3], files[3];
+	std::vector<Entry> entries; /**< Folders first, then files, sorted */
+	bool bEmpty; /**< No folders or files on any side */
+	std::atomic_int state; /**< One of State values */
+	Poco::Event evDone; /**< Set when state becomes DONE */
+};
+
+typedef std::shared_ptr<DirScanNode> DirScanNodePtr;
+
+/**
+ * @brief Work-stealing scheduler for the collect phase.
+ *
+ * Each worker has its own queue of pending folder levels. Subfolders found
+ * by a worker are pushed to its own queue and popped LIFO, which keeps a
+ * worker walking down one subtree. Idle workers steal the oldest entries from
+ * other queues, which are the biggest remaining subtrees. The collect thread
+ * scans a node inline if no worker has picked it up when it is needed.
+ *
+ * One collector is created per compare and reused by every DirScan_GetItems()
+ * call, so refreshing many marked folders does not start and stop threads for
+ * each of them. Workers stop scanning ahead when MaxScannedAhead folder levels
+ * are waiting for the collect thread.
+ */
+class DirScanCollector
+{
+public:
+	DirScanCollector(const PathContext &paths, DiffFuncStruct *myStruct,
+		bool casesensitive, bool bUniques, int nworkers);
+	~DirScanCollector();
+	int Emit(DirScanNode &node, DIFFITEM *parent);
+
+	static const int MaxScannedAhead = 256;
+
+private:
+	class Worker: public Runnable
+	{
+	public:
+		Worker(DirScanCollector &collector, int id): m_collector(collector), m_id(id) {}
+		void run();
+	private:
+		DirScanCollector &m_collector;
+		int m_id;
+	};
+
+	struct WorkQueue
+	{
+		Poco::FastMutex mutex;
+		std::deque<DirScanNodePtr> nodes;
+	};
+
+	void Scan(DirScanNode &node, int iQueue);
+	void Schedule(const DirScanNodePtr &node, int iQueue);
+	DirScanNodePtr Take(int iQueue);
+	bool WaitForScan(DirScanNode &node);
+	bool WaitForRoom();
+	void Scanned(DirScanNode &node);
+
+	PathContext m_paths;
+	DiffFuncStruct *m_myStruct;
+	CDiffContext *m_pCtxt;
+	DirScanPipeline *m_pPipeline; /**< Compare pipeline to close folders in, or nullptr */
+	bool m_casesensitive;
+	bool m_bUniques;
+	int m_nWorkers;
+	std::vector<std::unique_ptr<WorkQueue>> m_queues; /**< One per worker, last one for collect thread */
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::unique_ptr<ThreadPool> m_pThreadPool;
+	Poco::Semaphore m_semaphore; /**< Count of scheduled nodes, plus wake-ups at exit */
+	Poco::FastMutex m_aheadMutex; /**< Guards m_nScannedAhead */
+	Poco::Condition m_aheadFreed; /**< Signaled when a scanned node is emitted */
+	int m_nScannedAhead; /**< Nodes scanned but not yet emitted */
+	std::atomic_bool m_bStopping;
+};
+
+DirScanCollector::DirScanCollector(const PathContext &paths, DiffFuncStruct *myStruct,
+		bool casesensitive, bool bUniques, int nworkers)
+	: m_paths(paths)
+	, m_myStruct(myStruct)
+	, m_pCtxt(myStruct->context)
+	, m_pPipeline(!myStruct->bMarkedRescan && myStruct->m_fncCollect ? myStruct->pPipeline : nullptr)
+	, m_casesensitive(casesensitive)
+	, m_bUniques(bUniques)
+	, m_nWorkers(nworkers > 1 ? nworkers : 0)
+	, m_semaphore(0, INT_MAX)
+	, m_nScannedAhead(0)
+	, m_bStopping(false)
+{
+	for (int i = 0; i < m_nWorkers + 1; ++i)
+		m_queues.emplace_back(new WorkQueue);
+	if (m_nWorkers > 0)
+	{
+		m_pThreadPool.reset(new ThreadPool(m_nWorkers, m_nWorkers));
+		for (int i = 0; i < m_nWorkers; ++i)
+		{
+			m_workers.emplace_back(new Worker(*this, i));
+			m_pThreadPool->start(*m_workers[i]);
+		}
+	}
+}
+
+DirScanCollector::~DirScanCollector()
+{
+	if (m_pThreadPool)
+	{
+		m_bStopping = true;
+		for (int i = 0; i < m_nWorkers; ++i)
+			m_semaphore.set();
+		{
+			Poco::FastMutex::ScopedLock lock(m_aheadMutex);
+			m_aheadFreed.broadcast();
+		}
+		m_pThreadPool->joinAll();
+	}
+}
+
+void DirScanCollector::Worker::run()
+{
+	for (;;)
+	{
+		m_collector.m_semaphore.wait();
+		if (m_collector.m_bStopping || !m_collector.WaitForRoom())
+			break;
+		DirScanNodePtr node = m_collector.Take(m_id);
+		int expected = DirScanNode::PENDING;
+		if (node && node->state.compare_exchange_strong(expected, DirScanNode::RUNNING))
+			m_collector.Scan(*node, m_id);
+	}
+}
+
+/**
+ * @brief Push a node to given queue and wake up one worker.
+ */
+void DirScanCollector::Schedule(const DirScanNodePtr &node, int iQueue)
+{
+	if (m_nWorkers == 0)
+		return;
+	{
+		Poco::FastMutex::ScopedLock lock(m_queues[iQueue]->mutex);
+		m_queues[iQueue]->nodes.push_back(node);
+	}
+	m_semaphore.set();
+}
+
+/**
+ * @brief Pop the newest node from own queue, or steal the oldest from others.
+ */
+DirScanNodePtr DirScanCollector::Take(int iQueue)
+{
+	{
+		WorkQueue &own = *m_queues[iQueue];
+		Poco::FastMutex::ScopedLock lock(own.mutex);
+		if (!own.nodes.empty())
+		{
+			DirScanNodePtr node = std::move(own.nodes.back());
+			own.nodes.pop_back();
+			return node;
+		}
+	}
+	const int nQueues = static_cast<int>(m_queues.size());
+	for (int i = 1; i < nQueues; ++i)
+	{
+		WorkQueue &victim = *m_queues[(iQueue + i) % nQueues];
+		Poco::FastMutex::ScopedLock lock(victim.mutex);
+		if (!victim.nodes.empty())
+		{
+			DirScanNodePtr node = std::move(victim.nodes.front());
+			victim.nodes.pop_front();
+			return node;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * @brief Wait until the collect thread has emitted enough scanned nodes for
+ * a worker to scan one more.
+ * @return false if collector is stopping
+ */
+bool DirScanCollector::WaitForRoom()
+{
+	Poco::FastMutex::ScopedLock lock(m_aheadMutex);
+	while (m_nScannedAhead >= MaxScannedAhead && !m_bStopping)
+		m_aheadFreed.wait(m_aheadMutex);
+	return !m_bStopping;
+}
+
+/**
+ * @brief Mark node as scanned and wake up the collect thread if it waits for it.
+ */
+void DirScanCollector::Scanned(DirScanNode &node)
+{
+	{
+		Poco::FastMutex::ScopedLock lock(m_aheadMutex);
+		++m_nScannedAhead;
+	}
+	node.state = DirScanNode::DONE;
+	node.evDone.set();
+}
+
+/**
+ * @brief Wait until node has been scanned, scanning it on this thread if no
+ * worker has started it yet.
+ * @return false if compare was aborted
+ */
+bool DirScanCollector::WaitForScan(DirScanNode &node)
+{
+	int expected = DirScanNode::PENDING;
+	if (node.state.compare_exchange_strong(expected, DirScanNode::RUNNING))
+		Scan(node, m_nWorkers);
+	else
+	{
+		while (!node.evDone.tryWait(100))
+		{
+			if (m_pCtxt->ShouldAbort())
+				return false;
+		}
+	}
+	return !m_pCtxt->ShouldAbort();
+}
+
+/**
+ * @brief Collect file- and folder-names of one folder level.
+ * Loads folders and files of all sides, and merges them into entries. Folders
+ * to walk into get a subnode which is scheduled for the workers right away.
+ *
+ * Folders are tested against file filters in this function.
+ *
+ * @param [in,out] node Folder level to scan
+ * @param [in] iQueue Queue of calling thread, for found subfolders
+ */
+void DirScanCollector::Scan(DirScanNode &node, int iQueue)
 {
 	static const TCHAR backslash[] = _T("\\");
-	int nDirs = paths.GetSize();
-	CDiffContext *pCtxt = myStruct->context;
+	const int nDirs = m_paths.GetSize();
+	const bool casesensitive = m_casesensitive;
+	CDiffContext *pCtxt = m_pCtxt;
+	const String *subdir = node.subdir;
+	DirItemArray *dirs = node.dirs;
+	DirItemArray *aFiles = node.files;
+	std::vector<DirScanNode::Entry> &entries = node.entries;
 	String sDir[3];
 	String subprefix[3];
 
-	std::copy(paths.begin(), paths.end(), sDir);
+	auto finish = [this, &node]()
+	{
+		Scanned(node);
+	};
+
+	// Allow user to abort scanning
+	if (pCtxt->ShouldAbort())
+		return finish();
+
+	std::copy(m_paths.begin(), m_paths.end(), sDir);
 
 	if (!subdir[0].empty())
 	{
-		for (int nIndex = 0; nIndex < paths.GetSize(); nIndex++)
+		for (int nIndex = 0; nIndex < nDirs; nIndex++)
 		{
 			sDir[nIndex] = paths::ConcatPath(sDir[nIndex], subdir[nIndex]);
 			subprefix[nIndex] = subdir[nIndex] + backslash;
 		}
 	}
 
-	DirItemArray dirs[3], aFiles[3];
 	for (int nIndex = 0; nIndex < nDirs; nIndex++)
 		LoadAndSortFiles(sDir[nIndex], &dirs[nIndex], &aFiles[nIndex], casesensitive);
 
-	// Allow user to abort scanning
-	if (pCtxt->ShouldAbort())
-		return -1;
-
-	// Handle directories
-	// i points to current directory in left list (leftDirs)
-	// j points to current directory in right list (rightDirs)
-
 	{
 		int nIndex;
 		for (nIndex = 0; nIndex < nDirs; nIndex++)
 			if (dirs[nIndex].size() != 0 || aFiles[nIndex].size() != 0) break;
 		if (nIndex == nDirs)
-			return 0;
+		{
+			node.bEmpty = true;
+			return finish();
+		}
 	}
 
+	// Handle directories
+	// i points to current directory in left list (leftDirs)
+	// j points to current directory in right list (rightDirs)
+
+	std::vector<DirScanNodePtr> subnodes;
 	DirItemArray::size_type i=0, j=0, k=0;
 	while (true)
 	{
 		if (pCtxt->ShouldAbort())
-			return -1;
+			return finish();
 
 		if (i >= dirs[0].size() && j >= dirs[1].size() && (nDirs < 3 || k >= dirs[2].size()))
 			break;
@@ -274,57 +497,24 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 		}
 
 		// add to list
-		if (!depth)
-		{
-			if (nDirs < 3)
-				AddToList(subdir[0], subdir[1], 
-					(nDiffCode & DIFFCODE::FIRST ) ? &dirs[0][i] : nullptr, 
-					(nDiffCode & DIFFCODE::SECOND) ? &dirs[1][j] : nullptr,
-					nDiffCode, myStruct, parent);
-			else
-				AddToList(subdir[0], subdir[1], subdir[2], 
-					(nDiffCode & DIFFCODE::FIRST ) ? &dirs[0][i] : nullptr,
-					(nDiffCode & DIFFCODE::SECOND) ? &dirs[1][j] : nullptr,
-					(nDiffCode & DIFFCODE::THIRD ) ? &dirs[2][k] : nullptr,
-					nDiffCode, myStruct, parent);
-		}
-		else
+		DirScanNode::Entry entry { nDiffCode, {
+			(nDiffCode & DIFFCODE::FIRST ) ? &dirs[0][i] : nullptr,
+			(nDiffCode & DIFFCODE::SECOND) ? &dirs[1][j] : nullptr,
+			(nDiffCode & DIFFCODE::THIRD ) ? &dirs[2][k] : nullptr } };
+		if (node.depth != 0 && (nDiffCode & DIFFCODE::SKIPPED) == 0 &&
+			((nDiffCode & DIFFCODE::SIDEFLAGS) == (nDirs < 3 ? DIFFCODE::BOTH : DIFFCODE::ALL) || m_bUniques))
 		{
-			// Recursive compare
-			if (nDirs < 3)
+			// Scan recursively all subdirectories too, we are not adding folders
+			String newsubdir[3] = {leftnewsub, rightnewsub};
+			if (nDirs == 3)
 			{
-				DIFFITEM *me = AddToList(subdir[0], subdir[1], 
-					(nDiffCode & DIFFCODE::FIRST ) ? &dirs[0][i] : nullptr, 
-					(nDiffCode & DIFFCODE::SECOND) ? &dirs[1][j] : nullptr,
-					nDiffCode, myStruct, parent);
-				if ((nDiffCode & DIFFCODE::SKIPPED) == 0 && ((nDiffCode & DIFFCODE::SIDEFLAGS) == DIFFCODE::BOTH || bUniques))
-				{
-					// Scan recursively all subdirectories too, we are not adding folders
-					String newsubdir[3] = {leftnewsub, rightnewsub};
-					int result = DirScan_GetItems(paths, newsubdir, myStruct, casesensitive,
-							depth - 1, me, bUniques);
-					if (result == -1)
-						return -1;
-				}
-			}
-			else
-			{
-				DIFFITEM *me = AddToList(subdir[0], subdir[1], subdir[2], 
-					(nDiffCode & DIFFCODE::FIRST ) ? &dirs[0][i] : nullptr,
-					(nDiffCode & DIFFCODE::SECOND) ? &dirs[1][j] : nullptr,
-					(nDiffCode & DIFFCODE::THIRD ) ? &dirs[2][k] : nullptr,
-					nDiffCode, myStruct, parent);
-				if ((nDiffCode & DIFFCODE::SKIPPED) == 0 && ((nDiffCode & DIFFCODE::SIDEFLAGS) == DIFFCODE::ALL || bUniques))
-				{
-					// Scan recursively all subdirectories too, we are not adding folders
-					String newsubdir[3] = {leftnewsub, middlenewsub, rightnewsub};
-					int result = DirScan_GetItems(paths, newsubdir, myStruct, casesensitive,
-							depth - 1, me, bUniques);
-					if (result == -1)
-						return -1;
-				}
+				newsubdir[1] = middlenewsub;
+				newsubdir[2] = rightnewsub;
 			}
+			entry.subnode = std::make_shared<DirScanNode>(newsubdir, node.depth - 1);
+			subnodes.push_back(entry.subnode);
 		}
+		entries.push_back(std::move(entry));
 		if (nDiffCode & DIFFCODE::FIRST)
 			i++;
 		if (nDiffCode & DIFFCODE::SECOND)
@@ -332,6 +522,12 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 		if (nDiffCode & DIFFCODE::THIRD)
 			k++;
 	}
+
+	// Newest entries are popped first from own queue, so push the first
+	// subfolder last: it is the one the collect thread needs next.
+	for (auto it = subnodes.rbegin(); it != subnodes.rend(); ++it)
+		Schedule(*it, iQueue);
+
 	// Handle files
 	// i points to current file in left list (aFiles[0])
 	// j points to current file in right list (aFiles[1])
@@ -339,7 +535,7 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 	while (true)
 	{
 		if (pCtxt->ShouldAbort())
-			return -1;
+			return finish();
 
 
 		// Comparing file aFiles[0][i].name to aFiles[1][j].name
@@ -348,16 +544,8 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 			&& (nDirs < 3 || 
 				(k==aFiles[2].size() || collstr(aFiles[0][i].filename, aFiles[2][k].filename, casesensitive)<0) ))
 		{
-			if (nDirs < 3)
-			{
-				const unsigned nDiffCode = DIFFCODE::FIRST | DIFFCODE::FILE;
-				AddToList(subdir[0], subdir[1], &aFiles[0][i], nullptr, nDiffCode, myStruct, parent);
-			}
-			else
-			{
-				const unsigned nDiffCode = DIFFCODE::FIRST | DIFFCODE::FILE;
-				AddToList(subdir[0], subdir[1], subdir[2], &aFiles[0][i], nullptr, nullptr, nDiffCode, myStruct, parent);
-			}
+			const unsigned nDiffCode = DIFFCODE::FIRST | DIFFCODE::FILE;
+			entries.push_back({ nDiffCode, { &aFiles[0][i], nullptr, nullptr } });
 			// Advance left pointer over left-only entry, and then retest with new pointers
 			++i;
 			continue;
@@ -368,10 +556,7 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 				(k==aFiles[2].size() || collstr(aFiles[1][j].filename, aFiles[2][k].filename, casesensitive)<0) ))
 		{
 			const unsigned nDiffCode = DIFFCODE::SECOND | DIFFCODE::FILE;
-			if (nDirs < 3)
-				AddToList(subdir[0], subdir[1], nullptr, &aFiles[1][j], nDiffCode, myStruct, parent);
-			else
-				AddToList(subdir[0], subdir[1], subdir[2], nullptr, &aFiles[1][j], nullptr, nDiffCode, myStruct, parent);
+			entries.push_back({ nDiffCode, { nullptr, &aFiles[1][j], nullptr } });
 			// Advance right pointer over right-only entry, and then retest with new pointers
 			++j;
 			continue;
@@ -383,7 +568,7 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 				&& (j==aFiles[1].size() || collstr(aFiles[2][k].filename, aFiles[1][j].filename, casesensitive)<0) )
 			{
 				const unsigned nDiffCode = DIFFCODE::THIRD | DIFFCODE::FILE;
-				AddToList(subdir[0], subdir[1], subdir[2], nullptr, nullptr, &aFiles[2][k], nDiffCode, myStruct, parent);
+				entries.push_back({ nDiffCode, { nullptr, nullptr, &aFiles[2][k] } });
 				++k;
 				// Advance right pointer over right-only entry, and then retest with new pointers
 				continue;
@@ -393,7 +578,7 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 			    && (k==aFiles[2].size() || collstr(aFiles[0][i].filename, aFiles[2][k].filename, casesensitive) != 0))
 			{
 				const unsigned nDiffCode = DIFFCODE::FIRST | DIFFCODE::SECOND | DIFFCODE::FILE;
-				AddToList(subdir[0], subdir[1], subdir[2], &aFiles[0][i], &aFiles[1][j], nullptr, nDiffCode, myStruct, parent);
+				entries.push_back({ nDiffCode, { &aFiles[0][i], &aFiles[1][j], nullptr } });
 				++i;
 				++j;
 				continue;
@@ -402,7 +587,7 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 			    && (j==aFiles[1].size() || collstr(aFiles[1][j].filename, aFiles[2][k].filename, casesensitive) != 0))
 			{
 				const unsigned nDiffCode = DIFFCODE::FIRST | DIFFCODE::THIRD | DIFFCODE::FILE;
-				AddToList(subdir[0], subdir[1], subdir[2], &aFiles[0][i], nullptr, &aFiles[2][k], nDiffCode, myStruct, parent);
+				entries.push_back({ nDiffCode, { &aFiles[0][i], nullptr, &aFiles[2][k] } });
 				++i;
 				++k;
 				continue;
@@ -411,7 +596,7 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 			    && (i==aFiles[0].size() || collstr(aFiles[0][i].filename, aFiles[1][j].filename, casesensitive) != 0))
 			{
 				const unsigned nDiffCode = DIFFCODE::SECOND | DIFFCODE::THIRD | DIFFCODE::FILE;
-				AddToList(subdir[0], subdir[1], subdir[2], nullptr, &aFiles[1][j], &aFiles[2][k], nDiffCode, myStruct, parent);
+				entries.push_back({ nDiffCode, { nullptr, &aFiles[1][j], &aFiles[2][k] } });
 				++j;
 				++k;
 				continue;
@@ -423,7 +608,7 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 			{
 				assert(j<aFiles[1].size());
 				const unsigned nDiffCode = DIFFCODE::BOTH | DIFFCODE::FILE;
-				AddToList(subdir[0], subdir[1], &aFiles[0][i], &aFiles[1][j], nDiffCode, myStruct, parent);
+				entries.push_back({ nDiffCode, { &aFiles[0][i], &aFiles[1][j], nullptr } });
 				++i;
 				++j;
 				continue;
@@ -433,7 +618,7 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 				assert(j<aFiles[1].size());
 				assert(k<aFiles[2].size());
 				const unsigned nDiffCode = DIFFCODE::ALL | DIFFCODE::FILE;
-				AddToList(subdir[0], subdir[1], subdir[2], &aFiles[0][i], &aFiles[1][j], &aFiles[2][k], nDiffCode, myStruct, parent);
+				entries.push_back({ nDiffCode, { &aFiles[0][i], &aFiles[1][j], &aFiles[2][k] } });
 				++i;
 				++j;
 				++k;
@@ -443,6 +628,58 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 		break;
 	}
 
+	finish();
+}
+
+/**
+ * @brief Add entries of a scanned folder level, and of its subfolders, to the list.
+ * This is only called on the collect thread, so items are added in the same
+ * order as a serial scan adds them.
+ * @param [in,out] node Folder level to add, subnodes are released once added
+ * @param [in] parent Folder diff item to be scanned
+ * @return 1 normally, 0 if folder is empty, -1 if compare was aborted
+ */
+int DirScanCollector::Emit(DirScanNode &node, DIFFITEM *parent)
+{
+	const int nDirs = m_paths.GetSize();
+
+	if (!WaitForScan(node))
+		return -1;
+	{
+		Poco::FastMutex::ScopedLock lock(m_aheadMutex);
+		--m_nScannedAhead;
+		m_aheadFreed.signal();
+	}
+	if (node.bEmpty)
+	{
+		if (m_pPipeline != nullptr)
+			m_pPipeline->CloseFolder(parent);
+		return 0;
+	}
+
+	for (auto& entry : node.entries)
+	{
+		if (m_pCtxt->ShouldAbort())
+			return -1;
+
+		DIFFITEM *me;
+		if (nDirs < 3)
+			me = AddToList(node.subdir[0], node.subdir[1], entry.ent[0], entry.ent[1],
+				entry.code, m_myStruct, parent);
+		else
+			me = AddToList(node.subdir[0], node.subdir[1], node.subdir[2], entry.ent[0], entry.ent[1], entry.ent[2],
+				entry.code, m_myStruct, parent);
+		if (entry.subnode)
+		{
+			int result = Emit(*entry.subnode, me);
+			entry.subnode.reset();
+			if (result == -1)
+				return -1;
+		}
+		else if ((entry.code & DIFFCODE::DIR) != 0 && m_pPipeline != nullptr)
+			m_pPipeline->CloseFolder(me);
+	}
+
 	if (parent != nullptr)
 	{
 		for (int nIndex = 0; nIndex < nDirs; ++nIndex)
@@ -461,137 +698,104 @@ int DirScan_GetItems(const PathContext &paths, const String subdir[],
 		}
 	}
 
+	if (m_pPipeline != nullptr)
+		m_pPipeline->CloseFolder(parent);
+
 	return 1;
 }
 
+/**
+ * @brief Return number of worker threads to use for folder compare.
+ */
+static int GetCompareThreadCount()
+{
+	int nworkers = GetOptionsMgr()->GetInt(OPT_CMP_COMPARE_THREADS);
+	if (nworkers <= 0)
+		nworkers += Environment::processorCount();
+	return std::clamp(nworkers, 1, static_cast<int>(Environment::processorCount()));
+}
+
+/**
+ * @brief Collect file- and folder-names to list.
+ * This function walks given folders and adds found subfolders and files into
+ * lists. There are two modes, determined by the @p depth:
+ * - in non-recursive mode we walk only given folders, and add files
+ *   contained. Subfolders are added as folder items, not walked into.
+ * - in recursive mode we walk all subfolders and add the files they
+ *   contain into list.
+ *
+ * In recursive mode sibling subfolders are listed concurrently by
+ * DirScanCollector's workers, but items are still added to the list in
+ * depth-first order. The collector is created by the first call of a compare
+ * and kept in @p myStruct until the collect phase ends.
+ *
+ * Items are tested against file filters in this function.
+ * 
+ * @param [in] paths Root paths of compare
+ * @param [in] subdir Subdirectories under root paths
+ * @param [in] myStruct Compare-related data, like context etc.
+ * @param [in] casesensitive Is filename compare case sensitive?
+ * @param [in] depth Levels of subdirectories to scan, -1 scans all
+ * @param [in] parent Folder diff item to be scanned
+ * @param [in] bUniques If true, walk into unique folders.
+ * @return 1 normally, -1 if compare was aborted
+ */
+int DirScan_GetItems(const PathContext &paths, const String subdir[],
+		DiffFuncStruct *myStruct,
+		bool casesensitive, int depth, DIFFITEM *parent,
+		bool bUniques)
+{
+	if (!myStruct->pCollector)
+	{
+		myStruct->pCollector = std::make_shared<DirScanCollector>(paths, myStruct, casesensitive, bUniques,
+			depth != 0 ? GetCompareThreadCount() : 1);
+	}
+	DirScanNode root(subdir, depth);
+	return myStruct->pCollector->Emit(root, parent);
+}
+
 /**
  * @brief Compare DiffItems in list and add results to compare context.
  *
+ * Items are compared by worker threads as soon as the collect thread pushes
+ * them to the DirScanPipeline. This function waits until all items have been
+ * compared, sending progress events meanwhile.
+ *
  * @param myStruct [in] A structure containing compare-related data.
- * @param parentdiffpos [in] Position of parent diff item 
+ * @param parentdiffpos [in] Position of parent diff item, must be nullptr
  * @return >= 0 number of diff items, -1 if compare was aborted
  */
 int DirScan_CompareItems(DiffFuncStruct *myStruct, DIFFITEM *parentdiffpos)
 {
+	assert(parentdiffpos == nullptr);
 	const int compareMethod = myStruct->context->GetCompareMethod();
 	int nworkers = 1;
 
 	if (compareMethod == CMP_CONTENT || compareMethod == CMP_QUICK_CONTENT)
-	{
-		nworkers = GetOptionsMgr()->GetInt(OPT_CMP_COMPARE_THREADS);
-		if (nworkers <= 0)
-			nworkers += Environment::processorCount();
-		nworkers = std::clamp(nworkers, 1, static_cast<int>(Environment::processorCount()));
-	}
+		nworkers = GetCompareThreadCount();
 
 	ThreadPool threadPool(nworkers, nworkers);
 	std::vector<DiffWorkerPtr> workers;
-	NotificationQueue queue;
+	DirScanPipeline &pipeline = *myStruct->pPipeline;
 	myStruct->context->m_pCompareStats->SetCompareThreadCount(nworkers);
 	for (int i = 0; i < nworkers; ++i)
 	{
-		workers.emplace_back(std::make_shared<DiffWorker>(queue, myStruct->context, i));
+		workers.emplace_back(std::make_shared<DiffWorker>(pipeline, myStruct->context, i));
 		threadPool.start(*workers[i]);
 	}
 
-	int res = CompareItems(queue, myStruct, parentdiffpos);
-
-	Thread::sleep(100);
-	queue.wakeUpAll();
-	threadPool.joinAll();
-
-	return res;
-}
-
-static int CompareItems(NotificationQueue& queue, DiffFuncStruct *myStruct, DIFFITEM *parentdiffpos)
-{
-	NotificationQueue queueResult;
-	Stopwatch stopwatch;
-	CDiffContext *pCtxt = myStruct->context;
-	int res = 0;
-	int count = 0;
-	bool bCompareFailure = false;
-	if (parentdiffpos == nullptr)
-		myStruct->pSemaphore->wait();
-	stopwatch.start();
-	DIFFITEM *pos = pCtxt->GetFirstChildDiffPosition(parentdiffpos);
-	while (pos != nullptr)
+	while (!pipeline.WaitForCompletion(2000))
 	{
-		if (pCtxt->ShouldAbort())
+		if (myStruct->context->ShouldAbort())
 			break;
-
-		if (stopwatch.elapsed() > 2000000)
-		{
-			int event = CDiffThread::EVENT_COMPARE_PROGRESSED;
-			myStruct->m_listeners.notify(myStruct, event);
-			stopwatch.restart();
-		}
-		myStruct->pSemaphore->wait();
-		DIFFITEM *curpos = pos;
-		DIFFITEM &di = pCtxt->GetNextSiblingDiffRefPosition(pos);
-		bool existsalldirs = di.diffcode.existAll();
-		if (di.diffcode.isDirectory() && pCtxt->m_bRecursive)
-		{
-			if ((di.diffcode.diffcode & DIFFCODE::CMPERR) != DIFFCODE::CMPERR)
-			{	// Only clear DIFF|SAME flags if not CMPERR (eg. both flags together)
-				di.diffcode.diffcode &= ~(DIFFCODE::DIFF | DIFFCODE::SAME);
-			}
-			int ndiff = CompareItems(queue, myStruct, curpos);
-			// Propagate sub-directory status to this directory
-			if (ndiff > 0)
-			{	// There were differences in the sub-directories
-				if (existsalldirs)
-					di.diffcode.diffcode |= DIFFCODE::DIFF;
-				res += ndiff;
-			}
-			else 
-			if (ndiff == 0)
-			{	// Sub-directories were identical
-				if (existsalldirs)
-					di.diffcode.diffcode |= DIFFCODE::SAME;
-			}
-			else
-			if (ndiff == -1)
-			{	// There were file IO-errors during sub-directory comparison.
-				di.diffcode.diffcode |= DIFFCODE::CMPERR;
-				bCompareFailure = true;
-			}
-		}
-		if (existsalldirs)
-			queue.enqueueUrgentNotification(new WorkNotification(di, queueResult));
-		else
-			queue.enqueueNotification(new WorkNotification(di, queueResult));
-		++count;
-		pos = curpos;
-		pCtxt->GetNextSiblingDiffRefPosition(pos);
+		int event = CDiffThread::EVENT_COMPARE_PROGRESSED;
+		myStruct->m_listeners.notify(myStruct, event);
 	}
 
-	while (count > 0)
-	{
-		AutoPtr<Notification> pNf(queueResult.waitDequeueNotification());
-		if (pNf.get() == nullptr)
-			break;
-		WorkCompletedNotification* pWorkCompletedNf = dynamic_cast<WorkCompletedNotification*>(pNf.get());
-		if (pWorkCompletedNf != nullptr) {
-			DIFFITEM &di = pWorkCompletedNf->data();
-			if (di.diffcode.isResultError()) { 
-				DIFFITEM *diParent = di.GetParentLink();
-				assert(diParent != nullptr);
-				if (diParent != nullptr)
-				{
-					diParent->diffcode.diffcode |= DIFFCODE::CMPERR;
-					bCompareFailure = true;
-				}
-			}
-				
-			if (di.diffcode.isResultDiff() ||
-				(!di.diffcode.existAll() && !di.diffcode.isResultFiltered()))
-				res++;
-		}
-		--count;
-	}
+	pipeline.Stop();
+	threadPool.joinAll();
 
-	return bCompareFailure || pCtxt->ShouldAbort() ? -1 : res;
+	return myStruct->context->ShouldAbort() ? -1 : pipeline.GetResult();
 }
 
 /**
@@ -732,8 +936,7 @@ int DirScan_UpdateMarkedItems(DiffFuncStruct *myStruct, DIFFITEM *parentdiffpos)
 			UpdateDiffItem(di, bItemsExist, pCtxt);
 			if (!bItemsExist)
 			{ 
-				di.DelinkFromSiblings();	// delink from list of Siblings
-				delete &di;					// Also delete all Children items
+				pCtxt->RemoveDiff(&di);		// delink from list of Siblings, also delete all Children items
 				continue;					// (... because `di` is now invalid)
 			}
 			if (!di.diffcode.isDirectory())
@@ -746,7 +949,7 @@ int DirScan_UpdateMarkedItems(DiffFuncStruct *myStruct, DIFFITEM *parentdiffpos)
 					di.diffFileInfo[i].size = 0;
 			if (di.diffcode.isScanNeeded() && !di.diffcode.isResultFiltered())
 			{
-				di.RemoveChildren();
+				pCtxt->RemoveChildren(&di);
 				di.diffcode.diffcode &= ~DIFFCODE::NEEDSCAN;
 
 				bool casesensitive = false;
@@ -801,6 +1004,7 @@ static void UpdateDiffItem(DIFFITEM &di, bool & bExists, CDiffContext *pCtxt)
 			{
 				String filepath = paths::ConcatPath(pCtxt->GetPath(i), di.diffFileInfo[i].GetFile());
 				if (di.diffFileInfo[i].UpdateFileName(filepath)) {
+					pCtxt->InvalidatePathIndex(); // filename case may have changed
 					di.diffcode.diffcode |= DIFFCODE::FIRST << i;
 					bExists = true;
 					bUpdated = true;
@@ -848,18 +1052,37 @@ static void CompareDiffItem(FolderCmp &fc, DIFFITEM &di)
 			)
 		{
 			di.diffcode.diffcode |= DIFFCODE::INCLUDED;
-			di.diffcode.diffcode |= fc.prepAndCompareFiles(di);
-			di.nsdiffs = fc.m_ndiffs;
-			di.nidiffs = fc.m_ntrivialdiffs;
 
-			for (int i = 0; i < nDirs; ++i)
+			// 2. Use result of an earlier compare if files are unchanged
+			CompareResultCache *pCache = pCtxt->m_pCompareResultCache;
+			CompareResultCache::Key key;
+			const bool bCacheable = pCache != nullptr &&
+				CompareResultCache::MakeKey(*pCtxt, di, fc.m_nOptionsFingerprint, key);
+			unsigned code;
+			if (bCacheable && pCache->Lookup(key, code, di))
 			{
-				// Set text statistics
-				if (di.diffcode.exists(i))
+				di.diffcode.diffcode |= code;
+				fc.UpdateAdditionalProperties(di);
+			}
+			else
+			{
+				code = fc.prepAndCompareFiles(di);
+				di.diffcode.diffcode |= code;
+				di.nsdiffs = fc.m_ndiffs;
+				di.nidiffs = fc.m_ntrivialdiffs;
+
+				for (int i = 0; i < nDirs; ++i)
 				{
-					di.diffFileInfo[i].m_textStats = fc.m_diffFileData.m_textStats[i];
-					di.diffFileInfo[i].encoding = fc.m_diffFileData.m_FileLocation[i].encoding;
+					// Set text statistics
+					if (di.diffcode.exists(i))
+					{
+						di.diffFileInfo[i].m_textStats = fc.m_diffFileData.m_textStats[i];
+						di.diffFileInfo[i].encoding = fc.m_diffFileData.m_FileLocation[i].encoding;
+					}
 				}
+
+				if (bCacheable && !pCtxt->ShouldAbort())
+					pCache->Store(key, code, di);
 			}
 		}
 		else
@@ -958,10 +1181,13 @@ static DIFFITEM *AddToList(const String& sDir1, const String& sDir2, const Strin
 	else
 		di->diffcode.diffcode = code | DIFFCODE::THREEWAY;
 
+	// Index the item only now that its paths and filenames are set
+	myStruct->context->InvalidatePathIndex();
+
 	if (!myStruct->bMarkedRescan && myStruct->m_fncCollect)
 	{
 		myStruct->context->m_pCompareStats->IncreaseTotalItems();
-		myStruct->pSemaphore->set();
+		myStruct->pPipeline->Push(*di);
 	}
 	return di;
 }
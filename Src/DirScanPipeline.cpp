@@ -0,0 +1,229 @@
+/**
+ *  @file DirScanPipeline.cpp
+ *
+ *  @brief Implementation of DirScanPipeline class
+ */
+
+#include "pch.h"
+#include "DirScanPipeline.h"
+#include <cassert>
+#include "DiffContext.h"
+#include "DiffItem.h"
+#include "DirItem.h"
+#include "DebugNew.h"
+
+DirScanPipeline::DirScanPipeline(CDiffContext *pCtxt, int nCapacity)
+	: m_pCtxt(pCtxt)
+	, m_nCapacity(nCapacity)
+	, m_nSeq(0)
+	, m_nInFlight(0)
+	, m_completed(Poco::Event::EVENT_MANUALRESET)
+	, m_bStopping(false)
+	, m_nResult(0)
+{
+	m_folders.emplace(nullptr, FolderState());
+}
+
+DirScanPipeline::~DirScanPipeline() = default;
+
+/**
+ * @brief Add item just created by the collect thread.
+ * File items are queued for compare, waiting for a free slot if the pipeline
+ * is full. Folder items are queued when they are completed.
+ * @param [in] di Item to add, its parent must not be closed yet.
+ */
+void DirScanPipeline::Push(DIFFITEM &di)
+{
+	const bool bFolder = di.diffcode.isDirectory();
+	{
+		Poco::FastMutex::ScopedLock lock(m_mutex);
+		auto it = m_folders.find(di.GetParentLink()->HasParent() ? di.GetParentLink() : nullptr);
+		assert(it != m_folders.end() && !it->second.bClosed);
+		++it->second.nPending;
+		if (bFolder)
+		{
+			m_folders.emplace(&di, FolderState());
+			return;
+		}
+		while (m_nInFlight >= m_nCapacity)
+		{
+			if (m_slotFreed.tryWait(m_mutex, 100))
+				continue;
+			if (m_pCtxt->ShouldAbort())
+				break;
+		}
+		++m_nInFlight;
+	}
+	Enqueue(di);
+}
+
+/**
+ * @brief Tell that collect thread has added all children of a folder.
+ * @param [in] parent Folder item, or nullptr for the root of the compare
+ */
+void DirScanPipeline::CloseFolder(DIFFITEM *parent)
+{
+	FolderState state;
+	{
+		Poco::FastMutex::ScopedLock lock(m_mutex);
+		auto it = m_folders.find(parent);
+		assert(it != m_folders.end());
+		it->second.bClosed = true;
+		if (it->second.nPending > 0)
+			return;
+		state = it->second;
+		m_folders.erase(it);
+	}
+	FolderCompleted(parent, state);
+}
+
+/**
+ * @brief Wait for next item to compare.
+ * @return Item with biggest compare cost, or nullptr if workers should exit.
+ */
+DIFFITEM *DirScanPipeline::Pop()
+{
+	Poco::FastMutex::ScopedLock lock(m_mutex);
+	while (m_queue.empty() && !m_bStopping)
+		m_itemQueued.wait(m_mutex);
+	if (m_bStopping)
+		return nullptr;
+	DIFFITEM *di = m_queue.top().di;
+	m_queue.pop();
+	return di;
+}
+
+/**
+ * @brief Tell that an item has been compared.
+ * The result is added to its parent folder, which is completed when this was
+ * the last pending child of a closed folder.
+ * @param [in] di Compared item
+ */
+void DirScanPipeline::Done(DIFFITEM &di)
+{
+	DIFFITEM *parent = di.GetParentLink()->HasParent() ? di.GetParentLink() : nullptr;
+	FolderState state;
+	{
+		Poco::FastMutex::ScopedLock lock(m_mutex);
+		if (!di.diffcode.isDirectory())
+		{
+			--m_nInFlight;
+			m_slotFreed.signal();
+		}
+		auto it = m_folders.find(parent);
+		assert(it != m_folders.end());
+		FolderState &parentState = it->second;
+		if (di.diffcode.isResultError())
+		{
+			if (parent != nullptr)
+				parent->diffcode.diffcode |= DIFFCODE::CMPERR;
+			parentState.bFailure = true;
+		}
+		if (di.diffcode.isResultDiff() ||
+			(!di.diffcode.existAll() && !di.diffcode.isResultFiltered()))
+			parentState.nDiffs++;
+		if (--parentState.nPending > 0 || !parentState.bClosed)
+			return;
+		state = parentState;
+		m_folders.erase(it);
+	}
+	FolderCompleted(parent, state);
+}
+
+/**
+ * @brief Wait until root folder is completed.
+ * @param [in] milliseconds Maximum time to wait
+ * @return true if compare is completed, false if timed out
+ */
+bool DirScanPipeline::WaitForCompletion(long milliseconds)
+{
+	return m_completed.tryWait(milliseconds);
+}
+
+/**
+ * @brief Make workers return from Pop() so they can exit.
+ * Items still queued (if compare was aborted) are dropped.
+ */
+void DirScanPipeline::Stop()
+{
+	Poco::FastMutex::ScopedLock lock(m_mutex);
+	m_bStopping = true;
+	m_queue = std::priority_queue<QueuedItem>();
+	m_itemQueued.broadcast();
+}
+
+/**
+ * @brief Estimate cost of comparing an item.
+ * @return Total size of files to compare, 0 if item is not content compared.
+ */
+uint64_t DirScanPipeline::GetCompareCost(const DIFFITEM &di)
+{
+	if (di.diffcode.isDirectory() || !di.diffcode.existAll())
+		return 0;
+	const int nDirs = (di.diffcode.diffcode & DIFFCODE::THREEWAY) ? 3 : 2;
+	uint64_t cost = 0;
+	for (int i = 0; i < nDirs; ++i)
+	{
+		if (di.diffFileInfo[i].size != DirItem::FILE_SIZE_NONE)
+			cost += di.diffFileInfo[i].size;
+	}
+	return cost;
+}
+
+void DirScanPipeline::Enqueue(DIFFITEM &di)
+{
+	const uint64_t cost = GetCompareCost(di);
+	Poco::FastMutex::ScopedLock lock(m_mutex);
+	m_queue.push({ cost, m_nSeq++, &di });
+	m_itemQueued.signal();
+}
+
+/**
+ * @brief Set folder result from its children and queue it for compare.
+ * @param [in] parent Completed folder, or nullptr for the root of the compare
+ * @param [in] state Results of folder's children
+ */
+void DirScanPipeline::FolderCompleted(DIFFITEM *parent, FolderState state)
+{
+	const int ndiff = state.bFailure ? -1 : state.nDiffs;
+	if (parent == nullptr)
+	{
+		m_nResult = m_pCtxt->ShouldAbort() ? -1 : ndiff;
+		m_completed.set();
+		return;
+	}
+
+	DIFFITEM &di = *parent;
+	if (m_pCtxt->m_bRecursive)
+	{
+		bool existsalldirs = di.diffcode.existAll();
+		if ((di.diffcode.diffcode & DIFFCODE::CMPERR) != DIFFCODE::CMPERR)
+		{	// Only clear DIFF|SAME flags if not CMPERR (eg. both flags together)
+			di.diffcode.diffcode &= ~(DIFFCODE::DIFF | DIFFCODE::SAME);
+		}
+		// Propagate sub-directory status to this directory
+		if (ndiff > 0)
+		{	// There were differences in the sub-directories
+			if (existsalldirs)
+				di.diffcode.diffcode |= DIFFCODE::DIFF;
+		}
+		else if (ndiff == 0)
+		{	// Sub-directories were identical
+			if (existsalldirs)
+				di.diffcode.diffcode |= DIFFCODE::SAME;
+		}
+		else
+		{	// There were file IO-errors during sub-directory comparison.
+			di.diffcode.diffcode |= DIFFCODE::CMPERR;
+		}
+		if (ndiff > 0)
+		{
+			Poco::FastMutex::ScopedLock lock(m_mutex);
+			DIFFITEM *grandparent = di.GetParentLink()->HasParent() ? di.GetParentLink() : nullptr;
+			auto it = m_folders.find(grandparent);
+			assert(it != m_folders.end());
+			it->second.nDiffs += ndiff;
+		}
+	}
+	Enqueue(di);
+}
@@ -0,0 +1,99 @@
+/**
+ *  @file DirScanPipeline.h
+ *
+ *  @brief Declaration of DirScanPipeline class
+ */
+#pragma once
+
+#include <unordered_map>
+#include <queue>
+#include <cstdint>
+#define POCO_NO_UNWINDOWS 1
+#include <Poco/Mutex.h>
+#include <Poco/Condition.h>
+#include <Poco/Event.h>
+
+class CDiffContext;
+class DIFFITEM;
+
+/**
+ * @brief Bounded handoff of DIFFITEMs from the collect thread to compare workers.
+ *
+ * The collect thread pushes each item as soon as it is added to the list.
+ * File items are queued for the compare workers right away, so files deep in
+ * the tree are compared while the scan is still running. Folder items are
+ * held back until the collect thread has closed them (no more children will
+ * be added) and all their children have been compared; then the folder result
+ * is set from its children and the folder is queued too. The compare side
+ * never walks the sibling lists the collect thread is building.
+ *
+ * At most nCapacity file items can be waiting or in compare; the collect
+ * thread blocks in Push() while the pipeline is full.
+ *
+ * Queued items are handed to the workers largest first, using the file sizes
+ * found by the collect phase, so that a big file found late does not keep one
+ * worker busy long after the others have gone idle. Items which don't need a
+ * content compare (unique items, folders) have no cost and are handed out in
+ * the order they were queued, after the files to compare.
+ */
+class DirScanPipeline
+{
+public:
+	DirScanPipeline(CDiffContext *pCtxt, int nCapacity = DefaultCapacity);
+	~DirScanPipeline();
+
+// collect thread
+	void Push(DIFFITEM &di);
+	void CloseFolder(DIFFITEM *parent);
+
+// compare workers
+	DIFFITEM *Pop();
+	void Done(DIFFITEM &di);
+
+// compare thread
+	bool WaitForCompletion(long milliseconds);
+	void Stop();
+	int GetResult() const { return m_nResult; }
+
+	static const int DefaultCapacity = 4096;
+
+private:
+	/** @brief Queued item, ordered by estimated compare cost. */
+	struct QueuedItem
+	{
+		uint64_t cost; /**< Bytes to compare */
+		uint64_t seq; /**< Queue order, for items of same cost */
+		DIFFITEM *di;
+		bool operator<(const QueuedItem& other) const
+		{
+			return cost != other.cost ? cost < other.cost : seq > other.seq;
+		}
+	};
+
+	/** @brief Results gathered for one folder from its children. */
+	struct FolderState
+	{
+		FolderState() : nPending(0), nDiffs(0), bFailure(false), bClosed(false) {}
+		int nPending; /**< Children pushed but not yet compared */
+		int nDiffs; /**< Differing or unique items below the folder */
+		bool bFailure; /**< There were compare errors below the folder */
+		bool bClosed; /**< All children have been pushed */
+	};
+
+	static uint64_t GetCompareCost(const DIFFITEM &di);
+	void Enqueue(DIFFITEM &di);
+	void FolderCompleted(DIFFITEM *parent, FolderState state);
+
+	CDiffContext *m_pCtxt;
+	Poco::FastMutex m_mutex; /**< Guards all members below */
+	std::priority_queue<QueuedItem> m_queue; /**< Items ready to be compared */
+	uint64_t m_nSeq; /**< Sequence number of next queued item */
+	Poco::Condition m_itemQueued; /**< Signaled when an item is queued */
+	Poco::Condition m_slotFreed; /**< Signaled when a file item is done */
+	std::unordered_map<const DIFFITEM *, FolderState> m_folders; /**< Open folders, nullptr for root */
+	int m_nCapacity;
+	int m_nInFlight; /**< File items pushed but not yet compared */
+	Poco::Event m_completed; /**< Set when root folder is completed */
+	bool m_bStopping; /**< Workers are told to exit */
+	int m_nResult; /**< >= 0 number of diff items, -1 on compare errors */
+};
@@ -50,6 +50,8 @@
 #include "Shell.h"
 #include <numeric>
 #include <functional>
+#include <execution>
+#include <unordered_map>
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -1123,10 +1125,17 @@ void CDirView::SortColumnsAppropriately()
 
 	bool bSortAscending = GetOptionsMgr()->GetBool(OPT_DIRVIEW_SORT_ASCENDING);
 	m_ctlSortHeader.SetSortImage(m_pColItems->ColLogToPhys(sortCol), bSortAscending);
-	//sort using static CompareFunc comparison function
-	CompareState cs(&GetDiffContext(), m_pColItems.get(), sortCol, bSortAscending, m_bTreeMode);
-	std::stable_sort(m_listViewItems.begin(), m_listViewItems.end(), [&cs](const ListViewOwnerDataItem& a, const ListViewOwnerDataItem& b)
-		{ return CompareState::CompareFunc(a.lParam, b.lParam, reinterpret_cast<LPARAM>(&cs)) < 0; });
+	if (m_pColItems->HasColSortKey(sortCol))
+	{
+		SortItemsByKeys(sortCol, bSortAscending);
+	}
+	else
+	{
+		//sort using static CompareFunc comparison function
+		CompareState cs(&GetDiffContext(), m_pColItems.get(), sortCol, bSortAscending, m_bTreeMode);
+		std::stable_sort(m_listViewItems.begin(), m_listViewItems.end(), [&cs](const ListViewOwnerDataItem& a, const ListViewOwnerDataItem& b)
+			{ return CompareState::CompareFunc(a.lParam, b.lParam, reinterpret_cast<LPARAM>(&cs)) < 0; });
+	}
 
 	m_firstDiffItem.reset();
 	m_lastDiffItem.reset();
@@ -1134,6 +1143,83 @@ void CDirView::SortColumnsAppropriately()
 	m_pList->Invalidate();
 }
 
+/**
+ * @brief Sort list items on a column by sort keys built once per sort.
+ * Items are formatted once for building their keys, instead of on every
+ * comparison. Large lists are sorted in parallel.
+ * @param [in] sortCol Column to sort, must have sort keys.
+ * @param [in] bSortAscending Sort ascending?
+ */
+void CDirView::SortItemsByKeys(int sortCol, bool bSortAscending)
+{
+	const size_t ParallelSortItems = 10000;
+	const CDiffContext& ctxt = GetDiffContext();
+	const size_t nItems = m_listViewItems.size();
+
+	// Keys of list items have the same index as the items. In tree mode,
+	// items in different folders are ordered like their ancestors, so
+	// keys of ancestors are added after them.
+	std::vector<DirColSortKey> keys(nItems);
+	std::unordered_map<const DIFFITEM *, size_t> keyIndex;
+	for (size_t i = 0; i < nItems; ++i)
+	{
+		DIFFITEM *diffpos = reinterpret_cast<DIFFITEM *>(m_listViewItems[i].lParam);
+		if (IsDiffItemSpecial(diffpos))
+			continue;
+		m_pColItems->ColSortKeyGet(&ctxt, sortCol, ctxt.GetDiffAt(diffpos), keys[i]);
+		if (m_bTreeMode)
+			keyIndex.emplace(diffpos, i);
+	}
+	if (m_bTreeMode)
+	{
+		for (size_t i = 0; i < nItems; ++i)
+		{
+			DIFFITEM *diffpos = reinterpret_cast<DIFFITEM *>(m_listViewItems[i].lParam);
+			if (IsDiffItemSpecial(diffpos))
+				continue;
+			for (DIFFITEM *parent = diffpos->GetParentLink(); parent->HasParent(); parent = parent->GetParentLink())
+			{
+				if (!keyIndex.emplace(parent, keys.size()).second)
+					break;
+				keys.emplace_back();
+				m_pColItems->ColSortKeyGet(&ctxt, sortCol, *parent, keys.back());
+			}
+		}
+	}
+
+	auto less = [&](size_t a, size_t b)
+	{
+		// Sort special items always first in dir view
+		const DIFFITEM *ldi = reinterpret_cast<const DIFFITEM *>(m_listViewItems[a].lParam);
+		const DIFFITEM *rdi = reinterpret_cast<const DIFFITEM *>(m_listViewItems[b].lParam);
+		if (IsDiffItemSpecial(ldi))
+			return !IsDiffItemSpecial(rdi);
+		if (IsDiffItemSpecial(rdi))
+			return false;
+		size_t lkey = a, rkey = b;
+		if (m_bTreeMode && ldi->GetParentLink() != rdi->GetParentLink())
+		{
+			DirViewColItems::GetSortSiblings(ldi, rdi);
+			lkey = keyIndex.find(ldi)->second;
+			rkey = keyIndex.find(rdi)->second;
+		}
+		const int retVal = DirViewColItems::ColSortKeyCompare(keys[lkey], keys[rkey]);
+		return bSortAscending ? retVal < 0 : retVal > 0;
+	};
+	std::vector<size_t> order(nItems);
+	std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+	if (nItems >= ParallelSortItems)
+		std::stable_sort(std::execution::par, order.begin(), order.end(), less);
+	else
+		std::stable_sort(order.begin(), order.end(), less);
+
+	std::vector<ListViewOwnerDataItem> sortedItems;
+	sortedItems.reserve(nItems);
+	for (size_t i : order)
+		sortedItems.push_back(m_listViewItems[i]);
+	m_listViewItems.swap(sortedItems);
+}
+
 /// Do any last minute work as view closes
 void CDirView::OnDestroy()
 {
@@ -1744,12 +1830,7 @@ void CDirView::DeleteItem(int sel, bool removeDIFFITEM)
 		m_pList->DeleteItem(sel);
 	}
 	if (removeDIFFITEM)
-	{
-		if (diffpos->HasChildren())
-			diffpos->RemoveChildren();
-		diffpos->DelinkFromSiblings();
-		delete diffpos;
-	}
+		GetDiffContext().RemoveDiff(diffpos);
 
 	m_firstDiffItem.reset();
 	m_lastDiffItem.reset();
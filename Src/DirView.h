@@ -95,6 +95,7 @@ public:
 	void SetFont(const LOGFONT & lf);
 
 	void SortColumnsAppropriately();
+	void SortItemsByKeys(int sortCol, bool bSortAscending);
 
 	UINT GetSelectedCount() const;
 	int GetFirstSelectedInd();
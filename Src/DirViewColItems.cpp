@@ -1234,6 +1234,113 @@ static int ColPropertyMoveSort(const CDiffContext *pCtxt, const void *p, const v
 
 /* @} */
 
+/**
+ * @name Functions to build sort keys of each type of column info.
+ * These functions build keys which order items like the sort functions
+ * above, so that a sort can compare the keys instead. Each function
+ * receives the same data as the sort function of the column, and fills
+ * a DirColSortKey.
+ */
+/* @{ */
+/**
+ * @brief Map signed number to unsigned number sorting in the same order.
+ */
+static uint64_t SignedSortKey(int64_t val)
+{
+	return static_cast<uint64_t>(val) ^ (static_cast<uint64_t>(1) << 63);
+}
+
+static void ColFileNameSortKey(const CDiffContext *pCtxt, const void *p, int, DirColSortKey &key)
+{
+	const DIFFITEM &di = *static_cast<const DIFFITEM *>(p);
+	key.num[0] = di.diffcode.isDirectory() ? 0 : 1;
+	key.str = ColFileNameGet<String>(pCtxt, p, 0);
+}
+
+static void ColExtSortKey(const CDiffContext *pCtxt, const void *p, int, DirColSortKey &key)
+{
+	const DIFFITEM &di = *static_cast<const DIFFITEM *>(p);
+	key.num[0] = di.diffcode.isDirectory() ? 0 : 1;
+	key.str = ColExtGet(pCtxt, p, 0);
+}
+
+static void ColPathSortKey(const CDiffContext *pCtxt, const void *p, int, DirColSortKey &key)
+{
+	key.str = ColPathGet(pCtxt, p, 0);
+}
+
+/**
+ * @brief Build key for compare results: identical items first, then
+ * descending diffcodes, like cmpdiffcode() with reversed arguments.
+ */
+static void ColStatusSortKey(const CDiffContext *, const void *p, int, DirColSortKey &key)
+{
+	const DIFFITEM &di = *static_cast<const DIFFITEM *>(p);
+	const unsigned diffcode = di.diffcode.diffcode;
+	key.num[0] = (diffcode & DIFFCODE::COMPAREFLAGS) == DIFFCODE::SAME ? 0 : 1;
+	key.num[1] = UINT_MAX - diffcode;
+}
+
+static void ColTimeSortKey(const CDiffContext *, const void *p, int, DirColSortKey &key)
+{
+	key.num[0] = SignedSortKey(*static_cast<const int64_t*>(p));
+}
+
+static void ColDiffsSortKey(const CDiffContext *, const void *p, int, DirColSortKey &key)
+{
+	key.num[0] = SignedSortKey(*static_cast<const int*>(p));
+}
+
+static void ColVersionSortKey(const CDiffContext *pCtxt, const void *p, int opt, DirColSortKey &key)
+{
+	key.num[0] = GetVersionQWORD(pCtxt, reinterpret_cast<const DIFFITEM *>(p), opt);
+}
+
+static void ColBinSortKey(const CDiffContext *, const void *p, int, DirColSortKey &key)
+{
+	const DIFFITEM &di = *static_cast<const DIFFITEM *>(p);
+	key.num[0] = di.diffcode.isBin() ? 1 : 0;
+}
+
+static void ColAttrSortKey(const CDiffContext *, const void *p, int, DirColSortKey &key)
+{
+	key.num[0] = static_cast<const FileFlags *>(p)->attributes;
+}
+
+/**
+ * @brief Get function building sort keys for a column.
+ * @return Key function, or nullptr if the column is sorted only with its
+ * sort function.
+ */
+static ColSortKeyFncPtrType GetSortKeyFnc(ColSortFncPtrType sortfnc)
+{
+	static const struct
+	{
+		ColSortFncPtrType sortfnc;
+		ColSortKeyFncPtrType keyfnc;
+	} keyfncs[] =
+	{
+		{ &ColFileNameSort, &ColFileNameSortKey },
+		{ &ColExtSort, &ColExtSortKey },
+		{ &ColPathSort, &ColPathSortKey },
+		{ &ColStatusSort, &ColStatusSortKey },
+		{ &ColTimeSort, &ColTimeSortKey },
+		{ &ColSizeSort, &ColTimeSortKey },
+		{ &ColDiffsSort, &ColDiffsSortKey },
+		{ &ColVersionSort, &ColVersionSortKey },
+		{ &ColBinSort, &ColBinSortKey },
+		{ &ColAttrSort, &ColAttrSortKey },
+	};
+	for (const auto& fncs : keyfncs)
+	{
+		if (fncs.sortfnc == sortfnc)
+			return fncs.keyfnc;
+	}
+	return nullptr;
+}
+
+/* @} */
+
 #undef FIELD_OFFSET	// incorrect for Win32 as defined in WinNT.h
 #define FIELD_OFFSET(type, field)    ((size_t)(LONG_PTR)&(((type *)nullptr)->field))
 
@@ -1753,24 +1860,8 @@ DirViewColItems::ColSort(const CDiffContext *pCtxt, int col, const DIFFITEM &ldi
 	const void * arg2;
 	if (bTreeMode)
 	{
-		int lLevel = ldi.GetDepth();
-		int rLevel = rdi.GetDepth();
 		const DIFFITEM *lcur = &ldi, *rcur = &rdi;
-		if (lLevel < rLevel)
-		{
-			for (; lLevel != rLevel; rLevel--)
-				rcur = rcur->GetParentLink();
-		}
-		else if (rLevel < lLevel)
-		{
-			for (; lLevel != rLevel; lLevel--)
-				lcur = lcur->GetParentLink();
-		}
-		while (lcur->GetParentLink() != rcur->GetParentLink())
-		{
-			lcur = lcur->GetParentLink();
-			rcur = rcur->GetParentLink();
-		}
+		GetSortSiblings(lcur, rcur);
 		arg1 = reinterpret_cast<const char *>(lcur) + offset;
 		arg2 = reinterpret_cast<const char *>(rcur) + offset;
 	}
@@ -1792,6 +1883,89 @@ DirViewColItems::ColSort(const CDiffContext *pCtxt, int col, const DIFFITEM &ldi
 	return 0;
 }
 
+/**
+ * @brief Check if items can be sorted on specified column by sort keys.
+ * @param [in] col Column number to sort.
+ * @return true if ColSortKeyGet() gives keys ordering items like ColSort().
+ */
+bool DirViewColItems::HasColSortKey(int col) const
+{
+	const DirColInfo * pColInfo = GetDirColInfo(col);
+	if (pColInfo == nullptr)
+		return false;
+	if (pColInfo->sortfnc == nullptr)
+		return true;
+	return GetSortKeyFnc(pColInfo->sortfnc) != nullptr;
+}
+
+/**
+ * @brief Get sort key of an item on specified column.
+ * @param [in] pCtxt Compare context.
+ * @param [in] col Column number to sort, HasColSortKey() must be true.
+ * @param [in] di Difference item.
+ * @param [out] key Sort key of the item.
+ */
+void DirViewColItems::ColSortKeyGet(const CDiffContext *pCtxt, int col, const DIFFITEM &di, DirColSortKey &key) const
+{
+	const DirColInfo * pColInfo = GetDirColInfo(col);
+	assert(pColInfo != nullptr);
+	const void * arg = reinterpret_cast<const char *>(&di) + pColInfo->offset;
+	if (pColInfo->sortfnc != nullptr)
+	{
+		ColSortKeyFncPtrType fnc = GetSortKeyFnc(pColInfo->sortfnc);
+		assert(fnc != nullptr);
+		(*fnc)(pCtxt, arg, pColInfo->opt, key);
+	}
+	else if (pColInfo->getfnc != nullptr)
+	{
+		key.str = (*pColInfo->getfnc)(pCtxt, arg, pColInfo->opt);
+	}
+}
+
+/**
+ * @brief Compare sort keys of two items.
+ * @return Order of items, like ColSort().
+ */
+int DirViewColItems::ColSortKeyCompare(const DirColSortKey &lkey, const DirColSortKey &rkey)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		if (lkey.num[i] != rkey.num[i])
+			return lkey.num[i] < rkey.num[i] ? -1 : 1;
+	}
+	if (lkey.str.empty() && rkey.str.empty())
+		return 0;
+	return strutils::compare_logical(lkey.str, rkey.str);
+}
+
+/**
+ * @brief Find the items compared when two items are sorted in tree mode.
+ * Items in different folders are ordered like their ancestors which are
+ * in the same folder.
+ * @param [in,out] lcur First item, replaced by its ancestor.
+ * @param [in,out] rcur Second item, replaced by its ancestor.
+ */
+void DirViewColItems::GetSortSiblings(const DIFFITEM *&lcur, const DIFFITEM *&rcur)
+{
+	int lLevel = lcur->GetDepth();
+	int rLevel = rcur->GetDepth();
+	if (lLevel < rLevel)
+	{
+		for (; lLevel != rLevel; rLevel--)
+			rcur = rcur->GetParentLink();
+	}
+	else if (rLevel < lLevel)
+	{
+		for (; lLevel != rLevel; lLevel--)
+			lcur = lcur->GetParentLink();
+	}
+	while (lcur->GetParentLink() != rcur->GetParentLink())
+	{
+		lcur = lcur->GetParentLink();
+		rcur = rcur->GetParentLink();
+	}
+}
+
 void DirViewColItems::SetColumnOrdering(const int colorder[])
 {
 	m_dispcols = 0;
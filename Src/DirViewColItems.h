@@ -18,6 +18,20 @@ class CDiffContext;
 typedef String (*ColGetFncPtrType)(const CDiffContext *, const void *, int);
 typedef int (*ColSortFncPtrType)(const CDiffContext *, const void *, const void *, int);
 
+/**
+ * @brief Sort key of one item in one column.
+ * Keys are built once per sort, so comparing items does not build strings
+ * or look up file data again. Numbers are compared first, then the string
+ * is compared logically.
+ */
+struct DirColSortKey
+{
+	uint64_t num[2] = {}; /**< Numbers compared in this order */
+	String str; /**< String compared after numbers */
+};
+
+typedef void (*ColSortKeyFncPtrType)(const CDiffContext *, const void *, int, DirColSortKey &);
+
 
 /**
  * @brief Information about one column of dirview list info
@@ -70,6 +84,10 @@ public:
 	int GetDispColCount() const { return m_dispcols; }
 	String ColGetTextToDisplay(const CDiffContext *pCtxt, int col, const DIFFITEM &di) const;
 	int ColSort(const CDiffContext *pCtxt, int col, const DIFFITEM &ldi, const DIFFITEM &rdi, bool bTreeMode) const;
+	bool HasColSortKey(int col) const;
+	void ColSortKeyGet(const CDiffContext *pCtxt, int col, const DIFFITEM &di, DirColSortKey &key) const;
+	static int ColSortKeyCompare(const DirColSortKey &lkey, const DirColSortKey &rkey);
+	static void GetSortSiblings(const DIFFITEM *&lcur, const DIFFITEM *&rcur);
 
 	int ColPhysToLog(int i) const { return m_invcolorder[i]; }
 	int ColLogToPhys(int i) const { return m_colorder[i]; } /**< -1 if not displayed */
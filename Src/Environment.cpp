@@ -136,6 +136,20 @@ String GetMyDocuments()
 	return path;
 }
 
+/**
+ * @brief Return WinMerge's folder under the user's local application data.
+ * This folder holds data that can be recreated, like caches.
+ * @return Full path to the folder, or empty string if error happened.
+ */
+String GetLocalAppDataPath()
+{
+	TCHAR path[MAX_PATH];
+	path[0] = _T('\0');
+	if (FAILED(SHGetFolderPath(nullptr, CSIDL_LOCAL_APPDATA, nullptr, 0, path)))
+		return _T("");
+	return paths::ConcatPath(path, _T("WinMerge"));
+}
+
 /**
  * @brief Return unique string for the instance.
  * This function formats an unique string for WinMerge instance. The string
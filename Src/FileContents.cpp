@@ -0,0 +1,151 @@
+/** 
+ * @file  FileContents.cpp
+ *
+ * @brief Implementation file for FileContents class.
+ */
+
+#include "pch.h"
+#include "FileContents.h"
+#include <io.h>
+#include <fcntl.h>
+#include <share.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "TFile.h"
+#include "DebugNew.h"
+
+/** @brief Size of one read from the file. */
+static const unsigned ReadBlockSize = 1024 * 1024;
+
+/** @brief Free the contents unless a compare took them over. */
+FileContents::~FileContents()
+{
+	free(m_pData);
+}
+
+/**
+ * @brief Read the whole file into memory.
+ * @param [in] path Full path to the file.
+ * @param [in] maxSize Files larger than this are not read.
+ * @return true if the file was read, false if it could not be opened,
+ *  was too large or reading failed.
+ */
+bool FileContents::Read(const String& path, int64_t maxSize)
+{
+	Clear();
+
+	int fd = -1;
+	_tsopen_s(&fd, TFile(path).wpath().c_str(), O_RDONLY | O_BINARY, _SH_DENYNO, _S_IREAD);
+	if (fd == -1)
+		return false;
+
+	bool bResult = false;
+	const int64_t size = _filelengthi64(fd);
+	if (size >= 0 && size <= maxSize)
+	{
+		m_pData = static_cast<char *>(malloc(static_cast<size_t>(size) + Slack));
+		if (m_pData != nullptr)
+		{
+			m_size = m_capacity = static_cast<size_t>(size);
+			size_t pos = 0;
+			while (pos < m_size)
+			{
+				const unsigned len = static_cast<unsigned>(m_size - pos < ReadBlockSize ? m_size - pos : ReadBlockSize);
+				const int nRead = _read(fd, m_pData + pos, len);
+				if (nRead <= 0)
+					break;
+				pos += nRead;
+			}
+			// A file shrinking or growing while it is read is treated as a failure
+			char extra;
+			bResult = (pos == m_size && _read(fd, &extra, 1) == 0);
+		}
+	}
+	_close(fd);
+
+	if (!bResult)
+	{
+		Clear();
+		return false;
+	}
+	m_path = path;
+	m_bLoaded = true;
+	return true;
+}
+
+/**
+ * @brief Append contents that are not read from a file.
+ * @param [in] data Contents, for example a part of an edit buffer serialized by the caller.
+ * @param [in] size Number of bytes in data.
+ * @return false if the buffer could not be grown.
+ */
+bool FileContents::Append(const char *data, size_t size)
+{
+	if (m_size + size > m_capacity || m_pData == nullptr)
+	{
+		const size_t capacity = (std::max)(m_size + size, m_capacity * 2);
+		char *pData = static_cast<char *>(realloc(m_pData, capacity + Slack));
+		if (pData == nullptr)
+			return false;
+		m_pData = pData;
+		m_capacity = capacity;
+	}
+	if (size > 0)
+		memcpy(m_pData + m_size, data, size);
+	m_size += size;
+	m_bLoaded = true;
+	return true;
+}
+
+/**
+ * @brief Set how many compares use the contents.
+ * Each compare but the last one gets a copy from Detach().
+ * @param [in] nUses Number of compares.
+ */
+void FileContents::SetUseCount(int nUses)
+{
+	m_nUses = nUses;
+}
+
+/**
+ * @brief Give the contents to a compare, which frees them with free().
+ * The buffer has FileContents::Slack bytes of room after the contents.
+ * The contents are released when the last compare set by SetUseCount()
+ * takes them, the compares before it get a copy.
+ * @param [out] bufsize Size of the returned buffer.
+ * @return The buffer, or nullptr if nothing is loaded or the copy could not be allocated.
+ */
+char *FileContents::Detach(size_t& bufsize)
+{
+	if (!m_bLoaded || m_pData == nullptr)
+		return nullptr;
+	if (--m_nUses > 0)
+	{
+		char *pData = static_cast<char *>(malloc(m_size + Slack));
+		if (pData == nullptr)
+			return nullptr;
+		memcpy(pData, m_pData, m_size);
+		bufsize = m_size + Slack;
+		return pData;
+	}
+	char *pData = m_pData;
+	bufsize = m_capacity + Slack;
+	m_pData = nullptr;
+	Clear();
+	return pData;
+}
+
+/**
+ * @brief Release the contents.
+ */
+void FileContents::Clear()
+{
+	m_path.clear();
+	free(m_pData);
+	m_pData = nullptr;
+	m_size = m_capacity = 0;
+	m_nUses = 1;
+	m_bLoaded = false;
+}
@@ -0,0 +1,49 @@
+/** 
+ * @file  FileContents.h
+ *
+ * @brief Declaration file for FileContents class.
+ */
+#pragma once
+
+#include <cstdint>
+#include "UnicodeString.h"
+
+/**
+ * @brief Whole contents of a file, read into memory once.
+ * Folder compare reads each compared file once into this buffer and then
+ * feeds encoding detection and the compare engines from it, instead of
+ * letting each of them open and read the file again. File compare hands
+ * the text of its edit buffers to the compare engine the same way.
+ */
+class FileContents
+{
+public:
+	/** @brief Room left after the contents for diffutils to append a newline and a sentinel word. */
+	static const size_t Slack = sizeof(unsigned) + 1;
+
+	FileContents() = default;
+	~FileContents();
+	FileContents(const FileContents&) = delete;
+	FileContents& operator=(const FileContents&) = delete;
+
+	bool Read(const String& path, int64_t maxSize);
+	bool Append(const char *data, size_t size);
+	void SetUseCount(int nUses);
+	char *Detach(size_t& bufsize);
+	void Clear();
+
+	/** @brief Return true if the file was read or contents were assigned. */
+	bool IsLoaded() const { return m_bLoaded; }
+	/** @brief Return path of the file that was read, empty for assigned contents. */
+	const String& GetPath() const { return m_path; }
+	const char *GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	String m_path;
+	char *m_pData = nullptr; /**< malloc()'d buffer of m_size bytes followed by Slack bytes */
+	size_t m_size = 0;
+	size_t m_capacity = 0; /**< Bytes m_pData has room for, not counting Slack */
+	int m_nUses = 1; /**< Compares still to use the contents, the last one takes the buffer */
+	bool m_bLoaded = false;
+};
@@ -13,9 +13,11 @@
 #include "pch.h"
 #include "FileTransform.h"
 #include <vector>
+#include <mutex>
 #include <Poco/Exception.h>
 #include <Poco/Mutex.h>
 #include "Plugins.h"
+#include "PluginOutputCache.h"
 #include "multiformatText.h"
 #include "Environment.h"
 #include "TFile.h"
@@ -26,6 +28,58 @@ using Poco::Exception;
 
 static Poco::FastMutex g_mutex;
 
+/**
+ * @brief Return the cache for the outputs of a pipeline, or nullptr if it
+ * has a plugin that did not opt in to the caching. Such a plugin may read
+ * settings at run time, as PrediffLineFilter.sct reads its patterns and
+ * ApplyPatch.sct reads the file of the other pane, and so its output is
+ * not decided by the description below.
+ */
+static PluginOutputCache *GetOutputCache(
+	const std::vector<std::tuple<PluginInfo*, std::vector<String>, bool>>& plugins)
+{
+	for (const auto& [plugin, args, bWithFile] : plugins)
+	{
+		if (!plugin->m_bCacheable)
+			return nullptr;
+	}
+	return FileTransform::OutputCache;
+}
+
+/**
+ * @brief Describe the plugins of a pipeline for the key of PluginOutputCache.
+ * The arguments the plugins get are part of it, and so are the modification
+ * time of the plugin files and the definition of the internal plugins, so
+ * that editing a plugin makes its cached outputs unreachable. The variables
+ * hold the path of the file, often a temporary one, so they are part of it
+ * only through the arguments referencing them (%1 to %9) and for the plugins
+ * using the PluginVariables property.
+ */
+static String MakeOutputCacheDescription(const TCHAR *pszEvent,
+	const std::vector<std::tuple<PluginInfo*, std::vector<String>, bool>>& plugins,
+	const std::vector<StringView>& variables)
+{
+	String description = pszEvent;
+	for (const auto& [plugin, args, bWithFile] : plugins)
+	{
+		description += _T("|") + plugin->m_name + _T("|") + plugin->m_filepath + _T("|");
+		try
+		{
+			description += strutils::to_str(TFile(plugin->m_filepath).getLastModified().epochMicroseconds());
+		}
+		catch (...)
+		{
+		}
+		description += plugin->m_definition;
+		description += (bWithFile ? _T("|file|") : _T("|buffer|")) + plugin->m_ext + _T("|");
+		if (plugin->m_hasArgumentsProperty)
+			description += args.empty() ? plugin->m_arguments : PluginForFile::MakeArguments(args, variables);
+		if (plugin->m_hasVariablesProperty)
+			description += _T("|") + strutils::to_str(variables[0]);
+	}
+	return description;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // transformations : packing unpacking
 
@@ -316,7 +370,9 @@ bool PackingInfo::pack(String & filepath, const String& dstFilepath, const std::
 		bufferData.SetDataFileAnsi(filepath);
 
 		LPDISPATCH piScript = plugin->m_lpDispatch;
-		Poco::FastMutex::ScopedLock lock(g_mutex);
+		std::unique_lock<Poco::FastMutex> lock(g_mutex, std::defer_lock);
+		if (!plugin->m_bConcurrent)
+			lock.lock();
 
 		if (plugin->m_hasVariablesProperty)
 		{
@@ -411,6 +467,16 @@ bool PackingInfo::Unpacking(std::vector<int> * handlerSubcodes, String & filepat
 		return false;
 	}
 
+	// skip the plugins if this content was unpacked before
+	PluginOutputCache *pCache = bUrl ? nullptr : GetOutputCache(plugins);
+	PluginOutputCache::Key key;
+	if (pCache != nullptr && !PluginOutputCache::MakeKey(filepath, MakeOutputCacheDescription(_T("UNPACK"), plugins, variables), key))
+		pCache = nullptr;
+	if (pCache != nullptr && pCache->Lookup(key, filepath, false, handlerSubcodes))
+		return true;
+
+	bool bChanged = false;
+	std::vector<int> subcodes;
 	for (auto& [plugin, args, bWithFile] : plugins)
 	{
 		bool bHandled = false;
@@ -421,7 +487,9 @@ bool PackingInfo::Unpacking(std::vector<int> * handlerSubcodes, String & filepat
 		int subcode = 0;
 
 		LPDISPATCH piScript = plugin->m_lpDispatch;
-		Poco::FastMutex::ScopedLock lock(g_mutex);
+		std::unique_lock<Poco::FastMutex> lock(g_mutex, std::defer_lock);
+		if (!plugin->m_bConcurrent)
+			lock.lock();
 
 		if (plugin->m_hasVariablesProperty)
 		{
@@ -461,8 +529,7 @@ bool PackingInfo::Unpacking(std::vector<int> * handlerSubcodes, String & filepat
 			return false;
 
 		// valid the subcode
-		if (handlerSubcodes)
-			handlerSubcodes->push_back(subcode);
+		subcodes.push_back(subcode);
 
 		// if the buffer changed, write it before leaving
 		if (bufferData.GetNChangedValid() > 0)
@@ -470,8 +537,13 @@ bool PackingInfo::Unpacking(std::vector<int> * handlerSubcodes, String & filepat
 			bool bSuccess = bufferData.SaveAsFile(filepath);
 			if (!bSuccess)
 				return false;
+			bChanged = true;
 		}
 	}
+	if (handlerSubcodes)
+		*handlerSubcodes = subcodes;
+	if (pCache != nullptr)
+		pCache->Store(key, filepath, bChanged, subcodes);
 	return true;
 }
 
@@ -567,6 +639,15 @@ bool PrediffingInfo::Prediffing(String & filepath, const String& filteredText, b
 		return false;
 	}
 
+	// skip the plugins if this content was prediffed before
+	PluginOutputCache *pCache = GetOutputCache(plugins);
+	PluginOutputCache::Key key;
+	if (pCache != nullptr && !PluginOutputCache::MakeKey(filepath, MakeOutputCacheDescription(_T("PREDIFF"), plugins, variables), key))
+		pCache = nullptr;
+	if (pCache != nullptr && pCache->Lookup(key, filepath, bMayOverwrite, nullptr))
+		return true;
+
+	bool bChanged = false;
 	for (const auto& [plugin, args, bWithFile] : plugins)
 	{
 		storageForPlugins bufferData;
@@ -576,7 +657,9 @@ bool PrediffingInfo::Prediffing(String & filepath, const String& filteredText, b
 		// bufferData.SetCodepage();
 
 		LPDISPATCH piScript = plugin->m_lpDispatch;
-		Poco::FastMutex::ScopedLock lock(g_mutex);
+		std::unique_lock<Poco::FastMutex> lock(g_mutex, std::defer_lock);
+		if (!plugin->m_bConcurrent)
+			lock.lock();
 
 		if (plugin->m_hasVariablesProperty)
 		{
@@ -622,8 +705,11 @@ bool PrediffingInfo::Prediffing(String & filepath, const String& filteredText, b
 			bool bSuccess = bufferData.SaveAsFile(filepath);
 			if (!bSuccess)
 				return false;
+			bChanged = true;
 		}
 	}
+	if (pCache != nullptr)
+		pCache->Store(key, filepath, bChanged, {});
 	return true;
 }
 
@@ -686,7 +772,9 @@ bool EditorScriptInfo::TransformText(String & text, const std::vector<StringView
 	for (const auto& [plugin, args, fncID] : plugins)
 	{
 		LPDISPATCH piScript = plugin->m_lpDispatch;
-		Poco::FastMutex::ScopedLock lock(g_mutex);
+		std::unique_lock<Poco::FastMutex> lock(g_mutex, std::defer_lock);
+		if (!plugin->m_bConcurrent)
+			lock.lock();
 
 		if (plugin->m_hasVariablesProperty)
 		{
@@ -714,6 +802,7 @@ namespace FileTransform
 
 bool AutoUnpacking = false;
 bool AutoPrediffing = false;
+PluginOutputCache *OutputCache = nullptr;
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -15,11 +15,13 @@
 #include "UnicodeString.h"
 
 class PluginInfo;
+class PluginOutputCache;
 
 namespace FileTransform
 {
 extern bool AutoUnpacking;
 extern bool AutoPrediffing;
+extern PluginOutputCache *OutputCache;
 }
 
 /**
@@ -39,6 +39,7 @@ void FilterList::AddRegExp(const std::string& regularExpression, bool exclude)
 	{
 		auto& list = exclude ? m_listExclude : m_list;
 		list.push_back(filter_item_ptr(new filter_item(regularExpression, RegularExpression::RE_UTF8)));
+		(exclude ? m_matcherExclude : m_matcher) = CreateMatcher(list);
 	}
 	catch (...)
 	{
@@ -46,82 +47,181 @@ void FilterList::AddRegExp(const std::string& regularExpression, bool exclude)
 	}
 }
 
-/** 
- * @brief Match string against list of expressions.
- * This function matches given @p string against the list of regular
- * expressions. The matching ends when first match is found, so all
- * expressions may not be matched against.
- * @param [in] string string to match.
- * @param [in] codepage codepage of string.
- * @return true if any of the expressions did match the string.
- */
-bool FilterList::Match(const std::string& string, int codepage/*=CP_UTF8*/)
+namespace
 {
-	const size_t count = m_list.size();
-	bool retval = m_list.size() == 0;
-
-	// convert string into UTF-8
-	ucr::buffer buf(string.length() * 2);
-
-	if (codepage != ucr::CP_UTF_8)
-			ucr::convert(ucr::NONE, codepage, reinterpret_cast<const unsigned char *>(string.c_str()), 
-					string.length(), ucr::UTF8, ucr::CP_UTF_8, &buf);
 
-	unsigned i = 0;
-	while (i < count && !retval)
+/**
+ * @brief Check if expression can be joined with other expressions.
+ * Backreferences, subroutine calls, numbered conditions and quoting refer to
+ * groups by number or run to the end of the expression, so they change
+ * meaning when the expression is wrapped into a group of an alternation.
+ * @param [in] regexp Expression to check.
+ * @return true if expression can be joined.
+ */
+bool IsJoinable(const std::string& regexp)
+{
+	const size_t length = regexp.length();
+	for (size_t i = 0; i + 1 < length; ++i)
 	{
-		const filter_item_ptr& item = m_list[i];
-		int result = 0;
-		RegularExpression::Match match;
-		try
+		const char c = regexp[i];
+		const char next = regexp[i + 1];
+		if (c == '\\')
 		{
-			if (buf.size > 0)
-				result = item->regexp.match(std::string(reinterpret_cast<const char *>(buf.ptr), buf.size), 0, match);
-			else
-				result = item->regexp.match(string, 0, match);
+			if ((next >= '1' && next <= '9') || next == 'g' || next == 'k' || next == 'Q')
+				return false;
+			++i; // skip escaped character
 		}
-		catch (...)
+		else if (c == '(' && next == '*')
 		{
-			// TODO:
+			return false;
 		}
-		if (result > 0)
+		else if (c == '(' && next == '?' && i + 2 < length)
 		{
-			retval = true;
+			const char kind = regexp[i + 2];
+			if (kind == 'P' || kind == '&' || kind == 'R' || kind == '+' ||
+				(kind >= '0' && kind <= '9') ||
+				(kind == '-' && i + 3 < length && regexp[i + 3] >= '0' && regexp[i + 3] <= '9'))
+				return false;
+			// Condition on a group number, (?(1)...), (?(+1)...), (?(-1)...),
+			// or on recursion, (?(R)...)
+			if (kind == '(' && i + 3 < length)
+			{
+				const char cond = regexp[i + 3];
+				if ((cond >= '0' && cond <= '9') || cond == '+' || cond == '-' || cond == 'R')
+					return false;
+			}
 		}
-		else
-			++i;
 	}
+	return true;
+}
 
-	if (!retval)
-		return retval;
+}
 
-	i = 0;
-	const size_t countExclude = m_listExclude.size();
-	while (i < countExclude && retval)
+/**
+ * @brief Prepare expressions of a list for matching.
+ * @param [in] list Expressions to prepare.
+ * @return Matcher for the expressions.
+ */
+FilterList::Matcher FilterList::CreateMatcher(const std::vector<filter_item_ptr>& list)
+{
+	Matcher matcher;
+	std::vector<filter_item_ptr> joined;
+	std::string combined;
+	for (const auto& item : list)
+	{
+		if (item->_reOpts == RegularExpression::RE_UTF8 && IsJoinable(item->filterAsString))
+		{
+			if (!combined.empty())
+				combined += '|';
+			combined += "(?:" + item->filterAsString + ")";
+			joined.push_back(item);
+		}
+		else
+			matcher.separate.push_back(item);
+	}
+	if (joined.size() > 1)
 	{
-		const filter_item_ptr& item = m_listExclude[i];
-		int result = 0;
-		RegularExpression::Match match;
 		try
 		{
-			if (buf.size > 0)
-				result = item->regexp.match(std::string(reinterpret_cast<const char *>(buf.ptr), buf.size), 0, match);
-			else
-				result = item->regexp.match(string, 0, match);
+			matcher.combined = std::make_shared<const RegularExpression>(combined, RegularExpression::RE_UTF8);
+			return matcher;
 		}
 		catch (...)
 		{
-			// TODO:
+			// eg. same group name in two expressions, match them one by one
+		}
+	}
+	matcher.separate.insert(matcher.separate.end(), joined.begin(), joined.end());
+	return matcher;
+}
+
+/**
+ * @brief Match UTF-8 string against prepared expressions.
+ * @param [in] string string to match.
+ * @return true if any of the expressions did match the string.
+ */
+bool FilterList::Matcher::Match(const std::string& string) const
+{
+	RegularExpression::Match match;
+	try
+	{
+		if (combined && combined->match(string, 0, match) > 0)
+			return true;
+	}
+	catch (...)
+	{
+		// TODO:
+	}
+	for (const auto& item : separate)
+	{
+		try
+		{
+			if (item->regexp.match(string, 0, match) > 0)
+				return true;
 		}
-		if (result > 0)
+		catch (...)
 		{
-			retval = false;
+			// TODO:
 		}
-		else
-			++i;
 	}
+	return false;
+}
 
-	return retval;
+/** 
+ * @brief Match UTF-8 string against list of expressions.
+ * @param [in] string string to match.
+ * @return true if any of the expressions did match the string and none
+ * of the exclude expressions did.
+ */
+bool FilterList::MatchUTF8(const std::string& string) const
+{
+	if (!m_list.empty() && !m_matcher.Match(string))
+		return false;
+	return m_listExclude.empty() || !m_matcherExclude.Match(string);
+}
+
+/** 
+ * @brief Match string against list of expressions.
+ * This function matches given @p string against the list of regular
+ * expressions. The matching ends when first match is found, so all
+ * expressions may not be matched against.
+ * @param [in] string string to match.
+ * @param [in] codepage codepage of string.
+ * @return true if any of the expressions did match the string.
+ */
+bool FilterList::Match(const std::string& string, int codepage/*=CP_UTF8*/) const
+{
+	if (codepage == ucr::CP_UTF_8)
+		return MatchUTF8(string);
+	return Match(string.c_str(), string.length(), codepage);
+}
+
+/** 
+ * @brief Match string against list of expressions.
+ * Buffers for the string are reused by later calls of the same thread,
+ * so matching lines one by one does not allocate memory for each line.
+ * @param [in] string string to match, need not be null-terminated.
+ * @param [in] length length of string in bytes.
+ * @param [in] codepage codepage of string.
+ * @return true if any of the expressions did match the string.
+ */
+bool FilterList::Match(const char *string, size_t length, int codepage/*=CP_UTF8*/) const
+{
+	thread_local std::string utf8;
+	if (codepage != ucr::CP_UTF_8)
+	{
+		// convert string into UTF-8
+		thread_local ucr::buffer buf(256);
+		ucr::convert(ucr::NONE, codepage, reinterpret_cast<const unsigned char *>(string),
+				length, ucr::UTF8, ucr::CP_UTF_8, &buf);
+		if (buf.size > 0)
+			utf8.assign(reinterpret_cast<const char *>(buf.ptr), buf.size);
+		else
+			utf8.assign(string, length);
+	}
+	else
+		utf8.assign(string, length);
+	return MatchUTF8(utf8);
 }
 
 /**
@@ -148,4 +248,21 @@ void FilterList::CloneFrom(const FilterList* filterList)
 	{
 		m_listExclude.emplace_back(std::make_shared<filter_item>(filterList->m_listExclude[i].get()));
 	}
+	m_matcher = CreateMatcher(m_list);
+	m_matcherExclude = CreateMatcher(m_listExclude);
+}
+
+/**
+ * @brief Return the expressions of the list as strings.
+ * @param [in] exclude Return the exclude expressions instead.
+ * @return Original expression strings in the order they were added.
+ */
+std::vector<std::string> FilterList::GetRegExps(bool exclude) const
+{
+	const auto& list = exclude ? m_listExclude : m_list;
+	std::vector<std::string> regexps;
+	regexps.reserve(list.size());
+	for (const auto& item : list)
+		regexps.push_back(item->filterAsString);
+	return regexps;
 }
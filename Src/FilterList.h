@@ -42,12 +42,33 @@ public:
 	void AddRegExp(const std::string& regularExpression, bool exclude = false);
 	void RemoveAllFilters();
 	bool HasRegExps() const;
-	bool Match(const std::string& string, int codepage = ucr::CP_UTF_8);
+	bool Match(const std::string& string, int codepage = ucr::CP_UTF_8) const;
+	bool Match(const char *string, size_t length, int codepage = ucr::CP_UTF_8) const;
 	void CloneFrom(const FilterList* filterList);
+	std::vector<std::string> GetRegExps(bool exclude = false) const;
 
 private:
+	/**
+	 * @brief Expressions of one list, prepared for matching.
+	 * Expressions that can be joined are compiled into one alternation, so
+	 * a string is scanned once for all of them. Expressions using
+	 * backreferences or other constructs that depend on their own group
+	 * numbering are matched one by one.
+	 */
+	struct Matcher
+	{
+		std::shared_ptr<const Poco::RegularExpression> combined; /**< All joinable expressions */
+		std::vector<filter_item_ptr> separate; /**< Expressions matched one by one */
+		bool Match(const std::string& string) const;
+	};
+
+	static Matcher CreateMatcher(const std::vector<filter_item_ptr>& list);
+	bool MatchUTF8(const std::string& string) const;
+
 	std::vector <filter_item_ptr> m_list;
 	std::vector <filter_item_ptr> m_listExclude;
+	Matcher m_matcher; /**< Matcher for m_list */
+	Matcher m_matcherExclude; /**< Matcher for m_listExclude */
 
 };
 
@@ -58,6 +79,8 @@ inline void FilterList::RemoveAllFilters()
 {
 	m_list.clear();
 	m_listExclude.clear();
+	m_matcher = Matcher();
+	m_matcherExclude = Matcher();
 }
 
 /** 
@@ -22,6 +22,8 @@
 #include "TFile.h"
 #include "FileFilterHelper.h"
 #include "PropertySystem.h"
+#include "CompareResultCache.h"
+#include "FileContents.h"
 #include "MergeApp.h"
 #include "DebugNew.h"
 
@@ -32,6 +34,8 @@ using CompareEngines::ImageCompare;
 
 FolderCmp::FolderCmp(CDiffContext *pCtxt)
 : m_pCtxt(pCtxt)
+, m_nOptionsFingerprint(pCtxt->m_pCompareResultCache != nullptr ?
+	CompareResultCache::MakeOptionsFingerprint(*pCtxt) : 0)
 , m_pDiffUtilsEngine(nullptr)
 , m_pByteCompare(nullptr)
 , m_pBinaryCompare(nullptr)
@@ -102,6 +106,7 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 		DiffFileData diffdata10, diffdata12, diffdata02;
 		String filepathUnpacked[3];
 		String filepathTransformed[3];
+		FileContents contents[3];
 		int codepage = 0;
 
 		// For user chosen plugins, define bAutomaticUnpacker as false and use the chosen infoHandler
@@ -123,6 +128,15 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 		FileTextEncoding encoding[3];
 		bool bForceUTF8 = m_pCtxt->GetCompareOptions(nCompMethod)->m_bIgnoreCase;
 
+		// Read each file once and share the contents between encoding detection
+		// and the compare engine. Quick compare stopping at the first difference
+		// usually needs only the start of the files, so it keeps reading on demand.
+		// Files above the quick compare limit are compared by quick compare anyway.
+		// Prediffers write the files they compare to temp files, so their input
+		// is not read ahead either.
+		const bool bPreload = !(nCompMethod == CMP_QUICK_CONTENT && m_pCtxt->m_bStopAfterFirstDiff) &&
+			(infoPrediffer == nullptr || infoPrediffer->GetPluginPipeline().empty());
+
 		for (nIndex = 0; nIndex < nDirs; nIndex++)
 		{
 		// plugin may alter filepaths to temp copies (which we delete before returning in all cases)
@@ -140,7 +154,19 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 			// Unpacked files will be deleted at end of this function.
 			filepathTransformed[nIndex] = filepathUnpacked[nIndex];
 
-			encoding[nIndex] = codepage_detect::Guess(filepathTransformed[nIndex], m_pCtxt->m_iGuessEncodingType);
+			if (bPreload && strutils::compare_nocase(filepathUnpacked[nIndex], _T("NUL")) != 0)
+			{
+				contents[nIndex].Read(filepathUnpacked[nIndex], m_pCtxt->m_nQuickCompareLimit);
+				// Each file takes part in two of the pairwise compares of a 3-way compare
+				if (nDirs == 3)
+					contents[nIndex].SetUseCount(2);
+			}
+			if (contents[nIndex].IsLoaded())
+				encoding[nIndex] = codepage_detect::Guess(paths::FindExtension(filepathUnpacked[nIndex]),
+					contents[nIndex].GetData(), (std::min)(contents[nIndex].GetSize(), static_cast<size_t>(codepage_detect::BufSize)),
+					m_pCtxt->m_iGuessEncodingType);
+			else
+				encoding[nIndex] = codepage_detect::Guess(filepathTransformed[nIndex], m_pCtxt->m_iGuessEncodingType);
 			m_diffFileData.m_FileLocation[nIndex].encoding = encoding[nIndex];
 		}
 
@@ -166,7 +192,8 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 		{
 			m_diffFileData.SetDisplayFilepaths(tFiles[0], tFiles[1]); // store true names for diff utils patch file
 			// This opens & fstats both files (if it succeeds)
-			if (!m_diffFileData.OpenFiles(filepathTransformed[0], filepathTransformed[1]))
+			// Contents are ignored by OpenFiles() if a prediffer or encoding conversion changed the path
+			if (!m_diffFileData.OpenFiles(filepathTransformed[0], filepathTransformed[1], &contents[0], &contents[1]))
 				goto exitPrepAndCompare;
 		}
 		else
@@ -175,14 +202,14 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 			diffdata12.SetDisplayFilepaths(tFiles[1], tFiles[2]); // store true names for diff utils patch file
 			diffdata02.SetDisplayFilepaths(tFiles[0], tFiles[2]); // store true names for diff utils patch file
 
-			if (!diffdata10.OpenFiles(filepathTransformed[1], filepathTransformed[0]))
+			if (!diffdata10.OpenFiles(filepathTransformed[1], filepathTransformed[0], &contents[1], &contents[0]))
 				goto exitPrepAndCompare;
 
-			if (!diffdata12.OpenFiles(filepathTransformed[1], filepathTransformed[2]))
+			if (!diffdata12.OpenFiles(filepathTransformed[1], filepathTransformed[2], &contents[1], &contents[2]))
 				goto exitPrepAndCompare;
 
-			if (!diffdata02.OpenFiles(filepathTransformed[0], filepathTransformed[2]))
-				goto exitPrepAndCompare;
+			// diffdata02 is opened only if the results of 10 and 12 can't tell
+			// which side differs, see below
 		}
 
 		// If either file is larger than limit compare files by quick contents
@@ -242,11 +269,6 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 				m_pDiffUtilsEngine->GetTextStats(0, &m_diffFileData.m_textStats[1]);
 				m_pDiffUtilsEngine->GetTextStats(1, &m_diffFileData.m_textStats[2]);
 
-				m_pDiffUtilsEngine->SetFileData(2, diffdata02.m_inf);
-				bRet = m_pDiffUtilsEngine->Diff2Files(&script02, 0, &bin_flag02, false, nullptr);
-				m_pDiffUtilsEngine->GetTextStats(0, &m_diffFileData.m_textStats[0]);
-				m_pDiffUtilsEngine->GetTextStats(1, &m_diffFileData.m_textStats[2]);
-
 				code = DIFFCODE::FILE;
 
 				String Ext = tFiles[0];
@@ -282,23 +304,40 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 
 				if ((code & DIFFCODE::COMPAREFLAGS) == DIFFCODE::DIFF)
 				{
+					// If the middle file equals one of the others, the left and right
+					// files differ like the middle file and the other one do. Only
+					// when both 10 and 12 differ is the 02 diff needed.
 					if ((code & DIFFCODE::TEXTFLAGS) == DIFFCODE::TEXT)
 					{
 						if (script12 == nullptr)
 							code |= DIFFCODE::DIFF1STONLY;
-						else if (script02 == nullptr)
-							code |= DIFFCODE::DIFF2NDONLY;
 						else if (script10 == nullptr)
 							code |= DIFFCODE::DIFF3RDONLY;
+						else if (!diffdata02.OpenFiles(filepathTransformed[0], filepathTransformed[2], &contents[0], &contents[2]))
+							code = DIFFCODE::FILE | DIFFCODE::CMPERR;
+						else
+						{
+							m_pDiffUtilsEngine->SetFileData(2, diffdata02.m_inf);
+							bRet = m_pDiffUtilsEngine->Diff2Files(&script02, 0, &bin_flag02, false, nullptr);
+							if (script02 == nullptr)
+								code |= DIFFCODE::DIFF2NDONLY;
+						}
 					}
 					else
 					{
 						if (bin_flag12 > 0)
 							code |= DIFFCODE::DIFF1STONLY;
-						else if (bin_flag02 > 0)
-							code |= DIFFCODE::DIFF2NDONLY;
 						else if (bin_flag10 > 0)
 							code |= DIFFCODE::DIFF3RDONLY;
+						else if (!diffdata02.OpenFiles(filepathTransformed[0], filepathTransformed[2], &contents[0], &contents[2]))
+							code = DIFFCODE::FILE | DIFFCODE::CMPERR;
+						else
+						{
+							m_pDiffUtilsEngine->SetFileData(2, diffdata02.m_inf);
+							bRet = m_pDiffUtilsEngine->Diff2Files(&script02, 0, &bin_flag02, false, nullptr);
+							if (bin_flag02 > 0)
+								code |= DIFFCODE::DIFF2NDONLY;
+						}
 					}
 				}
 
@@ -362,17 +401,8 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 				m_pByteCompare->GetTextStats(0, &m_diffFileData.m_textStats[1]);
 				m_pByteCompare->GetTextStats(1, &m_diffFileData.m_textStats[2]);
 
-				// 02
-				m_pByteCompare->SetFileData(2, diffdata02.m_inf);
-
-				// use our own byte-by-byte compare
-				int code02 = m_pByteCompare->CompareFiles(diffdata02.m_FileLocation);
-
-				m_pByteCompare->GetTextStats(0, &m_diffFileData.m_textStats[0]);
-				m_pByteCompare->GetTextStats(1, &m_diffFileData.m_textStats[2]);
-
 				code = DIFFCODE::FILE;
-				if (DIFFCODE::isResultError(code10) || DIFFCODE::isResultError(code12) || DIFFCODE::isResultError(code02))
+				if (DIFFCODE::isResultError(code10) || DIFFCODE::isResultError(code12))
 					code |= DIFFCODE::CMPERR;
 				if ((code10 & DIFFCODE::COMPAREFLAGS) == DIFFCODE::DIFF || (code12 & DIFFCODE::COMPAREFLAGS) == DIFFCODE::DIFF)
 					code |= DIFFCODE::DIFF;
@@ -391,12 +421,24 @@ int FolderCmp::prepAndCompareFiles(DIFFITEM &di)
 					code |= DIFFCODE::BINSIDE3;
 				if ((code & DIFFCODE::COMPAREFLAGS) == DIFFCODE::DIFF)
 				{
+					// 02 is compared only when neither 10 nor 12 is the same
 					if ((code12 & DIFFCODE::COMPAREFLAGS) == DIFFCODE::SAME)
 						code |= DIFFCODE::DIFF1STONLY;
-					else if ((code02 & DIFFCODE::COMPAREFLAGS) == DIFFCODE::SAME)
-						code |= DIFFCODE::DIFF2NDONLY;
 					else if ((code10 & DIFFCODE::COMPAREFLAGS) == DIFFCODE::SAME)
 						code |= DIFFCODE::DIFF3RDONLY;
+					else if (!diffdata02.OpenFiles(filepathTransformed[0], filepathTransformed[2], &contents[0], &contents[2]))
+						code |= DIFFCODE::CMPERR;
+					else
+					{
+						m_pByteCompare->SetFileData(2, diffdata02.m_inf);
+
+						// use our own byte-by-byte compare
+						int code02 = m_pByteCompare->CompareFiles(diffdata02.m_FileLocation);
+						if (DIFFCODE::isResultError(code02))
+							code |= DIFFCODE::CMPERR;
+						else if ((code02 & DIFFCODE::COMPAREFLAGS) == DIFFCODE::SAME)
+							code |= DIFFCODE::DIFF2NDONLY;
+					}
 				}
 
 				// Quick contents doesn't know about diff counts
@@ -465,6 +507,18 @@ exitPrepAndCompare:
 		throw "Invalid compare type, DiffFileData can't handle it";
 	}
 
+	UpdateAdditionalProperties(di);
+
+	return code;
+}
+
+/**
+ * @brief Read additional properties of the compared files.
+ * @param [in, out] di Compared files receiving the property values.
+ */
+void FolderCmp::UpdateAdditionalProperties(DIFFITEM &di)
+{
+	int nDirs = m_pCtxt->GetCompareDirs();
 	if (m_pCtxt->m_pPropertySystem)
 	{
 		size_t numprops = m_pCtxt->m_pPropertySystem->GetCanonicalNames().size();
@@ -485,7 +539,4 @@ exitPrepAndCompare:
 			}
 		}
 	}
-
-	return code;
 }
-
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
 #include "DiffFileData.h"
 #include "Wrap_DiffUtils.h"
 #include "ByteCompare.h"
@@ -44,12 +45,14 @@ public:
 	bool RunPlugins(PluginsContext * plugCtxt, String &errStr);
 	void CleanupAfterPlugins(PluginsContext *plugCtxt);
 	int prepAndCompareFiles(DIFFITEM &di);
+	void UpdateAdditionalProperties(DIFFITEM &di);
 
 	int m_ndiffs;
 	int m_ntrivialdiffs;
 
 	DiffFileData m_diffFileData;
 	CDiffContext *const m_pCtxt;
+	const uint64_t m_nOptionsFingerprint; /**< Options fingerprint for CompareResultCache */
 
 private:
 	std::unique_ptr<CompareEngines::DiffUtils> m_pDiffUtilsEngine;
@@ -7,8 +7,14 @@
 #include <Poco/SAX/ContentHandler.h>
 #include <Poco/SAX/Attributes.h>
 #include <Poco/Exception.h>
+#include <Poco/Environment.h>
 #include <vector>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <unordered_set>
 #include <algorithm>
 #include <cassert>
@@ -68,6 +74,33 @@ namespace
 		fileOut.Close();
 		return S_OK;
 	}
+
+	String ExpandWinMergeHome(const String& sCmd)
+	{
+		if (_wgetenv(L"WINMERGE_HOME") == nullptr)
+			_wputenv_s(L"WINMERGE_HOME", env::GetProgPath().c_str());
+		String command = sCmd;
+		strutils::replace(command, _T("${WINMERGE_HOME}"), env::GetProgPath());
+		return command;
+	}
+
+	bool SetPluginErrorInfo(const String& source, const String& description)
+	{
+		ICreateErrorInfo* pCreateErrorInfo = nullptr;
+		if (FAILED(CreateErrorInfo(&pCreateErrorInfo)))
+			return false;
+		pCreateErrorInfo->SetSource(const_cast<OLECHAR*>(ucr::toUTF16(source).c_str()));
+		pCreateErrorInfo->SetDescription(const_cast<OLECHAR*>(ucr::toUTF16(description).c_str()));
+		IErrorInfo* pErrorInfo = nullptr;
+		pCreateErrorInfo->QueryInterface(&pErrorInfo);
+		SetErrorInfo(0, pErrorInfo);
+		pErrorInfo->Release();
+		pCreateErrorInfo->Release();
+		return true;
+	}
+
+	/// Held while inheritable handles exist, so that they are not inherited by other child processes
+	std::mutex g_inheritableHandlesMutex;
 }
 
 namespace internal_plugin
@@ -83,6 +116,7 @@ struct Method
 {
 	String m_command;
 	std::unique_ptr<Script> m_script;
+	bool m_worker = false;
 };
 
 struct Info
@@ -104,6 +138,59 @@ struct Info
 	std::unique_ptr<Method> m_unpackFolder;
 	std::unique_ptr<Method> m_packFolder;
 	std::map<String, Method> m_editorScripts;
+	int m_workerProcesses = 0;
+
+	bool UsesWorkers() const
+	{
+		for (const auto* method : { m_prediffFile.get(), m_unpackFile.get(), m_packFile.get() })
+			if (method && method->m_worker)
+				return true;
+		return false;
+	}
+
+	/// Does a command use the variables, ${0} to ${9}?
+	bool UsesVariables() const
+	{
+		for (const auto* method : { m_prediffFile.get(), m_unpackFile.get(), m_packFile.get(),
+			m_isFolder.get(), m_unpackFolder.get(), m_packFolder.get() })
+		{
+			if (!method)
+				continue;
+			const String& command = method->m_command;
+			for (size_t pos = command.find(_T("${")); pos != String::npos; pos = command.find(_T("${"), pos + 2))
+			{
+				if (pos + 2 < command.length() && command[pos + 2] >= '0' && command[pos + 2] <= '9')
+					return true;
+			}
+		}
+		return false;
+	}
+
+	/// Do the file methods run scripts? They may read settings, as the scriptlets do
+	bool UsesScripts() const
+	{
+		for (const auto* method : { m_prediffFile.get(), m_unpackFile.get(), m_packFile.get() })
+			if (method && method->m_script)
+				return true;
+		return false;
+	}
+
+	/// The commands and scripts of the methods, for telling apart the versions of the plugin
+	String GetDefinition() const
+	{
+		String definition;
+		for (const auto* method : { m_prediffFile.get(), m_unpackFile.get(), m_packFile.get(),
+			m_isFolder.get(), m_unpackFolder.get(), m_packFolder.get() })
+		{
+			definition += _T("|");
+			if (!method)
+				continue;
+			definition += method->m_command;
+			if (method->m_script)
+				definition += _T("|") + method->m_script->m_fileExtension + _T("|") + method->m_script->m_body;
+		}
+		return definition;
+	}
 };
 
 class XMLHandler : public Poco::XML::ContentHandler
@@ -119,6 +206,7 @@ public:
 	inline static const std::string UnpackedFileExtensionElement = "unpacked-file-extension";
 	inline static const std::string ExtendedPropertiesElement = "extended-properties";
 	inline static const std::string ArgumentsElement = "arguments";
+	inline static const std::string WorkerProcessesElement = "worker-processes";
 	inline static const std::string PrediffFileElement = "prediff-file";
 	inline static const std::string UnpackFileElement = "unpack-file";
 	inline static const std::string PackFileElement = "pack-file";
@@ -130,6 +218,7 @@ public:
 	inline static const std::string NameAttribute = "name";
 	inline static const std::string ValueAttribute = "value";
 	inline static const std::string FileExtensionAttribute = "fileExtension";
+	inline static const std::string WorkerAttribute = "worker";
 
 	explicit XMLHandler(std::list<Info>* pPlugins) : m_pPlugins(pPlugins) {}
 
@@ -177,6 +266,8 @@ public:
 						plugin.m_extendedProperties = value;
 					else if (localName == ArgumentsElement)
 						plugin.m_arguments = std::move(value);
+					else if (localName == WorkerProcessesElement)
+						plugin.m_workerProcesses = _ttoi(value.c_str());
 				}
 				else if (localName == PrediffFileElement)
 				{
@@ -211,7 +302,16 @@ public:
 			}
 			else if (m_pMethod)
 			{
-				if (localName == ScriptElement)
+				if (localName == CommandElement)
+				{
+					int index = attributes.getIndex(Empty, WorkerAttribute);
+					if (index >= 0)
+					{
+						char ch = attributes.getValue(index).c_str()[0];
+						m_pMethod->m_worker = (ch == 't' || ch == 'T');
+					}
+				}
+				else if (localName == ScriptElement)
 				{
 					m_pMethod->m_script.reset(new Script);
 					int index = attributes.getIndex(Empty, FileExtensionAttribute);
@@ -322,6 +422,435 @@ private:
 	bool m_hasVariablesProperty;
 };
 
+static HRESULT createScript(const Script& script, TempFile& tempFile)
+{
+	String path = tempFile.Create(_T(""), script.m_fileExtension);
+	return WriteFile(path, script.m_body, false);
+}
+
+/**
+ * @brief Long-lived process of a plugin method declared with worker="true".
+ *
+ * Files are sent to the standard input of the process and the results are
+ * read from its standard output, so no process is started per file.
+ * A request is the plugin arguments encoded in UTF-8, then the content of the
+ * source file, each preceded by its 64-bit little-endian length. The process
+ * must read the whole request, then answer with a 32-bit status, a 64-bit
+ * length and the transformed content. If the status is not zero, the content
+ * is an error message encoded in UTF-8.
+ */
+class WorkerProcess
+{
+public:
+	~WorkerProcess()
+	{
+		Stop();
+	}
+
+	bool Start(const String& command, String& error)
+	{
+		PROCESS_INFORMATION processInfo{};
+		{
+			std::lock_guard<std::mutex> lock(g_inheritableHandlesMutex);
+			SECURITY_ATTRIBUTES sa{ sizeof(sa) };
+			sa.bInheritHandle = true;
+			HANDLE hStdInput = nullptr, hStdOutput = nullptr;
+			if (!CreatePipe(&hStdInput, &m_hStdin, &sa, 0))
+				return setLastError(error);
+			if (!CreatePipe(&m_hStdout, &hStdOutput, &sa, 0))
+			{
+				CloseHandle(hStdInput);
+				return setLastError(error);
+			}
+			SetHandleInformation(m_hStdin, HANDLE_FLAG_INHERIT, 0);
+			SetHandleInformation(m_hStdout, HANDLE_FLAG_INHERIT, 0);
+			STARTUPINFO stInfo = { sizeof(STARTUPINFO) };
+			stInfo.dwFlags = STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
+			stInfo.wShowWindow = SW_HIDE;
+			stInfo.hStdInput = hStdInput;
+			stInfo.hStdOutput = hStdOutput;
+			stInfo.hStdError = CreateFile(_T("NUL"), GENERIC_WRITE,
+				FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			bool retVal = !!CreateProcess(nullptr, (LPTSTR)command.c_str(),
+				nullptr, nullptr, TRUE, CREATE_DEFAULT_ERROR_MODE | CREATE_SUSPENDED, nullptr, nullptr,
+				&stInfo, &processInfo);
+			DWORD dwError = GetLastError();
+			CloseHandle(hStdInput);
+			CloseHandle(hStdOutput);
+			if (stInfo.hStdError != INVALID_HANDLE_VALUE)
+				CloseHandle(stInfo.hStdError);
+			if (!retVal)
+			{
+				SetLastError(dwError);
+				return setLastError(error);
+			}
+		}
+		// Workers are killed when WinMerge exits, even if it crashes
+		AssignProcessToJobObject(getJobObject(), processInfo.hProcess);
+		ResumeThread(processInfo.hThread);
+		CloseHandle(processInfo.hThread);
+		m_hProcess = processInfo.hProcess;
+		return true;
+	}
+
+	void Stop()
+	{
+		if (m_hStdin)
+		{
+			CloseHandle(m_hStdin);
+			m_hStdin = nullptr;
+		}
+		if (m_hStdout)
+		{
+			CloseHandle(m_hStdout);
+			m_hStdout = nullptr;
+		}
+		if (m_hProcess)
+		{
+			if (WaitForSingleObject(m_hProcess, 100) != WAIT_OBJECT_0)
+				TerminateProcess(m_hProcess, 1);
+			CloseHandle(m_hProcess);
+			m_hProcess = nullptr;
+		}
+	}
+
+	bool IsAlive() const
+	{
+		return !m_bBroken && m_hProcess && WaitForSingleObject(m_hProcess, 0) == WAIT_TIMEOUT;
+	}
+
+	bool Transform(const String& fileSrc, const String& fileDst, const String& arguments, String& error)
+	{
+		HANDLE hSrc = CreateFile(fileSrc.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+			nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (hSrc == INVALID_HANDLE_VALUE)
+			return setLastError(error);
+		LARGE_INTEGER size{};
+		GetFileSizeEx(hSrc, &size);
+		uint64_t nLength = static_cast<uint64_t>(size.QuadPart);
+		const std::string args = ucr::toUTF8(arguments);
+		const uint64_t nArgsLength = args.length();
+		bool bWritten = write(&nArgsLength, sizeof(nArgsLength)) && write(args.data(), args.length()) &&
+			write(&nLength, sizeof(nLength));
+		std::vector<char> buf(BufferSize);
+		while (bWritten && nLength > 0)
+		{
+			DWORD dwRead = 0;
+			if (!::ReadFile(hSrc, buf.data(), static_cast<DWORD>((std::min)(nLength, static_cast<uint64_t>(buf.size()))), &dwRead, nullptr) || dwRead == 0)
+				break;
+			bWritten = write(buf.data(), dwRead);
+			nLength -= dwRead;
+		}
+		CloseHandle(hSrc);
+		if (!bWritten || nLength > 0)
+		{
+			// The request can not be completed, so the process can not be used anymore
+			m_bBroken = true;
+			return setLastError(error);
+		}
+
+		uint32_t nStatus = 0;
+		if (!read(&nStatus, sizeof(nStatus)) || !read(&nLength, sizeof(nLength)))
+		{
+			m_bBroken = true;
+			error = _T("The worker process did not respond");
+			return false;
+		}
+		if (nStatus != 0)
+		{
+			std::string message(static_cast<size_t>((std::min)(nLength, static_cast<uint64_t>(MaxErrorLength))), '\0');
+			if (!read(message.data(), message.length()) || !skip(nLength - message.length()))
+				m_bBroken = true;
+			error = ucr::toTString(message);
+			return false;
+		}
+
+		HANDLE hDst = CreateFile(fileDst.c_str(), GENERIC_WRITE, 0,
+			nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (hDst == INVALID_HANDLE_VALUE)
+		{
+			// Drain the response so that the next request starts at a frame boundary
+			DWORD dwError = GetLastError();
+			if (!skip(nLength))
+				m_bBroken = true;
+			SetLastError(dwError);
+			return setLastError(error);
+		}
+		bool result = true;
+		while (nLength > 0)
+		{
+			DWORD dwRead = static_cast<DWORD>((std::min)(nLength, static_cast<uint64_t>(buf.size())));
+			if (!read(buf.data(), dwRead))
+			{
+				m_bBroken = true;
+				error = _T("The worker process did not respond");
+				result = false;
+				break;
+			}
+			DWORD dwWritten = 0;
+			if (result && (!::WriteFile(hDst, buf.data(), dwRead, &dwWritten, nullptr) || dwWritten != dwRead))
+				result = setLastError(error);
+			nLength -= dwRead;
+		}
+		CloseHandle(hDst);
+		return result;
+	}
+
+private:
+	static const size_t BufferSize = 65536;
+	static const size_t MaxErrorLength = 65536;
+
+	static HANDLE getJobObject()
+	{
+		static HANDLE hJob = []()
+		{
+			HANDLE hJob = CreateJobObject(nullptr, nullptr);
+			JOBOBJECT_EXTENDED_LIMIT_INFORMATION limitInfo{};
+			limitInfo.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+			SetInformationJobObject(hJob, JobObjectExtendedLimitInformation, &limitInfo, sizeof(limitInfo));
+			return hJob;
+		}();
+		return hJob;
+	}
+
+	static bool setLastError(String& error)
+	{
+		error = GetSysError(GetLastError());
+		return false;
+	}
+
+	bool write(const void* data, size_t len)
+	{
+		const char* p = static_cast<const char*>(data);
+		while (len > 0)
+		{
+			DWORD dwWritten = 0;
+			if (!::WriteFile(m_hStdin, p, static_cast<DWORD>(len), &dwWritten, nullptr))
+				return false;
+			p += dwWritten;
+			len -= dwWritten;
+		}
+		return true;
+	}
+
+	bool read(void* data, size_t len)
+	{
+		char* p = static_cast<char*>(data);
+		while (len > 0)
+		{
+			DWORD dwRead = 0;
+			if (!::ReadFile(m_hStdout, p, static_cast<DWORD>(len), &dwRead, nullptr) || dwRead == 0)
+				return false;
+			p += dwRead;
+			len -= dwRead;
+		}
+		return true;
+	}
+
+	bool skip(uint64_t len)
+	{
+		char buf[4096];
+		while (len > 0)
+		{
+			size_t n = static_cast<size_t>((std::min)(len, static_cast<uint64_t>(sizeof(buf))));
+			if (!read(buf, n))
+				return false;
+			len -= n;
+		}
+		return true;
+	}
+
+	HANDLE m_hProcess = nullptr;
+	HANDLE m_hStdin = nullptr; /**< Write end of the standard input pipe of the process */
+	HANDLE m_hStdout = nullptr; /**< Read end of the standard output pipe of the process */
+	bool m_bBroken = false; /**< true if a request or response was cut off */
+};
+
+/**
+ * @brief Worker processes running the same command.
+ *
+ * Pools are shared by the plugin instances of all threads, so up to
+ * m_nMaxProcesses files are transformed at the same time. Processes are
+ * started on demand and kept until WinMerge exits or the pool is dropped.
+ * The pools are keyed by the command before any replacement, since the
+ * arguments, which may hold file paths, are sent with each request.
+ * At most MaxPools pools are kept, the least recently used one being dropped
+ * first, and at most getMaxProcesses() processes run in all the pools. When
+ * they are all started, an idle process of another pool is stopped.
+ */
+class WorkerPool
+{
+public:
+	WorkerPool(const String& command, const Script* pScript, int nMaxProcesses)
+		: m_command(command)
+		, m_nMaxProcesses(nMaxProcesses)
+		, m_nProcesses(0)
+	{
+		strutils::replace(m_command, _T("${*}"), _T(""));
+		if (pScript)
+		{
+			createScript(*pScript, m_scriptFile);
+			strutils::replace(m_command, _T("${SCRIPT_FILE}"), m_scriptFile.GetPath());
+		}
+		m_command = ExpandWinMergeHome(m_command);
+	}
+
+	~WorkerPool()
+	{
+		s_nProcesses -= m_nProcesses;
+	}
+
+	static std::shared_ptr<WorkerPool> Get(const String& command, const Script* pScript, int nMaxProcesses)
+	{
+		String key = command;
+		if (pScript)
+			key += _T('\0') + pScript->m_fileExtension + _T('\0') + pScript->m_body;
+		std::shared_ptr<WorkerPool> dropped; // its idle processes are stopped after the lock is released
+		std::lock_guard<std::mutex> lock(s_mutex);
+		auto it = std::find_if(s_pools.begin(), s_pools.end(),
+			[&key](const std::pair<String, std::shared_ptr<WorkerPool>>& pool) { return pool.first == key; });
+		if (it != s_pools.end())
+		{
+			s_pools.splice(s_pools.begin(), s_pools, it);
+			return s_pools.front().second;
+		}
+		if (s_pools.size() >= MaxPools)
+		{
+			dropped = std::move(s_pools.back().second);
+			s_pools.pop_back();
+		}
+		s_pools.emplace_front(key, std::make_shared<WorkerPool>(command, pScript, nMaxProcesses));
+		return s_pools.front().second;
+	}
+
+	const String& GetCommand() const { return m_command; }
+
+	bool Transform(const String& fileSrc, const String& fileDst, const String& arguments, String& error)
+	{
+		std::unique_ptr<WorkerProcess> worker = acquire(error);
+		if (!worker)
+			return false;
+		bool result = worker->Transform(fileSrc, fileDst, arguments, error);
+		release(std::move(worker));
+		return result;
+	}
+
+private:
+	static const size_t MaxPools = 8;
+
+	static int getMaxProcesses()
+	{
+		return (std::max)(2 * static_cast<int>(Poco::Environment::processorCount()), 4);
+	}
+
+	std::unique_ptr<WorkerProcess> acquire(String& error)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			while (!m_idle.empty())
+			{
+				std::unique_ptr<WorkerProcess> worker = std::move(m_idle.back());
+				m_idle.pop_back();
+				if (worker->IsAlive())
+					return worker;
+				--m_nProcesses;
+				--s_nProcesses;
+			}
+			if (m_nProcesses < m_nMaxProcesses)
+			{
+				++m_nProcesses;
+				lock.unlock();
+				if (reserveProcess())
+				{
+					std::unique_ptr<WorkerProcess> worker(new WorkerProcess());
+					if (worker->Start(m_command, error))
+						return worker;
+					--s_nProcesses;
+					lock.lock();
+					--m_nProcesses;
+					m_cond.notify_one();
+					return nullptr;
+				}
+				// All the processes are busy, so wait for one of this pool or try again later
+				lock.lock();
+				--m_nProcesses;
+				m_cond.wait_for(lock, std::chrono::milliseconds(100));
+				continue;
+			}
+			m_cond.wait(lock);
+		}
+	}
+
+	void release(std::unique_ptr<WorkerProcess>&& worker)
+	{
+		std::unique_ptr<WorkerProcess> stopped; // destroyed after the lock is released
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (worker->IsAlive())
+			m_idle.push_back(std::move(worker));
+		else
+		{
+			stopped = std::move(worker);
+			--m_nProcesses;
+			--s_nProcesses;
+		}
+		m_cond.notify_one();
+	}
+
+	/**
+	 * @brief Count a process to start in the processes of all the pools.
+	 * If they are all started, the oldest idle process of the least recently
+	 * used pool is stopped and its place is taken. Called without m_mutex locked.
+	 * @return false if all the processes are busy.
+	 */
+	bool reserveProcess()
+	{
+		const int nMaxProcesses = getMaxProcesses();
+		int n = s_nProcesses;
+		while (n < nMaxProcesses)
+		{
+			if (s_nProcesses.compare_exchange_weak(n, n + 1))
+				return true;
+		}
+		std::unique_ptr<WorkerProcess> stopped; // destroyed after the lock is released
+		std::lock_guard<std::mutex> lock(s_mutex);
+		for (auto it = s_pools.rbegin(); it != s_pools.rend() && !stopped; ++it)
+		{
+			if (it->second.get() != this)
+				stopped = it->second->takeIdle();
+		}
+		return stopped != nullptr;
+	}
+
+	/**
+	 * @brief Remove an idle process from the pool, to be stopped by the caller.
+	 * The process stays counted in s_nProcesses, for the caller to start another one.
+	 */
+	std::unique_ptr<WorkerProcess> takeIdle()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_idle.empty())
+			return nullptr;
+		std::unique_ptr<WorkerProcess> worker = std::move(m_idle.front());
+		m_idle.erase(m_idle.begin());
+		--m_nProcesses;
+		m_cond.notify_one();
+		return worker;
+	}
+
+	String m_command;
+	TempFile m_scriptFile;
+	int m_nMaxProcesses;
+	int m_nProcesses; /**< Number of started processes, idle or busy */
+	std::vector<std::unique_ptr<WorkerProcess>> m_idle;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	inline static std::mutex s_mutex; /**< Guards s_pools */
+	inline static std::atomic<int> s_nProcesses{ 0 }; /**< Number of started processes of all the pools */
+	inline static std::list<std::pair<String, std::shared_ptr<WorkerPool>>> s_pools; /**< Most recently used first */
+};
+
 class InternalPlugin : public WinMergePluginBase
 {
 public:
@@ -335,6 +864,26 @@ public:
 	{
 	}
 
+	bool UsesWorkers() const
+	{
+		return m_info.UsesWorkers();
+	}
+
+	bool UsesVariables() const
+	{
+		return m_info.UsesVariables();
+	}
+
+	bool UsesScripts() const
+	{
+		return m_info.UsesScripts();
+	}
+
+	String GetDefinition() const
+	{
+		return m_info.GetDefinition();
+	}
+
 	HRESULT STDMETHODCALLTYPE PrediffFile(BSTR fileSrc, BSTR fileDst, VARIANT_BOOL* pbChanged, VARIANT_BOOL* pbSuccess) override
 	{
 		if (!m_info.m_prediffFile)
@@ -343,6 +892,8 @@ public:
 			*pbSuccess = VARIANT_FALSE;
 			return S_OK;
 		}
+		if (m_info.m_prediffFile->m_worker)
+			return transformByWorker(*m_info.m_prediffFile, fileSrc, fileDst, pbChanged, pbSuccess);
 		TempFile scriptFile;
 		String command = replaceMacros(m_info.m_prediffFile->m_command, fileSrc, fileDst);
 		if (m_info.m_prediffFile->m_script)
@@ -367,6 +918,11 @@ public:
 			*pbSuccess = VARIANT_FALSE;
 			return S_OK;
 		}
+		if (m_info.m_unpackFile->m_worker)
+		{
+			*pSubcode = 0;
+			return transformByWorker(*m_info.m_unpackFile, fileSrc, fileDst, pbChanged, pbSuccess);
+		}
 		TempFile scriptFile;
 		String command = replaceMacros(m_info.m_unpackFile->m_command, fileSrc, fileDst);
 		if (m_info.m_unpackFile->m_script)
@@ -391,6 +947,8 @@ public:
 			*pbSuccess = VARIANT_FALSE;
 			return S_OK;
 		}
+		if (m_info.m_packFile->m_worker)
+			return transformByWorker(*m_info.m_packFile, fileSrc, fileDst, pbChanged, pbSuccess);
 		TempFile scriptFile;
 		String command = replaceMacros(m_info.m_packFile->m_command, fileSrc, fileDst);
 		if (m_info.m_packFile->m_script)
@@ -480,33 +1038,54 @@ protected:
 		return command;
 	}
 
-	static HRESULT createScript(const Script& script, TempFile& tempFile)
+	HRESULT transformByWorker(const Method& method, const String& fileSrc, const String& fileDst, VARIANT_BOOL* pbChanged, VARIANT_BOOL* pbSuccess)
 	{
-		String path = tempFile.Create(_T(""), script.m_fileExtension);
-		return WriteFile(path, script.m_body, false);
+		int nProcesses = m_info.m_workerProcesses;
+		if (nProcesses <= 0)
+		{
+			// Same number as the folder compare threads
+			const int nprocessors = static_cast<int>(Poco::Environment::processorCount());
+			nProcesses = GetOptionsMgr()->GetInt(OPT_CMP_COMPARE_THREADS);
+			if (nProcesses <= 0)
+				nProcesses += nprocessors;
+			nProcesses = std::clamp(nProcesses, 1, nprocessors);
+		}
+		std::shared_ptr<WorkerPool> pool = WorkerPool::Get(method.m_command, method.m_script.get(), nProcesses);
+		String error;
+		bool result = pool->Transform(fileSrc, fileDst, m_sArguments, error);
+		*pbChanged = result;
+		*pbSuccess = result;
+		if (!result)
+			return SetPluginErrorInfo(pool->GetCommand(), error) ? DISP_E_EXCEPTION : E_FAIL;
+		return S_OK;
 	}
 
 	static HRESULT launchProgram(const String& sCmd, WORD wShowWindow, DWORD &dwExitCode)
 	{
 		TempFile stderrFile;
 		String sOutputFile = stderrFile.Create();
-		if (_wgetenv(L"WINMERGE_HOME") == nullptr)
-			_wputenv_s(L"WINMERGE_HOME", env::GetProgPath().c_str());
-		String command = sCmd;
-		strutils::replace(command, _T("${WINMERGE_HOME}"), env::GetProgPath());
+		String command = ExpandWinMergeHome(sCmd);
 		STARTUPINFO stInfo = { sizeof(STARTUPINFO) };
 		stInfo.dwFlags = STARTF_USESHOWWINDOW;
 		stInfo.wShowWindow = wShowWindow;
 		SECURITY_ATTRIBUTES sa{ sizeof(sa) };
 		sa.bInheritHandle = true;
-		stInfo.hStdError = CreateFile(sOutputFile.c_str(), GENERIC_READ | GENERIC_WRITE,
-			FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-		stInfo.hStdOutput = stInfo.hStdError;
-		stInfo.dwFlags |= STARTF_USESTDHANDLES;
 		PROCESS_INFORMATION processInfo;
-		bool retVal = !!CreateProcess(nullptr, (LPTSTR)command.c_str(),
-			nullptr, nullptr, TRUE, CREATE_DEFAULT_ERROR_MODE, nullptr, nullptr,
-			&stInfo, &processInfo);
+		bool retVal;
+		{
+			std::lock_guard<std::mutex> lock(g_inheritableHandlesMutex);
+			stInfo.hStdError = CreateFile(sOutputFile.c_str(), GENERIC_READ | GENERIC_WRITE,
+				FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			stInfo.hStdOutput = stInfo.hStdError;
+			stInfo.dwFlags |= STARTF_USESTDHANDLES;
+			retVal = !!CreateProcess(nullptr, (LPTSTR)command.c_str(),
+				nullptr, nullptr, TRUE, CREATE_DEFAULT_ERROR_MODE, nullptr, nullptr,
+				&stInfo, &processInfo);
+			DWORD dwError = GetLastError();
+			if (stInfo.hStdError != INVALID_HANDLE_VALUE)
+				SetHandleInformation(stInfo.hStdError, HANDLE_FLAG_INHERIT, 0);
+			SetLastError(dwError);
+		}
 		if (!retVal)
 			return HRESULT_FROM_WIN32(GetLastError());
 		WaitForSingleObject(processInfo.hProcess, INFINITE);
@@ -524,18 +1103,8 @@ protected:
 		{
 			String error;
 			ReadFile(sOutputFile, error);
-			ICreateErrorInfo* pCreateErrorInfo = nullptr;
-			if (SUCCEEDED(CreateErrorInfo(&pCreateErrorInfo)))
-			{
-				pCreateErrorInfo->SetSource(const_cast<OLECHAR*>(command.c_str()));
-				pCreateErrorInfo->SetDescription(const_cast<OLECHAR*>(ucr::toUTF16(error).c_str()));
-				IErrorInfo* pErrorInfo = nullptr;
-				pCreateErrorInfo->QueryInterface(&pErrorInfo);
-				SetErrorInfo(0, pErrorInfo);
-				pErrorInfo->Release();
-				pCreateErrorInfo->Release();
+			if (SetPluginErrorInfo(command, error))
 				return DISP_E_EXCEPTION;
-			}
 		}
 		return S_OK;
 	}
@@ -691,6 +1260,13 @@ struct Loader
 			IDispatch* pDispatch = new InternalPlugin(std::move(info));
 			pDispatch->AddRef();
 			pluginNew->MakeInfo(name, pDispatch);
+			pluginNew->m_bConcurrent = static_cast<InternalPlugin*>(pDispatch)->UsesWorkers();
+			// The variables change with every file, so don't make them part of the cached outputs' key if unused
+			pluginNew->m_hasVariablesProperty = static_cast<InternalPlugin*>(pDispatch)->UsesVariables();
+			// The commands run the same external tools for the same input, unless a script decides otherwise
+			if (!static_cast<InternalPlugin*>(pDispatch)->UsesScripts())
+				pluginNew->m_bCacheable = true;
+			pluginNew->m_definition = static_cast<InternalPlugin*>(pDispatch)->GetDefinition();
 			plugins[event]->push_back(pluginNew);
 		}
 
@@ -0,0 +1,53 @@
+/**
+ *  @file KeyHasher.h
+ *
+ *  @brief Declaration of class KeyHasher
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "UnicodeString.h"
+
+/**
+ * @brief Computes two independent 64-bit hashes over the added data.
+ * Used to build the keys of persistent caches.
+ */
+class KeyHasher
+{
+public:
+	KeyHasher() : m_h1(0xcbf29ce484222325ULL), m_h2(0x9e3779b97f4a7c15ULL) {}
+
+	void Add(const void *data, size_t len)
+	{
+		const unsigned char *p = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < len; ++i)
+		{
+			m_h1 = (m_h1 ^ p[i]) * 0x100000001b3ULL;
+			m_h2 = ((m_h2 << 5) | (m_h2 >> 59)) ^ p[i];
+			m_h2 *= 0x880355f21e6d1965ULL;
+		}
+	}
+
+	template<typename T>
+	void Add(const T& value) { Add(&value, sizeof(value)); }
+
+	void Add(const std::string& str)
+	{
+		Add(str.length());
+		Add(str.data(), str.length());
+	}
+
+	void Add(const String& str)
+	{
+		Add(str.length());
+		Add(str.data(), str.length() * sizeof(TCHAR));
+	}
+
+	uint64_t GetHash1() const { return m_h1; }
+	uint64_t GetHash2() const { return m_h2 ^ (m_h2 >> 29); }
+
+private:
+	uint64_t m_h1;
+	uint64_t m_h2;
+};
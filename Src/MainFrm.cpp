@@ -1271,6 +1271,8 @@ bool CMainFrame::DoFileOrFolderOpen(const PathContext * pFiles /*= nullptr*/,
 
 	FileTransform::AutoUnpacking = GetOptionsMgr()->GetBool(OPT_PLUGINS_UNPACKER_MODE);
 	FileTransform::AutoPrediffing = GetOptionsMgr()->GetBool(OPT_PLUGINS_PREDIFFER_MODE);
+	FileTransform::OutputCache = GetOptionsMgr()->GetBool(OPT_PLUGINS_OUTPUT_CACHE) ?
+		theApp.GetPluginOutputCache() : nullptr;
 
 	Merge7zFormatMergePluginScope scope(infoUnpacker);
 
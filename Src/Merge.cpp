@@ -55,6 +55,8 @@
 #include "paths.h"
 #include "Shell.h"
 #include "CompareStats.h"
+#include "CompareResultCache.h"
+#include "PluginOutputCache.h"
 #include "TestMain.h"
 #include "charsets.h" // For shutdown cleanup
 #include "OptionsProject.h"
@@ -327,6 +329,7 @@ BOOL CMergeApp::InitInstance()
 
 	FileTransform::AutoUnpacking = GetOptionsMgr()->GetBool(OPT_PLUGINS_UNPACKER_MODE);
 	FileTransform::AutoPrediffing = GetOptionsMgr()->GetBool(OPT_PLUGINS_PREDIFFER_MODE);
+	FileTransform::OutputCache = GetOptionsMgr()->GetBool(OPT_PLUGINS_OUTPUT_CACHE) ? GetPluginOutputCache() : nullptr;
 
 	NONCLIENTMETRICS ncm = { sizeof NONCLIENTMETRICS };
 	if (SystemParametersInfo(SPI_GETNONCLIENTMETRICS, sizeof NONCLIENTMETRICS, &ncm, 0))
@@ -511,6 +514,9 @@ int CMergeApp::ExitInstance()
 {
 	charsets_cleanup();
 
+	if (m_pPluginOutputCache)
+		m_pPluginOutputCache->Save();
+
 	//  Save registry keys if existing WinMerge.reg
 	env::SaveRegistryToFile(paths::ConcatPath(env::GetProgPath(), _T("WinMerge.reg")), RegDir);
 
@@ -919,6 +925,39 @@ void CMergeApp::OpenFileToExternalEditor(const String& file, int nLineNumber/* =
 	}
 }
 
+/**
+ * @brief Returns pointer to the persistent folder compare result cache.
+ * The cache is loaded from disk on first use.
+ */
+CompareResultCache* CMergeApp::GetCompareResultCache()
+{
+	if (!m_pCompareResultCache)
+	{
+		m_pCompareResultCache.reset(new CompareResultCache(
+			paths::ConcatPath(env::GetLocalAppDataPath(), _T("CompareResultCache.bin"))));
+		m_pCompareResultCache->Load();
+	}
+	return m_pCompareResultCache.get();
+}
+
+/**
+ * @brief Returns pointer to the persistent plugin output cache.
+ * The cache is loaded from disk on first use, and its maximum size is
+ * updated from the options on every call.
+ */
+PluginOutputCache* CMergeApp::GetPluginOutputCache()
+{
+	if (!m_pPluginOutputCache)
+	{
+		m_pPluginOutputCache.reset(new PluginOutputCache(
+			paths::ConcatPath(env::GetLocalAppDataPath(), _T("PluginOutputCache"))));
+		m_pPluginOutputCache->Load();
+	}
+	m_pPluginOutputCache->SetMaxSize(
+		static_cast<uint64_t>(GetOptionsMgr()->GetInt(OPT_PLUGINS_OUTPUT_CACHE_MAX_SIZE)) * 1024 * 1024);
+	return m_pPluginOutputCache.get();
+}
+
 /** @brief Returns pointer to global file filter */
 FileFilterHelper* CMergeApp::GetGlobalFileFilter()
 {
@@ -38,6 +38,8 @@ class SubstitutionFiltersList;
 class SyntaxColors;
 class CCrystalTextMarkers;
 class PackingInfo;
+class CompareResultCache;
+class PluginOutputCache;
 
 /////////////////////////////////////////////////////////////////////////////
 // CMergeApp:
@@ -87,6 +89,8 @@ public:
 
 	COptionsMgr * GetMergeOptionsMgr() { return static_cast<COptionsMgr *> (m_pOptions.get()); }
 	FileFilterHelper* GetGlobalFileFilter();
+	CompareResultCache* GetCompareResultCache();
+	PluginOutputCache* GetPluginOutputCache();
 	void ShowHelp(LPCTSTR helpLocation = nullptr);
 	static void OpenFileToExternalEditor(const String& file, int nLineNumber = 1);
 	static bool CreateBackup(bool bFolder, const String& pszPath);
@@ -166,6 +170,8 @@ protected:
 private:
 	std::unique_ptr<COptionsMgr> m_pOptions;
 	std::unique_ptr<FileFilterHelper> m_pGlobalFileFilter;
+	std::unique_ptr<CompareResultCache> m_pCompareResultCache;
+	std::unique_ptr<PluginOutputCache> m_pPluginOutputCache;
 	CAssureScriptsForThread * m_mainThreadScripts;
 	int m_nLastCompareResult;
 	bool m_bNonInteractive;
@@ -42,6 +42,7 @@
 #include "LineFiltersList.h"
 #include "SubstitutionFiltersList.h"
 #include "TempFile.h"
+#include "FileContents.h"
 #include "codepage_detect.h"
 #include "SelectPluginDlg.h"
 #include "EncodingErrorBar.h"
@@ -54,6 +55,7 @@
 #include "charsets.h"
 #include "markdown.h"
 #include "stringdiffs.h"
+#include "WordDiffPrecomputer.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -63,7 +65,7 @@ using std::swap;
 
 int CMergeDoc::m_nBuffersTemp = 2;
 
-static void SaveBuffForDiff(CDiffTextBuffer & buf, const String& filepath, int nStartLine = 0, int nLines = -1);
+static void SaveBuffForDiff(CDiffTextBuffer & buf, FileContents& contents, int nStartLine = 0, int nLines = -1);
 
 /////////////////////////////////////////////////////////////////////////////
 // CMergeDoc
@@ -150,6 +152,14 @@ CMergeDoc::CMergeDoc()
 , m_bAutomaticRescan(false)
 , m_CurrentPredifferID(0)
 , m_bChangedSchemeManually(false)
+, m_nRealLinesOnRescan{}
+, m_bMissingNLOnRescan{}
+, m_bRescanStateValid(false)
+, m_bRediffedEditedLines(false)
+, m_nRediffBegin{}
+, m_nRediffEnd{}
+, m_nRediffDelta{}
+, m_nWordDiffGeneration(0)
 {
 	DIFFOPTIONS options = {0};
 
@@ -167,6 +177,7 @@ CMergeDoc::CMergeDoc()
 
 	m_bEnableRescan = true;
 	m_bAutomaticRescan = GetOptionsMgr()->GetBool(OPT_AUTOMATIC_RESCAN);
+	SetUndoMemoryLimit();
 
 	// COleDateTime m_LastRescan
 	curUndo = undoTgt.begin();
@@ -278,29 +289,86 @@ void CMergeDoc::Serialize(CArchive& ar)
 // CMergeDoc commands
 
 /**
- * @brief Save an editor text buffer to a file for prediffing (make UCS-2LE if appropriate)
+ * @brief Serialize an editor text buffer for the diff-engine.
  *
- * @note 
- * original file is Ansi : 
- *   buffer  -> save as Ansi -> Ansi plugins -> diffutils
- * original file is Unicode (UCS2-LE, UCS2-BE, UTF-8) :
- *   buffer  -> save as UTF-8 -> Unicode plugins -> convert to UTF-8 -> diffutils
- * (the plugins are optional, not the conversion)
- * @todo Show SaveToFile() errors?
+ * The buffer is converted to UTF-8 in memory, the same way it used to be
+ * saved to a temp file before every compare.
+ * @sa CDiffTextBuffer::SaveToMemory()
  */
-static void SaveBuffForDiff(CDiffTextBuffer & buf, const String& filepath, int nStartLine, int nLines)
+static void SaveBuffForDiff(CDiffTextBuffer & buf, FileContents& contents, int nStartLine, int nLines)
 {
-	// and we don't repack the file
-	PackingInfo tempPacker(false);
+	buf.SaveToMemory(contents, nStartLine, nLines);
+}
 
-	// write buffer out to temporary file
-	String sError;
-	int retVal = buf.SaveToFile(filepath, true, sError, tempPacker,
-		CRLFSTYLE::AUTOMATIC, false, nStartLine, nLines);
+/**
+ * @brief Number of unchanged lines compared again around edited lines.
+ * Diffs near the edges of the compared lines are aligned the same way
+ * as when whole files are compared.
+ */
+static const int RescanContextLines = 100;
+
+/**
+ * @brief Get count of real (not ghost) lines in a buffer.
+ */
+static int GetRealLineCount(const CDiffTextBuffer & buf)
+{
+	const int nLineCount = buf.GetLineCount();
+	if (nLineCount == 0)
+		return 0;
+	const int nLastLine = nLineCount - 1;
+	return buf.ComputeRealLine(nLastLine) + ((buf.GetLineFlags(nLastLine) & LF_GHOST) ? 0 : 1);
+}
+
+/**
+ * @brief Return the line filters used for comparing, empty if disabled.
+ */
+static String GetLineFiltersString()
+{
+	if (GetOptionsMgr()->GetBool(OPT_LINEFILTER_ENABLED))
+		return theApp.m_pLineFilters->GetAsString();
+	return _T("");
+}
+
+/**
+ * @brief Check if the substitution filters differ from the saved ones.
+ * @param [in] pSaved Filters saved at the last compare, or nullptr.
+ */
+static bool SubstitutionFiltersChanged(const SubstitutionFiltersList *pSaved)
+{
+	const SubstitutionFiltersList *pCurrent = theApp.m_pSubstitutionFiltersList.get();
+	if (pSaved == nullptr || pCurrent == nullptr)
+		return pSaved != pCurrent;
+	return !pSaved->Compare(pCurrent);
 }
 
 /**
- * @brief Save files to temp files & compare again.
+ * @brief Get identical level of files from their diffs, as diffutils tells it.
+ */
+static IDENTLEVEL GetIdentLevel(const DiffList & diffList, int nFiles)
+{
+	const int nDiffs = diffList.GetSize();
+	if (nDiffs == 0)
+		return IDENTLEVEL::ALL;
+	if (nFiles < 3)
+		return IDENTLEVEL::NONE;
+	bool bDiff10 = false, bDiff12 = false;
+	for (int nDiff = 0; nDiff < nDiffs; ++nDiff)
+	{
+		const OP_TYPE op = diffList.DiffRangeAt(nDiff)->op;
+		if (op != OP_3RDONLY)
+			bDiff10 = true;
+		if (op != OP_1STONLY)
+			bDiff12 = true;
+	}
+	if (!bDiff10)
+		return IDENTLEVEL::EXCEPTRIGHT;
+	if (!bDiff12)
+		return IDENTLEVEL::EXCEPTLEFT;
+	return IDENTLEVEL::EXCEPTMIDDLE;
+}
+
+/**
+ * @brief Serialize the buffers & compare again.
  *
  * @param bBinary [in,out] [in] If true, compare two binary files
  * [out] If true binary file was detected.
@@ -311,8 +379,11 @@ static void SaveBuffForDiff(CDiffTextBuffer & buf, const String& filepath, int n
  * error happened
  * If this code is OK, Rescan has detached the views temporarily
  * (positions of cursors have been lost)
- * @note Rescan() ALWAYS compares temp files. Actual user files are not
+ * @note Rescan() ALWAYS compares the text of the buffers, in memory or as
+ * temp files when prediffer plugins need files. Actual user files are not
  * touched by Rescan().
+ * @note Unless bForced is true, only lines edited since the last compare
+ * may be compared again, see RescanEditedLines().
  * @sa CDiffWrapper::RunFileDiff()
  */
 int CMergeDoc::Rescan(bool &bBinary, IDENTLEVEL &identical,
@@ -331,16 +402,11 @@ int CMergeDoc::Rescan(bool &bBinary, IDENTLEVEL &identical,
 			return RESCAN_SUPPRESSED;
 	}
 
-	ClearWordDiffCache();
+	// Word diffs of blocks the edits didn't touch are put back after the rescan
+	KeepWordDiffCache();
+	m_bRediffedEditedLines = false;
 
-	if (GetOptionsMgr()->GetBool(OPT_LINEFILTER_ENABLED))
-	{
-		m_diffWrapper.SetFilterList(theApp.m_pLineFilters->GetAsString());
-	}
-	else
-	{
-		m_diffWrapper.SetFilterList(_T(""));
-	}
+	m_diffWrapper.SetFilterList(GetLineFiltersString());
 
 	if (theApp.m_pSubstitutionFiltersList && theApp.m_pSubstitutionFiltersList->GetEnabled())
 	{
@@ -417,37 +483,51 @@ int CMergeDoc::Rescan(bool &bBinary, IDENTLEVEL &identical,
 	m_diffWrapper.SetCompareFiles(m_filePaths);
 
 	DIFFSTATUS status;
+	FileContents contents[3];
+	m_diffWrapper.SetContents(contents);
 
 	if (!HasSyncPoints())
 	{
-		// Save text buffer to file
 		for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
-		{
 			m_ptBuf[nBuffer]->SetTempPath(tempPath);
-			SaveBuffForDiff(*m_ptBuf[nBuffer], m_tempFiles[nBuffer].GetPath());
-		}
 
-		m_diffWrapper.SetCreateDiffList(&m_diffList);
-		diffSuccess = m_diffWrapper.RunFileDiff();
+		// After edits, compare only the edited lines if possible
+		diffSuccess = !bForced && !bBinary && RescanEditedLines(contents, status);
+		m_bRediffedEditedLines = diffSuccess;
+		if (!diffSuccess)
+		{
+			// Serialize text buffers for the diff-engine
+			for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+				SaveBuffForDiff(*m_ptBuf[nBuffer], contents[nBuffer]);
 
-		// Read diff-status
-		m_diffWrapper.GetDiffStatus(&status);
-		if (bBinary) // believe caller if we were told these are binaries
-			status.bBinaries = true;
+			m_diffWrapper.SetCreateDiffList(&m_diffList);
+			diffSuccess = m_diffWrapper.RunFileDiff();
+
+			// Read diff-status
+			m_diffWrapper.GetDiffStatus(&status);
+			if (bBinary) // believe caller if we were told these are binaries
+				status.bBinaries = true;
+		}
+
+		if (diffSuccess && !status.bBinaries)
+			SaveRescanState(status);
+		else
+			m_bRescanStateValid = false;
 	}
 	else
 	{
+		m_bRescanStateValid = false;
 		const std::vector<std::vector<int> > syncpoints = GetSyncPointList();	
 		int nStartLine[3] = {0};
 		int nLines[3], nRealLine[3];
 		for (size_t i = 0; i <= syncpoints.size(); ++i)
 		{
-			// Save text buffer to file
+			// Serialize text buffers for the diff-engine
 			for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
 			{
 				nLines[nBuffer] = (i >= syncpoints.size()) ? -1 : syncpoints[i][nBuffer] - nStartLine[nBuffer];
 				m_ptBuf[nBuffer]->SetTempPath(tempPath);
-				SaveBuffForDiff(*m_ptBuf[nBuffer], m_tempFiles[nBuffer].GetPath(), 
+				SaveBuffForDiff(*m_ptBuf[nBuffer], contents[nBuffer],
 					nStartLine[nBuffer], nLines[nBuffer]);
 			}
 			DiffList templist;
@@ -500,6 +580,7 @@ int CMergeDoc::Rescan(bool &bBinary, IDENTLEVEL &identical,
 		}
 		m_diffWrapper.SetCreateDiffList(&m_diffList);
 	}
+	m_diffWrapper.SetContents(nullptr);
 
 	// If one file has EOL before EOF and other not...
 	if (std::count(status.bMissingNL, status.bMissingNL + m_nBuffers, status.bMissingNL[0]) < m_nBuffers)
@@ -579,7 +660,11 @@ int CMergeDoc::Rescan(bool &bBinary, IDENTLEVEL &identical,
 		for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
 		{
 			m_bEditAfterRescan[nBuffer] = false;
+			m_ptBuf[nBuffer]->SetRescanned();
 		}
+
+		// Compute word diffs in background before the blocks are painted
+		PrecomputeWordDiffs();
 	}
 
 	if (!GetOptionsMgr()->GetBool(OPT_CMP_IGNORE_CODEPAGE) &&
@@ -593,6 +678,238 @@ int CMergeDoc::Rescan(bool &bBinary, IDENTLEVEL &identical,
 	return nResult;
 }
 
+/**
+ * @brief Compare again only the lines edited since the last compare.
+ *
+ * Diffs before and after the edited lines are kept from the last compare.
+ * Edited lines, widened with unchanged lines around them, are compared on
+ * their own and their diffs are put between the kept diffs.
+ * @param [out] contents Serialized text of compared lines.
+ * @param [out] status Diff status of whole files.
+ * @return true if m_diffList was updated, false if whole files must be compared.
+ * @sa SaveRescanState(), CDiffTextBuffer::GetEditedLines()
+ */
+bool CMergeDoc::RescanEditedLines(FileContents contents[], DIFFSTATUS & status)
+{
+	if (!m_bRescanStateValid || m_diffWrapper.GetDetectMovedBlocks())
+		return false;
+
+	// Kept diffs are not valid if the filters changed after the last compare
+	if (m_sLineFiltersOnRescan != GetLineFiltersString() ||
+		SubstitutionFiltersChanged(m_pSubstitutionFiltersOnRescan.get()))
+		return false;
+
+	// Comment filtering and prediffers may need text outside the edited lines
+	DIFFOPTIONS diffOptions = {0};
+	m_diffWrapper.GetOptions(&diffOptions);
+	if (diffOptions.bFilterCommentsLines)
+		return false;
+	PrediffingInfo infoPrediffer;
+	GetPrediffer(&infoPrediffer);
+	if (!infoPrediffer.GetPluginPipeline().empty())
+		return false;
+
+	// Find edited real lines, [nFirst, nOldEnd) in the last compare
+	int nRealLines[3] = {0}, nDelta[3] = {0}, nFirst[3] = {0}, nOldEnd[3] = {0};
+	bool bEdited[3] = {false};
+	int nBuffer;
+	for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+	{
+		const CDiffTextBuffer & buf = *m_ptBuf[nBuffer];
+		int nFirstLine, nLastLine;
+		if (!buf.GetEditedLines(nFirstLine, nLastLine))
+			return false;
+		nRealLines[nBuffer] = GetRealLineCount(buf);
+		nDelta[nBuffer] = nRealLines[nBuffer] - m_nRealLinesOnRescan[nBuffer];
+		if (nFirstLine < 0)
+		{
+			if (nDelta[nBuffer] != 0)
+				return false;
+			continue;
+		}
+		nFirst[nBuffer] = buf.ComputeRealLine(nFirstLine);
+		const int nEnd = buf.ComputeRealLine(nLastLine) + ((buf.GetLineFlags(nLastLine) & LF_GHOST) ? 0 : 1);
+		nOldEnd[nBuffer] = nEnd - nDelta[nBuffer];
+		if (nOldEnd[nBuffer] < nFirst[nBuffer] || nOldEnd[nBuffer] > m_nRealLinesOnRescan[nBuffer])
+			return false;
+		bEdited[nBuffer] = true;
+	}
+
+	if (std::none_of(bEdited, bEdited + m_nBuffers, [](bool b) { return b; }))
+	{
+		std::fill_n(m_nRediffBegin, 3, INT_MAX);
+		std::fill_n(m_nRediffEnd, 3, INT_MAX);
+		std::fill_n(m_nRediffDelta, 3, 0);
+		m_diffList.AppendDiffList(m_diffListOnRescan);
+		std::copy_n(m_bMissingNLOnRescan, 3, status.bMissingNL);
+		status.bBinaries = false;
+		status.Identical = GetIdentLevel(m_diffList, m_nBuffers);
+		return true;
+	}
+
+	// Gap nGap is the unchanged lines between diffs nGap-1 and nGap
+	const DiffList & diffList = m_diffListOnRescan;
+	const int nDiffs = diffList.GetSize();
+	auto gapBegin = [&](int nGap, int nBuf) {
+		return nGap > 0 ? diffList.DiffRangeAt(nGap - 1)->end[nBuf] + 1 : 0;
+	};
+	auto gapEnd = [&](int nGap, int nBuf) {
+		return nGap < nDiffs ? diffList.DiffRangeAt(nGap)->begin[nBuf] : m_nRealLinesOnRescan[nBuf];
+	};
+	// Lines of a gap match each other only if the gap is equally long in all files
+	auto gapLength = [&](int nGap) {
+		const int nLength = gapEnd(nGap, 0) - gapBegin(nGap, 0);
+		for (int nBuf = 1; nBuf < m_nBuffers; nBuf++)
+		{
+			if (gapEnd(nGap, nBuf) - gapBegin(nGap, nBuf) != nLength)
+				return 0;
+		}
+		return nLength;
+	};
+
+	// Start compared lines in the last gap beginning before the edits
+	int nStartGap = 0;
+	while (nStartGap < nDiffs)
+	{
+		bool bBefore = true;
+		for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+		{
+			if (bEdited[nBuffer] && gapBegin(nStartGap + 1, nBuffer) > nFirst[nBuffer])
+				bBefore = false;
+		}
+		if (!bBefore)
+			break;
+		++nStartGap;
+	}
+	// ..and end them in the first gap ending after the edits
+	int nEndGap = nStartGap;
+	while (nEndGap < nDiffs)
+	{
+		bool bAfter = true;
+		for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+		{
+			if (bEdited[nBuffer] && gapEnd(nEndGap, nBuffer) < nOldEnd[nBuffer])
+				bAfter = false;
+		}
+		if (bAfter)
+			break;
+		++nEndGap;
+	}
+
+	// Keep some unchanged lines of both gaps in compared lines
+	int nSkipStart = gapLength(nStartGap);
+	int nSkipEnd = gapLength(nEndGap);
+	for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+	{
+		if (bEdited[nBuffer])
+		{
+			nSkipStart = (std::min)(nSkipStart, nFirst[nBuffer] - gapBegin(nStartGap, nBuffer));
+			nSkipEnd = (std::min)(nSkipEnd, gapEnd(nEndGap, nBuffer) - nOldEnd[nBuffer]);
+		}
+	}
+	nSkipStart = (std::max)(0, nSkipStart - RescanContextLines);
+	nSkipEnd = (std::max)(0, nSkipEnd - RescanContextLines);
+
+	// Serialize compared lines, [nBegin, nEnd) in real lines of buffers
+	int nBegin[3] = {0}, nEnd[3] = {0};
+	for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+	{
+		nBegin[nBuffer] = gapBegin(nStartGap, nBuffer) + nSkipStart;
+		nEnd[nBuffer] = gapEnd(nEndGap, nBuffer) - nSkipEnd + nDelta[nBuffer];
+		if (nEnd[nBuffer] < nBegin[nBuffer])
+			return false;
+		CDiffTextBuffer & buf = *m_ptBuf[nBuffer];
+		const int nApparentBegin = buf.ComputeApparentLine(nBegin[nBuffer]);
+		const int nApparentEnd = (nEnd[nBuffer] < nRealLines[nBuffer]) ?
+			buf.ComputeApparentLine(nEnd[nBuffer]) : buf.GetLineCount();
+		SaveBuffForDiff(buf, contents[nBuffer], nApparentBegin, nApparentEnd - nApparentBegin);
+	}
+
+	DiffList templist;
+	m_diffWrapper.SetCreateDiffList(&templist);
+	const bool bSuccess = m_diffWrapper.RunFileDiff();
+	m_diffWrapper.SetCreateDiffList(&m_diffList);
+	DIFFSTATUS statusPart;
+	m_diffWrapper.GetDiffStatus(&statusPart);
+	if (!bSuccess || statusPart.bBinaries)
+		return false;
+
+	// Correct the comparison results made by diffutils if compared lines of a file are empty.
+	for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+	{
+		if (nEnd[nBuffer] > nBegin[nBuffer])
+			continue;
+		for (int nDiff = 0; nDiff < templist.GetSize(); ++nDiff)
+		{
+			DIFFRANGE di;
+			templist.GetDiff(nDiff, di);
+			if (di.begin[nBuffer] == 0 && di.end[nBuffer] == 0)
+			{
+				di.end[nBuffer] = -1;
+				templist.SetDiff(nDiff, di);
+			}
+		}
+	}
+
+	// Kept diffs before, new diffs, and kept diffs after moved by edits
+	int nDiff;
+	for (nDiff = 0; nDiff < nStartGap; ++nDiff)
+		m_diffList.AddDiff(*diffList.DiffRangeAt(nDiff));
+	m_diffList.AppendDiffList(templist, nBegin);
+	for (nDiff = nEndGap; nDiff < nDiffs; ++nDiff)
+	{
+		DIFFRANGE di = *diffList.DiffRangeAt(nDiff);
+		for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+		{
+			di.begin[nBuffer] += nDelta[nBuffer];
+			di.end[nBuffer] += nDelta[nBuffer];
+		}
+		m_diffList.AddDiff(di);
+	}
+
+	for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+	{
+		const bool bLastLineCompared = nEnd[nBuffer] > nBegin[nBuffer] && nEnd[nBuffer] == nRealLines[nBuffer];
+		status.bMissingNL[nBuffer] = bLastLineCompared ?
+			statusPart.bMissingNL[nBuffer] : m_bMissingNLOnRescan[nBuffer];
+	}
+	std::copy_n(nBegin, 3, m_nRediffBegin);
+	std::copy_n(nEnd, 3, m_nRediffEnd);
+	std::copy_n(nDelta, 3, m_nRediffDelta);
+	status.bBinaries = false;
+	status.Identical = GetIdentLevel(m_diffList, m_nBuffers);
+	return true;
+}
+
+/**
+ * @brief Remember diff-engine results of a compare.
+ * The next rescan can then compare only the lines edited after this.
+ * @note Must be called before the diff list is adjusted for display.
+ * @sa RescanEditedLines()
+ */
+void CMergeDoc::SaveRescanState(const DIFFSTATUS & status)
+{
+	m_diffListOnRescan.Clear();
+	m_diffListOnRescan.AppendDiffList(m_diffList);
+	for (int nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+	{
+		m_nRealLinesOnRescan[nBuffer] = GetRealLineCount(*m_ptBuf[nBuffer]);
+		m_bMissingNLOnRescan[nBuffer] = status.bMissingNL[nBuffer];
+	}
+	m_sLineFiltersOnRescan = GetLineFiltersString();
+	if (theApp.m_pSubstitutionFiltersList)
+	{
+		if (!m_pSubstitutionFiltersOnRescan)
+			m_pSubstitutionFiltersOnRescan.reset(new SubstitutionFiltersList());
+		m_pSubstitutionFiltersOnRescan->CloneFrom(theApp.m_pSubstitutionFiltersList.get());
+	}
+	else
+	{
+		m_pSubstitutionFiltersOnRescan.reset();
+	}
+	m_bRescanStateValid = true;
+}
+
 void CMergeDoc::CheckFileChanged(void)
 {
 	int nBuffer;
@@ -3099,6 +3416,7 @@ bool CMergeDoc::OpenDocs(int nFiles, const FileLocation ifileloc[],
 	// clear undo stack
 	undoTgt.clear();
 	curUndo = undoTgt.begin();
+	m_bRescanStateValid = false;
 
 	// Prevent displaying views during LoadFile
 	// Note : attach buffer again only if both loads succeed
@@ -3109,7 +3427,7 @@ bool CMergeDoc::OpenDocs(int nFiles, const FileLocation ifileloc[],
 	for (nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
 	{
 		// clear undo buffers
-		m_ptBuf[nBuffer]->m_aUndoBuf.clear();
+		m_ptBuf[nBuffer]->ClearUndoHistory();
 
 		// free the buffers
 		m_ptBuf[nBuffer]->FreeAll ();
@@ -3412,11 +3730,23 @@ void CMergeDoc::RefreshOptions()
 	Options::DiffOptions::Load(GetOptionsMgr(), options);
 
 	m_diffWrapper.SetOptions(&options);
+	m_bRescanStateValid = false;
+	SetUndoMemoryLimit();
 
 	// Refresh view options
 	ForEachView([](auto& pView) { pView->RefreshOptions(); });
 }
 
+/**
+ * @brief Limit memory used by undo history of each buffer.
+ */
+void CMergeDoc::SetUndoMemoryLimit()
+{
+	const size_t nLimit = static_cast<size_t>(GetOptionsMgr()->GetInt(OPT_UNDO_MEMORY_LIMIT)) * 1024 * 1024;
+	for (int nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+		m_ptBuf[nBuffer]->SetUndoMemoryLimit(nLimit);
+}
+
 /**
  * @brief Write path and filename to headerbar
  * @note SetText() does not repaint unchanged text
@@ -3580,6 +3910,7 @@ void CMergeDoc::SwapFiles(int nFromIndex, int nToIndex)
 
 		m_filePaths.Swap(nFromIndex, nToIndex);
 		m_diffList.Swap(nFromIndex, nToIndex);
+		m_bRescanStateValid = false;
 		for (int nGroup = 0; nGroup < m_nGroups; nGroup++)
 			swap(m_pView[nGroup][nFromIndex]->m_piMergeEditStatus, m_pView[nGroup][nToIndex]->m_piMergeEditStatus);
 
@@ -11,15 +11,18 @@
 #pragma once
 
 #include "DiffTextBuffer.h"
+#include <array>
 #include <vector>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include "DiffWrapper.h"
 #include "DiffList.h"
 #include "TempFile.h"
 #include "PathContext.h"
 #include "IMergeDoc.h"
+#include "WordDiff.h"
 
 /**
  * @brief Additional action codes for WinMerge.
@@ -74,28 +77,6 @@ enum class BUFFERTYPE
 	UNNAMED_SAVED, /**< Empty buffer saved with filename */
 };
 
-struct WordDiff {
-	std::array<int, 3> begin; // 0-based, eg, begin[0] is from str1
-	std::array<int, 3> end; // 0-based, eg, end[1] is from str2
-	std::array<int, 3> beginline;
-	std::array<int, 3> endline;
-	int op;
-
-	WordDiff(int s1=0, int e1=0, int bl1=0, int el1=0, int s2=0, int e2=0, int bl2=0, int el2=0, int s3=0, int e3=0, int bl3=0, int el3=0, int op=0)
-		: begin{s1, s2, s3}
-		, beginline{bl1, bl2, bl3}
-		, endline{el1, el2, el3}
-		, op(op)
-	{
-		if (s1>e1) e1=s1;
-		if (s2>e2) e2=s2;
-		if (s3>e3) e3=s3;
-		end[0] = e1;
-		end[1] = e2;
-		end[2] = e3;
-	}
-};
-
 struct CurrentWordDiff
 {
 	int nDiff;
@@ -112,8 +93,10 @@ class PrediffingInfo;
 class CMergeEditFrame;
 class CDirDoc;
 class CEncodingErrorBar;
+class SubstitutionFiltersList;
 class CLocationView;
 class CMergeEditSplitterView;
+class WordDiffPrecomputer;
 
 /**
  * @brief Document class for merging two files
@@ -264,10 +247,28 @@ public:
 	std::vector<WordDiff> GetWordDiffArrayInDiffBlock(int nDiff);
 	std::vector<WordDiff> GetWordDiffArray(int nLineIndex);
 	std::vector<WordDiff> GetWordDiffArrayInRange(const int begin[3], const int end[3], int pane1 = -1, int pane2 = -1);
+	bool GetWordDiffSource(const int begin[3], const int end[3], int pane1, int pane2, WordDiffSource& source) const;
 	void ClearWordDiffCache(int nDiff = -1);
+	void PrecomputeWordDiffs();
+	bool QueueWordDiffJobs();
 private:
 	void Computelinediff(CMergeEditView *pView, CRect rc[], bool bReversed);
-	std::map<int, std::vector<WordDiff> > m_cacheWordDiffs;
+	void KeepWordDiffCache();
+	void RestoreWordDiffCache();
+	/** Word diffs of a diff block kept over a rescan */
+	struct KeptWordDiffs
+	{
+		int dbegin = 0; /**< First line of the block when the word diffs were computed */
+		std::optional<std::vector<WordDiff>> block;
+		std::map<int, std::vector<WordDiff> > lines; /**< By line relative to the block */
+	};
+	std::mutex m_mutexWordDiffCache; /**< Guards the caches, which precomputing threads fill */
+	std::map<int, std::vector<WordDiff> > m_cacheWordDiffs; /**< Word diffs of diff blocks */
+	std::map<std::pair<int, int>, std::vector<WordDiff> > m_cacheLineWordDiffs; /**< Word diffs of lines of blocks diffed per line, by diff and line relative to it */
+	unsigned m_nWordDiffGeneration; /**< Incremented when the caches are cleared, guarded by m_mutexWordDiffCache */
+	std::map<std::array<int, 6>, KeptWordDiffs> m_keptWordDiffs; /**< Cached word diffs of the last compare, by lines of blocks in the files */
+	std::vector<std::pair<int, int> > m_wordDiffJobsToCopy; /**< Diffs and lines of blocks to precompute word diffs of */
+	std::unique_ptr<WordDiffPrecomputer> m_pWordDiffPrecomputer; /**< Must be destroyed before the caches */
 // End MergeDocLineDiffs.cpp
 
 // Implementation in MergeDocEncoding.cpp
@@ -332,6 +333,9 @@ private:
 	void SanityCheckCodepage(FileLocation & fileinfo);
 	DWORD LoadOneFile(int index, const String& filename, bool readOnly, const String& strDesc, const FileTextEncoding & encoding);
 	void SetTableProperties();
+	bool RescanEditedLines(FileContents contents[], DIFFSTATUS & status);
+	void SaveRescanState(const DIFFSTATUS & status);
+	void SetUndoMemoryLimit();
 
 // Implementation data
 protected:
@@ -349,6 +353,16 @@ protected:
 	String m_strDesc[3]; /**< Left/Middle/Right side description text */
 	BUFFERTYPE m_nBufferType[3];
 	bool m_bEditAfterRescan[3]; /**< Left/middle/right doc edited after rescanning */
+	DiffList m_diffListOnRescan; /**< Diff-engine results of the last compare, before adjusting */
+	int m_nRealLinesOnRescan[3]; /**< Real line counts of buffers at the last compare */
+	bool m_bMissingNLOnRescan[3]; /**< EOL status of buffers at the last compare */
+	bool m_bRescanStateValid; /**< Can the last compare be updated with edited lines only? */
+	bool m_bRediffedEditedLines; /**< Did the last compare update the one before with edited lines only? */
+	int m_nRediffBegin[3]; /**< First real line compared again by the last compare */
+	int m_nRediffEnd[3]; /**< End of real lines compared again by the last compare */
+	int m_nRediffDelta[3]; /**< Real lines added by edits before the last compare */
+	String m_sLineFiltersOnRescan; /**< Line filters used in the last compare */
+	std::unique_ptr<SubstitutionFiltersList> m_pSubstitutionFiltersOnRescan; /**< Substitution filters used in the last compare */
 	TempFile m_tempFiles[3]; /**< Temp files for compared files */
 	int m_nDiffContext;
 	bool m_bInvertDiffContext;
@@ -427,10 +441,6 @@ private:
 	void HideLines();
 	void AdjustDiffBlocks();
 	void AdjustDiffBlocks3way();
-	void AdjustDiffBlock(DiffMap & diffmap, const DIFFRANGE & diffrange,
-		const std::vector<WordDiff>& worddiffs,
-		int i0, int i1, int lo0, int hi0, int lo1, int hi1);
-	int GetMatchCost(const DIFFRANGE& dr, int i0, int i1, int line0, int line1, const std::vector<WordDiff>& worddiffs);
 	OP_TYPE ComputeOpType3way(const std::vector<std::array<int, 3>>& vlines, size_t index,
 		const DIFFRANGE& diffrange, const DIFFOPTIONS& diffOptions);
 	void FlagTrivialLines();
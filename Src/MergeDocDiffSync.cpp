@@ -7,6 +7,9 @@
 
 #include "StdAfx.h"
 #include <vector>
+#include <algorithm>
+#include <execution>
+#include <cstdint>
 #include "MergeDoc.h"
 
 #include "Merge.h"
@@ -238,6 +241,41 @@ CreateVirtualLineToRealLineMap3way(
 	return vlines;
 }
 
+/**
+ * @brief Map lines of pane i0 to lines of pane i1 in a diff block, as best we can
+ *
+ * Lines are aligned by the match lengths built from the word diffs. Lines
+ * between aligned lines are mapped 1:1 from the top, and lines left over
+ * in pane i0 become ghost lines in pane i1.
+ * @param [in] pSource Text of the block, nullptr if it was not available
+ */
+static void
+AdjustDiffBlock(DiffMap & diffmap, int nlines0, int nlines1, const WordDiffSource *pSource,
+	const std::vector<WordDiff>& worddiffs, int i0, int i1)
+{
+	std::vector<std::pair<int, int>> aligned;
+	if (pSource != nullptr && nlines0 > 0 && nlines1 > 0)
+		aligned = GetAlignedLines(GetLineMatches(*pSource, worddiffs, i0, i1), nlines1);
+
+	auto mapLines = [&diffmap](int lo0, int hi0, int lo1, int hi1)
+	{
+		for (int line0 = lo0; line0 < hi0; ++line0)
+		{
+			const int line1 = lo1 + line0 - lo0;
+			diffmap.m_map[line0] = (line1 < hi1) ? line1 : DiffMap::GHOST_MAP_ENTRY;
+		}
+	};
+	int line0 = 0, line1 = 0;
+	for (const auto& pair : aligned)
+	{
+		mapLines(line0, pair.first, line1, pair.second);
+		diffmap.m_map[pair.first] = pair.second;
+		line0 = pair.first + 1;
+		line1 = pair.second + 1;
+	}
+	mapLines(line0, nlines0, line1, nlines1);
+}
+
 OP_TYPE CMergeDoc::ComputeOpType3way(
 	const std::vector<std::array<int, 3>>& vlines, size_t index,
 	const DIFFRANGE& diffrange, const DIFFOPTIONS& diffOptions)
@@ -327,33 +365,65 @@ OP_TYPE CMergeDoc::ComputeOpType3way(
  */
 void CMergeDoc::AdjustDiffBlocks()
 {
+	const size_t ParallelAdjustBlocks = 16;
 	int nDiff;
 	int nDiffCount = m_diffList.GetSize();
 
-	// Go through and do our best to line up lines within each diff block
-	// between left side and right side
-	DiffList newDiffList;
-	newDiffList.Clear();
+	// Copy text of the blocks, so their lines can be aligned in parallel
+	struct Block
+	{
+		int nDiff;
+		bool bSource; /**< Is source valid? */
+		WordDiffSource source;
+		std::vector<std::array<int, 2>> vlines;
+	};
+	std::vector<Block> blocks;
 	for (nDiff = 0; nDiff < nDiffCount; nDiff++)
 	{
 		const DIFFRANGE & diffrange = *m_diffList.DiffRangeAt(nDiff);
+		if (diffrange.end[0] >= diffrange.begin[0] && diffrange.end[1] >= diffrange.begin[1])
+		{
+			blocks.emplace_back();
+			Block& block = blocks.back();
+			block.nDiff = nDiff;
+			block.bSource = GetWordDiffSource(diffrange.begin, diffrange.end, 0, 1, block.source);
+		}
+	}
+
+	auto align = [this](Block& block)
+	{
+		const DIFFRANGE & diffrange = *m_diffList.DiffRangeAt(block.nDiff);
 		// size map correctly (it will hold one entry for each left-side line
 		int nlines0 = diffrange.end[0] - diffrange.begin[0] + 1;
 		int nlines1 = diffrange.end[1] - diffrange.begin[1] + 1;
-		if (nlines0>0 && nlines1>0)
-		{
-			// Call worker to do all lines in block
-			int lo0 = 0, hi0 = nlines0-1;
-			int lo1 = 0, hi1 = nlines1-1;
-			const std::vector<WordDiff> worddiffs = GetWordDiffArrayInRange(diffrange.begin, diffrange.end);
+		const std::vector<WordDiff> worddiffs = block.bSource ? block.source.Compute() : std::vector<WordDiff>();
 #ifdef _DEBUG
-			PrintWordDiffList(2, worddiffs);
+		PrintWordDiffList(2, worddiffs);
 #endif
-			DiffMap diffmap;
-			diffmap.InitDiffMap(nlines0);
-			AdjustDiffBlock(diffmap, diffrange, worddiffs, 0, 1, lo0, hi0, lo1, hi1);
-			ValidateDiffMap(diffmap);
-			std::vector<std::array<int, 2>> vlines = CreateVirtualLineToRealLineMap(diffmap, nlines0, nlines1);
+		DiffMap diffmap;
+		diffmap.InitDiffMap(nlines0);
+		AdjustDiffBlock(diffmap, nlines0, nlines1, block.bSource ? &block.source : nullptr, worddiffs, 0, 1);
+		ValidateDiffMap(diffmap);
+		block.vlines = CreateVirtualLineToRealLineMap(diffmap, nlines0, nlines1);
+		// Release the copied text
+		block.source = WordDiffSource();
+	};
+	if (blocks.size() >= ParallelAdjustBlocks)
+		std::for_each(std::execution::par, blocks.begin(), blocks.end(), align);
+	else
+		std::for_each(blocks.begin(), blocks.end(), align);
+
+	// Go through and do our best to line up lines within each diff block
+	// between left side and right side
+	DiffList newDiffList;
+	newDiffList.Clear();
+	auto itBlock = blocks.begin();
+	for (nDiff = 0; nDiff < nDiffCount; nDiff++)
+	{
+		const DIFFRANGE & diffrange = *m_diffList.DiffRangeAt(nDiff);
+		if (itBlock != blocks.end() && itBlock->nDiff == nDiff)
+		{
+			const std::vector<std::array<int, 2>>& vlines = (itBlock++)->vlines;
 
 			// divide diff blocks
 			int line0 = 0, line1 = 0;
@@ -440,40 +510,71 @@ void CMergeDoc::AdjustDiffBlocks()
  */
 void CMergeDoc::AdjustDiffBlocks3way()
 {
+	const size_t ParallelAdjustBlocks = 16;
 	int nDiff;
 	int nDiffCount = m_diffList.GetSize();
 
-	// Go through and do our best to line up lines within each diff block
-	// between left side and right side
-	DiffList newDiffList;
-	newDiffList.Clear();
+	// Copy text of the blocks, so their lines can be aligned in parallel
+	struct Block
+	{
+		int nDiff;
+		bool bSource[3]; /**< Is source of pane pair valid? */
+		WordDiffSource source[3]; /**< Panes 0-1, 1-2 and 2-0 */
+		std::vector<std::array<int, 3>> vlines;
+	};
+	std::vector<Block> blocks;
 	for (nDiff = 0; nDiff < nDiffCount; nDiff++)
 	{
 		const DIFFRANGE & diffrange = *m_diffList.DiffRangeAt(nDiff);
-		// size map correctly (it will hold one entry for each left-side line
 		int nlines0 = diffrange.end[0] - diffrange.begin[0] + 1;
 		int nlines1 = diffrange.end[1] - diffrange.begin[1] + 1;
 		int nlines2 = diffrange.end[2] - diffrange.begin[2] + 1;
 		if ((nlines0 > 0) + (nlines1 > 0) + (nlines2 > 0) > 1)
 		{
-			// Call worker to do all lines in block
-			int lo0 = 0, hi0 = nlines0 - 1;
-			int lo1 = 0, hi1 = nlines1 - 1;
-			int lo2 = 0, hi2 = nlines2 - 1;
-			const std::vector<WordDiff> worddiffs01 = GetWordDiffArrayInRange(diffrange.begin, diffrange.end, 0, 1);
-			const std::vector<WordDiff> worddiffs12 = GetWordDiffArrayInRange(diffrange.begin, diffrange.end, 1, 2);
-			const std::vector<WordDiff> worddiffs20 = GetWordDiffArrayInRange(diffrange.begin, diffrange.end, 2, 0);
-			DiffMap diffmap01, diffmap12, diffmap20;
-			diffmap01.InitDiffMap(nlines0);
-			diffmap12.InitDiffMap(nlines1);
-			diffmap20.InitDiffMap(nlines2);
-			AdjustDiffBlock(diffmap01, diffrange, worddiffs01, 0, 1, lo0, hi0, lo1, hi1);
-			AdjustDiffBlock(diffmap12, diffrange, worddiffs12, 1, 2, lo1, hi1, lo2, hi2);
-			AdjustDiffBlock(diffmap20, diffrange, worddiffs20, 2, 0, lo2, hi2, lo0, hi0);
-			ValidateDiffMap(diffmap01);
-			ValidateDiffMap(diffmap12);
-			ValidateDiffMap(diffmap20);
-			std::vector<std::array<int, 3>> vlines = CreateVirtualLineToRealLineMap3way(diffmap01, diffmap12, diffmap20, nlines0, nlines1, nlines2);
+			blocks.emplace_back();
+			Block& block = blocks.back();
+			block.nDiff = nDiff;
+			for (int i = 0; i < 3; ++i)
+				block.bSource[i] = GetWordDiffSource(diffrange.begin, diffrange.end, i, (i + 1) % 3, block.source[i]);
+		}
+	}
+
+	auto align = [this](Block& block)
+	{
+		const DIFFRANGE & diffrange = *m_diffList.DiffRangeAt(block.nDiff);
+		// size map correctly (it will hold one entry for each left-side line
+		int nlines[3];
+		for (int i = 0; i < 3; ++i)
+			nlines[i] = diffrange.end[i] - diffrange.begin[i] + 1;
+		DiffMap diffmap[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			const int i0 = i, i1 = (i + 1) % 3;
+			const std::vector<WordDiff> worddiffs = block.bSource[i] ? block.source[i].Compute() : std::vector<WordDiff>();
+			diffmap[i].InitDiffMap(nlines[i0]);
+			AdjustDiffBlock(diffmap[i], nlines[i0], nlines[i1], block.bSource[i] ? &block.source[i] : nullptr, worddiffs, i0, i1);
+			ValidateDiffMap(diffmap[i]);
+			// Release the copied text
+			block.source[i] = WordDiffSource();
+		}
+		block.vlines = CreateVirtualLineToRealLineMap3way(diffmap[0], diffmap[1], diffmap[2], nlines[0], nlines[1], nlines[2]);
+	};
+	if (blocks.size() >= ParallelAdjustBlocks)
+		std::for_each(std::execution::par, blocks.begin(), blocks.end(), align);
+	else
+		std::for_each(blocks.begin(), blocks.end(), align);
+
+	// Go through and do our best to line up lines within each diff block
+	// between left side and right side
+	DiffList newDiffList;
+	newDiffList.Clear();
+	auto itBlock = blocks.begin();
+	for (nDiff = 0; nDiff < nDiffCount; nDiff++)
+	{
+		const DIFFRANGE & diffrange = *m_diffList.DiffRangeAt(nDiff);
+		if (itBlock != blocks.end() && itBlock->nDiff == nDiff)
+		{
+			const std::vector<std::array<int, 3>>& vlines = (itBlock++)->vlines;
 
 			DIFFOPTIONS diffOptions = {0};
 			m_diffWrapper.GetOptions(&diffOptions);
@@ -673,202 +774,3 @@ void CMergeDoc::AdjustDiffBlocks3way()
 	for (nDiff = 0; nDiff < nDiffCount; nDiff++)
 		m_diffList.AddDiff(*newDiffList.DiffRangeAt(nDiff));
 }
-
-/**
- * @brief Return cost of making strings equal
- *
- * The cost of making them equal is the measure of their dissimilarity
- * which is their Levenshtein distance.
- */
-int CMergeDoc::GetMatchCost(const DIFFRANGE& dr, int i0, int i1, int line0, int line1, const std::vector<WordDiff>& worddiffs)
-{
-	int matchlen = 0;
-	WordDiff dummyWordDiff(0, 0, dr.begin[0], dr.begin[0], 0, 0, dr.begin[1], dr.begin[1]);
-	WordDiff& prevWordDiff = dummyWordDiff;
-	for (size_t i = 0; i < worddiffs.size(); ++i)
-	{
-		if ((prevWordDiff.endline[0] <= line0 && line0 <= worddiffs[i].beginline[0]) &&
-		    (prevWordDiff.endline[1] <= line1 && line1 <= worddiffs[i].beginline[1]))
-		{
-			if (line0 == worddiffs[i].beginline[0])
-			{
-				if (prevWordDiff.endline[0] == line0)
-					matchlen += worddiffs[i].begin[0] - prevWordDiff.end[0];
-				else
-					matchlen += worddiffs[i].begin[0];
-			}
-			else /* line0 < worddiffs[i].beginline[0] */
-			{
-				if (prevWordDiff.endline[0] == line0)
-					matchlen += m_ptBuf[i0]->GetFullLineLength(line0) - prevWordDiff.end[0];
-				else
-					matchlen += m_ptBuf[i0]->GetFullLineLength(line0);
-			}
-		}
-		prevWordDiff = worddiffs[i];
-	}
-	if (worddiffs.empty())
-	{
-		matchlen += m_ptBuf[i0]->GetFullLineLength(line0);
-	}
-	else
-	{
-		if (prevWordDiff.endline[0] <= line0 && prevWordDiff.endline[1] <= line1)
-		{
-			if (prevWordDiff.endline[0] == line0)
-				matchlen += m_ptBuf[i0]->GetFullLineLength(line0) - prevWordDiff.end[0];
-			else
-				matchlen += m_ptBuf[i0]->GetFullLineLength(line0);
-		}
-	}
-/*
-#ifdef _DEBUG
-	String str = strutils::format(_T("pane%d,%d line%5d,%5d match len: %d\n"), i0, i1, line0, line1, matchlen);
-	OutputDebugString(str.c_str());
-#endif
-*/
-	return -matchlen;
-}
-
-/**
- * @brief Map lines from left to right for specified range in diff block, as best we can
- * Map left side range [lo0;hi0] to right side range [lo1;hi1]
- * (ranges include ends)
- *
- * Algorithm:
- * Find best match, and use that to split problem into two parts (above & below match)
- * and call ourselves recursively to solve each smaller problem
- */
-void CMergeDoc::AdjustDiffBlock(DiffMap & diffMap, const DIFFRANGE & diffrange, const std::vector<WordDiff>& worddiffs, int i0, int i1, int lo0, int hi0, int lo1, int hi1)
-{
-	// Map & lo & hi numbers are all relative to this block
-	// We need to know offsets to find actual line strings from buffer
-	int offset0 = diffrange.begin[i0];
-	int offset1 = diffrange.begin[i1];
-
-	// # of lines on left and right
-	int lines0 = hi0 - lo0 + 1;
-	int lines1 = hi1 - lo1 + 1;
-
-	// shortcut special case
-	if (lines0 == 0)
-	{
-		return;
-	}
-	if (lines1 == 0)
-	{
-		for (int w=0; w<lines0; ++w)
-			diffMap.m_map[w] = DiffMap::GHOST_MAP_ENTRY;
-		return;
-	}
-	if (lines0 == 1 && lines1 == 1)
-	{
-		diffMap.m_map[lo0] = hi1;
-		return;
-	}
-
-	// Bail out if range is large
-	auto tooManyCharacters = [&](int pane, int start, int end)
-	{
-		size_t charCount = 0;
-		const int charCountMax = 4096;
-		for (int i = start; i <= end; ++i)
-		{
-			charCount += m_ptBuf[pane]->GetLineLength(i);
-			if (charCount > charCountMax)
-				return true;
-		}
-		return false;
-	};
-	if (tooManyCharacters(i0, offset0 + lo0, offset0 + hi0) || tooManyCharacters(i1, offset1 + lo1, offset1 + hi1))
-	{
-		// Do simple 1:1 mapping
-		// but try to stay within original block
-		// Cannot be outside both sides, so just test for outside one side
-		int tlo=0, thi=0;
-		if (lo1 < 0)
-		{
-			// right side is off the bottom
-			// so put it as close to bottom as possible
-			tlo = hi1 - (hi0-lo0);
-			thi = hi1;
-		}
-		else
-		{
-			// put it as close to top as possible
-			tlo = lo1;
-			thi = lo1 + (hi0-lo0);
-		}
-
-		for (int w=0; w<lines0; ++w)
-		{
-			if (w < lines1)
-				diffMap.m_map[w] = w + tlo;
-			else
-				diffMap.m_map[w] = DiffMap::GHOST_MAP_ENTRY;
-		}
-		return;
-	}
-
-	// Find best fit
-	int ibest=-1, isavings=0x7fffffff, itarget=-1;
-	for (int i=lo0; i<=hi0; ++i)
-	{
-		for (int j=lo1; j<=hi1; ++j)
-		{
-			int savings = GetMatchCost(diffrange, i0, i1, offset0 + i, offset1 + j, worddiffs);
-			// TODO
-			// Need to penalize assignments that push us outside the box
-			// further than is required
-			if (savings < isavings)
-			{
-				ibest = i;
-				itarget = j;
-				isavings = savings;
-			}
-		}
-	}
-	// I think we have to find at least one
-	// because cost (Levenshtein distance) is less than or equal to maxlen
-	// so cost is always nonnegative
-	ASSERT(ibest >= 0);
-
-	ASSERT(diffMap.m_map[ibest] == DiffMap::BAD_MAP_ENTRY);
-
-	diffMap.m_map[ibest] = itarget;
-
-	// Half of the remaining problem is below our match
-	if (lo0 < ibest)
-	{
-		if (lo1 < itarget)
-		{
-			AdjustDiffBlock(diffMap, diffrange, worddiffs, i0, i1, lo0, ibest-1, lo1, itarget-1);
-		}
-		else
-		{
-			// No target space for the ones below our match
-			for (int x = lo0; x < ibest; ++x)
-			{
-				diffMap.m_map[x] = DiffMap::GHOST_MAP_ENTRY;
-			}
-		}
-	}
-
-	// Half of the remaining problem is above our match
-	if (hi0 > ibest)
-	{
-		if (itarget < hi1)
-		{
-			AdjustDiffBlock(diffMap, diffrange, worddiffs, i0, i1, ibest + 1, hi0,
-					itarget + 1, hi1);
-		}
-		else
-		{
-			// No target space for the ones above our match
-			for (int x = ibest + 1; x <= hi0; ++x)
-			{
-				diffMap.m_map[x] = DiffMap::GHOST_MAP_ENTRY;
-			}
-		}
-	}
-}
@@ -9,12 +9,16 @@
 #include "MergeDoc.h"
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include "MergeEditView.h"
 #include "DiffTextBuffer.h"
 #include "stringdiffs.h"
 #include "UnicodeString.h"
 #include "SubstitutionFiltersList.h"
 #include "Merge.h"
+#include "WordDiffPrecomputer.h"
+#include "OptionsDef.h"
+#include "OptionsMgr.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -305,16 +309,278 @@ void CMergeDoc::ClearWordDiffCache(int nDiff/* = -1 */)
 {
 	if (nDiff == -1)
 	{
+		// Don't wait for word diffs being precomputed, they may take long for
+		// big blocks. Their results are dropped as the generation changes.
+		if (m_pWordDiffPrecomputer)
+			m_pWordDiffPrecomputer->Clear();
+		m_wordDiffJobsToCopy.clear();
+		m_keptWordDiffs.clear();
+
+		std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
+		++m_nWordDiffGeneration;
 		m_cacheWordDiffs.clear();
+		m_cacheLineWordDiffs.clear();
 	}
 	else
 	{
+		std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
 		std::map<int, std::vector<WordDiff> >::iterator it = m_cacheWordDiffs.find(nDiff);
 		if (it != m_cacheWordDiffs.end())
 			m_cacheWordDiffs.erase(it);
+		m_cacheLineWordDiffs.erase(m_cacheLineWordDiffs.lower_bound({ nDiff, 0 }),
+			m_cacheLineWordDiffs.lower_bound({ nDiff + 1, 0 }));
 	}
 }
 
+/**
+ * @brief Return the lines of a diff block in the files, which don't change
+ * when ghost lines are added or removed around it.
+ */
+static std::array<int, 6> GetBlockLines(const DIFFRANGE& dr)
+{
+	return { dr.begin[0], dr.begin[1], dr.begin[2], dr.end[0], dr.end[1], dr.end[2] };
+}
+
+/**
+ * @brief Clear the word diff caches, keeping their contents for the blocks
+ * of the next compare the edits didn't change, see RestoreWordDiffCache().
+ * Must be called before the diff list is cleared for a rescan.
+ */
+void CMergeDoc::KeepWordDiffCache()
+{
+	std::map<std::array<int, 6>, KeptWordDiffs> keptWordDiffs;
+	{
+		std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
+		const int nDiffs = m_diffList.GetSize();
+		for (auto& [nDiff, worddiffs] : m_cacheWordDiffs)
+		{
+			if (nDiff >= nDiffs)
+				continue;
+			const DIFFRANGE *dr = m_diffList.DiffRangeAt(nDiff);
+			KeptWordDiffs& kept = keptWordDiffs[GetBlockLines(*dr)];
+			kept.dbegin = dr->dbegin;
+			kept.block = std::move(worddiffs);
+		}
+		for (auto& [key, worddiffs] : m_cacheLineWordDiffs)
+		{
+			if (key.first >= nDiffs)
+				continue;
+			const DIFFRANGE *dr = m_diffList.DiffRangeAt(key.first);
+			KeptWordDiffs& kept = keptWordDiffs[GetBlockLines(*dr)];
+			kept.dbegin = dr->dbegin;
+			kept.lines.emplace(key.second, std::move(worddiffs));
+		}
+	}
+	ClearWordDiffCache();
+	m_keptWordDiffs = std::move(keptWordDiffs);
+}
+
+/**
+ * @brief Put back the word diffs kept by KeepWordDiffCache() for the blocks
+ * outside the lines compared again. Their text is the same as in the last
+ * compare, but ghost lines before them may have moved them.
+ */
+void CMergeDoc::RestoreWordDiffCache()
+{
+	std::map<std::array<int, 6>, KeptWordDiffs> keptWordDiffs = std::move(m_keptWordDiffs);
+	m_keptWordDiffs.clear();
+	if (!m_bRediffedEditedLines || keptWordDiffs.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
+	const int nDiffs = m_diffList.GetSize();
+	for (int nDiff = 0; nDiff < nDiffs; ++nDiff)
+	{
+		DIFFRANGE dr = *m_diffList.DiffRangeAt(nDiff);
+		bool bBefore = true, bAfter = true;
+		for (int nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+		{
+			bBefore = bBefore && dr.end[nBuffer] < m_nRediffBegin[nBuffer];
+			bAfter = bAfter && dr.begin[nBuffer] >= m_nRediffEnd[nBuffer];
+		}
+		if (!bBefore && !bAfter)
+			continue;
+		if (bAfter)
+		{
+			for (int nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+			{
+				dr.begin[nBuffer] -= m_nRediffDelta[nBuffer];
+				dr.end[nBuffer] -= m_nRediffDelta[nBuffer];
+			}
+		}
+		auto it = keptWordDiffs.find(GetBlockLines(dr));
+		if (it == keptWordDiffs.end())
+			continue;
+		KeptWordDiffs& kept = it->second;
+		const int nMoved = dr.dbegin - kept.dbegin;
+		auto shift = [this, nMoved](std::vector<WordDiff>& worddiffs)
+		{
+			for (auto& worddiff : worddiffs)
+			{
+				for (int nBuffer = 0; nBuffer < m_nBuffers; nBuffer++)
+				{
+					worddiff.beginline[nBuffer] += nMoved;
+					worddiff.endline[nBuffer] += nMoved;
+				}
+			}
+			return std::move(worddiffs);
+		};
+		if (kept.block)
+			m_cacheWordDiffs.emplace(nDiff, shift(*kept.block));
+		for (auto& [nLine, worddiffs] : kept.lines)
+			m_cacheLineWordDiffs.emplace(std::make_pair(nDiff, nLine), shift(worddiffs));
+	}
+}
+
+/**
+ * @brief Start computing word diffs of the diff blocks in worker threads.
+ * The word diffs of blocks not changed by the edits are kept from the last
+ * compare. The text of the other blocks is copied a batch at a time by
+ * QueueWordDiffJobs(), which the active view calls on a timer until all are
+ * copied, so the word diffs are usually cached before the blocks are painted.
+ */
+void CMergeDoc::PrecomputeWordDiffs()
+{
+	m_wordDiffJobsToCopy.clear();
+	if (!GetOptionsMgr()->GetBool(OPT_WORDDIFF_HIGHLIGHT))
+	{
+		m_keptWordDiffs.clear();
+		return;
+	}
+	RestoreWordDiffCache();
+
+	const bool bTableEditing = m_ptBuf[0]->GetTableEditing();
+	const int nDiffs = m_diffList.GetSize();
+	{
+		std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
+		for (int nDiff = 0; nDiff < nDiffs; ++nDiff)
+		{
+			DIFFRANGE cd;
+			m_diffList.GetDiff(nDiff, cd);
+			// Views don't highlight words of blocks with less than two sides
+			int unemptyLineCount = 0;
+			for (int nPane = 0; nPane < m_nBuffers; nPane++)
+			{
+				if (cd.begin[nPane] != cd.end[nPane] + 1)
+					unemptyLineCount++;
+			}
+			if (unemptyLineCount < 2)
+				continue;
+
+			if (!IsDiffPerLine(bTableEditing, cd))
+			{
+				if (m_cacheWordDiffs.find(nDiff) == m_cacheWordDiffs.end())
+					m_wordDiffJobsToCopy.emplace_back(nDiff, -1);
+			}
+			else
+			{
+				for (int nLine = cd.dbegin; nLine <= cd.dend; ++nLine)
+				{
+					if (m_cacheLineWordDiffs.find({ nDiff, nLine - cd.dbegin }) == m_cacheLineWordDiffs.end())
+						m_wordDiffJobsToCopy.emplace_back(nDiff, nLine);
+				}
+			}
+		}
+	}
+
+	if (!m_pWordDiffPrecomputer)
+	{
+		m_pWordDiffPrecomputer.reset(new WordDiffPrecomputer(
+			[this](const WordDiffPrecomputer::Job& job, std::vector<WordDiff>&& worddiffs)
+			{
+				std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
+				if (job.nGeneration != m_nWordDiffGeneration)
+					return;
+				if (job.nLine == -1)
+					m_cacheWordDiffs.emplace(job.nDiff, std::move(worddiffs));
+				else
+					m_cacheLineWordDiffs.emplace(std::make_pair(job.nDiff, job.nLine), std::move(worddiffs));
+			}, WordDiffPrecomputer::GetWorkerCount()));
+	}
+	if (QueueWordDiffJobs())
+		GetActiveMergeView()->StartWordDiffTimer();
+}
+
+/**
+ * @brief Copy the text of the next diff blocks to precompute word diffs of.
+ * About a screen of lines nearest to the lines shown in the active view is
+ * copied, and only when the workers have run out of jobs, so the text of big
+ * files is not copied in one go.
+ * @return true if there are blocks left to copy
+ */
+bool CMergeDoc::QueueWordDiffJobs()
+{
+	// The diff list doesn't match edited text until the next rescan
+	if (IsEditedAfterRescan())
+		m_wordDiffJobsToCopy.clear();
+	if (m_wordDiffJobsToCopy.empty())
+		return false;
+	if (m_pWordDiffPrecomputer->GetQueuedCount() >= static_cast<size_t>(m_pWordDiffPrecomputer->GetWorkers()))
+		return true;
+
+	CMergeEditView *pView = GetActiveMergeView();
+	const int nScreenLines = (std::max)(pView->GetScreenLines(), 1);
+	const int nTopLine = pView->GetTopLine();
+	const int nBottomLine = nTopLine + nScreenLines;
+	auto getLines = [this](const std::pair<int, int>& job, int& nLineBegin, int& nLineEnd)
+	{
+		const DIFFRANGE *dr = m_diffList.DiffRangeAt(job.first);
+		nLineBegin = job.second == -1 ? dr->dbegin : job.second;
+		nLineEnd = job.second == -1 ? dr->dend : job.second;
+	};
+	auto distance = [&](const std::pair<int, int>& job)
+	{
+		int nLineBegin, nLineEnd;
+		getLines(job, nLineBegin, nLineEnd);
+		if (nLineEnd < nTopLine)
+			return nTopLine - nLineEnd;
+		if (nLineBegin > nBottomLine)
+			return nLineBegin - nBottomLine;
+		return 0;
+	};
+	// The view may have scrolled since the last batch, so take the nearest
+	// blocks from the back
+	std::vector<std::pair<int, std::pair<int, int> > > sorted;
+	sorted.reserve(m_wordDiffJobsToCopy.size());
+	for (const auto& job : m_wordDiffJobsToCopy)
+		sorted.emplace_back(distance(job), job);
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const auto& a, const auto& b) { return a.first > b.first; });
+	for (size_t i = 0; i < sorted.size(); ++i)
+		m_wordDiffJobsToCopy[i] = sorted[i].second;
+
+	unsigned nGeneration;
+	{
+		std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
+		nGeneration = m_nWordDiffGeneration;
+	}
+	std::vector<WordDiffPrecomputer::Job> jobs;
+	int nCopiedLines = 0;
+	while (!m_wordDiffJobsToCopy.empty() && nCopiedLines < nScreenLines)
+	{
+		const std::pair<int, int> job = m_wordDiffJobsToCopy.back();
+		m_wordDiffJobsToCopy.pop_back();
+		int nLineBegin[3]{}, nLineEnd[3]{};
+		getLines(job, nLineBegin[0], nLineEnd[0]);
+		const int nLine = job.second == -1 ? -1 : job.second - m_diffList.DiffRangeAt(job.first)->dbegin;
+		{
+			// Painting may have computed it meanwhile
+			std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
+			if (nLine == -1 ? m_cacheWordDiffs.find(job.first) != m_cacheWordDiffs.end() :
+				m_cacheLineWordDiffs.find({ job.first, nLine }) != m_cacheLineWordDiffs.end())
+				continue;
+		}
+		std::fill_n(nLineBegin + 1, m_nBuffers - 1, nLineBegin[0]);
+		std::fill_n(nLineEnd + 1, m_nBuffers - 1, nLineEnd[0]);
+		WordDiffPrecomputer::Job copied{ job.first, nLine, nGeneration };
+		if (GetWordDiffSource(nLineBegin, nLineEnd, -1, -1, copied.source))
+			jobs.push_back(std::move(copied));
+		nCopiedLines += nLineEnd[0] - nLineBegin[0] + 1;
+	}
+	m_pWordDiffPrecomputer->Add(std::move(jobs));
+	return !m_wordDiffJobsToCopy.empty();
+}
+
 std::vector<WordDiff> CMergeDoc::GetWordDiffArrayInDiffBlock(int nDiff)
 {
 	DIFFRANGE cd;
@@ -335,104 +601,68 @@ std::vector<WordDiff> CMergeDoc::GetWordDiffArrayInDiffBlock(int nDiff)
 
 std::vector<WordDiff>
 CMergeDoc::GetWordDiffArrayInRange(const int begin[3], const int end[3], int pane1/*=-1*/, int pane2/*=-1*/)
+{
+	WordDiffSource source;
+	if (!GetWordDiffSource(begin, end, pane1, pane2, source))
+		return std::vector<WordDiff>();
+	return source.Compute();
+}
+
+/**
+ * @brief Copy text and options needed to compute word diffs of lines
+ * @return false if the lines are not in the buffers
+ */
+bool CMergeDoc::GetWordDiffSource(const int begin[3], const int end[3], int pane1, int pane2, WordDiffSource& source) const
 {
 	DIFFOPTIONS diffOptions = {0};
 	m_diffWrapper.GetOptions(&diffOptions);
-	String str[3];
-	std::unique_ptr<int[]> nOffsets[3];
-	std::vector<WordDiff> worddiffs;
-	std::vector<int> panes;
 	if (pane1 == -1 && pane2 == -1)
-		panes = (m_nBuffers == 2) ? std::vector<int>{0, 1} : std::vector<int>{ 0, 1, 2 };
+	{
+		source.nPanes = m_nBuffers;
+		for (int i = 0; i < m_nBuffers; ++i)
+			source.panes[i] = i;
+	}
 	else
-		panes = std::vector<int>{ pane1, pane2 };
-	for (size_t i = 0; i < panes.size(); ++i)
 	{
-		int file = panes[i];
+		source.nPanes = 2;
+		source.panes[0] = pane1;
+		source.panes[1] = pane2;
+	}
+	for (int i = 0; i < source.nPanes; ++i)
+	{
+		int file = source.panes[i];
 		int nLineBegin = begin[file];
 		int nLineEnd = end[file];
 		if (nLineEnd >= m_ptBuf[file]->GetLineCount())
-			return worddiffs;
-		nOffsets[file].reset(new int[nLineEnd - nLineBegin + 1]);
+			return false;
+		source.begin[file] = nLineBegin;
+		source.end[file] = nLineEnd;
+		source.lineCount[file] = m_ptBuf[file]->GetLineCount();
+		source.offsets[file].resize(nLineEnd - nLineBegin + 1);
+		source.lineLengths[file].resize(nLineEnd - nLineBegin + 1);
 		CString strText;
 		if (nLineBegin <= nLineEnd)
 		{
 			if (nLineBegin != nLineEnd || m_ptBuf[file]->GetLineLength(nLineEnd) > 0)
 				m_ptBuf[file]->GetTextWithoutEmptys(nLineBegin, 0, nLineEnd, m_ptBuf[file]->GetLineLength(nLineEnd), strText);
 			strText += m_ptBuf[file]->GetLineEol(nLineEnd);
-			nOffsets[file][0] = 0;
+			source.offsets[file][0] = 0;
 		}
-		str[i].assign(strText, strText.GetLength());
+		source.str[i].assign(strText, strText.GetLength());
 		for (int nLine = nLineBegin; nLine < nLineEnd; nLine++)
-			nOffsets[file][nLine-nLineBegin+1] = nOffsets[file][nLine-nLineBegin] + m_ptBuf[file]->GetFullLineLength(nLine);
+			source.offsets[file][nLine-nLineBegin+1] = source.offsets[file][nLine-nLineBegin] + m_ptBuf[file]->GetFullLineLength(nLine);
+		for (int nLine = nLineBegin; nLine <= nLineEnd; nLine++)
+			source.lineLengths[file][nLine-nLineBegin] = m_ptBuf[file]->GetLineLength(nLine);
 	}
 
 	// Options that affect comparison
-	bool casitive = !diffOptions.bIgnoreCase;
-	bool eolSensitive = !diffOptions.bIgnoreEol;
-	int xwhite = diffOptions.nIgnoreWhitespace;
-	int breakType = GetBreakType(); // whitespace only or include punctuation
-	bool byteColoring = GetByteColoringOption();
-
-	// Make the call to stringdiffs, which does all the hard & tedious computations
-	std::vector<strdiff::wdiff> wdiffs =
-		strdiff::ComputeWordDiffs(static_cast<int>(panes.size()), str, casitive, eolSensitive, xwhite, diffOptions.bIgnoreNumbers, breakType, byteColoring);
-
-	std::vector<strdiff::wdiff>::iterator it;
-	for (it = wdiffs.begin(); it != wdiffs.end(); ++it)
-	{
-		WordDiff wd;
-		for (size_t i = 0; i < panes.size(); ++i)
-		{
-			int file = panes[i];
-			int nLineBegin = begin[file];
-			int nLineEnd = end[file];
-			int nLine;
-			for (nLine = nLineBegin; nLine < nLineEnd; nLine++)
-			{
-				if (it->begin[i] == nOffsets[file][nLine-nLineBegin] || it->begin[i] < nOffsets[file][nLine-nLineBegin+1])
-					break;
-			}
-			wd.beginline[i] = nLine;
-			wd.begin[i] = it->begin[i] - nOffsets[file][nLine-nLineBegin];
-			if (m_ptBuf[file]->GetLineLength(nLine) < wd.begin[i])
-			{
-				if (wd.beginline[i] < m_ptBuf[file]->GetLineCount() - 1)
-				{
-					wd.begin[i] = 0;
-					wd.beginline[i]++;
-				}
-				else
-				{
-					wd.begin[i] = m_ptBuf[file]->GetLineLength(nLine);
-				}
-			}
-
-			for (; nLine < nLineEnd; nLine++)
-			{
-				if (it->end[i] + 1 == nOffsets[file][nLine-nLineBegin] || it->end[i] + 1 < nOffsets[file][nLine-nLineBegin+1])
-					break;
-			}
-			wd.endline[i] = nLine;
-			wd.end[i] = it->end[i]  + 1 - nOffsets[file][nLine-nLineBegin];
-			if (m_ptBuf[file]->GetLineLength(nLine) < wd.end[i])
-			{
-				if (wd.endline[i] < m_ptBuf[file]->GetLineCount() - 1)
-				{
-					wd.end[i] = 0;
-					wd.endline[i]++;
-				}
-				else
-				{
-					wd.end[i] = m_ptBuf[file]->GetLineLength(nLine);
-				}
-			}
-		}
-		wd.op = it->op;
-
-		worddiffs.push_back(wd);
-	}
-	return worddiffs;
+	source.casitive = !diffOptions.bIgnoreCase;
+	source.eolSensitive = !diffOptions.bIgnoreEol;
+	source.xwhite = diffOptions.nIgnoreWhitespace;
+	source.ignoreNumbers = diffOptions.bIgnoreNumbers;
+	source.breakType = GetBreakType(); // whitespace only or include punctuation
+	source.byteColoring = GetByteColoringOption();
+	return true;
 }
 
 /**
@@ -455,18 +685,26 @@ std::vector<WordDiff> CMergeDoc::GetWordDiffArray(int nLineIndex)
 	int nDiff = m_diffList.LineToDiff(nLineIndex);
 	if (nDiff == -1)
 		return worddiffs;
-	std::map<int, std::vector<WordDiff> >::iterator itmap = m_cacheWordDiffs.find(nDiff);
-	if (itmap != m_cacheWordDiffs.end())
-	{
-		worddiffs.resize((*itmap).second.size());
-		std::copy((*itmap).second.begin(), (*itmap).second.end(), worddiffs.begin());
-		return worddiffs;
-	}
-
 	m_diffList.GetDiff(nDiff, cd);
 
 	bool diffPerLine = IsDiffPerLine(m_ptBuf[0]->GetTableEditing(), cd);
 
+	{
+		std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
+		if (!diffPerLine)
+		{
+			auto itmap = m_cacheWordDiffs.find(nDiff);
+			if (itmap != m_cacheWordDiffs.end())
+				return (*itmap).second;
+		}
+		else
+		{
+			auto itmap = m_cacheLineWordDiffs.find({ nDiff, nLineIndex - cd.dbegin });
+			if (itmap != m_cacheLineWordDiffs.end())
+				return (*itmap).second;
+		}
+	}
+
 	int nLineBegin[3]{}, nLineEnd[3]{};
 	if (!diffPerLine)
 	{
@@ -486,11 +724,15 @@ std::vector<WordDiff> CMergeDoc::GetWordDiffArray(int nLineIndex)
 
 	worddiffs = GetWordDiffArrayInRange(nLineBegin, nLineEnd);
 
+	// The diff list doesn't match edited text until the next rescan
+	if (IsEditedAfterRescan())
+		return worddiffs;
+
+	std::lock_guard<std::mutex> lock(m_mutexWordDiffCache);
 	if (!diffPerLine)
-	{
-		m_cacheWordDiffs[nDiff].resize(worddiffs.size());
-		std::copy(worddiffs.begin(), worddiffs.end(), m_cacheWordDiffs[nDiff].begin());
-	}
+		m_cacheWordDiffs[nDiff] = worddiffs;
+	else
+		m_cacheLineWordDiffs[{ nDiff, nLineIndex - cd.dbegin }] = worddiffs;
 
 	return worddiffs;
 }
@@ -48,6 +48,10 @@ using CrystalLineParser::TEXTBLOCK;
 const UINT IDT_RESCAN = 2;
 /** @brief Timer timeout for delayed rescan. */
 const UINT RESCAN_TIMEOUT = 1000;
+/** @brief Timer ID for copying blocks to precompute word diffs of. */
+const UINT IDT_WORDDIFFS = 3;
+/** @brief Timer timeout for copying blocks to precompute word diffs of. */
+const UINT WORDDIFFS_TIMEOUT = 50;
 
 /** @brief Location for file compare specific help to open. */
 static TCHAR MergeViewHelpLocation[] = _T("::/htmlhelp/Compare_files.html");
@@ -2497,6 +2501,12 @@ void CMergeEditView::OnTimer(UINT_PTR nIDEvent)
 		theApp.SetNeedIdleTimer();
 	}
 
+	if (nIDEvent == IDT_WORDDIFFS)
+	{
+		if (!GetDocument()->QueueWordDiffJobs())
+			KillTimer(IDT_WORDDIFFS);
+	}
+
 	if (nIDEvent == IDLE_TIMER)
 	{
 		// not a real timer, just come back after OnIdle
@@ -2509,6 +2519,16 @@ void CMergeEditView::OnTimer(UINT_PTR nIDEvent)
 	CCrystalEditViewEx::OnTimer(nIDEvent);
 }
 
+/**
+ * @brief Copy the blocks to precompute word diffs of on a timer, until
+ * CMergeDoc::QueueWordDiffJobs() has copied all.
+ */
+void CMergeEditView::StartWordDiffTimer()
+{
+	// Without the timer, the word diffs are computed when painted
+	SetTimer(IDT_WORDDIFFS, WORDDIFFS_TIMEOUT, nullptr);
+}
+
 /**
  * @brief Returns if buffer is read-only
  * @note This has no any relation to file being read-only!
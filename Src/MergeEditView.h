@@ -160,6 +160,7 @@ public:
 	void SetSelection(const CPoint& ptStart, const CPoint& ptEnd, bool bUpdateView = true) override;
 	void ScrollToSubLine(int nNewTopLine, bool bNoSmoothScroll = false, bool bTrackScrollBar = true) override;
 	void SetActivePane();
+	void StartWordDiffTimer();
 
 	// Overrides
 	// ClassWizard generated virtual function overrides
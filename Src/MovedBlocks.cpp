@@ -6,20 +6,23 @@
  */
 
 #include "pch.h"
-#include <map>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
 #include <cassert>
 #include "diff.h"
 
 class IntSet
 {
 public:
-	void Add(int val) { m_map[val] = 1; }
-	void Remove(int val) { m_map.erase(val); }
-	size_t count() const { return m_map.size(); }
-	bool isPresent(int val) const { return m_map.find(val) != m_map.end(); }
-	int getSingle() const { return m_map.begin()->first; }
+	void Add(int val) { m_values.push_back(val); }
+	void Remove(int val) { m_values.erase(std::remove(m_values.begin(), m_values.end(), val), m_values.end()); }
+	size_t count() const { return m_values.size(); }
+	bool isPresent(int val) const { return std::find(m_values.begin(), m_values.end(), val) != m_values.end(); }
+	int getSingle() const { return m_values.front(); }
 private:
-	std::map<int, int> m_map;
+	// Lines of different changes never overlap, so values are unique
+	std::vector<int> m_values;
 };
 
 /** 
@@ -35,60 +38,95 @@ struct EqGroup
 };
 
 
-/** @brief  Maps equivalency code to equivalency group */
+/**
+ * @brief  Maps equivalency code to equivalency group
+ * Open addressing hash table with linear probing; groups are stored in
+ * a single array and are only added, never removed.
+ */
 class CodeToGroupMap
 {
 public:
-	std::map<int, EqGroup *> m_map;
+	explicit CodeToGroupMap(size_t nlines)
+	{
+		size_t capacity = 16;
+		while (capacity < nlines * 2)
+			capacity *= 2;
+		m_codes.resize(capacity);
+		m_slots.resize(capacity, -1);
+		m_groups.reserve(nlines);
+	}
+
 	/** @brief Add a line to the appropriate equivalency group */
 	void Add(int lineno, int eqcode, int nside)
 	{
-		EqGroup *pgroup = find(eqcode);
-		if (pgroup == nullptr)
+		size_t slot = findSlot(eqcode);
+		if (m_slots[slot] < 0)
 		{
-			pgroup = new EqGroup;
-			m_map[eqcode] = pgroup;
+			m_codes[slot] = eqcode;
+			m_slots[slot] = static_cast<int>(m_groups.size());
+			m_groups.emplace_back();
 		}
+		EqGroup& group = m_groups[m_slots[slot]];
 		if (nside)
-			pgroup->m_lines1.Add(lineno);
+			group.m_lines1.Add(lineno);
 		else
-			pgroup->m_lines0.Add(lineno);
+			group.m_lines0.Add(lineno);
 	}
 
 	/** @brief Return the appropriate equivalency group */
 	EqGroup * find(int eqcode)
 	{
-		std::map<int, EqGroup *>::const_iterator it = m_map.find(eqcode);
-		return it != m_map.end() ? it->second : nullptr;
+		int index = m_slots[findSlot(eqcode)];
+		return index >= 0 ? &m_groups[index] : nullptr;
 	}
 
-	~CodeToGroupMap()
+private:
+	/** @brief Return slot holding @p eqcode, or the empty slot where it goes */
+	size_t findSlot(int eqcode) const
 	{
-		std::map<int, EqGroup *>::const_iterator pos = m_map.begin();
-		while (pos != m_map.end())
-			delete pos++->second;
+		const size_t mask = m_slots.size() - 1;
+		// Fibonacci hashing spreads consecutive codes over the table
+		size_t slot = static_cast<size_t>((static_cast<uint32_t>(eqcode) * 2654435769u) >> 8) & mask;
+		while (m_slots[slot] >= 0 && m_codes[slot] != eqcode)
+			slot = (slot + 1) & mask;
+		return slot;
 	}
+
+	std::vector<int> m_codes;
+	std::vector<int> m_slots; // index into m_groups, or -1 if slot is empty
+	std::vector<EqGroup> m_groups;
 };
 
-static bool isLineInDiffBlock(int nside, int lineno, change *script)
+/**
+ * @brief  Lines of one side that are inside diff blocks
+ * Splitting blocks in moved_block_analysis() moves lines between blocks but
+ * never in or out of them, so the set can be built once per script.
+ */
+class DiffLineSet
 {
-	change *p = nullptr;
-	for (change *e = script; e; e = p)
+public:
+	DiffLineSet(const change *script, int nside)
 	{
-		p = e->link;
-		if (nside == 0)
+		for (const change *e = script; e; e = e->link)
 		{
-			if (e->line0 <= lineno && lineno < e->line0 + e->deleted)
-				return true;
-		}
-		else
-		{
-			if (e->line1 <= lineno && lineno < e->line1 + e->inserted)
-				return true;
+			const int first = nside ? e->line1 : e->line0;
+			const int count = nside ? e->inserted : e->deleted;
+			if (count <= 0)
+				continue;
+			if (m_lines.size() < static_cast<size_t>(first + count))
+				m_lines.resize(first + count);
+			std::fill(m_lines.begin() + first, m_lines.begin() + first + count, true);
 		}
 	}
-	return false;
-}
+
+	bool contains(int lineno) const
+	{
+		return lineno >= 0 && static_cast<size_t>(lineno) < m_lines.size() && m_lines[lineno];
+	}
+
+private:
+	std::vector<bool> m_lines;
+};
 
 /*
  WinMerge moved block code
@@ -102,11 +140,18 @@ static bool isLineInDiffBlock(int nside, int lineno, change *script)
 */
 extern "C" void moved_block_analysis(struct change ** pscript, struct file_data fd[])
 {
-	// Hash all altered lines
-	CodeToGroupMap map;
-
 	struct change * script = *pscript;
 	struct change *p,*e;
+
+	size_t nlines = 0;
+	for (e = script; e; e = e->link)
+		nlines += e->deleted + e->inserted;
+
+	// Hash all altered lines
+	CodeToGroupMap map(nlines);
+	const DiffLineSet diffLines0(script, 0);
+	const DiffLineSet diffLines1(script, 1);
+
 	for (e = script; e; e = p)
 	{
 		p = e->link;
@@ -150,9 +195,11 @@ extern "C" void moved_block_analysis(struct change ** pscript, struct file_data
 		int j1 = j-1;
 		for ( ; i1>=e->line0; --i1, --j1)
 		{
+			if (!diffLines1.contains(j1))
+				break;
 			EqGroup * pgroup0 = map.find(fd[0].equivs[i1]);
 			EqGroup * pgroup1 = map.find(fd[1].equivs[j1]);
-			if (pgroup0 != pgroup1 || !isLineInDiffBlock(1, j1, script))
+			if (pgroup0 != pgroup1)
 				break;
 //			pgroup0->m_lines0.Remove(i1); // commented out this line although I'm not sure what this line means because this line causes the bug sf.net#2174
 //			pgroup1->m_lines1.Remove(j1);
@@ -166,9 +213,11 @@ extern "C" void moved_block_analysis(struct change ** pscript, struct file_data
 		int j2 = j+1;
 		for ( ; i2-(e->line0) < (e->deleted); ++i2,++j2)
 		{
+			if (!diffLines1.contains(j2))
+				break;
 			EqGroup * pgroup0 = map.find(fd[0].equivs[i2]);
 			EqGroup * pgroup1 = map.find(fd[1].equivs[j2]);
-			if (pgroup0 != pgroup1 || !isLineInDiffBlock(1, j2, script))
+			if (pgroup0 != pgroup1)
 				break;
 //			pgroup0->m_lines0.Remove(i2); // commented out this line although I'm not sure what this line means because this line causes the bug sf.net#2174
 //			pgroup1->m_lines1.Remove(j2);
@@ -268,9 +317,11 @@ extern "C" void moved_block_analysis(struct change ** pscript, struct file_data
 		int j1 = j-1;
 		for ( ; j1>=e->line1; --i1, --j1)
 		{
+			if (!diffLines0.contains(i1))
+				break;
 			EqGroup * pgroup0 = map.find(fd[0].equivs[i1]);
 			EqGroup * pgroup1 = map.find(fd[1].equivs[j1]);
-			if (pgroup0 != pgroup1 || !isLineInDiffBlock(0, i1, script))
+			if (pgroup0 != pgroup1)
 				break;
 //			pgroup0->m_lines0.Remove(i1); // commented out this line although I'm not sure what this line means because this line causes the bug sf.net#2174
 //			pgroup1->m_lines1.Remove(j1);
@@ -284,9 +335,11 @@ extern "C" void moved_block_analysis(struct change ** pscript, struct file_data
 		int j2 = j+1;
 		for ( ; j2-(e->line1) < (e->inserted); ++i2,++j2)
 		{
+			if (!diffLines0.contains(i2))
+				break;
 			EqGroup * pgroup0 = map.find(fd[0].equivs[i2]);
 			EqGroup * pgroup1 = map.find(fd[1].equivs[j2]);
-			if (pgroup0 != pgroup1 || !isLineInDiffBlock(0, i2, script))
+			if (pgroup0 != pgroup1)
 				break;
 //			pgroup0->m_lines0.Remove(i2); // commented out this line although I'm not sure what this line means because this line causes the bug sf.net#2174
 //			pgroup1->m_lines1.Remove(j2);
@@ -81,6 +81,8 @@ inline const String OPT_ALLOW_MIXED_EOL {_T("Settings/AllowMixedEOL"s)};
 inline const String OPT_COPY_FULL_LINE {_T("Settings/CopyFullLine"s)};
 inline const String OPT_TAB_SIZE {_T("Settings/TabSize"s)};
 inline const String OPT_TAB_TYPE {_T("Settings/TabType"s)};
+// hidden option, memory limit of undo history per file in megabytes, 0 means no limit
+inline const String OPT_UNDO_MEMORY_LIMIT {_T("Settings/UndoMemoryLimit"s)};
 inline const String OPT_WORDWRAP {_T("Settings/WordWrap"s)};
 inline const String OPT_VIEW_LINENUMBERS {_T("Settings/ViewLineNumbers"s)};
 inline const String OPT_VIEW_FILEMARGIN {_T("Settings/ViewFileMargin"s)};
@@ -211,6 +213,7 @@ inline const String OPT_CMP_QUICK_LIMIT {_T("Settings/QuickMethodLimit"s)};
 inline const String OPT_CMP_BINARY_LIMIT {_T("Settings/BinaryMethodLimit"s)};
 inline const String OPT_CMP_COMPARE_THREADS {_T("Settings/CompareThreads"s)};
 inline const String OPT_CMP_WALK_UNIQUE_DIRS {_T("Settings/ScanUnpairedDir"s)};
+inline const String OPT_CMP_RESULT_CACHE {_T("Settings/CompareResultCache"s)};
 inline const String OPT_CMP_IGNORE_REPARSE_POINTS {_T("Settings/IgnoreReparsePoints"s)};
 inline const String OPT_CMP_INCLUDE_SUBDIRS {_T("Settings/Recurse"s)};
 inline const String OPT_CMP_DIFF_ALGORITHM {_T("Settings/DiffAlgorithm"s)};
@@ -285,6 +288,8 @@ inline const String OPT_PLUGINS_UNPACKER_MODE {_T("Settings/UnpackerMode"s)};
 inline const String OPT_PLUGINS_PREDIFFER_MODE {_T("Settings/PredifferMode"s)};
 inline const String OPT_PLUGINS_UNPACK_DONT_CHECK_EXTENSION {_T("Plugins/UnpackDontCheckExtension"s)};
 inline const String OPT_PLUGINS_OPEN_IN_SAME_FRAME_TYPE {_T("Plugins/OpenInSameFrameType"s)};
+inline const String OPT_PLUGINS_OUTPUT_CACHE {_T("Plugins/OutputCache"s)};
+inline const String OPT_PLUGINS_OUTPUT_CACHE_MAX_SIZE {_T("Plugins/OutputCacheMaxSize"s)};
 
 // Startup options
 inline const String OPT_SHOW_SELECT_FILES_AT_STARTUP {_T("Settings/ShowFileDialog"s)};
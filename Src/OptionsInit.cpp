@@ -119,6 +119,7 @@ void Init(COptionsMgr *pOptions)
 	pOptions->InitOption(OPT_COPY_FULL_LINE, false);
 	pOptions->InitOption(OPT_TAB_SIZE, (int)4, 0, 64);
 	pOptions->InitOption(OPT_TAB_TYPE, (int)0, 0, 1);	// 0 means tabs inserted
+	pOptions->InitOption(OPT_UNDO_MEMORY_LIMIT, 0, 0, 4095); // Megs, 0 means no limit
 
 	pOptions->InitOption(OPT_EXT_EDITOR_CMD, _T("%windir%\\NOTEPAD.EXE"));
 	pOptions->InitOption(OPT_USE_RECYCLE_BIN, true);
@@ -143,6 +144,7 @@ void Init(COptionsMgr *pOptions)
 	pOptions->InitOption(OPT_CMP_BINARY_LIMIT, 64 * 1024 * 1024); // 64 Megs
 	pOptions->InitOption(OPT_CMP_COMPARE_THREADS, -1, -128, 128);
 	pOptions->InitOption(OPT_CMP_WALK_UNIQUE_DIRS, true);
+	pOptions->InitOption(OPT_CMP_RESULT_CACHE, false);
 	pOptions->InitOption(OPT_CMP_IGNORE_REPARSE_POINTS, false);
 	pOptions->InitOption(OPT_CMP_IGNORE_CODEPAGE, false);
 	pOptions->InitOption(OPT_CMP_INCLUDE_SUBDIRS, true);
@@ -220,6 +222,8 @@ void Init(COptionsMgr *pOptions)
 	pOptions->InitOption(OPT_PLUGINS_PREDIFFER_MODE, false);
 	pOptions->InitOption(OPT_PLUGINS_UNPACK_DONT_CHECK_EXTENSION, true);
 	pOptions->InitOption(OPT_PLUGINS_OPEN_IN_SAME_FRAME_TYPE, false);
+	pOptions->InitOption(OPT_PLUGINS_OUTPUT_CACHE, false);
+	pOptions->InitOption(OPT_PLUGINS_OUTPUT_CACHE_MAX_SIZE, 1024, 1, 1024 * 1024); // Megs
 
 	pOptions->InitOption(OPT_PATCHCREATOR_PATCH_STYLE, 0, 0, 3);
 	pOptions->InitOption(OPT_PATCHCREATOR_CONTEXT_LINES, 0);
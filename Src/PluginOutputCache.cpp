@@ -0,0 +1,486 @@
+/**
+ *  @file PluginOutputCache.cpp
+ *
+ *  @brief Implementation of PluginOutputCache class.
+ */
+
+#include "pch.h"
+#include "PluginOutputCache.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <Poco/DirectoryIterator.h>
+#include <Poco/Exception.h>
+#include <Poco/SHA2Engine.h>
+#include "Environment.h"
+#include "MergeApp.h"
+#include "TFile.h"
+#include "paths.h"
+#include "unicoder.h"
+#include "DebugNew.h"
+
+using Poco::FastMutex;
+using Poco::DirectoryIterator;
+
+namespace
+{
+
+const uint32_t IndexFileSignature = 0x4f505757; /**< "WWPO" */
+const uint32_t IndexFileVersion = 2;
+const TCHAR IndexFileName[] = _T("Index.bin");
+const TCHAR DataFileExtension[] = _T(".dat");
+const TCHAR TempFilePrefix[] = _T("_PO");
+/** @brief Maximum number of entries, including entries without output files. */
+const size_t MaxEntries = 1024 * 1024;
+/** @brief Outputs larger than the maximum size divided by this are not stored. */
+const uint64_t MaxSizeRatioPerEntry = 4;
+const uint32_t MaxSubcodes = 256;
+const uint32_t MaxExtLength = 256;
+
+#pragma pack(push, 4)
+struct FileHeader
+{
+	uint32_t signature;
+	uint32_t version;
+	uint64_t clock;
+	uint32_t count;
+};
+
+/** @brief Followed by int32_t subcodes and the UTF-8 extension. */
+struct FileRecord
+{
+	uint64_t hash[2];
+	uint64_t size;
+	uint64_t lastUsed;
+	uint32_t changed;
+	uint32_t subcodeCount;
+	uint32_t extLength;
+};
+#pragma pack(pop)
+
+/**
+ * @brief Get the key from the name of an output file.
+ * @return false if the file is not an output file.
+ */
+bool ParseDataFileName(const String& name, PluginOutputCache::Key& key)
+{
+	const size_t extLength = std::size(DataFileExtension) - 1;
+	if (name.length() != 32 + extLength || name.compare(32, extLength, DataFileExtension) != 0)
+		return false;
+	for (int i = 0; i < 2; ++i)
+	{
+		key.hash[i] = 0;
+		for (int j = 0; j < 16; ++j)
+		{
+			const TCHAR c = name[i * 16 + j];
+			int digit;
+			if (c >= '0' && c <= '9')
+				digit = c - '0';
+			else if (c >= 'a' && c <= 'f')
+				digit = c - 'a' + 10;
+			else
+				return false;
+			key.hash[i] = (key.hash[i] << 4) | digit;
+		}
+	}
+	return true;
+}
+
+}
+
+/**
+ * @brief Constructor.
+ * @param [in] folder Folder holding the index file and the output files.
+ */
+PluginOutputCache::PluginOutputCache(const String& folder)
+: m_folder(folder)
+, m_nClock(0)
+, m_nTotalSize(0)
+, m_nMaxSize(1024 * 1024 * 1024)
+, m_bModified(false)
+{
+}
+
+PluginOutputCache::~PluginOutputCache() = default;
+
+/**
+ * @brief Return the path of the output file of an entry.
+ */
+String PluginOutputCache::GetDataPath(const Key& key) const
+{
+	return paths::ConcatPath(m_folder,
+		strutils::format(_T("%016I64x%016I64x"), key.hash[0], key.hash[1]) + DataFileExtension);
+}
+
+/**
+ * @brief Load the index file.
+ * Output files missing from the index, left when WinMerge exited without
+ * saving it, are removed. A missing or damaged index file leaves the cache
+ * empty.
+ * @return true if the index file was read.
+ */
+bool PluginOutputCache::Load()
+{
+	FastMutex::ScopedLock lock(m_mutex);
+	m_entries.clear();
+	m_nTotalSize = 0;
+	m_bModified = false;
+
+	bool bLoaded = false;
+	std::ifstream istr(TFile(paths::ConcatPath(m_folder, IndexFileName)).wpath(), std::ios::in | std::ios::binary);
+	FileHeader header;
+	if (istr && istr.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+		header.signature == IndexFileSignature && header.version == IndexFileVersion)
+	{
+		bLoaded = true;
+		m_nClock = header.clock;
+		for (uint32_t i = 0; i < header.count && bLoaded; ++i)
+		{
+			FileRecord rec;
+			if (!istr.read(reinterpret_cast<char *>(&rec), sizeof(rec)) ||
+				rec.subcodeCount > MaxSubcodes || rec.extLength > MaxExtLength)
+			{
+				bLoaded = false;
+				break;
+			}
+			std::vector<int32_t> subcodes(rec.subcodeCount);
+			std::string ext(rec.extLength, '\0');
+			if (!istr.read(reinterpret_cast<char *>(subcodes.data()), subcodes.size() * sizeof(int32_t)) ||
+				!istr.read(&ext[0], ext.length()))
+			{
+				bLoaded = false;
+				break;
+			}
+			Key key = { { rec.hash[0], rec.hash[1] } };
+			Entry& entry = m_entries[key];
+			entry.bChanged = rec.changed != 0;
+			entry.ext = ucr::toTString(ext);
+			entry.subcodes.assign(subcodes.begin(), subcodes.end());
+			entry.nSize = rec.size;
+			entry.nLastUsed = rec.lastUsed;
+			m_nTotalSize += rec.size;
+		}
+		if (!bLoaded)
+		{
+			m_entries.clear();
+			m_nTotalSize = 0;
+		}
+	}
+
+	try
+	{
+		DirectoryIterator end;
+		for (DirectoryIterator it(ucr::toUTF8(m_folder)); it != end; ++it)
+		{
+			const String name = ucr::toTString(it.name());
+			Key key;
+			if (ParseDataFileName(name, key) ? m_entries.find(key) == m_entries.end() :
+				name.compare(0, std::size(TempFilePrefix) - 1, TempFilePrefix) == 0)
+				it->remove();
+		}
+	}
+	catch (Poco::Exception&)
+	{
+		// The folder does not exist yet
+	}
+	return bLoaded;
+}
+
+/**
+ * @brief Write the index file.
+ * The file is written to a temporary file first so that an interrupted
+ * save does not damage it.
+ * @return true if the index was saved or there was nothing to save.
+ */
+bool PluginOutputCache::Save()
+{
+	FastMutex::ScopedLock lock(m_mutex);
+	if (!m_bModified)
+		return true;
+
+	paths::CreateIfNeeded(m_folder);
+	const String filename = paths::ConcatPath(m_folder, IndexFileName);
+	const String tmpFilename = filename + _T(".tmp");
+	{
+		std::ofstream ostr(TFile(tmpFilename).wpath(), std::ios::out | std::ios::binary | std::ios::trunc);
+		FileHeader header = { IndexFileSignature, IndexFileVersion, m_nClock, static_cast<uint32_t>(m_entries.size()) };
+		ostr.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		for (const auto& it : m_entries)
+		{
+			const Entry& entry = it.second;
+			const std::string ext = ucr::toUTF8(entry.ext);
+			const std::vector<int32_t> subcodes(entry.subcodes.begin(), entry.subcodes.end());
+			FileRecord rec;
+			rec.hash[0] = it.first.hash[0];
+			rec.hash[1] = it.first.hash[1];
+			rec.size = entry.nSize;
+			rec.lastUsed = entry.nLastUsed;
+			rec.changed = entry.bChanged;
+			rec.subcodeCount = static_cast<uint32_t>(subcodes.size());
+			rec.extLength = static_cast<uint32_t>(ext.length());
+			ostr.write(reinterpret_cast<const char *>(&rec), sizeof(rec));
+			ostr.write(reinterpret_cast<const char *>(subcodes.data()), subcodes.size() * sizeof(int32_t));
+			ostr.write(ext.data(), ext.length());
+		}
+		if (!ostr.flush())
+			return false;
+	}
+	try
+	{
+		TFile(tmpFilename).renameTo(filename);
+	}
+	catch (...)
+	{
+		return false;
+	}
+	m_bModified = false;
+	return true;
+}
+
+/**
+ * @brief Remove all cached outputs.
+ */
+void PluginOutputCache::Clear()
+{
+	std::vector<String> removed;
+	{
+		FastMutex::ScopedLock lock(m_mutex);
+		for (const auto& it : m_entries)
+		{
+			if (it.second.bChanged)
+				removed.push_back(GetDataPath(it.first));
+		}
+		m_entries.clear();
+		m_nTotalSize = 0;
+		m_bModified = true;
+	}
+	for (const auto& path : removed)
+	{
+		try { TFile(path).remove(); } catch (...) {}
+	}
+}
+
+/**
+ * @brief Set the maximum size of all output files.
+ * Least recently used outputs are removed if they take more.
+ * @param [in] nMaxSize Maximum size in bytes.
+ */
+void PluginOutputCache::SetMaxSize(uint64_t nMaxSize)
+{
+	std::vector<String> removed;
+	{
+		FastMutex::ScopedLock lock(m_mutex);
+		m_nMaxSize = nMaxSize;
+		removed = Evict();
+	}
+	for (const auto& path : removed)
+	{
+		try { TFile(path).remove(); } catch (...) {}
+	}
+}
+
+/**
+ * @brief Remove least recently used entries until the outputs fit in the maximum size.
+ * Entries are removed down to 3/4 of the maximum, so that the entries are
+ * not sorted again on the next store. Called with the mutex locked.
+ * @return Paths of the output files to remove.
+ */
+std::vector<String> PluginOutputCache::Evict()
+{
+	std::vector<String> removed;
+	if (m_nTotalSize <= m_nMaxSize && m_entries.size() <= MaxEntries)
+		return removed;
+
+	std::vector<std::pair<uint64_t, Key>> lru;
+	lru.reserve(m_entries.size());
+	for (const auto& it : m_entries)
+		lru.emplace_back(it.second.nLastUsed, it.first);
+	std::sort(lru.begin(), lru.end(),
+		[](const std::pair<uint64_t, Key>& a, const std::pair<uint64_t, Key>& b) { return a.first < b.first; });
+	const uint64_t nTargetSize = m_nMaxSize / 4 * 3;
+	const size_t nTargetEntries = MaxEntries / 4 * 3;
+	for (const auto& [nLastUsed, key] : lru)
+	{
+		if (m_nTotalSize <= nTargetSize && m_entries.size() <= nTargetEntries)
+			break;
+		auto it = m_entries.find(key);
+		if (it->second.bChanged)
+			removed.push_back(GetDataPath(key));
+		m_nTotalSize -= it->second.nSize;
+		m_entries.erase(it);
+	}
+	m_bModified = true;
+	return removed;
+}
+
+/**
+ * @brief Build the cache key of an input file.
+ * The key addresses the stored output, so it is a cryptographic hash: a file
+ * crafted to collide with another one must not get the other one's output.
+ * @param [in] filepath Input file, its whole content is hashed.
+ * @param [in] pipeline Description of the plugins and their arguments.
+ * @param [out] key Key of the input, the first 128 bits of the SHA-256 digest.
+ * @return false if the file could not be read.
+ */
+bool PluginOutputCache::MakeKey(const String& filepath, const String& pipeline, Key& key)
+{
+	std::ifstream istr(TFile(filepath).wpath(), std::ios::in | std::ios::binary);
+	if (!istr)
+		return false;
+	Poco::SHA2Engine engine(Poco::SHA2Engine::SHA_256);
+	const uint64_t nPipelineLength = pipeline.length();
+	engine.update(&IndexFileVersion, sizeof(IndexFileVersion));
+	engine.update(&nPipelineLength, sizeof(nPipelineLength));
+	engine.update(pipeline.data(), pipeline.length() * sizeof(TCHAR));
+	std::vector<char> buffer(64 * 1024);
+	uint64_t nSize = 0;
+	while (istr.read(buffer.data(), buffer.size()) || istr.gcount() > 0)
+	{
+		engine.update(buffer.data(), static_cast<size_t>(istr.gcount()));
+		nSize += istr.gcount();
+	}
+	if (istr.bad())
+		return false;
+	engine.update(&nSize, sizeof(nSize));
+	const Poco::DigestEngine::Digest& digest = engine.digest();
+	for (int i = 0; i < 2; ++i)
+	{
+		key.hash[i] = 0;
+		for (int j = 0; j < 8; ++j)
+			key.hash[i] = (key.hash[i] << 8) | digest[i * 8 + j];
+	}
+	return true;
+}
+
+/**
+ * @brief Look up the cached output of an input file.
+ * @param [in] key Key from MakeKey().
+ * @param [in, out] filepath Input file, changed to the temporary file holding
+ * the output unless the input may be overwritten with it.
+ * @param [in] bMayOverwrite Can the input file be overwritten?
+ * @param [out] subcodes Subcodes returned by the unpackers, can be nullptr.
+ * @return true if the output was found.
+ */
+bool PluginOutputCache::Lookup(const Key& key, String& filepath, bool bMayOverwrite, std::vector<int>* subcodes)
+{
+	Entry entry;
+	{
+		FastMutex::ScopedLock lock(m_mutex);
+		auto it = m_entries.find(key);
+		if (it == m_entries.end())
+			return false;
+		it->second.nLastUsed = ++m_nClock;
+		m_bModified = true;
+		entry = it->second;
+	}
+
+	if (entry.bChanged)
+	{
+		String dstFilepath = filepath;
+		try
+		{
+			if (!bMayOverwrite)
+			{
+				dstFilepath = env::GetTemporaryFileName(env::GetTemporaryPath(), _T("_WM"));
+				if (dstFilepath.empty())
+					return false;
+				if (!entry.ext.empty())
+				{
+					const String dstFilepathNew = dstFilepath + entry.ext;
+					TFile(dstFilepath).renameTo(dstFilepathNew);
+					dstFilepath = dstFilepathNew;
+				}
+			}
+			TFile(GetDataPath(key)).copyTo(dstFilepath);
+		}
+		catch (Poco::Exception& e)
+		{
+			// The output file was removed, so is the entry
+			LogErrorStringUTF8(e.displayText());
+			if (!bMayOverwrite && !dstFilepath.empty())
+			{
+				try { TFile(dstFilepath).remove(); } catch (...) {}
+			}
+			FastMutex::ScopedLock lock(m_mutex);
+			auto it = m_entries.find(key);
+			if (it != m_entries.end())
+			{
+				m_nTotalSize -= it->second.nSize;
+				m_entries.erase(it);
+			}
+			return false;
+		}
+		filepath = dstFilepath;
+	}
+	if (subcodes != nullptr)
+		*subcodes = entry.subcodes;
+	return true;
+}
+
+/**
+ * @brief Store the output of an input file.
+ * Outputs too large for the cache are not stored.
+ * @param [in] key Key from MakeKey(), built before the plugins ran.
+ * @param [in] filepath Output file.
+ * @param [in] bChanged Did the plugins change the input?
+ * @param [in] subcodes Subcodes returned by the unpackers.
+ */
+void PluginOutputCache::Store(const Key& key, const String& filepath, bool bChanged, const std::vector<int>& subcodes)
+{
+	Entry entry;
+	entry.bChanged = bChanged;
+	entry.subcodes = subcodes;
+	entry.nSize = 0;
+	if (bChanged)
+	{
+		String tmpFilepath;
+		try
+		{
+			TFile file(filepath);
+			entry.nSize = file.getSize();
+			{
+				FastMutex::ScopedLock lock(m_mutex);
+				if (entry.nSize > m_nMaxSize / MaxSizeRatioPerEntry)
+					return;
+			}
+			paths::CreateIfNeeded(m_folder);
+			tmpFilepath = env::GetTemporaryFileName(m_folder, TempFilePrefix);
+			if (tmpFilepath.empty())
+				return;
+			file.copyTo(tmpFilepath);
+			TFile(tmpFilepath).renameTo(GetDataPath(key));
+		}
+		catch (Poco::Exception& e)
+		{
+			LogErrorStringUTF8(e.displayText());
+			if (!tmpFilepath.empty())
+			{
+				try { TFile(tmpFilepath).remove(); } catch (...) {}
+			}
+			return;
+		}
+		entry.ext = paths::FindExtension(filepath);
+	}
+
+	std::vector<String> removed;
+	{
+		FastMutex::ScopedLock lock(m_mutex);
+		auto it = m_entries.find(key);
+		if (it != m_entries.end())
+		{
+			if (it->second.bChanged && !bChanged)
+				removed.push_back(GetDataPath(key));
+			m_nTotalSize -= it->second.nSize;
+		}
+		entry.nLastUsed = ++m_nClock;
+		m_nTotalSize += entry.nSize;
+		m_entries[key] = std::move(entry);
+		m_bModified = true;
+		std::vector<String> evicted = Evict();
+		removed.insert(removed.end(), evicted.begin(), evicted.end());
+	}
+	for (const auto& path : removed)
+	{
+		try { TFile(path).remove(); } catch (...) {}
+	}
+}
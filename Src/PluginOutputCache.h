@@ -0,0 +1,77 @@
+/**
+ *  @file PluginOutputCache.h
+ *
+ *  @brief Declaration of class PluginOutputCache
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#define POCO_NO_UNWINDOWS 1
+#include <Poco/Mutex.h>
+#include "UnicodeString.h"
+
+/**
+ * @brief Persistent cache of files transformed by unpacker and prediffer plugins.
+ *
+ * Outputs are stored under a key built from the content of the input file
+ * and a description of the plugin pipeline, including the arguments passed
+ * to the plugins. When the same content goes through the same pipeline
+ * again, the stored output is copied to a temporary file and the plugins
+ * are not run. Each output is a file in the cache folder, and an index file
+ * holds the keys. When the outputs take more than the maximum size, the
+ * least recently used ones are removed.
+ *
+ * Lookup() and Store() may be called from several compare threads.
+ */
+class PluginOutputCache
+{
+public:
+	/** @brief First 128 bits of the SHA-256 digest of the input content and the pipeline. */
+	struct Key
+	{
+		uint64_t hash[2];
+		bool operator==(const Key& other) const { return hash[0] == other.hash[0] && hash[1] == other.hash[1]; }
+	};
+
+	explicit PluginOutputCache(const String& folder);
+	~PluginOutputCache();
+
+	bool Load();
+	bool Save();
+	void Clear();
+	void SetMaxSize(uint64_t nMaxSize);
+
+	static bool MakeKey(const String& filepath, const String& pipeline, Key& key);
+
+	bool Lookup(const Key& key, String& filepath, bool bMayOverwrite, std::vector<int>* subcodes);
+	void Store(const Key& key, const String& filepath, bool bChanged, const std::vector<int>& subcodes);
+
+private:
+	/** @brief Cached output of one input. */
+	struct Entry
+	{
+		bool bChanged; /**< false if the plugins left the input unchanged */
+		String ext; /**< Extension of the output file */
+		std::vector<int> subcodes; /**< Subcodes returned by unpackers */
+		uint64_t nSize; /**< Size of the output file */
+		uint64_t nLastUsed; /**< Value of m_nClock when entry was last used */
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash[0]); }
+	};
+
+	String GetDataPath(const Key& key) const;
+	std::vector<String> Evict();
+
+	String m_folder; /**< Folder of the index and output files */
+	std::unordered_map<Key, Entry, KeyHash> m_entries;
+	uint64_t m_nClock; /**< Incremented every time an entry is used */
+	uint64_t m_nTotalSize; /**< Size of all output files */
+	uint64_t m_nMaxSize; /**< Maximum size of all output files */
+	bool m_bModified;
+	mutable Poco::FastMutex m_mutex;
+};
@@ -601,6 +601,9 @@ int PluginInfo::MakeInfo(const String & scriptletFilepath, IDispatch *lpDispatch
 	}
 	VariantClear(&ret);
 
+	// Scriptlets may read settings at run time, so their outputs are cached only when they say they don't
+	m_bCacheable = GetExtendedPropertyValue(_T("Cacheable")).has_value();
+
 	// get optional property PluginArguments
 	if (SearchScriptForDefinedProperties(L"PluginArguments"))
 	{
@@ -43,6 +43,8 @@ public:
 		, m_nFreeFunctions(0)
 		, m_disabled(false)
 		, m_hasArgumentsProperty(false)
+		, m_bConcurrent(false)
+		, m_bCacheable(false)
 	{	
 	}
 
@@ -83,6 +85,12 @@ public:
 	bool        m_disabled;
 	bool        m_hasArgumentsProperty;
 	bool        m_hasVariablesProperty;
+	/// plugin may be called from several threads at the same time
+	bool        m_bConcurrent;
+	/// plugin output depends only on its input, arguments and definition, so it may be cached
+	bool        m_bCacheable;
+	/// commands and scripts of an internal plugin, which are part of the key of its cached outputs
+	String      m_definition;
 	std::vector<FileFilterElementPtr> m_filters;
 	/// only for plugins with free function names (EDITOR_SCRIPT)
 	int         m_nFreeFunctions;
@@ -58,6 +58,64 @@ void SubstitutionList::Add(
 	m_list.emplace_back(rePattern, replacement, regexpCompileOptions);
 }
 
+/**
+ * @brief Replace all matches of an expression in a string.
+ * This does what Poco::RegularExpression::subst() does with RE_GLOBAL, but
+ * builds the result in one pass instead of copying the whole string again
+ * for each match, and does not allocate anything when nothing matches.
+ * @param [in] regexp Expression to match.
+ * @param [in,out] subject String to replace matches in.
+ * @param [in] replacement Replacement, `$0`..`$9` insert captured substrings.
+ */
+static void SubstAll(const Poco::RegularExpression& regexp, std::string& subject, const std::string& replacement)
+{
+	Poco::RegularExpression::MatchVec matches;
+	if (subject.empty() || regexp.match(subject, 0, matches) == 0)
+		return;
+
+	const std::string::size_type length = subject.length();
+	std::string result;
+	result.reserve(length + replacement.length());
+	std::string::size_type pos = 0;
+	std::string::size_type offset = 0;
+	do
+	{
+		const auto& match = matches[0];
+		result.append(subject, pos, match.offset - pos);
+		for (auto it = replacement.begin(); it != replacement.end(); ++it)
+		{
+			if (*it == '$' && it + 1 != replacement.end())
+			{
+				const char d = *++it;
+				if (d >= '0' && d <= '9')
+				{
+					const size_t c = d - '0';
+					if (c < matches.size() && matches[c].offset != std::string::npos)
+						result.append(subject, matches[c].offset, matches[c].length);
+				}
+				else
+				{
+					result += '$';
+					result += d;
+				}
+			}
+			else
+				result += *it;
+		}
+		pos = offset = match.offset + match.length;
+		if (match.length == 0 && offset < length)
+		{
+			// Step over the next (UTF-8) character after an empty match
+			do
+				result += subject[offset++];
+			while (offset < length && (subject[offset] & 0xC0) == 0x80);
+			pos = offset;
+		}
+	} while (offset < length && regexp.match(subject, offset, matches) > 0);
+	result.append(subject, pos, std::string::npos);
+	subject.swap(result);
+}
+
 std::string SubstitutionList::Subst(const std::string& subject, int codepage/*=CP_UTF8*/) const
 {
 	std::string replaced;
@@ -81,7 +139,7 @@ std::string SubstitutionList::Subst(const std::string& subject, int codepage/*=C
 	{
 		try
 		{
-			item.regexp.subst(replaced, item.replacement, Poco::RegularExpression::RE_GLOBAL);
+			SubstAll(item.regexp, replaced, item.replacement);
 		}
 		catch (...)
 		{
@@ -0,0 +1,228 @@
+/**
+ * @file  WordDiff.cpp
+ *
+ * @brief Implementation file for word diffs of diff blocks and aligning lines by them.
+ */
+
+#include "pch.h"
+#include "WordDiff.h"
+#include <algorithm>
+#include <cstdint>
+#include "stringdiffs.h"
+
+/**
+ * @brief Compute word diffs of the copied lines
+ * This uses only the copied text, so it can be called in any thread.
+ */
+std::vector<WordDiff> WordDiffSource::Compute() const
+{
+	std::vector<WordDiff> worddiffs;
+
+	// Make the call to stringdiffs, which does all the hard & tedious computations
+	std::vector<strdiff::wdiff> wdiffs =
+		strdiff::ComputeWordDiffs(nPanes, str, casitive, eolSensitive, xwhite, ignoreNumbers, breakType, byteColoring);
+
+	std::vector<strdiff::wdiff>::iterator it;
+	for (it = wdiffs.begin(); it != wdiffs.end(); ++it)
+	{
+		WordDiff wd;
+		for (int i = 0; i < nPanes; ++i)
+		{
+			int file = panes[i];
+			int nLineBegin = begin[file];
+			int nLineEnd = end[file];
+			const std::vector<int>& nOffsets = offsets[file];
+			const std::vector<int>& nLineLengths = lineLengths[file];
+			int nLine;
+			for (nLine = nLineBegin; nLine < nLineEnd; nLine++)
+			{
+				if (it->begin[i] == nOffsets[nLine-nLineBegin] || it->begin[i] < nOffsets[nLine-nLineBegin+1])
+					break;
+			}
+			wd.beginline[i] = nLine;
+			wd.begin[i] = it->begin[i] - nOffsets[nLine-nLineBegin];
+			if (nLineLengths[nLine-nLineBegin] < wd.begin[i])
+			{
+				if (wd.beginline[i] < lineCount[file] - 1)
+				{
+					wd.begin[i] = 0;
+					wd.beginline[i]++;
+				}
+				else
+				{
+					wd.begin[i] = nLineLengths[nLine-nLineBegin];
+				}
+			}
+
+			for (; nLine < nLineEnd; nLine++)
+			{
+				if (it->end[i] + 1 == nOffsets[nLine-nLineBegin] || it->end[i] + 1 < nOffsets[nLine-nLineBegin+1])
+					break;
+			}
+			wd.endline[i] = nLine;
+			wd.end[i] = it->end[i]  + 1 - nOffsets[nLine-nLineBegin];
+			if (nLineLengths[nLine-nLineBegin] < wd.end[i])
+			{
+				if (wd.endline[i] < lineCount[file] - 1)
+				{
+					wd.end[i] = 0;
+					wd.endline[i]++;
+				}
+				else
+				{
+					wd.end[i] = nLineLengths[nLine-nLineBegin];
+				}
+			}
+		}
+		wd.op = it->op;
+
+		worddiffs.push_back(wd);
+	}
+	return worddiffs;
+}
+
+/**
+ * @brief Return length of a copied line, including EOL
+ */
+int WordDiffSource::GetFullLineLength(int file, int nLine) const
+{
+	const int n = nLine - begin[file];
+	if (nLine < end[file])
+		return offsets[file][n + 1] - offsets[file][n];
+	const int i = static_cast<int>(std::find(panes, panes + nPanes, file) - panes);
+	return static_cast<int>(str[i].length()) - offsets[file][n];
+}
+
+/**
+ * @brief Build the table of match lengths of line pairs in a diff block
+ *
+ * Text between two word diffs is the same in both panes, so a pair of lines
+ * sharing such text matches by the characters of the first line in it.
+ * The table is built once from the word diffs and holds only pairs that
+ * match. When the text spans many lines in both panes, only pairs near its
+ * diagonal are kept, which bounds the size of the table.
+ */
+std::vector<LineMatch>
+GetLineMatches(const WordDiffSource& source, const std::vector<WordDiff>& worddiffs, int i0, int i1)
+{
+	const int MaxPairsPerText = 4096;
+	const int begin0 = source.begin[i0], end0 = source.end[i0];
+	const int begin1 = source.begin[i1], end1 = source.end[i1];
+	std::vector<LineMatch> matches;
+	int prevline0 = begin0, prevcol0 = 0, prevline1 = begin1;
+	for (size_t i = 0; i <= worddiffs.size(); ++i)
+	{
+		// Text from the end of previous word diff to the beginning of next one
+		int nextline0, nextcol0, nextline1;
+		if (i < worddiffs.size())
+		{
+			nextline0 = worddiffs[i].beginline[0];
+			nextcol0 = worddiffs[i].begin[0];
+			nextline1 = worddiffs[i].beginline[1];
+		}
+		else
+		{
+			nextline0 = end0;
+			nextcol0 = source.GetFullLineLength(i0, end0);
+			nextline1 = end1;
+		}
+		const int lo0 = (std::max)(prevline0, begin0), hi0 = (std::min)(nextline0, end0);
+		const int lo1 = (std::max)(prevline1, begin1), hi1 = (std::min)(nextline1, end1);
+		const int width = (std::max)(MaxPairsPerText / (std::max)(hi0 - lo0 + 1, 1), 1);
+		for (int line0 = lo0; line0 <= hi0 && lo1 <= hi1; ++line0)
+		{
+			int len = (line0 == nextline0) ? nextcol0 : source.GetFullLineLength(i0, line0);
+			if (line0 == prevline0)
+				len -= prevcol0;
+			if (len <= 0)
+				continue;
+			int first1 = lo1, last1 = hi1;
+			if (hi1 - lo1 + 1 > width)
+			{
+				const int center = lo1 + static_cast<int>(
+					static_cast<int64_t>(line0 - lo0) * (hi1 - lo1) / (std::max)(hi0 - lo0, 1));
+				first1 = (std::max)(lo1, center - width / 2);
+				last1 = (std::min)(hi1, first1 + width - 1);
+			}
+			for (int line1 = first1; line1 <= last1; ++line1)
+				matches.push_back({ line0 - begin0, line1 - begin1, len });
+		}
+		if (i < worddiffs.size())
+		{
+			prevline0 = worddiffs[i].endline[0];
+			prevcol0 = worddiffs[i].end[0];
+			prevline1 = worddiffs[i].endline[1];
+		}
+	}
+
+	// Texts between word diffs on the same lines add up
+	std::sort(matches.begin(), matches.end(), [](const LineMatch& a, const LineMatch& b)
+		{ return a.line0 < b.line0 || (a.line0 == b.line0 && a.line1 < b.line1); });
+	size_t n = 0;
+	for (size_t i = 0; i < matches.size(); ++i)
+	{
+		if (n > 0 && matches[n - 1].line0 == matches[i].line0 && matches[n - 1].line1 == matches[i].line1)
+			matches[n - 1].len += matches[i].len;
+		else
+			matches[n++] = matches[i];
+	}
+	matches.resize(n);
+	return matches;
+}
+
+/**
+ * @brief Choose the line pairs to align, in order, maximizing total match length
+ *
+ * This is the heaviest common subsequence of the match table. Matches are
+ * visited line by line of the first pane, and the best chain ending before
+ * each line of the second pane is found with a Fenwick tree of prefix maxima,
+ * so aligning takes O(M log N) for M matches.
+ */
+std::vector<std::pair<int, int>>
+GetAlignedLines(const std::vector<LineMatch>& matches, int nlines1)
+{
+	struct Chain
+	{
+		int64_t len; /**< Total match length of the chain */
+		int last; /**< Index of last match of the chain, -1 if none */
+	};
+	std::vector<Chain> tree(nlines1 + 1, Chain{ 0, -1 });
+	std::vector<Chain> chains(matches.size());
+	Chain best{ 0, -1 };
+	for (size_t row = 0; row < matches.size(); )
+	{
+		size_t rowEnd = row;
+		while (rowEnd < matches.size() && matches[rowEnd].line0 == matches[row].line0)
+			++rowEnd;
+		// Extend the best chain ending above and left of each match
+		for (size_t i = row; i < rowEnd; ++i)
+		{
+			Chain prev{ 0, -1 };
+			for (int j = matches[i].line1; j > 0; j -= j & -j)
+			{
+				if (tree[j].len > prev.len)
+					prev = tree[j];
+			}
+			chains[i] = Chain{ prev.len + matches[i].len, prev.last };
+		}
+		// Only then make the chains of this line usable by later lines
+		for (size_t i = row; i < rowEnd; ++i)
+		{
+			const Chain chain{ chains[i].len, static_cast<int>(i) };
+			for (int j = matches[i].line1 + 1; j <= nlines1; j += j & -j)
+			{
+				if (chain.len > tree[j].len)
+					tree[j] = chain;
+			}
+			if (chain.len > best.len)
+				best = chain;
+		}
+		row = rowEnd;
+	}
+
+	std::vector<std::pair<int, int>> aligned;
+	for (int i = best.last; i >= 0; i = chains[i].last)
+		aligned.emplace_back(matches[i].line0, matches[i].line1);
+	std::reverse(aligned.begin(), aligned.end());
+	return aligned;
+}
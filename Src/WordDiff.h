@@ -0,0 +1,72 @@
+/**
+ * @file  WordDiff.h
+ *
+ * @brief Declaration file for word diffs of diff blocks and aligning lines by them.
+ */
+#pragma once
+
+#include <array>
+#include <vector>
+#include <utility>
+#include "UnicodeString.h"
+
+struct WordDiff {
+	std::array<int, 3> begin; // 0-based, eg, begin[0] is from str1
+	std::array<int, 3> end; // 0-based, eg, end[1] is from str2
+	std::array<int, 3> beginline;
+	std::array<int, 3> endline;
+	int op;
+
+	WordDiff(int s1=0, int e1=0, int bl1=0, int el1=0, int s2=0, int e2=0, int bl2=0, int el2=0, int s3=0, int e3=0, int bl3=0, int el3=0, int op=0)
+		: begin{s1, s2, s3}
+		, beginline{bl1, bl2, bl3}
+		, endline{el1, el2, el3}
+		, op(op)
+	{
+		if (s1>e1) e1=s1;
+		if (s2>e2) e2=s2;
+		if (s3>e3) e3=s3;
+		end[0] = e1;
+		end[1] = e2;
+		end[2] = e3;
+	}
+};
+
+/**
+ * @brief Text and options to compute word diffs of lines of a diff block.
+ * The text is copied from the buffers, so the word diffs can be computed
+ * in any thread.
+ */
+struct WordDiffSource
+{
+	int nPanes; /**< Number of strings compared */
+	int panes[3]; /**< Pane of each string */
+	int begin[3]; /**< First line in each pane */
+	int end[3]; /**< Last line in each pane */
+	String str[3]; /**< Lines joined, without ghost lines */
+	std::vector<int> offsets[3]; /**< Offset of each line in the string */
+	std::vector<int> lineLengths[3]; /**< Length of each line, without EOL */
+	int lineCount[3]; /**< Line count of each pane */
+	bool casitive;
+	bool eolSensitive;
+	int xwhite;
+	bool ignoreNumbers;
+	int breakType;
+	bool byteColoring;
+
+	std::vector<WordDiff> Compute() const;
+	int GetFullLineLength(int file, int nLine) const;
+};
+
+/**
+ * @brief Match length of a pair of lines in a diff block
+ */
+struct LineMatch
+{
+	int line0; /**< Line in first pane, relative to diff block */
+	int line1; /**< Line in second pane, relative to diff block */
+	int len; /**< Characters of line0 in text without word diffs spanning both lines */
+};
+
+std::vector<LineMatch> GetLineMatches(const WordDiffSource& source, const std::vector<WordDiff>& worddiffs, int i0, int i1);
+std::vector<std::pair<int, int>> GetAlignedLines(const std::vector<LineMatch>& matches, int nlines1);
@@ -0,0 +1,116 @@
+/**
+ *  @file WordDiffPrecomputer.cpp
+ *
+ *  @brief Implementation of WordDiffPrecomputer class
+ */
+
+#include "StdAfx.h"
+#include "WordDiffPrecomputer.h"
+#include <algorithm>
+#include <Poco/Environment.h>
+#include "OptionsDef.h"
+#include "OptionsMgr.h"
+#include "MergeApp.h"
+
+#ifdef _DEBUG
+#define new DEBUG_NEW
+#endif
+
+using Poco::Environment;
+
+WordDiffPrecomputer::WordDiffPrecomputer(const Callback& callback, int nworkers)
+	: m_callback(callback)
+	, m_nWorkers((std::max)(nworkers, 1))
+	, m_bStopping(false)
+{
+}
+
+WordDiffPrecomputer::~WordDiffPrecomputer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_cond.notify_all();
+	if (m_pThreadPool)
+		m_pThreadPool->joinAll();
+}
+
+/**
+ * @brief Queue jobs after the ones not taken yet.
+ * The workers are started with the first jobs, and wait for more after
+ * they have taken all.
+ */
+void WordDiffPrecomputer::Add(std::vector<Job>&& jobs)
+{
+	if (jobs.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& job : jobs)
+			m_jobs.push_back(std::move(job));
+	}
+	m_cond.notify_all();
+	if (!m_pThreadPool)
+	{
+		m_pThreadPool.reset(new Poco::ThreadPool(m_nWorkers, m_nWorkers));
+		for (int i = 0; i < m_nWorkers; ++i)
+		{
+			m_workers.emplace_back(new Worker(*this));
+			m_pThreadPool->start(*m_workers[i]);
+		}
+	}
+}
+
+/**
+ * @brief Drop the jobs not taken yet.
+ */
+void WordDiffPrecomputer::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_jobs.clear();
+}
+
+size_t WordDiffPrecomputer::GetQueuedCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_jobs.size();
+}
+
+/**
+ * @brief Return number of worker threads to use.
+ * The compare thread option is used like in folder compare, but one
+ * processor is left for the GUI thread which paints the word diffs.
+ */
+int WordDiffPrecomputer::GetWorkerCount()
+{
+	const int nprocessors = static_cast<int>(Environment::processorCount());
+	int nworkers = GetOptionsMgr()->GetInt(OPT_CMP_COMPARE_THREADS);
+	if (nworkers <= 0)
+		nworkers += nprocessors;
+	return std::clamp(nworkers, 1, (std::max)(nprocessors - 1, 1));
+}
+
+void WordDiffPrecomputer::Worker::run()
+{
+	WordDiffPrecomputer &precomputer = m_precomputer;
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(precomputer.m_mutex);
+			precomputer.m_cond.wait(lock, [&precomputer]() { return precomputer.m_bStopping || !precomputer.m_jobs.empty(); });
+			if (precomputer.m_bStopping)
+				break;
+			job = std::move(precomputer.m_jobs.front());
+			precomputer.m_jobs.pop_front();
+		}
+		std::vector<WordDiff> worddiffs = job.source.Compute();
+		{
+			std::lock_guard<std::mutex> lock(precomputer.m_mutex);
+			if (precomputer.m_bStopping)
+				break;
+		}
+		precomputer.m_callback(job, std::move(worddiffs));
+	}
+}
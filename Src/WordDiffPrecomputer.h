@@ -0,0 +1,73 @@
+/**
+ *  @file WordDiffPrecomputer.h
+ *
+ *  @brief Declaration of WordDiffPrecomputer class
+ */
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#define POCO_NO_UNWINDOWS 1
+#include <Poco/ThreadPool.h>
+#include <Poco/Runnable.h>
+#include "MergeDoc.h"
+
+/**
+ * @brief Computes word diffs of diff blocks in worker threads.
+ *
+ * CMergeDoc keeps one precomputer for all rescans. It copies the text of
+ * the blocks near the view a batch at a time, and the workers take the jobs
+ * in the order they were added. Each result is handed to the callback in
+ * the worker thread as soon as it is ready.
+ *
+ * Clear() drops the jobs not taken yet, without waiting for the word diffs
+ * being computed, so the callback may still be called for those. The jobs
+ * carry the generation of the caches they were made for, so the callback
+ * can drop them. Destroying the precomputer stops the workers and waits for
+ * them; the callback is not called after that.
+ */
+class WordDiffPrecomputer
+{
+public:
+	struct Job
+	{
+		int nDiff; /**< Diff block */
+		int nLine; /**< Line of a block diffed per line, relative to the block, -1 for whole block */
+		unsigned nGeneration; /**< Generation of the caches the job was made for */
+		WordDiffSource source;
+	};
+	typedef std::function<void (const Job& job, std::vector<WordDiff>&& worddiffs)> Callback;
+
+	WordDiffPrecomputer(const Callback& callback, int nworkers);
+	~WordDiffPrecomputer();
+
+	void Add(std::vector<Job>&& jobs);
+	void Clear();
+	size_t GetQueuedCount() const;
+	int GetWorkers() const { return m_nWorkers; }
+
+	static int GetWorkerCount();
+
+private:
+	class Worker: public Poco::Runnable
+	{
+	public:
+		explicit Worker(WordDiffPrecomputer &precomputer): m_precomputer(precomputer) {}
+		void run();
+	private:
+		WordDiffPrecomputer &m_precomputer;
+	};
+
+	Callback m_callback;
+	int m_nWorkers;
+	mutable std::mutex m_mutex; /**< Guards the queue and m_bStopping */
+	std::condition_variable m_cond; /**< Signaled when jobs are added or the workers stop */
+	std::deque<Job> m_jobs; /**< Jobs not taken yet */
+	bool m_bStopping;
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::unique_ptr<Poco::ThreadPool> m_pThreadPool; /**< Started with the first jobs */
+};
@@ -854,7 +854,7 @@ struct change * diff_2_files (struct file_data filevec[], int depth, int * bin_s
 		//  We can now safely assume to have a pair of Binary files.
 
 		// Are both files Open and Regular (no Pipes, Directories, Devices (e.g. NUL))
-		if (filevec[0].desc < 0 || filevec[1].desc < 0 ||
+		if ((filevec[0].desc < 0 && !filevec[0].preloaded) || (filevec[1].desc < 0 && !filevec[1].preloaded) ||
 			!(S_ISREG (filevec[0].stat.st_mode)) || !(S_ISREG (filevec[1].stat.st_mode))   )
 			changes = 1;
 		else
@@ -865,7 +865,13 @@ struct change * diff_2_files (struct file_data filevec[], int depth, int * bin_s
 		//  Identical descriptor implies identical files
 		if (filevec[0].desc == filevec[1].desc)
 			changes = 0;
-		//  Scan both files, a buffer at a time, looking for a difference.  
+		else
+		//  WinMerge: both files are already completely in memory.
+		if (filevec[0].preloaded && filevec[1].preloaded)
+			changes = memcmp (filevec[0].buffer,
+							  filevec[1].buffer,
+							  filevec[0].buffered_chars) != 0;
+		//  Scan both files, a buffer at a time, looking for a difference.
 		else
 		{
 			//  Same-sized buffers for both files were allocated in read_files().  
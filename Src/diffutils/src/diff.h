@@ -255,6 +255,10 @@ struct file_data {
     /* Number of valid characters now in the buffer. */
     FSIZE	    buffered_chars;
 
+    /* WinMerge: nonzero if the caller already read the whole file into buffer.
+       DESC is negative if the contents were not read from a file at all.  */
+    int             preloaded;
+
     /* Array of pointers to lines in the file.  */
     char const HUGE **linbuf;
 
@@ -140,14 +140,22 @@ int
 sip (struct file_data *current, int skip_test)
 {
   int isbinary = 0;
-  /* If we have a nonexistent file (or NUL: device) at this stage, treat it as empty.  */
-  if (current->desc < 0 || !(S_ISREG (current->stat.st_mode)))
+  /* If we have a nonexistent file (or NUL: device) at this stage, treat it as empty.
+     WinMerge: contents handed over in memory have no descriptor.  */
+  if ((current->desc < 0 && !current->preloaded) || !(S_ISREG (current->stat.st_mode)))
     {
       /* Leave room for a sentinel.  */
       current->buffer = xmalloc (sizeof (word));
       current->bufsize = sizeof (word);
       current->buffered_chars = 0;
     }
+  else if (current->preloaded)
+    {
+      /* WinMerge: the whole file is already in memory; check its first block.  */
+      if (!skip_test && !get_unicode_signature(current, NULL))
+        isbinary = binary_file_p(current->buffer,
+          min (current->buffered_chars, (FSIZE) STAT_BLOCKSIZE (current->stat)));
+    }
   else
     {
       current->bufsize = current->buffered_chars
@@ -184,7 +192,7 @@ slurp (struct file_data *current)
 {
   size_t cc;
 
-  if (current->desc < 0)
+  if (current->desc < 0 && !current->preloaded)
     /* The file is nonexistent.  */
     ;
   else if (always_text_flag || current->buffered_chars != 0)
@@ -196,7 +204,7 @@ slurp (struct file_data *current)
           ? ~0U	// yes, allocate extra room for transcoding
           : 0U;	// no, allocate no extra room for transcoding
 
-      for (;;)
+      while (!current->preloaded)
         {
           if (current->buffered_chars == current->bufsize)
             {
@@ -1032,7 +1040,7 @@ read_files (struct file_data filevec[], int pretend_binary, int *bin_file)
     }
 	
 	// Are both files Open and Regular (no Pipes, Directories, Devices (except NUL))
-	if (filevec[0].desc < 0 || filevec[1].desc < 0 ||
+	if ((filevec[0].desc < 0 && !filevec[0].preloaded) || (filevec[1].desc < 0 && !filevec[1].preloaded) ||
         (!(S_ISREG (filevec[0].stat.st_mode)) && strcmp(filevec[0].name, "NUL") != 0) ||
 		(!(S_ISREG (filevec[1].stat.st_mode)) && strcmp(filevec[1].name, "NUL") != 0))
       {
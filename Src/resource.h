@@ -609,6 +609,7 @@
 #define IDC_USERAGENT                   1628
 #define IDC_CHECK1                      1629
 #define IDC_COMPARE                     1630
+#define IDC_COMPARE_THREADS             1631
 #define IDC_EDIT_WHOLE_WORD             8603
 #define IDC_EDIT_MATCH_CASE             8604
 #define IDC_EDIT_FINDTEXT               8605
@@ -1330,6 +1331,7 @@
 #define IDS_ELAPSED_TIME                41881
 #define IDS_STATUS_SELITEM1             41882
 #define IDS_STATUS_SELITEMS             41883
+#define IDS_COMPARE_THREADS             41884
 #define IDS_COLDESC_FILENAME            41901
 #define IDS_COLDESC_DIR                 41902
 #define IDS_COLDESC_RESULT              41903
@@ -1701,7 +1703,7 @@
 #define _APS_3D_CONTROLS                     1
 #define _APS_NEXT_RESOURCE_VALUE        258
 #define _APS_NEXT_COMMAND_VALUE         34194
-#define _APS_NEXT_CONTROL_VALUE         1631
+#define _APS_NEXT_CONTROL_VALUE         1632
 #define _APS_NEXT_SYMED_VALUE           118
 #endif
 #endif
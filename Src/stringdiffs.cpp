@@ -9,7 +9,7 @@
 #include "stringdiffs.h"
 #define NOMINMAX
 #include <cassert>
-#include <chrono>
+#include <climits>
 #include "CompareOptions.h"
 #include "stringdiffsi.h"
 #include "Diff3.h"
@@ -23,7 +23,6 @@ static bool Initialized;
 static bool CustomChars;
 static TCHAR *BreakChars;
 static TCHAR BreakCharDefaults[] = _T(",.;:");
-static int TimeoutMilliSeconds = 500;
 
 static bool isSafeWhitespace(TCHAR ch);
 static bool isWordBreak(int breakType, const TCHAR *str, int index, bool ignore_numbers);
@@ -294,7 +293,7 @@ stringdiffs::BuildWordDiffList_DP()
 
 	//if (dp(edscript) <= 0)
 	//	return false;
-	if (onp(edscript) < 0)
+	if (myers(edscript) < 0)
 		return false;
 
 	int i = 1, j = 1;
@@ -391,16 +390,7 @@ stringdiffs::BuildWordDiffList()
 	m_words1 = BuildWordsArray(m_str1);
 	m_words2 = BuildWordsArray(m_str2);
 
-	bool succeeded = false;
-#ifdef _WIN64
-	if (m_words1.size() < 20480 && m_words2.size() < 20480)
-#else
-	if (m_words1.size() < 2048 && m_words2.size() < 2048)
-#endif
-	{
-		succeeded = BuildWordDiffList_DP();
-	}
-	if (!succeeded)
+	if (!BuildWordDiffList_DP())
 	{
 		int s1 = m_words1[0].start;
 		int e1 = m_words1[m_words1.size() - 1].end;
@@ -427,7 +417,7 @@ stringdiffs::BuildWordsArray(const String & str)
 	int iLen = static_cast<int>(sLen);
 
 	// dummy;
-	words.push_back(word(0, -1, 0, 0));
+	words.push_back(word(0, -1, 0));
 
 	// state when we are looking for next word
 inspace:
@@ -442,7 +432,7 @@ inspace:
 		// e is first word character (space or at end)
 		int e = i - 1;
 
-		words.push_back(word(begin, e, dlspace, Hash(str, begin, e, 0)));
+		words.push_back(word(begin, e, dlspace));
 	}
 	if (i == iLen)
 		return words;
@@ -460,7 +450,7 @@ inword:
 			// e is first non-word character (space or at end)
 			int e = i-1;
 			
-			words.push_back(word(begin, e, dlword, Hash(str, begin, e, 0)));
+			words.push_back(word(begin, e, dlword));
 		}
 		if (i == iLen)
 		{
@@ -481,7 +471,7 @@ inword:
 				break_type = dlnumber;
 			}
 			int inext = pIterChar->next();
-			words.push_back(word(i, inext - 1, break_type, Hash(str, i, inext - 1, 0)));
+			words.push_back(word(i, inext - 1, break_type));
 			i = inext;
 			begin = i;
 			goto inword;
@@ -568,38 +558,6 @@ stringdiffs::Hash(const String & str, int begin, int end, unsigned h) const
 	return h;
 }
 
-/**
- * @brief Compare two words (by reference to original strings)
- */
-bool
-stringdiffs::AreWordsSame(const word & word1, const word & word2) const
-{
-	if (this->m_whitespace != WHITESPACE_COMPARE_ALL)
-	{
-		if (IsSpace(word1) && IsSpace(word2))
-			return true;
-	}
-	if (m_ignore_numbers)
-	{
-		auto a = m_str1[word1.start];
-		auto b = m_str2[word2.start];
-		if (_istdigit(a) && _istdigit(b))
-			return true;
-
-	}
-	
-	if (word1.hash != word2.hash)
-		return false;
-	if (word1.length() != word2.length())
-		return false;
-	for (int i=0; i<word1.length(); ++i)
-	{
-		if (!caseMatch(m_str1[word1.start+i], m_str2[word2.start+i]))
-			return false;
-	}
-	return true;
-}
-
 /**
  * @brief Return true if characters match
  */
@@ -612,155 +570,519 @@ stringdiffs::caseMatch(TCHAR ch1, TCHAR ch2) const
 		return _totlower(ch1)==_totlower(ch2);
 }
 
+namespace
+{
+
 /**
- * @ brief An O(NP) Sequence Comparison Algorithm. Sun Wu, Udi Manber, Gene Myers
+ * @brief Memory used by word diffs.
+ * The memory is kept per thread and reused by later word diffs, so
+ * comparing lines allocates only when a line is longer than before.
  */
-int
-stringdiffs::onp(std::vector<char> &edscript)
+struct WordDiffScratch
 {
-	auto start = std::chrono::system_clock::now();
+	struct Slot
+	{
+		const TCHAR *text; /**< First character of the word */
+		int length; /**< Length of the word */
+		unsigned hash; /**< Hash of the word */
+		int id; /**< Id of the word, -1 if slot is free */
+	};
+	struct EditScriptElem { int op; int neq; int pk; int pi; };
+	std::vector<Slot> slots; /**< Hash table interning words */
+	std::vector<int> ids[2]; /**< Ids of the words of both lines */
+	std::vector<int> diags; /**< Forward and backward diagonal vectors */
+	std::vector<int> fp; /**< Furthest points of the O(NP) search */
+	std::vector<int> last; /**< Last edit script element of each diagonal */
+	std::vector<EditScriptElem> es; /**< Edit script elements of the O(NP) search */
+	std::vector<char> ses; /**< Edit script of '=', '-' and '+' */
+	std::vector<char> path; /**< Reversed edit script of the O(NP) search */
+};
+
+thread_local WordDiffScratch t_scratch;
 
-	int M = static_cast<int>(m_words1.size() - 1);
-	int N = static_cast<int>(m_words2.size() - 1);
-	bool exchanged = false;
-	if (M > N)
+/**
+ * @brief Myers' O(ND) difference algorithm in linear space.
+ * This is compareseq() and diag() of diffutils analyze.c working on word
+ * ids: the middle snake is found by searching forward and backward at
+ * once, and both halves are compared recursively. When the search gets
+ * too expensive the best diagonal so far is used, so the result of very
+ * different lines may be a little longer than minimal.
+ * Small parts are compared with the O(NP) algorithm of Wu, Manber and
+ * Myers, which places changes the way word diffs always have.
+ */
+class WordSequenceDiff
+{
+public:
+	WordSequenceDiff(const int *xv, const int *yv, WordDiffScratch& scratch,
+		int *fd, int *bd, int tooExpensive)
+		: xv(xv), yv(yv), scratch(scratch), ses(scratch.ses)
+		, fd(fd), bd(bd), tooExpensive(tooExpensive)
 	{
-		M = static_cast<int>(m_words2.size() - 1);
-		N = static_cast<int>(m_words1.size() - 1);
-		exchanged = true;
 	}
-	int *fp = (new int[(M+1) + 1 + (N+1)]) + (M+1);
-	struct EditScriptElem { int op; int neq; int pk; int pi; };
-	std::vector<EditScriptElem> *es = (new std::vector<EditScriptElem>[(M+1) + 1 + (N+1)]) + (M+1);
-	int DELTA = N - M;
-	
-	auto addEditScriptElem = [&es, &fp](int k) {
-		EditScriptElem ese;
-		if (fp[k - 1] + 1 > fp[k + 1])
-		{
-			ese.op = '+';
-			ese.neq = fp[k] - (fp[k - 1] + 1);
-			ese.pk = k - 1;
-		}
-		else
+
+	/**
+	 * @brief Append edit script of [xoff, xlim) and [yoff, ylim) to ses.
+	 */
+	void compareseq(int xoff, int xlim, int yoff, int ylim, bool minimal)
+	{
+		int nsuffix = 0;
+		for (;;)
 		{
-			ese.op = '-';
-			ese.neq = fp[k] - fp[k + 1];
-			ese.pk = k + 1;
+			// Slide down the bottom initial diagonal
+			while (xoff < xlim && yoff < ylim && xv[xoff] == yv[yoff])
+			{
+				ses.push_back('=');
+				++xoff, ++yoff;
+			}
+			// onp() moves changes down, so keep the common suffix in small parts
+			if ((xlim - xoff) + (ylim - yoff) > ONP_LIMIT)
+			{
+				// Slide up the top initial diagonal
+				while (xlim > xoff && ylim > yoff && xv[xlim - 1] == yv[ylim - 1])
+				{
+					++nsuffix;
+					--xlim, --ylim;
+				}
+			}
+
+			// Handle simple cases
+			if (xoff == xlim || yoff == ylim)
+			{
+				ses.insert(ses.end(), xlim - xoff, '-');
+				ses.insert(ses.end(), ylim - yoff, '+');
+				break;
+			}
+			if ((xlim - xoff) + (ylim - yoff) <= ONP_LIMIT)
+			{
+				onp(xoff, xlim, yoff, ylim);
+				break;
+			}
+
+			// Find a point of correspondence in the middle and split there,
+			// looping on the second half
+			Partition part;
+			diag(xoff, xlim, yoff, ylim, minimal, part);
+			compareseq(xoff, part.xmid, yoff, part.ymid, part.lo_minimal);
+			xoff = part.xmid;
+			yoff = part.ymid;
+			minimal = part.hi_minimal;
 		}
-		ese.pi = static_cast<int>(es[ese.pk].size() - 1);
-		es[k].push_back(ese);
-	};
+		ses.insert(ses.end(), nsuffix, '=');
+	}
 
-	const int COUNTMAX = 100000;
-	int count = 0;
-	int k;
-	for (k = -(M+1); k <= (N+1); k++)
-		fp[k] = -1; 
-	int p = -1;
-	do
+private:
+	/**
+	 * @brief An O(NP) Sequence Comparison Algorithm. Sun Wu, Udi Manber, Gene Myers
+	 */
+	void onp(int xoff, int xlim, int yoff, int ylim)
 	{
-		p = p + 1;
-		for (k = -p; k <= DELTA-1; k++)
+		// Search over the shorter sequence
+		const int *a = xv + xoff, *b = yv + yoff;
+		int M = xlim - xoff;
+		int N = ylim - yoff;
+		const bool exchanged = M > N;
+		if (exchanged)
 		{
-			fp[k] = snake(k, std::max(fp[k-1] + 1, fp[k+1]), exchanged);
-			addEditScriptElem(k);
-			count++;
+			std::swap(a, b);
+			std::swap(M, N);
 		}
-		for (k = DELTA + p; k >= DELTA+1; k--)
+		scratch.fp.assign((M+1) + 1 + (N+1), -1);
+		scratch.last.assign((M+1) + 1 + (N+1), -1);
+		int *fp = scratch.fp.data() + (M+1);
+		int *last = scratch.last.data() + (M+1);
+		auto& es = scratch.es;
+		es.clear();
+		const int DELTA = N - M;
+
+		auto snake = [a, b, M, N](int k, int y)
 		{
-			fp[k] = snake(k, std::max(fp[k-1] + 1, fp[k+1]), exchanged);
+			int x = y - k;
+			while (x < M && y < N && a[x] == b[y])
+			{
+				x = x + 1; y = y + 1;
+			}
+			return y;
+		};
+		auto addEditScriptElem = [&es, fp, last](int k)
+		{
+			WordDiffScratch::EditScriptElem ese;
+			if (fp[k - 1] + 1 > fp[k + 1])
+			{
+				ese.op = '+';
+				ese.neq = fp[k] - (fp[k - 1] + 1);
+				ese.pk = k - 1;
+			}
+			else
+			{
+				ese.op = '-';
+				ese.neq = fp[k] - fp[k + 1];
+				ese.pk = k + 1;
+			}
+			ese.pi = last[ese.pk];
+			last[k] = static_cast<int>(es.size());
+			es.push_back(ese);
+		};
+
+		int k;
+		int p = -1;
+		do
+		{
+			p = p + 1;
+			for (k = -p; k <= DELTA-1; k++)
+			{
+				fp[k] = snake(k, (std::max)(fp[k-1] + 1, fp[k+1]));
+				addEditScriptElem(k);
+			}
+			for (k = DELTA + p; k >= DELTA+1; k--)
+			{
+				fp[k] = snake(k, (std::max)(fp[k-1] + 1, fp[k+1]));
+				addEditScriptElem(k);
+			}
+			k = DELTA;
+			fp[k] = snake(k, (std::max)(fp[k-1] + 1, fp[k+1]));
 			addEditScriptElem(k);
-			count++;
+		} while (fp[k] != N);
+
+		auto& path = scratch.path;
+		path.clear();
+		for (int i = last[DELTA]; i >= 0; )
+		{
+			const WordDiffScratch::EditScriptElem& esi = es[i];
+			path.insert(path.end(), esi.neq, '=');
+			path.push_back(static_cast<char>(esi.op));
+			i = esi.pi;
 		}
-		k = DELTA;
-		fp[k] = snake(k, std::max(fp[k-1] + 1, fp[k+1]), exchanged);
-		addEditScriptElem(k);
-		count++;
+		// The first element is the move to the start point
+		path.pop_back();
+		for (auto it = path.rbegin(); it != path.rend(); ++it)
+		{
+			if (exchanged && *it != '=')
+				ses.push_back(*it == '+' ? '-' : '+');
+			else
+				ses.push_back(*it);
+		}
+	}
+
+	struct Partition
+	{
+		int xmid, ymid; /**< Midpoint of the edit script */
+		bool lo_minimal; /**< Minimal script for left half is known */
+		bool hi_minimal; /**< Minimal script for right half is known */
+	};
+
+	enum { SNAKE_LIMIT = 20 }; /**< Snakes bigger than this are considered "big" */
+	enum { ONP_LIMIT = 256 }; /**< Parts with fewer words are compared with onp() */
 
-		if (count > COUNTMAX)
+	void diag(int xoff, int xlim, int yoff, int ylim, bool minimal, Partition& part) const
+	{
+		const int dmin = xoff - ylim; // Minimum valid diagonal
+		const int dmax = xlim - yoff; // Maximum valid diagonal
+		const int fmid = xoff - yoff; // Center diagonal of top-down search
+		const int bmid = xlim - ylim; // Center diagonal of bottom-up search
+		int fmin = fmid, fmax = fmid; // Limits of top-down search
+		int bmin = bmid, bmax = bmid; // Limits of bottom-up search
+		const bool odd = ((fmid - bmid) & 1) != 0;
+
+		fd[fmid] = xoff;
+		bd[bmid] = xlim;
+
+		for (int c = 1;; ++c)
 		{
-			count = 0;
-			auto end = std::chrono::system_clock::now();
-			auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-			if (msec > TimeoutMilliSeconds)
+			bool big_snake = false;
+
+			// Extend the top-down search by an edit step in each diagonal
+			if (fmin > dmin)
+				fd[--fmin - 1] = -1;
+			else
+				++fmin;
+			if (fmax < dmax)
+				fd[++fmax + 1] = -1;
+			else
+				--fmax;
+			for (int d = fmax; d >= fmin; d -= 2)
 			{
-				delete [] (es - (M+1));
-				delete [] (fp - (M+1));
-				return -1;
+				const int tlo = fd[d - 1], thi = fd[d + 1];
+				int x = (tlo >= thi) ? tlo + 1 : thi;
+				const int oldx = x;
+				int y = x - d;
+				while (x < xlim && y < ylim && xv[x] == yv[y])
+					++x, ++y;
+				if (x - oldx > SNAKE_LIMIT)
+					big_snake = true;
+				fd[d] = x;
+				if (odd && bmin <= d && d <= bmax && bd[d] <= x)
+				{
+					part = { x, y, true, true };
+					return;
+				}
 			}
-		}
-	} while (fp[k] != N);
 
-	edscript.clear();
+			// Similarly extend the bottom-up search
+			if (bmin > dmin)
+				bd[--bmin - 1] = INT_MAX;
+			else
+				++bmin;
+			if (bmax < dmax)
+				bd[++bmax + 1] = INT_MAX;
+			else
+				--bmax;
+			for (int d = bmax; d >= bmin; d -= 2)
+			{
+				const int tlo = bd[d - 1], thi = bd[d + 1];
+				int x = (tlo < thi) ? tlo : thi - 1;
+				const int oldx = x;
+				int y = x - d;
+				while (x > xoff && y > yoff && xv[x - 1] == yv[y - 1])
+					--x, --y;
+				if (oldx - x > SNAKE_LIMIT)
+					big_snake = true;
+				bd[d] = x;
+				if (!odd && fmin <= d && d <= fmax && x <= fd[d])
+				{
+					part = { x, y, true, true };
+					return;
+				}
+			}
 
-	std::vector<char> ses;
-	int i;
-	for (k = DELTA, i = static_cast<int>(es[DELTA].size() - 1); i >= 0;)
-	{
-		EditScriptElem& esi = es[k][i];
-		for (int j = 0; j < esi.neq; ++j)
-			ses.push_back('=');
-		ses.push_back(static_cast<char>(esi.op));
-		i = esi.pi;
-		k = esi.pk;
+			if (minimal)
+				continue;
+
+			// Heuristic: check occasionally for a diagonal that has made
+			// lots of progress compared with the edit distance
+			if (c > 200 && big_snake)
+			{
+				int best = 0;
+				for (int d = fmax; d >= fmin; d -= 2)
+				{
+					const int dd = d - fmid;
+					const int x = fd[d];
+					const int y = x - d;
+					const int v = (x - xoff) * 2 - dd;
+					if (v > 12 * (c + (dd < 0 ? -dd : dd)) && v > best
+						&& xoff + SNAKE_LIMIT <= x && x < xlim
+						&& yoff + SNAKE_LIMIT <= y && y < ylim)
+					{
+						// Insist that the diagonal ends with a significant snake
+						int k;
+						for (k = 1; k <= SNAKE_LIMIT && xv[x - k] == yv[y - k]; k++)
+							;
+						if (k > SNAKE_LIMIT)
+						{
+							best = v;
+							part = { x, y, true, false };
+						}
+					}
+				}
+				if (best > 0)
+					return;
+
+				for (int d = bmax; d >= bmin; d -= 2)
+				{
+					const int dd = d - bmid;
+					const int x = bd[d];
+					const int y = x - d;
+					const int v = (xlim - x) * 2 + dd;
+					if (v > 12 * (c + (dd < 0 ? -dd : dd)) && v > best
+						&& xoff < x && x <= xlim - SNAKE_LIMIT
+						&& yoff < y && y <= ylim - SNAKE_LIMIT)
+					{
+						int k;
+						for (k = 0; k < SNAKE_LIMIT && xv[x + k] == yv[y + k]; k++)
+							;
+						if (k == SNAKE_LIMIT)
+						{
+							best = v;
+							part = { x, y, false, true };
+						}
+					}
+				}
+				if (best > 0)
+					return;
+			}
+
+			// Heuristic: if we've gone well beyond the call of duty,
+			// give up and report halfway between our best results so far
+			if (c >= tooExpensive)
+			{
+				// Find forward diagonal that maximizes X + Y
+				int fxybest = -1, fxbest = 0;
+				for (int d = fmax; d >= fmin; d -= 2)
+				{
+					int x = (std::min)(fd[d], xlim);
+					int y = x - d;
+					if (ylim < y)
+						x = ylim + d, y = ylim;
+					if (fxybest < x + y)
+					{
+						fxybest = x + y;
+						fxbest = x;
+					}
+				}
+
+				// Find backward diagonal that minimizes X + Y
+				int bxybest = INT_MAX, bxbest = 0;
+				for (int d = bmax; d >= bmin; d -= 2)
+				{
+					int x = (std::max)(xoff, bd[d]);
+					int y = x - d;
+					if (y < yoff)
+						x = yoff + d, y = yoff;
+					if (x + y < bxybest)
+					{
+						bxybest = x + y;
+						bxbest = x;
+					}
+				}
+
+				// Use the better of the two diagonals
+				if ((xlim + ylim) - bxybest < fxybest - (xoff + yoff))
+					part = { fxbest, fxybest - fxbest, true, false };
+				else
+					part = { bxbest, bxybest - bxbest, false, true };
+				return;
+			}
+		}
 	}
-	std::reverse(ses.begin(), ses.end());
 
-	int D = 0;
-	for (i = 1; i < static_cast<int>(ses.size()); i++)
+	const int *xv, *yv; /**< Word ids being compared */
+	WordDiffScratch& scratch; /**< Memory for onp() */
+	std::vector<char>& ses; /**< Edit script being built */
+	int *fd, *bd; /**< Furthest points of the searches, indexed by diagonal */
+	int tooExpensive; /**< Edit costs beyond this use the heuristic */
+};
+
+}
+
+/**
+ * @brief Give equal words equal ids.
+ * Words considered the same by the compare options (eg, any whitespace when
+ * whitespace changes are ignored) get the same id, so the diff algorithm
+ * only compares integers.
+ */
+void
+stringdiffs::InternWords()
+{
+	enum { SpaceId, NumberId, FirstWordId };
+
+	auto& slots = t_scratch.slots;
+	const size_t count = m_words1.size() + m_words2.size();
+	size_t capacity = 16;
+	while (capacity < count * 2)
+		capacity <<= 1;
+	slots.assign(capacity, { nullptr, 0, 0, -1 });
+
+	int nextId = FirstWordId;
+	auto intern = [&](const String& str, word& w)
 	{
-		switch (ses[i])
+		if (m_whitespace != WHITESPACE_COMPARE_ALL && IsSpace(w))
 		{
-		case '+':
-			if (static_cast<size_t>(i + 1) < ses.size() && ses[i + 1] == '-')
+			w.id = SpaceId;
+			return;
+		}
+		if (m_ignore_numbers && _istdigit(str[w.start]))
+		{
+			w.id = NumberId;
+			return;
+		}
+		const TCHAR *text = str.c_str() + w.start;
+		const int length = w.length();
+		const unsigned hash = Hash(str, w.start, w.end, 0);
+		for (size_t i = hash & (capacity - 1); ; i = (i + 1) & (capacity - 1))
+		{
+			WordDiffScratch::Slot& slot = slots[i];
+			if (slot.id < 0)
 			{
-				edscript.push_back('!');
-				i++;
-				D++;
+				slot = { text, length, hash, nextId };
+				w.id = nextId++;
+				return;
 			}
-			else
+			if (slot.hash == hash && slot.length == length)
 			{
-				edscript.push_back(exchanged ? '-' : '+');
-				D++;
+				int j = 0;
+				while (j < length && caseMatch(slot.text[j], text[j]))
+					++j;
+				if (j == length)
+				{
+					w.id = slot.id;
+					return;
+				}
 			}
-			break;
+		}
+	};
+
+	// Skip the dummy words
+	for (size_t i = 1; i < m_words1.size(); ++i)
+		intern(m_str1, m_words1[i]);
+	for (size_t i = 1; i < m_words2.size(); ++i)
+		intern(m_str2, m_words2[i]);
+}
+
+/**
+ * @brief Compute the edit script between the word arrays.
+ * @param [out] edscript '=' for same words, '-' for deleted words, '+' for
+ * inserted words and '!' for changed words.
+ * @return Number of edits.
+ */
+int
+stringdiffs::myers(std::vector<char> &edscript)
+{
+	const int M = static_cast<int>(m_words1.size() - 1);
+	const int N = static_cast<int>(m_words2.size() - 1);
+
+	InternWords();
+	std::vector<int>& ids1 = t_scratch.ids[0];
+	std::vector<int>& ids2 = t_scratch.ids[1];
+	ids1.resize(M);
+	ids2.resize(N);
+	for (int i = 0; i < M; ++i)
+		ids1[i] = m_words1[i + 1].id;
+	for (int j = 0; j < N; ++j)
+		ids2[j] = m_words2[j + 1].id;
+
+	// Diagonals range from -N to M, with one more at both ends
+	const int ndiags = M + N + 3;
+	t_scratch.diags.resize(2 * ndiags);
+	int *fd = t_scratch.diags.data() + N + 1;
+	int *bd = fd + ndiags;
+
+	// Approximate square root of the number of words, as diffutils does
+	int tooExpensive = 1;
+	for (int i = M + N; i != 0; i >>= 2)
+		tooExpensive <<= 1;
+	tooExpensive = (std::max)(256, tooExpensive);
+
+	std::vector<char>& ses = t_scratch.ses;
+	ses.clear();
+	WordSequenceDiff(ids1.data(), ids2.data(), t_scratch, fd, bd, tooExpensive)
+		.compareseq(0, M, 0, N, false);
+
+	// Adjacent deleted and inserted words are a changed word
+	edscript.clear();
+	int D = 0;
+	for (size_t i = 0; i < ses.size(); i++)
+	{
+		switch (ses[i])
+		{
+		case '+':
 		case '-':
-			if (static_cast<size_t>(i + 1) < ses.size() && ses[i + 1] == '+')
+			if (i + 1 < ses.size() && ses[i + 1] != '=' && ses[i + 1] != ses[i])
 			{
 				edscript.push_back('!');
 				i++;
-				D++;
 			}
 			else
 			{
-				edscript.push_back(exchanged ? '+' : '-');
-				D++;
+				edscript.push_back(ses[i]);
 			}
+			D++;
 			break;
 		default:
 			edscript.push_back('=');
 		}
 	}
-		
-	delete [] (es - (M+1));
-	delete [] (fp - (M+1));
-
 	return D;
 }
 
-int
-stringdiffs::snake(int k, int y, bool exchanged)
-{
-	int M = static_cast<int>(exchanged ? m_words2.size() - 1 : m_words1.size() - 1);
-	int N = static_cast<int>(exchanged ? m_words1.size() - 1 : m_words2.size() - 1);
-	int x = y - k;
-	while (x < M && y < N && (exchanged ? AreWordsSame(m_words1[y + 1], m_words2[x + 1]) : AreWordsSame(m_words1[x + 1], m_words2[y + 1]))) {
-		x = x + 1; y = y + 1;
-	}
-	return y;
-}
-
 /**
  * @brief Return true if chars match
  *
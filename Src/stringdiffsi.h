@@ -61,9 +61,9 @@ private:
 	struct word {
 		int start; // index of first character of word in original string
 		int end;   // index of last character of word in original string
-		int hash;
+		int id;    // same for words considered equal, set by InternWords()
 		int bBreak; // Is it a isWordBreak 0 = word -1= whitespace -2 = empty 1 = breakWord
-		word(int s = 0, int e = 0, int b = 0, int h = 0) : start(s), end(e), bBreak(b),hash(h) { }
+		word(int s = 0, int e = 0, int b = 0) : start(s), end(e), id(0), bBreak(b) { }
 		int length() const { return end+1-start; }
 	};
 
@@ -75,7 +75,6 @@ private:
 			int begin[2], int end[2], bool equal);
 	std::vector<word> BuildWordsArray(const String & str);
 	unsigned Hash(const String & str, int begin, int end, unsigned h ) const;
-	bool AreWordsSame(const word & word1, const word & word2) const;
 	bool IsWord(const word & word1) const;
 	/**
 	 * @brief Is this block an space or whitespace one?
@@ -108,8 +107,8 @@ private:
 	bool caseMatch(TCHAR ch1, TCHAR ch2) const;
 	bool BuildWordDiffList_DP();
 	int dp(std::vector<char> & edscript);
-	int onp(std::vector<char> & edscript);
-	int snake(int k, int y, bool exchanged);
+	void InternWords();
+	int myers(std::vector<char> & edscript);
 #ifdef STRINGDIFF_LOGGING
 	void debugoutput();
 #endif
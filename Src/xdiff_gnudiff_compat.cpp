@@ -22,6 +22,19 @@ static bool read_mmfile(int fd, mmfile_t& mmfile)
 	return true;
 }
 
+static bool read_mmfile(file_data& fd, mmfile_t& mmfile)
+{
+	if (!fd.preloaded)
+		return read_mmfile(fd.desc, mmfile);
+	if (fd.buffered_chars > INT32_MAX)
+		return false;
+	// Take over the buffer the caller already filled
+	mmfile.ptr = fd.buffer;
+	mmfile.size = static_cast<long>(fd.buffered_chars);
+	fd.buffer = nullptr;
+	return true;
+}
+
 unsigned long make_xdl_flags(const DiffutilsOptions& options)
 {
 	unsigned long xdl_flags = 0;
@@ -71,48 +84,60 @@ static int hunk_func(long start_a, long count_a, long start_b, long count_b, voi
 	return 0;
 }
 
-static void append_equivs(const xdfile_t& xdf, struct file_data& filevec, std::vector<xrecord_t *>& equivs, unsigned xdl_flags)
+/**
+ * @brief Assigns equivalence class numbers to lines of both files.
+ * Used when xdiff did not classify the lines itself (histogram diff).
+ * Classes are kept in a hash table with chaining through arrays, so no
+ * allocation is made per line or per class.
+ */
+class EquivClassifier
 {
-	std::unordered_map<unsigned long, std::vector<int>> equivs_map;
-	for (int i = 0; i < static_cast<int>(equivs.size()); ++i)
+public:
+	EquivClassifier(size_t nrecs, unsigned xdl_flags) : m_xdl_flags(xdl_flags)
 	{
-		unsigned long ha = equivs[i]->ha;
-		if (equivs_map.find(ha) != equivs_map.end())
-			equivs_map[ha].push_back(i);
-		else
-			equivs_map.emplace(ha, std::vector<int>{i});
+		size_t size = 16;
+		while (size < nrecs)
+			size *= 2;
+		m_buckets.resize(size, -1);
+		m_recs.reserve(nrecs);
+		m_next.reserve(nrecs);
 	}
 
-	for (int i = 0; i < xdf.nrec; ++i)
+	int classify(xrecord_t *rec)
 	{
-		unsigned long ha = xdf.recs[i]->ha;
-		if (equivs_map.find(ha) != equivs_map.end())
-		{
-			bool found = false;
-			for (auto j: equivs_map[ha])
-			{
-				if (xdl_recmatch(equivs[j]->ptr, equivs[j]->size, xdf.recs[i]->ptr, xdf.recs[i]->size, xdl_flags))
-				{
-					found = true;
-					filevec.equivs[i] = j;
-					equivs_map.emplace(ha, std::vector<int>{j});
-					break;
-				}
-			}
-			if (!found)
-			{
-				filevec.equivs[i] = static_cast<int>(equivs.size());
-				equivs_map[ha].push_back(filevec.equivs[i]);
-				equivs.push_back(xdf.recs[i]);
-			}
-		}
-		else
+		const size_t bucket = static_cast<size_t>(rec->ha) & (m_buckets.size() - 1);
+		for (int c = m_buckets[bucket]; c >= 0; c = m_next[c])
 		{
-			filevec.equivs[i] = static_cast<int>(equivs.size());
-			equivs_map.emplace(ha, std::vector<int>{filevec.equivs[i]});
-			equivs.push_back(xdf.recs[i]);
+			if (m_recs[c]->ha == rec->ha &&
+				xdl_recmatch(m_recs[c]->ptr, m_recs[c]->size, rec->ptr, rec->size, m_xdl_flags))
+				return c;
 		}
+		const int c = static_cast<int>(m_recs.size());
+		m_recs.push_back(rec);
+		m_next.push_back(m_buckets[bucket]);
+		m_buckets[bucket] = c;
+		return c;
 	}
+
+private:
+	unsigned m_xdl_flags;
+	std::vector<int> m_buckets; // first class of each bucket, or -1
+	std::vector<int> m_next; // next class in the same bucket, or -1
+	std::vector<xrecord_t *> m_recs; // first line of each class
+};
+
+static void append_equivs(const xdfile_t& xdf, struct file_data& filevec, EquivClassifier& classifier, unsigned xdl_flags)
+{
+	if (XDF_DIFF_ALG(xdl_flags) != XDF_HISTOGRAM_DIFF)
+	{
+		// xdl_prepare_env() already replaced the hash of each line with the
+		// index of its equivalence class, shared by both files
+		for (int i = 0; i < xdf.nrec; ++i)
+			filevec.equivs[i] = static_cast<int>(xdf.recs[i]->ha);
+		return;
+	}
+	for (int i = 0; i < xdf.nrec; ++i)
+		filevec.equivs[i] = classifier.classify(xdf.recs[i]);
 }
 
 static int is_missing_newline(const mmfile_t& mmfile)
@@ -132,9 +157,9 @@ struct change * diff_2_files_xdiff (struct file_data filevec[], int bMoved_block
 	xdemitconf_t xecfg = { 0 };
 	xdemitcb_t ecb = { 0 };
 
-	if (!read_mmfile(filevec[0].desc, mmfile1))
+	if (!read_mmfile(filevec[0], mmfile1))
 		goto abort;
-	if (!read_mmfile(filevec[1].desc, mmfile2))
+	if (!read_mmfile(filevec[1], mmfile2))
 		goto abort;
 
 	xpp.flags = xdl_flags;
@@ -204,9 +229,10 @@ struct change * diff_2_files_xdiff (struct file_data filevec[], int bMoved_block
 
 		if (bMoved_blocks_flag)
 		{
-			std::vector<xrecord_t *> equivs;
-			append_equivs(xe.xdf1, filevec[0], equivs, xdl_flags);
-			append_equivs(xe.xdf2, filevec[1], equivs, xdl_flags);
+			EquivClassifier classifier(
+				XDF_DIFF_ALG(xdl_flags) == XDF_HISTOGRAM_DIFF ? xe.xdf1.nrec + xe.xdf2.nrec : 0, xdl_flags);
+			append_equivs(xe.xdf1, filevec[0], classifier, xdl_flags);
+			append_equivs(xe.xdf2, filevec[1], classifier, xdl_flags);
 			moved_block_analysis(&script, filevec);
 		}
 
@@ -0,0 +1,73 @@
+#include "pch.h"
+#include <gtest/gtest.h>
+#include "DiffContext.h"
+#include "CompareEngines/BinaryCompare.h"
+#include "CompareEngines/MemCompare.h"
+#include <Poco/Timestamp.h>
+#include <fstream>
+
+// Throughput benchmarks for the binary compare engine. They are disabled by
+// default; run them with --gtest_also_run_disabled_tests.
+
+namespace
+{
+	const size_t BenchmarkFileSize = 512 * 1024 * 1024;
+
+	void PrintThroughput(const char *name, size_t bytes, const Poco::Timestamp& start)
+	{
+		const double seconds = static_cast<double>(start.elapsed()) / Poco::Timestamp::resolution();
+		printf("%-24s %8.2f GB/s\n", name, seconds > 0 ? bytes / seconds / 1e9 : 0.0);
+	}
+
+	void WriteFile(const std::string& filename, size_t size, char lastByte)
+	{
+		std::vector<char> chunk(1024 * 1024);
+		for (size_t i = 0; i < chunk.size(); ++i)
+			chunk[i] = static_cast<char>(i * 31);
+		std::ofstream ostr(filename.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+		for (size_t written = 0; written < size; written += chunk.size())
+		{
+			if (written + chunk.size() >= size)
+				chunk[size - written - 1] = lastByte;
+			ostr.write(chunk.data(), size - written < chunk.size() ? size - written : chunk.size());
+		}
+	}
+
+	TEST(BinaryCompareBenchmark, DISABLED_Kernel)
+	{
+		std::vector<unsigned char> buf1(64 * 1024 * 1024, 0x5a), buf2(buf1);
+		const int passes = 8;
+
+		Poco::Timestamp start;
+		for (int i = 0; i < passes; ++i)
+			EXPECT_EQ(buf1.size(), CompareEngines::FindFirstDifferenceScalar(buf1.data(), buf2.data(), buf1.size()));
+		PrintThroughput("FindFirstDifferenceScalar", buf1.size() * passes, start);
+
+		start.update();
+		for (int i = 0; i < passes; ++i)
+			EXPECT_EQ(buf1.size(), CompareEngines::FindFirstDifference(buf1.data(), buf2.data(), buf1.size()));
+		PrintThroughput("FindFirstDifference", buf1.size() * passes, start);
+
+		start.update();
+		for (int i = 0; i < passes; ++i)
+			EXPECT_EQ(0, memcmp(buf1.data(), buf2.data(), buf1.size()));
+		PrintThroughput("memcmp", buf1.size() * passes, start);
+	}
+
+	TEST(BinaryCompareBenchmark, DISABLED_Files)
+	{
+		WriteFile("A", BenchmarkFileSize, 'a');
+		WriteFile("B", BenchmarkFileSize, 'b');
+
+		CompareEngines::BinaryCompare bc;
+		int64_t pos = -1;
+		Poco::Timestamp start;
+		EXPECT_EQ(DIFFCODE::DIFF, bc.CompareFiles(_T("A"), _T("B"), &pos));
+		PrintThroughput("BinaryCompare (cached)", BenchmarkFileSize, start);
+		EXPECT_EQ(static_cast<int64_t>(BenchmarkFileSize - 1), pos);
+
+		remove("A");
+		remove("B");
+	}
+
+}  // namespace
@@ -3,6 +3,7 @@
 #include "DiffContext.h"
 #include "PathContext.h"
 #include "CompareEngines/BinaryCompare.h"
+#include "CompareEngines/MemCompare.h"
 #include <fstream>
 
 namespace
@@ -230,4 +231,66 @@ namespace
 		EXPECT_EQ(DIFFCODE::CMPERR, bc.CompareFiles(files, di));
 	}
 
+	TEST_F(BinaryCompareTest, FirstDifference)
+	{
+		CompareEngines::BinaryCompare bc;
+		int64_t pos = -1;
+
+		{
+			TempFile l1("A", "abcdef", 6);
+			TempFile r1("B", "abcdef", 6);
+			EXPECT_EQ(DIFFCODE::SAME, bc.CompareFiles(_T("A"), _T("B"), &pos));
+			EXPECT_EQ(-1, pos);
+		}
+
+		{
+			TempFile l1("A", "abcdef", 6);
+			TempFile r1("B", "abcXef", 6);
+			EXPECT_EQ(DIFFCODE::DIFF, bc.CompareFiles(_T("A"), _T("B"), &pos));
+			EXPECT_EQ(3, pos);
+		}
+
+		{
+			TempFile l1("A", "abc", 3);
+			TempFile r1("B", "abcdef", 6);
+			EXPECT_EQ(DIFFCODE::DIFF, bc.CompareFiles(_T("A"), _T("B"), &pos));
+			EXPECT_EQ(3, pos);
+		}
+
+		{
+			TempFile l1("A", "", 0);
+			TempFile r1("B", "", 0);
+			EXPECT_EQ(DIFFCODE::SAME, bc.CompareFiles(_T("A"), _T("B")));
+		}
+
+		{
+			std::string data(3 * 1024 * 1024 + 17, 'x');
+			TempFile l1("A", data.data(), data.size());
+			data[data.size() - 5] = 'y';
+			TempFile r1("B", data.data(), data.size());
+			EXPECT_EQ(DIFFCODE::DIFF, bc.CompareFiles(_T("A"), _T("B"), &pos));
+			EXPECT_EQ(static_cast<int64_t>(data.size() - 5), pos);
+		}
+	}
+
+	TEST_F(BinaryCompareTest, FindFirstDifference)
+	{
+		std::vector<unsigned char> buf1(1000), buf2;
+		for (size_t i = 0; i < buf1.size(); ++i)
+			buf1[i] = static_cast<unsigned char>(i * 7);
+		buf2 = buf1;
+		// Unaligned starts and every tail length hit all code paths
+		for (size_t len = 0; len < 300; ++len)
+		{
+			EXPECT_EQ(len, CompareEngines::FindFirstDifference(&buf1[1], &buf2[1], len));
+			for (size_t k = 0; k < len; ++k)
+			{
+				buf2[k + 1] ^= 0x80;
+				EXPECT_EQ(k, CompareEngines::FindFirstDifference(&buf1[1], &buf2[1], len));
+				EXPECT_EQ(k, CompareEngines::FindFirstDifferenceScalar(&buf1[1], &buf2[1], len));
+				buf2[k + 1] ^= 0x80;
+			}
+		}
+	}
+
 }  // namespace
@@ -2,6 +2,7 @@
 #include <gtest/gtest.h>
 #include "diff.h"
 #include "CompareEngines/ByteCompare.h"
+#include "CompareEngines/MemCompare.h"
 #include "CompareOptions.h"
 #include "FileLocation.h"
 #include "DiffItem.h"
@@ -9,6 +10,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <fstream>
+#include <vector>
 
 namespace
 {
@@ -43,7 +45,7 @@ namespace
 		}
 
 		FileLocation location[2];
-		file_data filedata[2];
+		file_data filedata[2]{};
 	};
 
 	// The fixture for testing paths functions.
@@ -539,4 +541,44 @@ namespace
 
 	}
 
+	TEST_F(ByteCompareTest, FindFirstDifferenceOrStop)
+	{
+		const char stops[] = " \t\r\n";
+		std::vector<char> buf1(400, 'x'), buf2;
+		for (size_t i = 0; i < buf1.size(); i += 37)
+			buf1[i] = stops[(i / 37) % 4];
+		buf2 = buf1;
+		for (size_t len = 0; len < 300; ++len)
+		{
+			for (size_t nstops = 0; nstops <= CompareEngines::MaxStopBytes; ++nstops)
+			{
+				EXPECT_EQ(CompareEngines::FindFirstDifferenceOrStopScalar(&buf1[1], &buf2[1], len, stops, nstops),
+					CompareEngines::FindFirstDifferenceOrStop(&buf1[1], &buf2[1], len, stops, nstops));
+				buf2[len / 2 + 1] ^= 1;
+				EXPECT_EQ(CompareEngines::FindFirstDifferenceOrStopScalar(&buf1[1], &buf2[1], len, stops, nstops),
+					CompareEngines::FindFirstDifferenceOrStop(&buf1[1], &buf2[1], len, stops, nstops));
+				buf2[len / 2 + 1] ^= 1;
+			}
+		}
+	}
+
+	TEST_F(ByteCompareTest, CountEolBytes)
+	{
+		const char bytes[] = { '\r', '\n', '\0', 'a', 'b' };
+		std::vector<char> buf(20000);
+		for (size_t i = 0; i < buf.size(); ++i)
+			buf[i] = bytes[(i * 7 + i / 3) % 5];
+		// Long buffers overflow the 8-bit counters of the vector loop
+		for (size_t len : { 0, 1, 2, 15, 16, 17, 31, 32, 33, 100, 255 * 32 + 5, 20000 - 1 })
+		{
+			CompareEngines::EolByteCounts counts, expected;
+			CompareEngines::CountEolBytes(&buf[1], len, counts);
+			CompareEngines::CountEolBytesScalar(&buf[1], len, expected);
+			EXPECT_EQ(expected.nzeros, counts.nzeros);
+			EXPECT_EQ(expected.ncrs, counts.ncrs);
+			EXPECT_EQ(expected.nlfs, counts.nlfs);
+			EXPECT_EQ(expected.ncrlfs, counts.ncrlfs);
+		}
+	}
+
 }  // namespace
@@ -0,0 +1,155 @@
+#include "pch.h"
+#include <gtest/gtest.h>
+#include "CompareResultCache.h"
+#include "DiffItem.h"
+#include "Environment.h"
+#include "paths.h"
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	// The fixture for testing CompareResultCache class.
+	class CompareResultCacheTest : public testing::Test
+	{
+	protected:
+		virtual void SetUp()
+		{
+			CacheFile = paths::ConcatPath(env::GetSystemTempPath(), _T("CompareResultCache_test.bin"));
+			_tremove(CacheFile.c_str());
+		}
+
+		virtual void TearDown()
+		{
+			_tremove(CacheFile.c_str());
+		}
+
+		static void MakeItem(DIFFITEM& di, int nsdiffs, int nidiffs, int codepage)
+		{
+			di.diffcode.diffcode = DIFFCODE::FILE | DIFFCODE::BOTH;
+			di.nsdiffs = nsdiffs;
+			di.nidiffs = nidiffs;
+			for (int i = 0; i < 2; ++i)
+			{
+				di.diffFileInfo[i].m_textStats.ncrlfs = nsdiffs + i;
+				di.diffFileInfo[i].encoding.m_codepage = codepage;
+			}
+		}
+
+		uint64_t GetFileSize() const
+		{
+			std::ifstream istr(CacheFile.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+			return static_cast<uint64_t>(istr.tellg());
+		}
+
+		String CacheFile;
+	};
+
+	TEST_F(CompareResultCacheTest, SaveAndLoad)
+	{
+		const CompareResultCache::Key key1 = { { 1, 2 } };
+		const CompareResultCache::Key key2 = { { 3, 4 } };
+		const CompareResultCache::Key key3 = { { 1, 4 } };
+		{
+			CompareResultCache cache(CacheFile);
+			DIFFITEM di1, di2;
+			MakeItem(di1, 5, 1, 65001);
+			MakeItem(di2, 0, 0, 1252);
+			cache.Store(key1, DIFFCODE::DIFF | DIFFCODE::TEXT, di1);
+			cache.Store(key2, DIFFCODE::SAME | DIFFCODE::TEXT, di2);
+			EXPECT_EQ(2u, cache.GetCount());
+			EXPECT_TRUE(cache.Save());
+		}
+
+		CompareResultCache cache(CacheFile);
+		EXPECT_TRUE(cache.Load());
+		EXPECT_EQ(2u, cache.GetCount());
+
+		DIFFITEM di;
+		di.diffcode.diffcode = DIFFCODE::FILE | DIFFCODE::BOTH;
+		unsigned code = 0;
+		EXPECT_TRUE(cache.Lookup(key1, code, di));
+		EXPECT_EQ(DIFFCODE::DIFF | DIFFCODE::TEXT, code);
+		EXPECT_EQ(5, di.nsdiffs);
+		EXPECT_EQ(1, di.nidiffs);
+		EXPECT_EQ(5, di.diffFileInfo[0].m_textStats.ncrlfs);
+		EXPECT_EQ(6, di.diffFileInfo[1].m_textStats.ncrlfs);
+		EXPECT_EQ(65001, di.diffFileInfo[1].encoding.m_codepage);
+
+		EXPECT_TRUE(cache.Lookup(key2, code, di));
+		EXPECT_EQ(DIFFCODE::SAME | DIFFCODE::TEXT, code);
+		EXPECT_EQ(0, di.nsdiffs);
+		EXPECT_EQ(1252, di.diffFileInfo[0].encoding.m_codepage);
+
+		EXPECT_FALSE(cache.Lookup(key3, code, di));
+	}
+
+	TEST_F(CompareResultCacheTest, ErrorsAreNotStored)
+	{
+		CompareResultCache cache(CacheFile);
+		DIFFITEM di;
+		MakeItem(di, 0, 0, 1252);
+		const CompareResultCache::Key key = { { 1, 2 } };
+		cache.Store(key, DIFFCODE::CMPERR | DIFFCODE::TEXT, di);
+		cache.Store(key, DIFFCODE::CMPABORT | DIFFCODE::TEXT, di);
+		EXPECT_EQ(0u, cache.GetCount());
+	}
+
+	TEST_F(CompareResultCacheTest, LoadMissingFile)
+	{
+		CompareResultCache cache(CacheFile);
+		EXPECT_FALSE(cache.Load());
+		EXPECT_EQ(0u, cache.GetCount());
+	}
+
+	TEST_F(CompareResultCacheTest, LoadTruncatedFile)
+	{
+		{
+			CompareResultCache cache(CacheFile);
+			DIFFITEM di;
+			MakeItem(di, 1, 0, 1252);
+			for (uint64_t i = 0; i < 10; ++i)
+				cache.Store({ { i, i } }, DIFFCODE::DIFF | DIFFCODE::TEXT, di);
+			EXPECT_TRUE(cache.Save());
+		}
+		const uint64_t size = GetFileSize();
+		std::vector<char> buf(static_cast<size_t>(size));
+		{
+			std::ifstream istr(CacheFile.c_str(), std::ios::in | std::ios::binary);
+			istr.read(buf.data(), buf.size());
+		}
+		{
+			std::ofstream ostr(CacheFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+			ostr.write(buf.data(), buf.size() - 1);
+		}
+
+		CompareResultCache cache(CacheFile);
+		EXPECT_FALSE(cache.Load());
+		EXPECT_EQ(0u, cache.GetCount());
+	}
+
+	TEST_F(CompareResultCacheTest, LoadHugeCount)
+	{
+		{
+			CompareResultCache cache(CacheFile);
+			DIFFITEM di;
+			MakeItem(di, 1, 0, 1252);
+			cache.Store({ { 1, 2 } }, DIFFCODE::DIFF | DIFFCODE::TEXT, di);
+			EXPECT_TRUE(cache.Save());
+		}
+		{
+			// Overwrite the record count of the header
+			std::fstream str(CacheFile.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+			str.seekp(3 * sizeof(uint32_t));
+			const uint32_t count = 0xffffffff;
+			str.write(reinterpret_cast<const char *>(&count), sizeof(count));
+		}
+
+		CompareResultCache cache(CacheFile);
+		EXPECT_FALSE(cache.Load());
+		EXPECT_EQ(0u, cache.GetCount());
+	}
+
+}  // namespace
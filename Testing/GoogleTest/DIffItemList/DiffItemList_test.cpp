@@ -82,5 +82,46 @@ namespace
 		EXPECT_EQ(String(_T("Dir1\\File2")), pdi->diffFileInfo[0].GetFile());
 	}
 
+	TEST_F(DiffItemListTest, FindItemFromRelativePaths)
+	{
+		DiffItemList list;
+		list.InitDiffItemList();
+		DIFFITEM *pDir1 = list.AddNewDiff(nullptr);
+		DIFFITEM *pFile1 = list.AddNewDiff(pDir1);
+		DIFFITEM *pFile2 = list.AddNewDiff(pDir1);
+		SetFile(*pDir1, _T("Dir1"));
+		SetFile(*pFile1, _T("Dir1\\File1"));
+		SetFile(*pFile2, _T("Dir1\\File2"));
+		list.InvalidatePathIndex();
+
+		String path[2] = { _T("Dir1"), _T("Dir1") };
+		String file[2] = { _T("File2"), _T("File2") };
+		EXPECT_EQ(pFile2, list.FindItemFromRelativePaths(2, path, file));
+		file[1] = _T("File1");
+		EXPECT_EQ(nullptr, list.FindItemFromRelativePaths(2, path, file));
+		String rootpath[2];
+		String rootfile[2] = { _T("Dir1"), _T("Dir1") };
+		EXPECT_EQ(pDir1, list.FindItemFromRelativePaths(2, rootpath, rootfile));
+
+		// Index is rebuilt after items are removed, or added and invalidated
+		file[1] = _T("File2");
+		list.RemoveDiff(pFile2);
+		EXPECT_EQ(nullptr, list.FindItemFromRelativePaths(2, path, file));
+		DIFFITEM *pFile3 = list.AddNewDiff(nullptr);
+		SetFile(*pFile3, _T("File3"));
+		rootfile[0] = rootfile[1] = _T("File3");
+		EXPECT_EQ(nullptr, list.FindItemFromRelativePaths(2, rootpath, rootfile));
+		list.InvalidatePathIndex();
+		EXPECT_EQ(pFile3, list.FindItemFromRelativePaths(2, rootpath, rootfile));
+
+		// Removing children invalidates the index too
+		file[1] = _T("File1");
+		file[0] = _T("File1");
+		EXPECT_EQ(pFile1, list.FindItemFromRelativePaths(2, path, file));
+		list.RemoveChildren(pDir1);
+		EXPECT_FALSE(pDir1->HasChildren());
+		EXPECT_EQ(nullptr, list.FindItemFromRelativePaths(2, path, file));
+	}
+
 
 }  // namespace
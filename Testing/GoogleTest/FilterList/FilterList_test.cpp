@@ -0,0 +1,93 @@
+#include "pch.h"
+#include <gtest/gtest.h>
+#include "FilterList.h"
+
+namespace
+{
+	// The fixture for testing FilterList class.
+	class FilterListTest : public testing::Test
+	{
+	protected:
+		FilterList list;
+	};
+
+	TEST_F(FilterListTest, Empty)
+	{
+		EXPECT_FALSE(list.HasRegExps());
+		EXPECT_TRUE(list.Match("abc"));
+	}
+
+	TEST_F(FilterListTest, Joined)
+	{
+		list.AddRegExp("^abc");
+		list.AddRegExp("def$");
+		list.AddRegExp("(x+)y");
+		EXPECT_TRUE(list.Match("abcxyz"));
+		EXPECT_TRUE(list.Match("xyzdef"));
+		EXPECT_TRUE(list.Match("0xxy0"));
+		EXPECT_FALSE(list.Match("xabc defx"));
+	}
+
+	TEST_F(FilterListTest, Exclude)
+	{
+		list.AddRegExp("a");
+		list.AddRegExp("b");
+		list.AddRegExp("c", true);
+		list.AddRegExp("d", true);
+		EXPECT_TRUE(list.Match("ab"));
+		EXPECT_FALSE(list.Match("ac"));
+		EXPECT_FALSE(list.Match("bd"));
+		EXPECT_FALSE(list.Match("xyz"));
+	}
+
+	TEST_F(FilterListTest, Backreference)
+	{
+		// \1 would refer to (x) if the expressions were joined
+		list.AddRegExp("(x)");
+		list.AddRegExp("(a)\\1");
+		EXPECT_TRUE(list.Match("aa"));
+		EXPECT_FALSE(list.Match("ab"));
+	}
+
+	TEST_F(FilterListTest, NumberedCondition)
+	{
+		// (?(1)...) would test (x) if the expressions were joined
+		list.AddRegExp("(x)");
+		list.AddRegExp("^(a)?(?(1)b|c)$");
+		EXPECT_TRUE(list.Match("ab"));
+		EXPECT_TRUE(list.Match("c"));
+		EXPECT_FALSE(list.Match("ac"));
+	}
+
+	TEST_F(FilterListTest, RelativeCondition)
+	{
+		list.AddRegExp("(x)");
+		list.AddRegExp("^(a)?(?(-1)b|c)$");
+		EXPECT_TRUE(list.Match("ab"));
+		EXPECT_TRUE(list.Match("c"));
+		EXPECT_FALSE(list.Match("b"));
+	}
+
+	TEST_F(FilterListTest, InvalidJoin)
+	{
+		// Same group name in two expressions can not be compiled joined
+		list.AddRegExp("(?<name>a)z");
+		list.AddRegExp("(?<name>b)z");
+		EXPECT_TRUE(list.Match("az"));
+		EXPECT_TRUE(list.Match("bz"));
+		EXPECT_FALSE(list.Match("cz"));
+	}
+
+	TEST_F(FilterListTest, CloneFrom)
+	{
+		list.AddRegExp("a");
+		list.AddRegExp("(x)");
+		list.AddRegExp("(b)\\1");
+		FilterList list2;
+		list2.CloneFrom(&list);
+		EXPECT_TRUE(list2.Match("a"));
+		EXPECT_TRUE(list2.Match("bb"));
+		EXPECT_FALSE(list2.Match("b"));
+	}
+
+}  // namespace
@@ -0,0 +1,194 @@
+#include "pch.h"
+#include <gtest/gtest.h>
+#include "PluginOutputCache.h"
+#include "Environment.h"
+#include "TFile.h"
+#include "paths.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// The fixture for testing PluginOutputCache class.
+	class PluginOutputCacheTest : public testing::Test
+	{
+	protected:
+		virtual void SetUp()
+		{
+			Folder = paths::ConcatPath(env::GetSystemTempPath(), _T("PluginOutputCache_test"));
+			RemoveFolder();
+			paths::CreateIfNeeded(Folder);
+		}
+
+		virtual void TearDown()
+		{
+			for (const auto& path : TempFiles)
+			{
+				try { TFile(path).remove(); } catch (...) {}
+			}
+			RemoveFolder();
+		}
+
+		void RemoveFolder()
+		{
+			try { TFile(Folder).remove(true); } catch (...) {}
+		}
+
+		String WriteFile(const String& name, const std::string& content)
+		{
+			const String path = paths::ConcatPath(Folder, name);
+			std::ofstream ostr(TFile(path).wpath(), std::ios::out | std::ios::binary | std::ios::trunc);
+			ostr.write(content.data(), content.length());
+			return path;
+		}
+
+		static std::string ReadFile(const String& path)
+		{
+			std::ifstream istr(TFile(path).wpath(), std::ios::in | std::ios::binary);
+			return std::string(std::istreambuf_iterator<char>(istr), std::istreambuf_iterator<char>());
+		}
+
+		PluginOutputCache::Key MakeKey(const std::string& content, const String& pipeline)
+		{
+			const String path = WriteFile(_T("input.txt"), content);
+			PluginOutputCache::Key key{};
+			EXPECT_TRUE(PluginOutputCache::MakeKey(path, pipeline, key));
+			return key;
+		}
+
+		// Store an output of the given content, which is removed after the test
+		void StoreOutput(PluginOutputCache& cache, const PluginOutputCache::Key& key, const std::string& content,
+			const std::vector<int>& subcodes = {})
+		{
+			cache.Store(key, WriteFile(_T("output.xml"), content), true, subcodes);
+		}
+
+		// Look up an output, and return its content in output
+		bool LookupOutput(PluginOutputCache& cache, const PluginOutputCache::Key& key, std::string& output,
+			std::vector<int>* subcodes = nullptr)
+		{
+			const String input = WriteFile(_T("input.txt"), "input");
+			String path = input;
+			if (!cache.Lookup(key, path, false, subcodes))
+				return false;
+			if (path != input)
+				TempFiles.push_back(path);
+			output = ReadFile(path);
+			return true;
+		}
+
+		String Folder;
+		std::vector<String> TempFiles;
+	};
+
+	TEST_F(PluginOutputCacheTest, MakeKey)
+	{
+		const PluginOutputCache::Key key1 = MakeKey("abc", _T("UNPACK|plugin"));
+		EXPECT_TRUE(key1 == MakeKey("abc", _T("UNPACK|plugin")));
+		EXPECT_FALSE(key1 == MakeKey("abd", _T("UNPACK|plugin")));
+		EXPECT_FALSE(key1 == MakeKey("abc", _T("PREDIFF|plugin")));
+		EXPECT_FALSE(key1 == MakeKey("", _T("UNPACK|plugin")));
+
+		PluginOutputCache::Key key;
+		EXPECT_FALSE(PluginOutputCache::MakeKey(paths::ConcatPath(Folder, _T("missing.txt")), _T("UNPACK"), key));
+	}
+
+	TEST_F(PluginOutputCacheTest, StoreAndLookup)
+	{
+		PluginOutputCache cache(Folder);
+		const PluginOutputCache::Key key1 = MakeKey("abc", _T("UNPACK"));
+		const PluginOutputCache::Key key2 = MakeKey("def", _T("UNPACK"));
+		const PluginOutputCache::Key key3 = MakeKey("ghi", _T("UNPACK"));
+		StoreOutput(cache, key1, "<abc/>", { 1, 2 });
+		cache.Store(key2, WriteFile(_T("input.txt"), "def"), false, {});
+
+		std::string output;
+		std::vector<int> subcodes;
+		EXPECT_TRUE(LookupOutput(cache, key1, output, &subcodes));
+		EXPECT_EQ("<abc/>", output);
+		EXPECT_EQ((std::vector<int>{ 1, 2 }), subcodes);
+		ASSERT_FALSE(TempFiles.empty());
+		EXPECT_EQ(_T(".xml"), paths::FindExtension(TempFiles.back()));
+
+		// The input is left as is when the plugins did not change it
+		String path = WriteFile(_T("input.txt"), "def");
+		EXPECT_TRUE(cache.Lookup(key2, path, false, nullptr));
+		EXPECT_EQ(paths::ConcatPath(Folder, _T("input.txt")), path);
+
+		EXPECT_FALSE(LookupOutput(cache, key3, output));
+	}
+
+	TEST_F(PluginOutputCacheTest, SaveAndLoad)
+	{
+		const PluginOutputCache::Key key1 = MakeKey("abc", _T("UNPACK"));
+		const PluginOutputCache::Key key2 = MakeKey("def", _T("UNPACK"));
+		{
+			PluginOutputCache cache(Folder);
+			StoreOutput(cache, key1, "<abc/>", { 3 });
+			EXPECT_TRUE(cache.Save());
+			// Not in the saved index, so the output file is removed on load
+			StoreOutput(cache, key2, "<def/>");
+		}
+
+		PluginOutputCache cache(Folder);
+		EXPECT_TRUE(cache.Load());
+		std::string output;
+		std::vector<int> subcodes;
+		EXPECT_TRUE(LookupOutput(cache, key1, output, &subcodes));
+		EXPECT_EQ("<abc/>", output);
+		EXPECT_EQ(std::vector<int>{ 3 }, subcodes);
+		EXPECT_FALSE(LookupOutput(cache, key2, output));
+	}
+
+	TEST_F(PluginOutputCacheTest, LoadDamagedIndex)
+	{
+		const PluginOutputCache::Key key = MakeKey("abc", _T("UNPACK"));
+		{
+			PluginOutputCache cache(Folder);
+			StoreOutput(cache, key, "<abc/>");
+			EXPECT_TRUE(cache.Save());
+		}
+		const String indexPath = paths::ConcatPath(Folder, _T("Index.bin"));
+		const std::string index = ReadFile(indexPath);
+		WriteFile(_T("Index.bin"), index.substr(0, index.length() - 1));
+
+		PluginOutputCache cache(Folder);
+		EXPECT_FALSE(cache.Load());
+		std::string output;
+		EXPECT_FALSE(LookupOutput(cache, key, output));
+	}
+
+	TEST_F(PluginOutputCacheTest, EvictLeastRecentlyUsed)
+	{
+		PluginOutputCache cache(Folder);
+		cache.SetMaxSize(400);
+		std::vector<PluginOutputCache::Key> keys;
+		for (int i = 0; i < 5; ++i)
+			keys.push_back(MakeKey(std::string(1, static_cast<char>('a' + i)), _T("UNPACK")));
+		for (int i = 0; i < 4; ++i)
+			StoreOutput(cache, keys[i], std::string(100, static_cast<char>('a' + i)));
+		std::string output;
+		EXPECT_TRUE(LookupOutput(cache, keys[0], output));
+
+		// Going over the maximum size evicts down to 3/4 of it
+		StoreOutput(cache, keys[4], std::string(100, 'e'));
+		EXPECT_TRUE(LookupOutput(cache, keys[0], output));
+		EXPECT_FALSE(LookupOutput(cache, keys[1], output));
+		EXPECT_FALSE(LookupOutput(cache, keys[2], output));
+		EXPECT_TRUE(LookupOutput(cache, keys[3], output));
+		EXPECT_TRUE(LookupOutput(cache, keys[4], output));
+		EXPECT_EQ(std::string(100, 'e'), output);
+
+		// Outputs taking more than a quarter of the maximum size are not stored
+		StoreOutput(cache, keys[1], std::string(101, 'b'));
+		EXPECT_FALSE(LookupOutput(cache, keys[1], output));
+
+		cache.SetMaxSize(200);
+		EXPECT_FALSE(LookupOutput(cache, keys[0], output));
+		EXPECT_FALSE(LookupOutput(cache, keys[3], output));
+		EXPECT_TRUE(LookupOutput(cache, keys[4], output));
+	}
+
+}  // namespace
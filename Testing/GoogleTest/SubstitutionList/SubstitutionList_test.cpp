@@ -0,0 +1,61 @@
+#include "pch.h"
+#include <gtest/gtest.h>
+#include "SubstitutionList.h"
+
+namespace
+{
+	// The fixture for testing SubstitutionList class.
+	class SubstitutionListTest : public testing::Test
+	{
+	protected:
+		SubstitutionList list;
+	};
+
+	TEST_F(SubstitutionListTest, NoMatch)
+	{
+		list.Add("x", "y", 0);
+		EXPECT_EQ("abc", list.Subst("abc"));
+		EXPECT_EQ("", list.Subst(""));
+	}
+
+	TEST_F(SubstitutionListTest, RegExp)
+	{
+		list.Add("[0-9]+", "N", 0);
+		EXPECT_EQ("aNbNc", list.Subst("a12b3c"));
+	}
+
+	TEST_F(SubstitutionListTest, CapturedSubstrings)
+	{
+		list.Add("(\\w+)=(\\w+)", "$2=$1 $$", 0);
+		EXPECT_EQ("b=a $$, d=c $$", list.Subst("a=b, c=d"));
+	}
+
+	TEST_F(SubstitutionListTest, EmptyMatch)
+	{
+		list.Add("x*", "-", 0);
+		EXPECT_EQ("-a-b-c", list.Subst("abc"));
+		EXPECT_EQ("-a--b", list.Subst("axxb"));
+	}
+
+	TEST_F(SubstitutionListTest, EmptyMatchUTF8)
+	{
+		// Multibyte characters are not split after an empty match
+		list.Add("x*", "-", Poco::RegularExpression::RE_UTF8);
+		EXPECT_EQ("-\xC3\xA4-b", list.Subst("\xC3\xA4" "b"));
+	}
+
+	TEST_F(SubstitutionListTest, Plain)
+	{
+		list.Add("a.b", "x", true, false);
+		list.Add("cd", "y", false, false);
+		EXPECT_EQ("x aXb y ye", list.Subst("a.b aXb CD CDe"));
+	}
+
+	TEST_F(SubstitutionListTest, Order)
+	{
+		list.Add("a", "b", 0);
+		list.Add("b", "c", 0);
+		EXPECT_EQ("cc", list.Subst("ab"));
+	}
+
+}  // namespace
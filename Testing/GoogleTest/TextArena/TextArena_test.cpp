@@ -0,0 +1,90 @@
+#include "pch.h"
+#include <gtest/gtest.h>
+#include <windows.h>
+#include <tchar.h>
+#include <string>
+#include "TextArena.h"
+
+namespace
+{
+	// The fixture for testing TextArena class.
+	class TextArenaTest : public testing::Test
+	{
+	protected:
+		TextArena arena;
+	};
+
+	TEST_F(TextArenaTest, Append)
+	{
+		LPCTSTR psz1 = arena.Append(_T("abc"), 3);
+		LPCTSTR psz2 = arena.Append(_T("de"), 2);
+		EXPECT_STREQ(_T("abc"), psz1);
+		EXPECT_STREQ(_T("de"), psz2);
+		EXPECT_EQ(psz1 + 4, psz2);
+		EXPECT_EQ(7 * sizeof(TCHAR), arena.GetUsedSize());
+		EXPECT_LE(arena.GetUsedSize(), arena.GetMemorySize());
+	}
+
+	TEST_F(TextArenaTest, Extend)
+	{
+		LPCTSTR psz1 = arena.Append(_T("abc"), 3);
+		EXPECT_TRUE(arena.Extend(psz1, 3, _T("de"), 2));
+		EXPECT_STREQ(_T("abcde"), psz1);
+		EXPECT_EQ(6 * sizeof(TCHAR), arena.GetUsedSize());
+
+		// Only the last text can be extended
+		LPCTSTR psz2 = arena.Append(_T("f"), 1);
+		EXPECT_FALSE(arena.Extend(psz1, 5, _T("g"), 1));
+		EXPECT_STREQ(_T("f"), psz2);
+	}
+
+	TEST_F(TextArenaTest, Truncate)
+	{
+		LPCTSTR psz1 = arena.Append(_T("abc"), 3);
+		arena.Append(_T("de"), 2);
+		arena.Truncate(psz1 + 4);
+		EXPECT_EQ(4 * sizeof(TCHAR), arena.GetUsedSize());
+		LPCTSTR psz2 = arena.Append(_T("xy"), 2);
+		EXPECT_EQ(psz1 + 4, psz2);
+		EXPECT_STREQ(_T("xy"), psz2);
+	}
+
+	TEST_F(TextArenaTest, ReleaseBeforeInSameChunk)
+	{
+		arena.Append(_T("abc"), 3);
+		LPCTSTR psz2 = arena.Append(_T("de"), 2);
+		const size_t nMemorySize = arena.GetMemorySize();
+		arena.ReleaseBefore(psz2);
+		// The chunk is still used by the second text
+		EXPECT_EQ(nMemorySize, arena.GetMemorySize());
+		EXPECT_EQ(3 * sizeof(TCHAR), arena.GetUsedSize());
+		EXPECT_STREQ(_T("de"), psz2);
+		arena.Append(_T("f"), 1);
+		EXPECT_EQ(5 * sizeof(TCHAR), arena.GetUsedSize());
+	}
+
+	TEST_F(TextArenaTest, ReleaseBeforeFreesChunks)
+	{
+		// Texts longer than a chunk get chunks of their own
+		const std::basic_string<TCHAR> big(100 * 1024, _T('x'));
+		arena.Append(big.c_str(), big.length());
+		LPCTSTR psz2 = arena.Append(big.c_str(), big.length());
+		LPCTSTR psz3 = arena.Append(_T("abc"), 3);
+		const size_t nMemorySize = arena.GetMemorySize();
+		arena.ReleaseBefore(psz2);
+		EXPECT_EQ(nMemorySize - (big.length() + 1) * sizeof(TCHAR), arena.GetMemorySize());
+		EXPECT_EQ((big.length() + 1 + 4) * sizeof(TCHAR), arena.GetUsedSize());
+		arena.ReleaseBefore(psz3);
+		EXPECT_EQ(4 * sizeof(TCHAR), arena.GetUsedSize());
+		EXPECT_STREQ(_T("abc"), psz3);
+	}
+
+	TEST_F(TextArenaTest, Clear)
+	{
+		arena.Append(_T("abc"), 3);
+		arena.Clear();
+		EXPECT_EQ(0u, arena.GetUsedSize());
+		EXPECT_EQ(0u, arena.GetMemorySize());
+	}
+
+}  // namespace
@@ -0,0 +1,127 @@
+#include "pch.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+#include "WordDiff.h"
+#include "stringdiffs.h"
+
+namespace
+{
+	// The fixture for testing aligning lines of diff blocks by word diffs.
+	class WordDiffTest : public testing::Test
+	{
+	protected:
+		WordDiffTest()
+		{
+			strdiff::Init();
+		}
+
+		virtual ~WordDiffTest()
+		{
+			strdiff::Close();
+		}
+
+		// Copy lines, including EOLs, of a two-way diff block the way CMergeDoc does
+		static WordDiffSource MakeSource(const std::vector<String>& lines0, const std::vector<String>& lines1)
+		{
+			WordDiffSource source;
+			source.nPanes = 2;
+			const std::vector<String>* lines[2] = { &lines0, &lines1 };
+			for (int file = 0; file < 2; ++file)
+			{
+				const int nLines = static_cast<int>(lines[file]->size());
+				source.panes[file] = file;
+				source.begin[file] = 0;
+				source.end[file] = nLines - 1;
+				source.lineCount[file] = nLines;
+				source.offsets[file].resize(nLines);
+				source.lineLengths[file].resize(nLines);
+				int offset = 0;
+				for (int nLine = 0; nLine < nLines; ++nLine)
+				{
+					const String& line = (*lines[file])[nLine];
+					source.str[file] += line;
+					if (nLine + 1 < nLines)
+						source.offsets[file][nLine + 1] = offset + static_cast<int>(line.length());
+					offset += static_cast<int>(line.length());
+					source.lineLengths[file][nLine] = static_cast<int>(line.find_last_not_of(_T("\r\n")) + 1);
+				}
+			}
+			source.casitive = true;
+			source.eolSensitive = true;
+			source.xwhite = 0;
+			source.ignoreNumbers = false;
+			source.breakType = 1;
+			source.byteColoring = false;
+			return source;
+		}
+	};
+
+	TEST_F(WordDiffTest, AlignSmallBlock)
+	{
+		const WordDiffSource source = MakeSource(
+			{ _T("alpha beta\n"), _T("gamma delta\n") },
+			{ _T("inserted\n"), _T("alpha beta\n"), _T("gamma delta epsilon\n") });
+		const std::vector<WordDiff> worddiffs = source.Compute();
+		const std::vector<LineMatch> matches = GetLineMatches(source, worddiffs, 0, 1);
+		const std::vector<std::pair<int, int>> aligned = GetAlignedLines(matches, 3);
+		ASSERT_EQ(2u, aligned.size());
+		EXPECT_EQ(std::make_pair(0, 1), aligned[0]);
+		EXPECT_EQ(std::make_pair(1, 2), aligned[1]);
+	}
+
+	TEST_F(WordDiffTest, AlignHeaviestMatches)
+	{
+		// Crossing pairs can't be aligned both, so the longer match wins
+		const std::vector<LineMatch> matches = { { 0, 1, 5 }, { 1, 0, 10 }, { 1, 2, 3 } };
+		const std::vector<std::pair<int, int>> aligned = GetAlignedLines(matches, 3);
+		ASSERT_EQ(1u, aligned.size());
+		EXPECT_EQ(std::make_pair(1, 0), aligned[0]);
+
+		// A line is aligned to one line only
+		const std::vector<LineMatch> matches2 = { { 0, 0, 5 }, { 0, 1, 6 } };
+		const std::vector<std::pair<int, int>> aligned2 = GetAlignedLines(matches2, 2);
+		ASSERT_EQ(1u, aligned2.size());
+		EXPECT_EQ(std::make_pair(0, 1), aligned2[0]);
+	}
+
+	TEST_F(WordDiffTest, DiagonalBandOfLongText)
+	{
+		// Without word diffs the whole block is one text shared by all lines,
+		// and only pairs near its diagonal are kept
+		const int nlines0 = 1000, nlines1 = 2000;
+		const WordDiffSource source = MakeSource(
+			std::vector<String>(nlines0, _T("x\n")), std::vector<String>(nlines1, _T("x\n")));
+		const std::vector<LineMatch> matches = GetLineMatches(source, {}, 0, 1);
+		const int width = 4096 / nlines0;
+		EXPECT_LE(matches.size(), static_cast<size_t>(nlines0 * width));
+		for (const auto& match : matches)
+		{
+			const int center = match.line0 * (nlines1 - 1) / (nlines0 - 1);
+			EXPECT_LE(std::abs(match.line1 - center), width);
+			EXPECT_EQ(2, match.len);
+		}
+
+		const std::vector<std::pair<int, int>> aligned = GetAlignedLines(matches, nlines1);
+		ASSERT_EQ(static_cast<size_t>(nlines0), aligned.size());
+		for (size_t i = 1; i < aligned.size(); ++i)
+		{
+			EXPECT_LT(aligned[i - 1].first, aligned[i].first);
+			EXPECT_LT(aligned[i - 1].second, aligned[i].second);
+		}
+	}
+
+	TEST_F(WordDiffTest, NoMatchingText)
+	{
+		// One word diff spanning the whole block leaves no common text,
+		// and the caller maps the lines 1:1 from the top
+		const WordDiffSource source = MakeSource(
+			{ _T("abc\n"), _T("def\n") },
+			{ _T("uvw\n"), _T("xyz\n"), _T("123\n") });
+		const std::vector<WordDiff> worddiffs = { WordDiff(0, 4, 0, 1, 0, 4, 0, 2) };
+		const std::vector<LineMatch> matches = GetLineMatches(source, worddiffs, 0, 1);
+		EXPECT_TRUE(matches.empty());
+		EXPECT_TRUE(GetAlignedLines(matches, 3).empty());
+	}
+
+}  // namespace